@@ -5,21 +5,29 @@
 #include "crpropa/Candidate.h"
 #include "crpropa/Common.h"
 #include "crpropa/Cosmology.h"
+#include "crpropa/DataTable.h"
+#include "crpropa/DiscreteSampler.h"
 #include "crpropa/EmissionMap.h"
 #include "crpropa/Geometry.h"
 #include "crpropa/Grid.h"
+#include "crpropa/GridKernels.h"
 #include "crpropa/GridTools.h"
+#include "crpropa/InterpolationTable.h"
 #include "crpropa/Logging.h"
+#include "crpropa/MemoryMappedFile.h"
 #include "crpropa/Module.h"
 #include "crpropa/ModuleList.h"
+#include "crpropa/OctreeGrid.h"
 #include "crpropa/ParticleID.h"
 #include "crpropa/ParticleMass.h"
 #include "crpropa/ParticleState.h"
 #include "crpropa/PhotonBackground.h"
 #include "crpropa/PhotonPropagation.h"
 #include "crpropa/Random.h"
+#include "crpropa/RateTableBuilder.h"
 #include "crpropa/Referenced.h"
 #include "crpropa/Source.h"
+#include "crpropa/TableRegistry.h"
 #include "crpropa/Units.h"
 #include "crpropa/Variant.h"
 #include "crpropa/Vector3.h"
@@ -29,6 +37,7 @@
 #include "crpropa/module/Acceleration.h"
 #include "crpropa/module/Boundary.h"
 #include "crpropa/module/BreakCondition.h"
+#include "crpropa/module/ContinuousEnergyLoss.h"
 #include "crpropa/module/DiffusionSDE.h"
 #include "crpropa/module/EMCascade.h"
 #include "crpropa/module/EMDoublePairProduction.h"
@@ -49,14 +58,17 @@
 #include "crpropa/module/PropagationBP.h"
 #include "crpropa/module/PropagationCK.h"
 #include "crpropa/module/Redshift.h"
+#include "crpropa/module/ResponseMatrix.h"
 #include "crpropa/module/RestrictToRegion.h"
 #include "crpropa/module/SimplePropagation.h"
 #include "crpropa/module/SynchrotronRadiation.h"
 #include "crpropa/module/TextOutput.h"
 #include "crpropa/module/Tools.h"
+#include "crpropa/module/WeightWindow.h"
 
 #include "crpropa/magneticField/AMRMagneticField.h"
 #include "crpropa/magneticField/ArchimedeanSpiralField.h"
+#include "crpropa/magneticField/CachedMagneticField.h"
 #include "crpropa/magneticField/JF12Field.h"
 #include "crpropa/magneticField/JF12FieldSolenoidal.h"
 #include "crpropa/magneticField/MagneticField.h"
@@ -70,6 +82,7 @@
 #include "crpropa/magneticField/turbulentField/HelicalGridTurbulence.h"
 #include "crpropa/magneticField/turbulentField/PlaneWaveTurbulence.h"
 #include "crpropa/magneticField/turbulentField/SimpleGridTurbulence.h"
+#include "crpropa/magneticField/turbulentField/TiledGridTurbulence.h"
 #include "crpropa/magneticField/turbulentField/TurbulentField.h"
 
 #include "crpropa/advectionField/AdvectionField.h"
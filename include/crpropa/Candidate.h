@@ -121,6 +121,14 @@ public:
 	inline void addSecondary(ref_ptr<Candidate> c) { addSecondary(c.get()); };
 	void addSecondary(int id, double energy, double w = 1.);
 	void addSecondary(int id, double energy, Vector3d position, double w = 1.);
+	/**
+	 Add a secondary with weighted sampling (thinning) at the given position.
+	 The secondary is added with probability f^thinning and the weight 1 / f^thinning.
+	 @param f			fraction of the energy of this candidate carried by the secondary
+	 @param thinning	thinning exponent (0: all secondaries are added; 1: maximum thinning)
+	 @returns true if the secondary was added
+	 */
+	bool addThinnedSecondary(int id, double energy, Vector3d position, double f, double thinning);
 	void clearSecondaries();
 
 	std::string getDescription() const;
@@ -1,6 +1,8 @@
 #ifndef CRPROPA_COSMOLOGY_H
 #define CRPROPA_COSMOLOGY_H
 
+#include <vector>
+
 namespace crpropa {
 /**
  * \addtogroup PhysicsDefinitions
@@ -16,6 +18,10 @@ namespace crpropa {
  Set the cosmological parameters for a flat universe. To ensure flatness omegaL is set to 1 - omegaMatter
  @param hubbleParameter	dimensionless Hubble parameter, default = 0.673
  @param omegaMatter		matter parameter, default = 0.315
+
+ The distance tables are computed before the new parameters take effect, so
+ the parameters can be changed while other threads use the functions below.
+ The tables of the previous parameters are freed once no thread uses them.
  */
 void setCosmologyParameters(double hubbleParameter, double omegaMatter);
 
@@ -76,6 +82,19 @@ double comoving2LightTravelDistance(double distance);
 // Conversion from light travel distance to comoving distance.
 double lightTravel2ComovingDistance(double distance);
 
+/**
+ Batch variants of the conversions above. All values are converted with the
+ same cosmological parameters, also when they are changed concurrently.
+ */
+std::vector<double> comovingDistance2Redshift(const std::vector<double> &distances);
+std::vector<double> redshift2ComovingDistance(const std::vector<double> &redshifts);
+std::vector<double> luminosityDistance2Redshift(const std::vector<double> &distances);
+std::vector<double> redshift2LuminosityDistance(const std::vector<double> &redshifts);
+std::vector<double> lightTravelDistance2Redshift(const std::vector<double> &distances);
+std::vector<double> redshift2LightTravelDistance(const std::vector<double> &redshifts);
+std::vector<double> comoving2LightTravelDistance(const std::vector<double> &distances);
+std::vector<double> lightTravel2ComovingDistance(const std::vector<double> &distances);
+
 /** @}*/
 } // namespace crpropa
 
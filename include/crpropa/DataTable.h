@@ -0,0 +1,89 @@
+#ifndef CRPROPA_DATATABLE_H
+#define CRPROPA_DATATABLE_H
+
+#include "crpropa/MemoryMappedFile.h"
+#include "crpropa/Referenced.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace crpropa {
+/**
+ * \addtogroup Core
+ * @{
+ */
+
+/**
+ @class DataTable
+ @brief Numeric text table with a memory-mapped binary cache
+
+ Holds the numbers of a whitespace separated text file row by row. Empty lines
+ and lines starting with '#' are skipped, rows may differ in length.
+
+ Parsing the large interaction tables is slow, therefore load() compiles the
+ text file once into a binary cache file and maps this file into memory on
+ all following calls. The mapping is read-only and shared between all
+ processes on a node, so that after the first run the tables are available
+ almost immediately. The cache stores size, modification time and a checksum
+ of the text file as well as a format version and is rebuilt when any of
+ them do not match. If only the modification time differs, e.g. after a copy,
+ the checksum decides and the stored time is updated, so that the text file is
+ read at most once for this.
+
+ The cache file is written next to the text file (filename + ".cache") or,
+ if the environment variable CRPROPA_CACHE_PATH is set, into that directory.
+ If the cache cannot be written, the table is parsed from the text file.
+ */
+class DataTable: public Referenced {
+private:
+	const uint64_t *offsets; // start of each row in values, nRows + 1 entries
+	const double *values;
+	size_t nRows, nValues;
+
+	// storage if the table was parsed instead of mapped
+	std::vector<uint64_t> ownOffsets;
+	std::vector<double> ownValues;
+
+	// memory mapping of the cache file
+	ref_ptr<MemoryMappedFile> file;
+
+	DataTable();
+	DataTable(const DataTable &);
+	DataTable &operator=(const DataTable &);
+
+	void parseText(const std::string &content, const std::string &filename);
+	bool mapCache(const std::string &cachename, const std::string &filename);
+	bool writeCache(const std::string &cachename, uint64_t sourceSize,
+			int64_t sourceTime, uint64_t sourceChecksum) const;
+
+public:
+	~DataTable();
+
+	/// Load a text table, using (and if needed creating) the binary cache
+	static ref_ptr<DataTable> load(const std::string &filename);
+	/// Parse a text table without using the cache
+	static ref_ptr<DataTable> parse(const std::string &filename);
+	/// Name of the cache file used for the given text file
+	static std::string getCacheFilename(const std::string &filename);
+
+	/// Number of (non comment) rows
+	size_t rows() const;
+	/// Number of values in the given row
+	size_t columns(size_t row) const;
+	/// Pointer to the values of the given row
+	const double *row(size_t row) const;
+	double operator()(size_t row, size_t column) const;
+
+	/// Total number of values
+	size_t size() const;
+	/// Pointer to all values, row after row
+	const double *data() const;
+	/// True if the table is mapped from a cache file
+	bool isMapped() const;
+};
+
+/** @}*/
+} // namespace crpropa
+
+#endif // CRPROPA_DATATABLE_H
@@ -0,0 +1,82 @@
+#ifndef CRPROPA_DISCRETESAMPLER_H
+#define CRPROPA_DISCRETESAMPLER_H
+
+#include "crpropa/Random.h"
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+
+namespace crpropa {
+/**
+ * \addtogroup Core
+ * @{
+ */
+
+/**
+ @class DiscreteSampler
+ @brief Draw random bins from a discrete distribution in constant time.
+
+ Implements Walker's alias method with the construction of Vose
+ (IEEE Trans. Softw. Eng. 17, 972, 1991). The alias table is built once in
+ O(n) and every draw then costs one random number and one table lookup,
+ independent of the number of bins. Bin i is drawn with probability
+ w_i / sum(w), bins with zero weight are never drawn.
+
+ Weights can be given at once (setWeights, setCDF) or appended one by one
+ (add). In the latter case the table is rebuilt lazily on the first draw or
+ query after the change, so filling a sampler with many entries stays linear
+ in the number of entries. The rebuild is serialized, so a filled sampler can
+ be shared by several threads; modifying it while other threads draw from it
+ is not supported.
+ */
+class DiscreteSampler {
+private:
+	std::vector<double> weights;
+	mutable std::vector<double> probability; // acceptance probability of each bin
+	mutable std::vector<uint32_t> alias; // alias bin used on rejection
+	mutable double totalWeight;
+	mutable std::atomic<bool> dirty; // set by add, cleared once the tables are complete
+
+	void build() const;
+	void update() const;
+
+public:
+	DiscreteSampler();
+	/** Constructor
+	 @param weights	(unnormalized) weights of the bins
+	 */
+	DiscreteSampler(const std::vector<double> &weights);
+	DiscreteSampler(const DiscreteSampler &other);
+	DiscreteSampler &operator=(const DiscreteSampler &other);
+
+	/// Set the (unnormalized) weights of all bins
+	void setWeights(const std::vector<double> &weights);
+	void setWeights(const std::vector<float> &weights);
+	/// Set the bins from a (unnormalized) cumulative distribution function
+	/// without leading zero, as used in Random::randBin
+	void setCDF(const std::vector<double> &cdf);
+	void setCDF(const std::vector<float> &cdf);
+	/// Append a bin with the given (unnormalized) weight
+	void add(double weight);
+	/// Remove all bins
+	void clear();
+
+	/// Draw a random bin using the given random number generator
+	size_t sample(Random &random) const;
+	/// Draw a random bin using the thread local random number generator
+	size_t sample() const;
+
+	/// Number of bins
+	size_t size() const;
+	bool empty() const;
+	/// Sum of all weights
+	double getTotalWeight() const;
+	/// Probability to draw bin i
+	double getProbability(size_t i) const;
+};
+
+/** @}*/
+} // namespace crpropa
+
+#endif // CRPROPA_DISCRETESAMPLER_H
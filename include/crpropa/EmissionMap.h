@@ -3,6 +3,7 @@
 
 #include "Referenced.h"
 #include "Candidate.h"
+#include "DiscreteSampler.h"
 
 namespace crpropa {
 
@@ -17,8 +18,9 @@ private:
 	mutable bool dirty;
 	std::vector<double> pdf;
 	mutable std::vector<double> cdf;
+	mutable DiscreteSampler sampler;
 
-	/** Calculate the cdf from the pdf */
+	/** Calculate the cdf and the sampling table from the pdf */
 	void updateCdf() const;
 
 public:
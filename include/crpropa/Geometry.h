@@ -32,6 +32,14 @@ public:
 	 @param point	vector corresponding to the point to which compute the normal vector
 	 */
 	virtual Vector3d normal(const Vector3d& point) const = 0;
+	/** Returns the distance along a straight line from a point to the next
+	 crossing of the surface, or infinity if the line does not cross it.
+	 Crossings at the point itself are not counted. The default implementation
+	 returns the absolute distance of the point, which is a lower bound.
+	 @param point		start of the line
+	 @param direction	unit vector of the direction of the line
+	 */
+	virtual double intersectionDistance(const Vector3d& point, const Vector3d& direction) const;
 	virtual std::string getDescription() const {return "Surface without description.";};
 };
 
@@ -48,6 +56,7 @@ public:
 	Plane(const Vector3d& x0, const Vector3d& n);
 	virtual double distance(const Vector3d &x) const;
 	virtual Vector3d normal(const Vector3d& point) const;
+	virtual double intersectionDistance(const Vector3d& point, const Vector3d& direction) const;
 	virtual std::string getDescription() const;
 };
 
@@ -64,6 +73,7 @@ public:
 	Sphere(const Vector3d& center, double radius);
 	virtual double distance(const Vector3d &point) const;
 	virtual Vector3d normal(const Vector3d& point) const;
+	virtual double intersectionDistance(const Vector3d& point, const Vector3d& direction) const;
 	virtual std::string getDescription() const;
 };
 
@@ -79,6 +89,7 @@ public:
 	ParaxialBox(const Vector3d& corner, const Vector3d& size);
 	virtual double distance(const Vector3d &point) const;
 	virtual Vector3d normal(const Vector3d& point) const;
+	virtual double intersectionDistance(const Vector3d& point, const Vector3d& direction) const;
 	virtual std::string getDescription() const;
 };
 
@@ -1,12 +1,21 @@
 #ifndef CRPROPA_GRID_H
 #define CRPROPA_GRID_H
 
+#include "crpropa/GridKernels.h"
+#include "crpropa/MemoryMappedFile.h"
 #include "crpropa/Referenced.h"
 #include "crpropa/Vector3.h"
 
 #include "kiss/string.h"
 #include "kiss/logger.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
 #include <vector>
 #include <type_traits>
 #if HAVE_SIMD
@@ -56,6 +65,42 @@ inline void reflectiveClamp(double x, int n, int &lo, int &hi, double &res) {
 	}
 }
 
+/** IEEE 754 half precision of a float, rounded to nearest even */
+inline uint16_t floatToHalf(float f) {
+	uint32_t x;
+	std::memcpy(&x, &f, sizeof(x));
+	uint16_t sign = (x >> 16) & 0x8000;
+	x &= 0x7fffffff;
+	if (x >= 0x7f800000) // inf and nan
+		return sign | 0x7c00 | ((x > 0x7f800000) ? 0x200 : 0);
+	if (x >= 0x477ff000) // overflow
+		return sign | 0x7c00;
+	if (x < 0x38800000) // subnormal, in units of 2^-24
+		return sign | uint16_t(lrintf(std::fabs(f) * 16777216.f));
+	// rebias the exponent and round the mantissa to 10 bits
+	x += 0x0fff + ((x >> 13) & 1);
+	return sign | uint16_t((x - 0x38000000) >> 13);
+}
+
+/** Float of an IEEE 754 half precision value */
+inline float halfToFloat(uint16_t h) {
+	uint32_t sign = uint32_t(h & 0x8000) << 16;
+	uint32_t em = h & 0x7fff;
+	uint32_t x;
+	if (em >= 0x7c00) {
+		x = sign | 0x7f800000 | ((em & 0x3ff) << 13);
+	} else if (em >= 0x400) {
+		x = sign | ((em << 13) + 0x38000000);
+	} else {
+		float f = em * 5.9604645e-8f; // subnormal, 2^-24
+		std::memcpy(&x, &f, sizeof(x));
+		x |= sign;
+	}
+	float f;
+	std::memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
 /** Symmetrical round */
 inline double round(double r) {
 	return (r > 0.0) ? floor(r + 0.5) : ceil(r - 0.5);
@@ -66,6 +111,24 @@ inline double round(double r) {
  * @{
  */
 
+/** Storage of the grid values (Grid::setStorageType)
+FULL_PRECISION: values of the grid type (default)
+HALF_PRECISION: IEEE half precision of the values divided by the largest component in the block
+QUANTIZED_INT16: 16 bit integers, scaled to the largest component in the block */
+enum storageType {
+  FULL_PRECISION = 0,
+  HALF_PRECISION,
+  QUANTIZED_INT16
+};
+
+/** Memory layout of the grid values (Grid::setLayout)
+ROW_MAJOR: z-index changing the fastest, as in the grid files (default)
+BRICKED: bricks of 8^3 grid points in row-major order, the points in a brick in Z-order (Morton order) */
+enum layoutType {
+  ROW_MAJOR = 0,
+  BRICKED
+};
+
 /**
  @class GridProperties
  @brief Combines parameters that uniquely define Grid class
@@ -124,6 +187,25 @@ public:
 	}
 };
 
+/**
+ @class GridFileHeader
+ @brief Header of the binary grid files written by Grid::save
+
+ The header is followed by the values of the grid points in the order of
+ Grid::get, in the byte order of the machine that wrote the file.
+ It is 128 bytes long, so that the values are aligned when the file is mapped.
+ */
+struct GridFileHeader {
+	char magic[8]; // "CRPGRID1"
+	uint64_t valueSize; // bytes per grid point, e.g. 12 for Grid3f
+	uint64_t Nx, Ny, Nz;
+	double origin[3];
+	double spacing[3];
+	int32_t reflective;
+	int32_t interpolation;
+	char reserved[32];
+};
+
 /**
  @class Grid
  @brief Template class for fields on a periodic grid with trilinear interpolation
@@ -132,10 +214,37 @@ public:
  Values are calculated by trilinear interpolation of the surrounding 8 grid points.
  The grid is periodically (default) or reflectively extended.
  The grid sample positions are at 1/2 * size/N, 3/2 * size/N ... (2N-1)/2 * size/N.
+
+ A grid can also be backed by a read-only memory mapped file instead of
+ memory (see the constructors with a filename). The operating system then
+ reads only the pages that are accessed and shares them between all processes
+ on a machine.
+
+ Grid1f and Grid3f can store their values with 16 bits per component instead
+ (see setStorageType), which halves the memory and the memory traffic of the
+ interpolation. The values are stored relative to the largest component in
+ blocks of consecutive grid points and decoded on the fly when read.
+
+ Mapped and 16 bit grids are read-only: the non-const get, setValue and
+ getGrid throw a std::runtime_error. To modify such a grid, convert it
+ explicitly with detach() first, which copies or decodes all values into
+ memory at full precision.
+
+ The values can be arranged in bricks of 8^3 grid points (see setLayout),
+ so that the neighbours of an interpolation are close in memory. The grid
+ is then padded to multiples of 8 points along each axis.
  */
 template<typename T>
 class Grid: public Referenced {
 	std::vector<T> grid;
+	ref_ptr<MemoryMappedFile> file; /**< Mapped file holding the values, if any */
+	const T *mapped; /**< Values in the mapped file, 0 if the values are held in memory */
+	storageType storage; /**< Storage of the values */
+	std::vector<uint16_t> packed; /**< 16 bit components for HALF_PRECISION and QUANTIZED_INT16 */
+	std::vector<float> blockScale; /**< Scale of the packed components per block */
+	static const size_t blockShift = 10; /**< 2^blockShift grid points per block */
+	layoutType layout; /**< Memory layout of the values */
+	size_t NBy, NBz; /**< Number of bricks along y and z for the BRICKED layout */
 	size_t Nx, Ny, Nz; /**< Number of grid points */
 	Vector3d origin; /**< Origin of the volume that is represented by the grid. */
 	Vector3d gridOrigin; /**< Grid origin */
@@ -154,6 +263,7 @@ public:
 		setGridSize(N, N, N);
 		setSpacing(Vector3d(spacing));
 		setReflective(false);
+		setInterpolationType(TRILINEAR);
 	}
 
 	/** Constructor for non-cubic grid
@@ -168,6 +278,7 @@ public:
 		setGridSize(Nx, Ny, Nz);
 		setSpacing(Vector3d(spacing));
 		setReflective(false);
+		setInterpolationType(TRILINEAR);
 	}
 
 	/** Constructor for non-cubic grid with spacing vector
@@ -182,6 +293,7 @@ public:
 		setGridSize(Nx, Ny, Nz);
 		setSpacing(spacing);
 		setReflective(false);
+		setInterpolationType(TRILINEAR);
 	}
 
 	/** Constructor for GridProperties
@@ -192,6 +304,154 @@ public:
 		setGridSize(p.Nx, p.Ny, p.Nz);
 	}
 
+	/** Constructor mapping a file written by save()
+	 @param filename	grid file with a GridFileHeader
+	 */
+	Grid(const std::string &filename) : mapped(0) {
+		ref_ptr<MemoryMappedFile> f = new MemoryMappedFile(filename);
+		GridFileHeader header;
+		if (f->size() < sizeof(header))
+			throw std::runtime_error("Grid: " + filename + " is not a grid file");
+		std::memcpy(&header, f->data(), sizeof(header));
+		if (std::strncmp(header.magic, "CRPGRID1", 8) != 0)
+			throw std::runtime_error("Grid: " + filename + " is not a grid file");
+		if (header.valueSize != sizeof(T))
+			throw std::runtime_error("Grid: value type of " + filename + " does not match");
+		origin = Vector3d(header.origin);
+		spacing = Vector3d(header.spacing);
+		reflective = header.reflective;
+		ipolType = interpolationType(header.interpolation);
+		setGridSize(header.Nx, header.Ny, header.Nz);
+		map(f, sizeof(header));
+	}
+
+	/** Constructor mapping a raw file without header, as written by dumpGrid
+	 @param p			GridProperties instance
+	 @param filename	raw file of the grid values
+	 */
+	Grid(const GridProperties &p, const std::string &filename) :
+		mapped(0), origin(p.origin), spacing(p.spacing), reflective(p.reflective), ipolType(p.ipol) {
+		setGridSize(p.Nx, p.Ny, p.Nz);
+		map(new MemoryMappedFile(filename), 0);
+	}
+
+	/** Save the grid to a binary file with a GridFileHeader, which can be mapped with Grid(filename) */
+	void save(const std::string &filename) const {
+		std::ofstream out(filename.c_str(), std::ios::binary);
+		if (not out.good())
+			throw std::runtime_error("Grid: could not open " + filename);
+		GridFileHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, "CRPGRID1", 8);
+		header.valueSize = sizeof(T);
+		header.Nx = Nx;
+		header.Ny = Ny;
+		header.Nz = Nz;
+		for (int i = 0; i < 3; i++) {
+			header.origin[i] = origin.data[i];
+			header.spacing[i] = spacing.data[i];
+		}
+		header.reflective = reflective;
+		header.interpolation = ipolType;
+		out.write((const char*) &header, sizeof(header));
+		if ((storage == FULL_PRECISION) and (layout == ROW_MAJOR)) {
+			out.write((const char*) values(), sizeof(T) * Nx * Ny * Nz);
+		} else {
+			for (size_t ix = 0; ix < Nx; ix++)
+				for (size_t iy = 0; iy < Ny; iy++)
+					for (size_t iz = 0; iz < Nz; iz++) {
+						T v = get(ix, iy, iz);
+						out.write((const char*) &v, sizeof(T));
+					}
+		}
+		if (not out.good())
+			throw std::runtime_error("Grid: could not write " + filename);
+	}
+
+	/** True if the values are read from a mapped file */
+	bool isMapped() const {
+		return mapped != 0;
+	}
+
+	/** Release the pages of the mapped file holding the grid points with
+	 ix in [ix0, ix1) from the memory of the process, e.g. after reading them
+	 once. They are read again from the file when accessed. */
+	void releaseMapped(size_t ix0, size_t ix1) const {
+		if (mapped)
+			file->release(mapped + ix0 * Ny * Nz, (ix1 - ix0) * Ny * Nz * sizeof(T));
+	}
+
+	/** Change the storage of the values, HALF_PRECISION and QUANTIZED_INT16 only for Grid1f and Grid3f
+	 @returns the rms deviation of the stored from the previous values
+	 */
+	double setStorageType(storageType s) {
+		if (s == storage)
+			return 0;
+		detach();
+		if (s == FULL_PRECISION)
+			return 0;
+		if ((s != HALF_PRECISION) and (s != QUANTIZED_INT16))
+			throw std::runtime_error("Grid: unknown storage type");
+		if (not (std::is_same<T, float>::value or std::is_same<T, Vector3f>::value))
+			throw std::runtime_error("Grid: 16 bit storage only for Grid1f and Grid3f");
+
+		const size_t nc = sizeof(T) / sizeof(float);
+		const size_t n = grid.size();
+		const size_t nBlocks = (n + (size_t(1) << blockShift) - 1) >> blockShift;
+		const float *v = reinterpret_cast<const float*>(grid.data());
+		packed.resize(n * nc);
+		blockScale.resize(nBlocks);
+		storage = s;
+
+		for (size_t b = 0; b < nBlocks; b++) {
+			size_t i0 = (b << blockShift) * nc;
+			size_t i1 = std::min(n, (b + 1) << blockShift) * nc;
+			float vmax = 0;
+			for (size_t i = i0; i < i1; i++)
+				vmax = std::max(vmax, std::fabs(v[i]));
+			blockScale[b] = (s == QUANTIZED_INT16) ? vmax / 32767 : vmax;
+			float inv = (vmax > 0) ? 1 / vmax : 0;
+			for (size_t i = i0; i < i1; i++) {
+				if (s == QUANTIZED_INT16)
+					packed[i] = uint16_t(int16_t(lrintf(v[i] * inv * 32767)));
+				else
+					packed[i] = floatToHalf(v[i] * inv);
+			}
+		}
+
+		double sum2 = 0;
+		for (size_t i = 0; i < n; i++) {
+			T d = decode(i) - grid[i];
+			sum2 += squaredNorm(d);
+		}
+		std::vector<T>().swap(grid);
+		return std::sqrt(sum2 / (Nx * Ny * Nz));
+	}
+
+	storageType getStorageType() const {
+		return storage;
+	}
+
+	/** Change the memory layout of the values. The values are held in memory at full precision afterwards. */
+	void setLayout(layoutType l) {
+		if (l == layout)
+			return;
+		if ((l != ROW_MAJOR) and (l != BRICKED))
+			throw std::runtime_error("Grid: unknown layout");
+		detach();
+		std::vector<T> v(l == BRICKED ? ((Nx + 7) / 8) * ((Ny + 7) / 8) * ((Nz + 7) / 8) * 512 : Nx * Ny * Nz);
+		for (size_t ix = 0; ix < Nx; ix++)
+			for (size_t iy = 0; iy < Ny; iy++)
+				for (size_t iz = 0; iz < Nz; iz++)
+					v[toIndex(ix, iy, iz, l)] = grid[toIndex(ix, iy, iz)];
+		grid.swap(v);
+		layout = l;
+	}
+
+	layoutType getLayout() const {
+		return layout;
+	}
+
 	void setOrigin(Vector3d origin) {
 		this->origin = origin;
 		this->gridOrigin = origin + spacing/2;
@@ -202,6 +462,14 @@ public:
 		this->Nx = Nx;
 		this->Ny = Ny;
 		this->Nz = Nz;
+		file = 0;
+		mapped = 0;
+		storage = FULL_PRECISION;
+		std::vector<uint16_t>().swap(packed);
+		std::vector<float>().swap(blockScale);
+		layout = ROW_MAJOR;
+		NBy = (Ny + 7) / 8;
+		NBz = (Nz + 7) / 8;
 		grid.resize(Nx * Ny * Nz);
 		setOrigin(origin);
 	}
@@ -245,9 +513,11 @@ public:
 		return Nz;
 	}
 
-	/** Calculates the total size of the grid in bytes */
+	/** Calculates the total size of the grid in bytes, including the values in a mapped file */
 	size_t getSizeOf() const {
-		return sizeof(grid) + (sizeof(grid[0]) * grid.size());
+		if (storage != FULL_PRECISION)
+			return sizeof(grid) + sizeof(uint16_t) * packed.size() + sizeof(float) * blockScale.size();
+		return sizeof(grid) + (sizeof(T) * std::max(grid.size(), Nx * Ny * Nz));
 	}
 
 	Vector3d getSpacing() const {
@@ -270,44 +540,109 @@ public:
 		return trilinearInterpolate(position);
 	}
 
-	/** Inspector & Mutator */
+	/** Interpolate the grid at several positions with the set interpolation type.
+	  Periodic Grid1f and Grid3f in memory order ROW_MAJOR at full precision use
+	  the vectorised kernels for the trilinear and nearest neighbour interpolation
+	  (see setGridKernel), which give exactly the values of the interpolation at
+	  a single position. The latter is not vectorised.
+	  @param positions	array of n positions
+	  @param values		array of n values, output
+	  @param n			number of positions
+	 */
+	void interpolate(const Vector3d *positions, T *values, size_t n) const {
+		if (ipolType == TRICUBIC) {
+			for (size_t i = 0; i < n; i++)
+				values[i] = tricubicInterpolate(T(), positions[i]);
+		} else if (ipolType == NEAREST_NEIGHBOUR) {
+			for (size_t i = kernelInterpolate(positions, values, n); i < n; i++)
+				values[i] = closestValue(positions[i]);
+		} else {
+			size_t m = kernelInterpolate(positions, values, n);
+			trilinearInterpolate(positions + m, values + m, n - m);
+		}
+	}
+
+	/** Inspector & Mutator, only for grids held in memory at full precision */
 	T &get(size_t ix, size_t iy, size_t iz) {
-		return grid[ix * Ny * Nz + iy * Nz + iz];
+		checkWritable();
+		return grid[toIndex(ix, iy, iz)];
 	}
 
-	/** Inspector */
-	const T &get(size_t ix, size_t iy, size_t iz) const {
-		return grid[ix * Ny * Nz + iy * Nz + iz];
+	/** Inspector, returns a copy since the value may be decoded from 16 bits */
+	T get(size_t ix, size_t iy, size_t iz) const {
+		return decode(toIndex(ix, iy, iz));
 	}
 
-	const T &periodicGet(size_t ix, size_t iy, size_t iz) const {
+	T periodicGet(size_t ix, size_t iy, size_t iz) const {
 		ix = periodicBoundary(ix, Nx);
 		iy = periodicBoundary(iy, Ny);
 		iz = periodicBoundary(iz, Nz);
-		return grid[ix * Ny * Nz + iy * Nz + iz];
+		return decode(toIndex(ix, iy, iz));
 	}
 
-	const T &reflectiveGet(size_t ix, size_t iy, size_t iz) const {
+	T reflectiveGet(size_t ix, size_t iy, size_t iz) const {
 		ix = reflectiveBoundary(ix, Nx);
 		iy = reflectiveBoundary(iy, Ny);
 		iz = reflectiveBoundary(iz, Nz);
-		return grid[ix * Ny * Nz + iy * Nz + iz];
+		return decode(toIndex(ix, iy, iz));
 	}
 
 	T getValue(size_t ix, size_t iy, size_t iz) {
-		return grid[ix * Ny * Nz + iy * Nz + iz];
+		return decode(toIndex(ix, iy, iz));
 	}
 
 	void setValue(size_t ix, size_t iy, size_t iz, T value) {
-		grid[ix * Ny * Nz + iy * Nz + iz] = value;
+		checkWritable();
+		grid[toIndex(ix, iy, iz)] = value;
 	}
 
-	/** Return a reference to the grid values */
+	/** Return a reference to the grid values, in row-major order.
+	 Only for grids held in memory at full precision; a BRICKED grid is
+	 converted to ROW_MAJOR. */
 	std::vector<T> &getGrid() {
+		checkWritable();
+		setLayout(ROW_MAJOR);
 		return grid;
 	}
 
-	/** Position of the grid point of a given index */
+	/** Pointer to the values in the order of get(), in memory or in the mapped file.
+	 Only for full precision storage. */
+	const T *values() const {
+		return mapped ? mapped : grid.data();
+	}
+
+	/** True if the values are held in memory at full precision and can be modified */
+	bool isWritable() const {
+		return (mapped == 0) and (storage == FULL_PRECISION);
+	}
+
+	/** Copy the values of a mapped file into memory, or decode the values at
+	 full precision. This needs the memory of the full grid at full precision.
+	 Like all non-const methods it must not be called while other threads use
+	 the grid. */
+	void detach() {
+		if (mapped) {
+			grid.assign(mapped, mapped + Nx * Ny * Nz);
+			mapped = 0;
+			file = 0;
+		}
+		if (storage != FULL_PRECISION) {
+			grid.resize(packed.size() / (sizeof(T) / sizeof(float)));
+			for (size_t i = 0; i < grid.size(); i++)
+				grid[i] = decode(i);
+			storage = FULL_PRECISION;
+			std::vector<uint16_t>().swap(packed);
+			std::vector<float>().swap(blockScale);
+		}
+	}
+
+	/** Throw unless the values can be modified, see detach() */
+	void checkWritable() const {
+		if (not isWritable())
+			throw std::runtime_error("Grid: values are mapped or stored with 16 bits, call detach() before modifying them");
+	}
+
+	/** Position of the grid point of a given index in row-major order */
 	Vector3d positionFromIndex(int index) const {
 		int ix = index / (Ny * Nz);
 		int iy = (index / Nz) % Ny;
@@ -341,19 +676,98 @@ public:
 	}
 
 private:
+	/** Index of a grid point in the values */
+	size_t toIndex(size_t ix, size_t iy, size_t iz) const {
+		return toIndex(ix, iy, iz, layout);
+	}
+
+	size_t toIndex(size_t ix, size_t iy, size_t iz, layoutType l) const {
+		if (l == ROW_MAJOR)
+			return ix * Ny * Nz + iy * Nz + iz;
+		// bits of the brick coordinates at the positions 0, 3 and 6
+		static const size_t spread[8] = {0, 1, 8, 9, 64, 65, 72, 73};
+		size_t brick = ((ix >> 3) * NBy + (iy >> 3)) * NBz + (iz >> 3);
+		return (brick << 9) | (spread[ix & 7] << 2) | (spread[iy & 7] << 1) | spread[iz & 7];
+	}
+
+	/** Value of the grid point with the given index in any storage */
+	T decode(size_t i) const {
+		if (storage == FULL_PRECISION)
+			return values()[i];
+		else if (storage == QUANTIZED_INT16)
+			return decodePacked(i, Int16Decoder());
+		else
+			return decodePacked(i, HalfDecoder());
+	}
+
+	struct Int16Decoder {
+		float operator()(uint16_t p) const {
+			return int16_t(p);
+		}
+	};
+
+	struct HalfDecoder {
+		float operator()(uint16_t p) const {
+			return halfToFloat(p);
+		}
+	};
+
+	template<typename D>
+	T decodePacked(size_t i, D decoder) const {
+		const size_t nc = sizeof(T) / sizeof(float);
+		const uint16_t *p = &packed[i * nc];
+		float scale = blockScale[i >> blockShift];
+		float c[nc];
+		for (size_t j = 0; j < nc; j++)
+			c[j] = decoder(p[j]) * scale;
+		T v;
+		fromComponents(c, v);
+		return v;
+	}
+
+	static void fromComponents(const float *c, float &v) {
+		v = c[0];
+	}
+
+	static void fromComponents(const float *c, Vector3f &v) {
+		v = Vector3f(c[0], c[1], c[2]);
+	}
+
+	template<typename U>
+	static void fromComponents(const float *, U &) {
+		throw std::runtime_error("Grid: 16 bit storage only for Grid1f and Grid3f");
+	}
+
+	template<typename U>
+	static double squaredNorm(const Vector3<U> &v) {
+		return v.getR2();
+	}
+
+	static double squaredNorm(double v) {
+		return v * v;
+	}
+
+	void map(ref_ptr<MemoryMappedFile> f, size_t offset) {
+		if (f->size() != offset + sizeof(T) * Nx * Ny * Nz)
+			throw std::runtime_error("Grid: file and grid size do not match in " + f->getFilename());
+		std::vector<T>().swap(grid);
+		file = f;
+		mapped = reinterpret_cast<const T*>(f->data() + offset);
+	}
+
 	#ifdef HAVE_SIMD
 	__m128 simdperiodicGet(size_t ix, size_t iy, size_t iz) const {
 		ix = periodicBoundary(ix, Nx);
 		iy = periodicBoundary(iy, Ny);
 		iz = periodicBoundary(iz, Nz);
-		return convertVector3fToSimd(grid[ix * Ny * Nz + iy * Nz + iz]);
+		return convertVector3fToSimd(decode(toIndex(ix, iy, iz)));
 	}
 
 	__m128 simdreflectiveGet(size_t ix, size_t iy, size_t iz) const {
 		ix = reflectiveBoundary(ix, Nx);
 		iy = reflectiveBoundary(iy, Ny);
 		iz = reflectiveBoundary(iz, Nz);
-		return convertVector3fToSimd(grid[ix * Ny * Nz + iy * Nz + iz]);
+		return convertVector3fToSimd(decode(toIndex(ix, iy, iz)));
 	}
 
 	__m128 convertVector3fToSimd(const Vector3f v) const {
@@ -472,8 +886,9 @@ private:
 		return result;
 	}
 
-	/** Interpolate the grid trilinear at a given position */
-	T trilinearInterpolate(const Vector3d &position) const {
+	/** Indices of the 8 neighbours of a position and the factors of their
+	  trilinear weights, three per neighbour */
+	void trilinearWeights(const Vector3d &position, size_t *index, double *w) const {
 		/** position on a unit grid */
 		Vector3d r = (position - gridOrigin) / spacing;
 
@@ -504,19 +919,122 @@ private:
 		double fZ1 = 1 - fZ0;
 
 		/** trilinear interpolation (see http://paulbourke.net/miscellaneous/interpolation) */
-		T b(0.);
-		b += get(iX0, iY0, iZ0) * fX1 * fY1 * fZ1;
-		b += get(iX1, iY0, iZ0) * fX0 * fY1 * fZ1;
-		b += get(iX0, iY1, iZ0) * fX1 * fY0 * fZ1;
-		b += get(iX0, iY0, iZ1) * fX1 * fY1 * fZ0;
-		b += get(iX1, iY0, iZ1) * fX0 * fY1 * fZ0;
-		b += get(iX0, iY1, iZ1) * fX1 * fY0 * fZ0;
-		b += get(iX1, iY1, iZ0) * fX0 * fY0 * fZ1;
-		b += get(iX1, iY1, iZ1) * fX0 * fY0 * fZ0;
+		const int iX[8] = {iX0, iX1, iX0, iX0, iX1, iX0, iX1, iX1};
+		const int iY[8] = {iY0, iY0, iY1, iY0, iY0, iY1, iY1, iY1};
+		const int iZ[8] = {iZ0, iZ0, iZ0, iZ1, iZ1, iZ1, iZ0, iZ1};
+		const double fX[8] = {fX1, fX0, fX1, fX1, fX0, fX1, fX0, fX0};
+		const double fY[8] = {fY1, fY1, fY0, fY1, fY1, fY0, fY0, fY0};
+		const double fZ[8] = {fZ1, fZ1, fZ1, fZ0, fZ0, fZ0, fZ1, fZ0};
+		for (int i = 0; i < 8; i++) {
+			index[i] = toIndex(iX[i], iY[i], iZ[i]);
+			w[3 * i] = fX[i];
+			w[3 * i + 1] = fY[i];
+			w[3 * i + 2] = fZ[i];
+		}
+	}
+
+	/** Weighted sum of the 8 neighbours in 16 bit storage, the block scale is part of the weight */
+	template<typename D>
+	T packedSum(const size_t *index, const double *w, D decoder) const {
+		const size_t nc = sizeof(T) / sizeof(float);
+		float c[nc];
+		std::fill(c, c + nc, 0.f);
+		for (int i = 0; i < 8; i++) {
+			const uint16_t *p = &packed[index[i] * nc];
+			float wi = w[3 * i] * w[3 * i + 1] * w[3 * i + 2] * blockScale[index[i] >> blockShift];
+			for (size_t j = 0; j < nc; j++)
+				c[j] += wi * decoder(p[j]);
+		}
+		T v;
+		fromComponents(c, v);
+		return v;
+	}
 
+	/** Weighted sum of the 8 neighbours, see trilinearWeights */
+	template<typename U>
+	U trilinearSum(U, const size_t *index, const double *w) const {
+		U b(0.);
+		if (storage == FULL_PRECISION) {
+			const T *v = values();
+			for (int i = 0; i < 8; i++)
+				b += v[index[i]] * w[3 * i] * w[3 * i + 1] * w[3 * i + 2];
+		} else if (storage == QUANTIZED_INT16) {
+			b = packedSum(index, w, Int16Decoder());
+		} else {
+			b = packedSum(index, w, HalfDecoder());
+		}
+		return b;
+	}
+
+	/** Weighted sum of the 8 neighbours of Grid1f and Grid3f. The weights are
+	  rounded to float, so that their products with the values are exact in
+	  double precision and the sum does not depend on contractions to FMA.
+	  The vectorised kernels compute the same sum, see gridKernelInterpolate. */
+	T floatSum(const size_t *index, const double *w) const {
+		if (storage == QUANTIZED_INT16)
+			return packedSum(index, w, Int16Decoder());
+		else if (storage == HALF_PRECISION)
+			return packedSum(index, w, HalfDecoder());
+		const size_t nc = sizeof(T) / sizeof(float);
+		const float *v = (const float*) values();
+		double c[nc];
+		std::fill(c, c + nc, 0.);
+		for (int i = 0; i < 8; i++) {
+			double wi = (float) (w[3 * i] * w[3 * i + 1] * w[3 * i + 2]);
+			for (size_t j = 0; j < nc; j++)
+				c[j] += v[index[i] * nc + j] * wi;
+		}
+		float f[nc];
+		std::copy(c, c + nc, f);
+		T b;
+		fromComponents(f, b);
 		return b;
 	}
 
+	float trilinearSum(float, const size_t *index, const double *w) const {
+		return floatSum(index, w);
+	}
+
+	Vector3f trilinearSum(Vector3f, const size_t *index, const double *w) const {
+		return floatSum(index, w);
+	}
+
+	/** Interpolate the grid trilinear at a given position */
+	T trilinearInterpolate(const Vector3d &position) const {
+		size_t index[8];
+		double w[24];
+		trilinearWeights(position, index, w);
+		return trilinearSum(T(), index, w);
+	}
+
+	/** Interpolate the first positions with the vectorised kernel, if it supports the grid.
+	  @returns the number of interpolated positions */
+	size_t kernelInterpolate(const Vector3d *positions, T *values, size_t n) const {
+		const size_t nc = sizeof(T) / sizeof(float);
+		if (not (std::is_same<T, float>::value or std::is_same<T, Vector3f>::value))
+			return 0;
+		if (reflective or (storage != FULL_PRECISION) or (layout != ROW_MAJOR))
+			return 0;
+		const size_t N[3] = {Nx, Ny, Nz};
+		return gridKernelInterpolate((const float*) this->values(), nc, N, gridOrigin,
+				spacing, ipolType == NEAREST_NEIGHBOUR, positions, (float*) values, n);
+	}
+
+	/** Interpolate the grid trilinear at several positions. The neighbours of a
+	  block of positions are located first, so that their memory accesses overlap. */
+	void trilinearInterpolate(const Vector3d *positions, T *values, size_t n) const {
+		const size_t blockSize = 16;
+		size_t index[8 * blockSize];
+		double w[24 * blockSize];
+		for (size_t first = 0; first < n; first += blockSize) {
+			size_t m = std::min(blockSize, n - first);
+			for (size_t i = 0; i < m; i++)
+				trilinearWeights(positions[first + i], index + 8 * i, w + 24 * i);
+			for (size_t i = 0; i < m; i++)
+				values[first + i] = trilinearSum(T(), index + 8 * i, w + 24 * i);
+		}
+	}
+
 }; // class Grid
 
 typedef Grid<Vector3f> Grid3f;
@@ -0,0 +1,54 @@
+#ifndef CRPROPA_GRIDKERNELS_H
+#define CRPROPA_GRIDKERNELS_H
+
+#include "crpropa/Vector3.h"
+
+#include <cstddef>
+
+namespace crpropa {
+/**
+ * \addtogroup Core
+ * @{
+ */
+
+/** Vectorised kernels for the interpolation of Grid1f and Grid3f at several positions
+SCALAR_KERNEL: no vectorised kernel, the grid interpolates itself
+AVX2_KERNEL: 4 positions at once with AVX2 and FMA
+AVX512_KERNEL: 8 positions at once with AVX-512F */
+enum gridKernelType {
+  SCALAR_KERNEL = 0,
+  AVX2_KERNEL,
+  AVX512_KERNEL
+};
+
+/** Best kernel supported by the CPU, detected at runtime */
+gridKernelType getBestGridKernel();
+
+/** Kernel used by Grid::interpolate for several positions, by default the best supported one */
+gridKernelType getGridKernel();
+
+/** Select the kernel, e.g. SCALAR_KERNEL for comparisons. Throws if the CPU does not support it. */
+void setGridKernel(gridKernelType kernel);
+
+/** Interpolate a periodic float grid in row-major order at several positions
+ with the selected kernel (see Grid::interpolate).
+ @param values		grid values, nc floats per grid point
+ @param nc			number of components per grid point, 1 or 3
+ @param N			number of grid points along x, y and z
+ @param gridOrigin	position of the first grid point
+ @param spacing		grid spacing
+ @param nearest		nearest neighbour instead of trilinear interpolation
+ @param positions	array of n positions
+ @param out			array of n * nc interpolated components, output
+ @param n			number of positions
+ @returns the number of processed positions, a multiple of the vector width;
+ the grid interpolates the remaining positions itself
+ */
+size_t gridKernelInterpolate(const float *values, size_t nc, const size_t *N,
+		const Vector3d &gridOrigin, const Vector3d &spacing, bool nearest,
+		const Vector3d *positions, float *out, size_t n);
+
+/** @}*/
+} // namespace crpropa
+
+#endif // CRPROPA_GRIDKERNELS_H
@@ -2,6 +2,7 @@
 #define CRPROPA_GRIDTOOLS_H
 
 #include "crpropa/Grid.h"
+#include "crpropa/OctreeGrid.h"
 #include "crpropa/magneticField/MagneticField.h"
 #include <string>
 #include <array>
@@ -21,6 +22,11 @@
  Vector components are stored per grid point in xyz-order.
  In case of plain-text files the vector components are separated by a blank or tab and grid points are stored one per line.
  All functions offer a conversion factor that is multiplied to all values.
+
+ The reductions (mean, RMS, gridStatistics), scaleGrid and fromMagneticField
+ run in parallel over slabs of constant x-index with OpenMP. The sums of the
+ slabs are added in order, so the results do not depend on the number of
+ threads. Mapped grids (see Grid) are read without copying them into memory.
  */
 
 namespace crpropa {
@@ -62,6 +68,29 @@ double rmsFieldStrength(ref_ptr<Grid3f> grid);
  */
 std::array<float, 3> rmsFieldStrengthPerAxis(ref_ptr<Grid3f> grid);
 
+/**
+ @class GridStatistics
+ @brief Statistics of the points of a vector grid, see gridStatistics
+ */
+struct GridStatistics {
+	size_t count; /**< Number of grid points */
+	Vector3d mean; /**< Mean vector */
+	double meanStrength; /**< Mean of the vector lengths */
+	double rms; /**< RMS of the vector lengths */
+	Vector3d rmsPerAxis; /**< RMS of the components */
+};
+
+/** Evaluate the mean and RMS values of all grid points in one pass.
+ @param grid		a vector grid (Grid3f)
+ */
+GridStatistics gridStatistics(ref_ptr<Grid3f> grid);
+/** Evaluate the mean and RMS values of a grid file written by Grid3f::save
+ in one pass. The file is mapped and streamed in slabs, which are released
+ after reading, so that grids larger than the memory can be checked.
+ @param filename	grid file with a GridFileHeader
+ */
+GridStatistics gridStatistics(const std::string &filename);
+
 /** Multiply all grid values by a given factor.
  @param grid		a scalar grid (Grid1f)
  @param a			scaling factor that will be used to multiply all points in grid
@@ -73,6 +102,21 @@ void scaleGrid(ref_ptr<Grid1f> grid, double a);
  */
 void scaleGrid(ref_ptr<Grid3f> grid, double a);
 
+/** Change the storage of the grid values (Grid::setStorageType) and report the
+ introduced error. The RMS before and after and the RMS deviation are logged.
+ @param grid		a vector grid (Grid3f)
+ @param storage		new storage type, e.g. HALF_PRECISION or QUANTIZED_INT16
+ @returns The RMS deviation relative to the RMS of the grid before.
+ */
+double convertGridStorage(ref_ptr<Grid3f> grid, storageType storage);
+/** Change the storage of the grid values (Grid::setStorageType) and report the
+ introduced error. The RMS before and after and the RMS deviation are logged.
+ @param grid		a scalar grid (Grid1f)
+ @param storage		new storage type, e.g. HALF_PRECISION or QUANTIZED_INT16
+ @returns The RMS deviation relative to the RMS of the grid before.
+ */
+double convertGridStorage(ref_ptr<Grid1f> grid, storageType storage);
+
 /** Fill vector grid from provided magnetic field.
  @param grid		a vector grid (Grid3f)
  @param field		the magnetic field 
@@ -149,10 +193,33 @@ void dumpGridToTxt(ref_ptr<Grid3f> grid, std::string filename,
 void dumpGridToTxt(ref_ptr<Grid1f> grid, std::string filename,
 		double conversion = 1);
 
+/** Load the leaf cells of an adaptive mesh into an OctreeGrid3f from a plain text file.
+ Each line holds the center, the edge length and the value of a cell:
+ x y z dx bx by bz, as exported for the leaf cells of AMR simulations
+ (e.g. RAMSES, Enzo or FLASH) with yt. The level of a cell follows from the
+ ratio of the root cell spacing and dx. Lines starting with # are skipped.
+ @param grid		a vector octree grid (OctreeGrid3f) to which the cells will be loaded
+ @param filename	name of input file
+ @param conversion	multiply every value by a conversion factor
+ @param lengthUnit	multiply the positions and edge lengths by this unit
+ */
+void loadOctreeGridFromTxt(ref_ptr<OctreeGrid3f> grid, std::string filename,
+		double conversion = 1, double lengthUnit = 1);
+
+/** Dump the leaf cells of an OctreeGrid3f to a plain text file in the format of loadOctreeGridFromTxt.
+ @param grid		a vector octree grid (OctreeGrid3f)
+ @param filename	name of output file
+ @param conversion	multiply every value by a conversion factor
+ @param lengthUnit	divide the positions and edge lengths by this unit
+ */
+void dumpOctreeGridToTxt(ref_ptr<OctreeGrid3f> grid, std::string filename,
+		double conversion = 1, double lengthUnit = 1);
+
 #ifdef CRPROPA_HAVE_FFTW3F
 /**
- Calculate the omnidirectional power spectrum E(k) for a given turbulent field
- @param grid	a three-dimensional grid
+ Calculate the omnidirectional power spectrum E(k) for a given turbulent field.
+ The Fourier transform is done in slabs in parallel, one component at a time.
+ @param grid	a three-dimensional cubic grid
  @returns Returns a vector of pairs (k_i, E(k_i)).
 */
 std::vector<std::pair<int, float>> gridPowerSpectrum(ref_ptr<Grid3f> grid);
@@ -0,0 +1,97 @@
+#ifndef CRPROPA_INTERPOLATIONTABLE_H
+#define CRPROPA_INTERPOLATIONTABLE_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace crpropa {
+/**
+ * \addtogroup Core
+ * @{
+ */
+
+/**
+ @class InterpolationTable
+ @brief Tabulated function Y(X) with fast linear interpolation
+
+ Gives the same results as interpolate(x, X, Y): linear interpolation between
+ the tabulated points, Y[0] for x < X[0] and Y[n-1] for x > X[n-1].
+ When the table is set, the abscissae are checked for uniform or
+ logarithmically uniform spacing. For such tables the bin is computed
+ directly from x instead of searched, irregular tables fall back to a binary
+ search. The slopes of all bins are precomputed.
+ */
+class InterpolationTable {
+public:
+	enum Spacing {
+		Irregular, Uniform, LogUniform
+	};
+
+private:
+	std::vector<double> X, Y;
+	std::vector<double> slope; // (Y[i+1] - Y[i]) / (X[i+1] - X[i])
+	Spacing spacing;
+	double offset, scale; // estimated bin = (x - offset) * scale, or (log(x) - offset) * scale
+
+	/// index i of the bin X[i] <= x < X[i+1] from the estimate p, requires X[0] <= x < X[n-1]
+	size_t correctBin(double x, double p) const {
+		size_t n = X.size();
+		size_t i = std::min(size_t(std::max(p, 0.)), n - 2);
+		// correct for round-off in the bin estimate
+		while ((i > 0) and (x < X[i]))
+			i--;
+		while ((i < n - 2) and (x >= X[i + 1]))
+			i++;
+		return i;
+	}
+
+	/// index i of the bin X[i] <= x < X[i+1], requires X[0] <= x < X[n-1]
+	size_t findBin(double x) const {
+		if (spacing == Uniform)
+			return correctBin(x, (x - offset) * scale);
+		if (spacing == LogUniform)
+			return correctBin(x, (std::log(x) - offset) * scale);
+		return std::upper_bound(X.begin(), X.end(), x) - X.begin() - 1;
+	}
+
+public:
+	InterpolationTable();
+	/** Constructor
+	 @param X	tabulated abscissae, in increasing order
+	 @param Y	tabulated values
+	 */
+	InterpolationTable(const std::vector<double> &X, const std::vector<double> &Y);
+
+	/// Set the tabulated points and detect the spacing of X
+	void setTable(const std::vector<double> &X, const std::vector<double> &Y);
+
+	/// Interpolated value at x
+	double interpolate(double x) const {
+		if (x < X.front())
+			return Y.front();
+		if (not (x < X.back()))
+			return Y.back();
+		size_t i = findBin(x);
+		return Y[i] + (x - X[i]) * slope[i];
+	}
+
+	double operator()(double x) const {
+		return interpolate(x);
+	}
+
+	/// Interpolated values at n positions x[0 .. n-1]; x and y must not overlap
+	void interpolate(const double *x, double *y, size_t n) const;
+	std::vector<double> interpolate(const std::vector<double> &x) const;
+
+	Spacing getSpacing() const;
+	const std::vector<double> &getX() const;
+	const std::vector<double> &getY() const;
+	size_t size() const;
+	bool empty() const;
+};
+
+/** @}*/
+} // namespace crpropa
+
+#endif // CRPROPA_INTERPOLATIONTABLE_H
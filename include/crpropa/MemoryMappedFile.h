@@ -0,0 +1,49 @@
+#ifndef CRPROPA_MEMORYMAPPEDFILE_H
+#define CRPROPA_MEMORYMAPPEDFILE_H
+
+#include "crpropa/Referenced.h"
+
+#include <string>
+
+namespace crpropa {
+/**
+ * \addtogroup Core
+ * @{
+ */
+
+/**
+ @class MemoryMappedFile
+ @brief Read-only file mapped into memory
+
+ The pages of the file are read on first access and, through the page cache
+ of the operating system, shared by all processes that map the same file.
+ Where mmap is not available the file is read into memory instead.
+ */
+class MemoryMappedFile: public Referenced {
+private:
+	std::string filename;
+	const char *begin;
+	size_t length;
+	bool mapped; // false if the file was read into memory
+
+	MemoryMappedFile(const MemoryMappedFile&);
+	MemoryMappedFile &operator=(const MemoryMappedFile&);
+
+public:
+	MemoryMappedFile(const std::string &filename);
+	~MemoryMappedFile();
+
+	/// Pointer to the first byte of the file, aligned to the page size if mapped
+	const char *data() const;
+	/// Size of the file in bytes
+	size_t size() const;
+	std::string getFilename() const;
+	/// Release the pages within [p, p + n) from the memory of the process,
+	/// e.g. after reading them once. They are read again when accessed.
+	void release(const void *p, size_t n) const;
+};
+
+/** @}*/
+} // namespace crpropa
+
+#endif // CRPROPA_MEMORYMAPPEDFILE_H
@@ -0,0 +1,343 @@
+#ifndef CRPROPA_OCTREEGRID_H
+#define CRPROPA_OCTREEGRID_H
+
+#include "crpropa/Referenced.h"
+#include "crpropa/Vector3.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <stdint.h>
+#include <vector>
+
+namespace crpropa {
+
+/**
+ * \addtogroup Core
+ * @{
+ */
+
+/**
+ @class OctreeGrid
+ @brief Template class for fields on a block-structured adaptive mesh with trilinear interpolation
+
+ The volume is covered by a regular grid of Nx * Ny * Nz root cells, as the
+ base grid of AMR codes like Enzo, FLASH or RAMSES. Each root cell is the root
+ of an octree: a cell of level l can be refined into 8 cells of level l + 1 with
+ half the edge length. Only the leaves of the trees, the finest cells at each
+ position, carry data, so that the memory scales with the number of cells and
+ not with the finest resolution. The refined cells additionally hold the mean of
+ their children (see update()).
+
+ As in Grid, the values are located at the cell centers. A position is located
+ by descending the tree of its root cell. The value at a position is
+ interpolated trilinearly between the centers of the 8 cells of the level of
+ its leaf that surround it, where for coarser neighbours the value of the
+ coarser cell is used. The interpolation is hence continuous within regions of
+ constant level and has small steps at the level boundaries.
+
+ The grid is repeated periodically (default). If it is not periodic, the
+ values vanish outside of the volume and are extrapolated constantly from the
+ nearest cells at its faces.
+ */
+template<typename T>
+class OctreeGrid: public Referenced {
+	struct Node {
+		T value; // leaf value or mean of the children
+		uint32_t children; // index of the first of 8 consecutive children, 0 for leaves
+	};
+
+	std::vector<Node> nodes; // root cells in the order of Grid, then the children
+	size_t Nx, Ny, Nz; /**< Number of root cells */
+	Vector3d origin; /**< Lower left front corner of the volume */
+	Vector3d spacing; /**< Edge lengths of the root cells */
+	bool periodic;
+	int maxLevel; /**< Highest level of a cell */
+	size_t nLeaves;
+
+	/** Locate the cell containing the position r in units of the root cells,
+	  descending at most to the given level. Returns false outside of the volume. */
+	bool locate(Vector3d r, int level, size_t &node, int &nodeLevel) const {
+		double fx = floor(r.x), fy = floor(r.y), fz = floor(r.z);
+		long ix = long(fx), iy = long(fy), iz = long(fz);
+		if (periodic) {
+			ix = ((ix % long(Nx)) + long(Nx)) % long(Nx);
+			iy = ((iy % long(Ny)) + long(Ny)) % long(Ny);
+			iz = ((iz % long(Nz)) + long(Nz)) % long(Nz);
+		} else if ((ix < 0) or (iy < 0) or (iz < 0) or (ix >= long(Nx))
+				or (iy >= long(Ny)) or (iz >= long(Nz))) {
+			return false;
+		}
+		node = ix * Ny * Nz + iy * Nz + iz;
+
+		// fractional position in the cell, doubling it is exact
+		r.x -= fx;
+		r.y -= fy;
+		r.z -= fz;
+		nodeLevel = 0;
+		while ((nodes[node].children != 0) and (nodeLevel < level)) {
+			r *= 2;
+			int cx = (r.x >= 1), cy = (r.y >= 1), cz = (r.z >= 1);
+			r.x -= cx;
+			r.y -= cy;
+			r.z -= cz;
+			node = nodes[node].children + (cx << 2) + (cy << 1) + cz;
+			nodeLevel++;
+		}
+		return true;
+	}
+
+	/** Split a leaf into 8 children with its value */
+	void split(size_t node) {
+		if (nodes.size() + 8 > UINT32_MAX)
+			throw std::runtime_error("OctreeGrid: too many cells");
+		Node child = nodes[node];
+		child.children = 0;
+		nodes[node].children = nodes.size();
+		nodes.insert(nodes.end(), 8, child);
+		nLeaves += 7;
+	}
+
+public:
+	/** Constructor for cubic root cells
+	 @param	origin	Position of the lower left front corner of the volume
+	 @param	N		Number of root cells in one direction
+	 @param spacing	Edge length of the root cells
+	 */
+	OctreeGrid(Vector3d origin, size_t N, double spacing) {
+		init(origin, N, N, N, Vector3d(spacing));
+	}
+
+	/** Constructor for a non-cubic volume
+	 @param	origin	Position of the lower left front corner of the volume
+	 @param	Nx		Number of root cells in x-direction
+	 @param	Ny		Number of root cells in y-direction
+	 @param	Nz		Number of root cells in z-direction
+	 @param spacing	Edge lengths of the root cells
+	 */
+	OctreeGrid(Vector3d origin, size_t Nx, size_t Ny, size_t Nz, Vector3d spacing) {
+		init(origin, Nx, Ny, Nz, spacing);
+	}
+
+	/** Reset to unrefined root cells with value zero */
+	void init(Vector3d origin, size_t Nx, size_t Ny, size_t Nz, Vector3d spacing) {
+		if (Nx * Ny * Nz == 0)
+			throw std::runtime_error("OctreeGrid: no root cells");
+		this->origin = origin;
+		this->spacing = spacing;
+		this->Nx = Nx;
+		this->Ny = Ny;
+		this->Nz = Nz;
+		Node root;
+		root.value = T(0.);
+		root.children = 0;
+		nodes.assign(Nx * Ny * Nz, root);
+		nLeaves = nodes.size();
+		maxLevel = 0;
+		periodic = true;
+	}
+
+	/** If false, the values vanish outside of the volume instead of being repeated */
+	void setPeriodic(bool b) {
+		periodic = b;
+	}
+
+	bool isPeriodic() const {
+		return periodic;
+	}
+
+	/** returns the positon of the lower left front corner of the volume */
+	Vector3d getOrigin() const {
+		return origin;
+	}
+
+	size_t getNx() const {
+		return Nx;
+	}
+
+	size_t getNy() const {
+		return Ny;
+	}
+
+	size_t getNz() const {
+		return Nz;
+	}
+
+	/** Edge lengths of the root cells */
+	Vector3d getSpacing() const {
+		return spacing;
+	}
+
+	/** Edge lengths of the cells at the given level */
+	Vector3d getSpacing(int level) const {
+		return spacing / double(1L << level);
+	}
+
+	/** Highest level of refinement */
+	int getMaximumLevel() const {
+		return maxLevel;
+	}
+
+	/** Number of leaf cells */
+	size_t getNumberOfCells() const {
+		return nLeaves;
+	}
+
+	/** Number of leaf and refined cells */
+	size_t getNumberOfNodes() const {
+		return nodes.size();
+	}
+
+	/** Calculates the total size of the grid in bytes */
+	size_t getSizeOf() const {
+		return sizeof(nodes) + sizeof(Node) * nodes.size();
+	}
+
+	/** Set the value of the cell of the given level that contains the position.
+	 Coarser leaves on the way are refined, their children inherit the value.
+	 Throws if the cell is refined already. Call update() when all cells are set.
+	 @param position	position in the cell
+	 @param level		refinement level of the cell, 0 for the root cells
+	 @param value		value of the cell
+	 */
+	void setCell(const Vector3d &position, int level, const T &value) {
+		if ((level < 0) or (level > 30))
+			throw std::runtime_error("OctreeGrid: level must be in [0, 30]");
+		size_t node;
+		int nodeLevel;
+		Vector3d r = (position - origin) / spacing;
+		if (not locate(r, level, node, nodeLevel))
+			throw std::runtime_error("OctreeGrid: cell outside of the volume");
+		while (nodeLevel < level) {
+			split(node);
+			locate(r, level, node, nodeLevel);
+		}
+		if (nodes[node].children != 0)
+			throw std::runtime_error("OctreeGrid: cell is refined already");
+		nodes[node].value = value;
+		maxLevel = std::max(maxLevel, level);
+	}
+
+	/** Refine the leaf cell containing the position into 8 cells with its value
+	 @returns the level of the new cells
+	 */
+	int refine(const Vector3d &position) {
+		size_t node;
+		int nodeLevel;
+		if (not locate((position - origin) / spacing, 31, node, nodeLevel))
+			throw std::runtime_error("OctreeGrid: cell outside of the volume");
+		if (nodeLevel >= 30)
+			throw std::runtime_error("OctreeGrid: level must be in [0, 30]");
+		split(node);
+		maxLevel = std::max(maxLevel, nodeLevel + 1);
+		return nodeLevel + 1;
+	}
+
+	/** Set the values of the refined cells to the mean of their children.
+	 The children follow their parents in memory, so one backward pass suffices. */
+	void update() {
+		for (size_t i = nodes.size(); i-- > 0;) {
+			uint32_t c = nodes[i].children;
+			if (c == 0)
+				continue;
+			T sum(0.);
+			for (int j = 0; j < 8; j++)
+				sum += nodes[c + j].value;
+			nodes[i].value = sum / 8.;
+		}
+	}
+
+	/** Apply a function to the center, level and value of all leaf cells */
+	template<typename F>
+	void forEachCell(F f) {
+		for (size_t ix = 0; ix < Nx; ix++)
+			for (size_t iy = 0; iy < Ny; iy++)
+				for (size_t iz = 0; iz < Nz; iz++)
+					forEachCell(f, ix * Ny * Nz + iy * Nz + iz,
+							origin + Vector3d(ix, iy, iz) * spacing, 0);
+	}
+
+	/** Level of the leaf cell containing the position, -1 outside of the volume */
+	int getLevel(const Vector3d &position) const {
+		size_t node;
+		int level;
+		if (not locate((position - origin) / spacing, 31, node, level))
+			return -1;
+		return level;
+	}
+
+	/** Value of the leaf cell containing the position */
+	T closestValue(const Vector3d &position) const {
+		size_t node;
+		int level;
+		if (not locate((position - origin) / spacing, 31, node, level))
+			return T(0.);
+		return nodes[node].value;
+	}
+
+	/** Interpolate the grid trilinearly at a given position */
+	T interpolate(const Vector3d &position) const {
+		Vector3d r = (position - origin) / spacing;
+		size_t node;
+		int level;
+		if (not locate(r, 31, node, level))
+			return T(0.);
+
+		// lower neighbour and weights on the unit grid of the level
+		double scale = double(1L << level);
+		Vector3d u = r * scale - Vector3d(0.5);
+		Vector3d u0(floor(u.x), floor(u.y), floor(u.z));
+		Vector3d f = u - u0;
+
+		T b(0.);
+		for (int i = 0; i < 8; i++) {
+			int dx = (i >> 2) & 1, dy = (i >> 1) & 1, dz = i & 1;
+			Vector3d s = (u0 + Vector3d(dx, dy, dz) + Vector3d(0.5)) / scale;
+			if (not periodic) {
+				// constant extrapolation at the faces of the volume
+				double h = 0.5 / scale;
+				s.x = std::min(std::max(s.x, h), Nx - h);
+				s.y = std::min(std::max(s.y, h), Ny - h);
+				s.z = std::min(std::max(s.z, h), Nz - h);
+			}
+			size_t n = 0;
+			int l = 0;
+			// s lies inside the volume (clamped or periodic), so the cell is always found
+			(void) locate(s, level, n, l);
+			double wx = dx ? f.x : 1 - f.x;
+			double wy = dy ? f.y : 1 - f.y;
+			double wz = dz ? f.z : 1 - f.z;
+			b += nodes[n].value * wx * wy * wz;
+		}
+		return b;
+	}
+
+	/** Interpolate the grid at several positions */
+	void interpolate(const Vector3d *positions, T *values, size_t n) const {
+		for (size_t i = 0; i < n; i++)
+			values[i] = interpolate(positions[i]);
+	}
+
+private:
+	template<typename F>
+	void forEachCell(F &f, size_t node, const Vector3d &corner, int level) {
+		Vector3d h = getSpacing(level);
+		uint32_t c = nodes[node].children;
+		if (c == 0) {
+			f(corner + h / 2, level, nodes[node].value);
+			return;
+		}
+		for (int j = 0; j < 8; j++)
+			forEachCell(f, c + j, corner + Vector3d((j >> 2) & 1,
+					(j >> 1) & 1, j & 1) * h / 2, level + 1);
+	}
+}; // class OctreeGrid
+
+typedef OctreeGrid<Vector3f> OctreeGrid3f;
+typedef OctreeGrid<float> OctreeGrid1f;
+
+/** @}*/
+
+} // namespace crpropa
+
+#endif // CRPROPA_OCTREEGRID_H
@@ -0,0 +1,122 @@
+#ifndef CRPROPA_RATETABLEBUILDER_H
+#define CRPROPA_RATETABLEBUILDER_H
+
+#include "crpropa/PhotonBackground.h"
+#include "crpropa/Referenced.h"
+
+#include <string>
+#include <vector>
+
+namespace crpropa {
+/**
+ * \addtogroup Core
+ * @{
+ */
+
+/**
+ @class RateTableBuilder
+ @brief Computes interaction rate tables for arbitrary photon fields
+
+ The interaction modules read their rates from tables that are shipped for the
+ standard photon fields. This class computes the same tables in-process for
+ any PhotonField by integrating the cross sections over the photon spectrum,
+ so that custom fields can be used without the external data tools.
+
+ The rate of an ultra-relativistic particle of energy E is written as
+ rate(E) = 1 / (8 E^2) int sigma(s) s G(s / 4E) ds, with the kinematic center of
+ mass energy s = s_tot - m^2 c^4 and G(x) = int_x^inf n(eps) / eps^2 deps.
+ G is tabulated once per photon field, the integrals are evaluated with
+ adaptive Simpson quadrature in parallel over the tabulated energies.
+
+ The build functions write the tables in the layout of the data directory,
+ <directory>/<module>/rate_<fieldName>.txt etc., and compile them into the
+ binary DataTable cache. Tables of the written files held by the
+ TableRegistry are dropped, so that modules created afterwards use the new
+ tables. With the data directory as target, the modules pick them up for the
+ photon field; otherwise pass the files to their initRate functions. Tables are computed for z = 0, the modules apply the redshift
+ scaling of the field. Not covered are the redshift dependent photo-pion
+ tables and the secondary spectrum of ElectronPairProduction.
+ */
+class RateTableBuilder: public Referenced {
+public:
+	/// Kinematic cross section sigma(s) [m^2] with s = s_tot - m^2 c^4 [J^2]
+	typedef double (*CrossSection)(double s);
+
+private:
+	ref_ptr<PhotonField> photonField;
+	double tolerance;
+	double epsMin, epsMax; // photon energy range of the field [J]
+	double logEpsMin, dLogEps;
+	std::vector<double> tabG; // G(eps) on a logarithmic grid in eps
+
+	void initPhotonIntegral();
+	double photonIntegral(double eps) const;
+	double sLimit(double sMin, double E) const;
+
+	void writeTables(const std::string &rateFile, const std::string &cdfFile,
+			CrossSection sigma, double sMin, bool binCenters) const;
+
+public:
+	RateTableBuilder(ref_ptr<PhotonField> photonField, double tolerance = 1e-4);
+	ref_ptr<PhotonField> getPhotonField() const;
+	double getTolerance() const;
+
+	/**
+	 Interaction rate [1/m] of an ultra-relativistic particle
+	 @param sigma	cross section as function of s = s_tot - m^2 c^4
+	 @param sMin	threshold in s [J^2]
+	 @param E		energy of the particle [J]
+	 */
+	double rate(CrossSection sigma, double sMin, double E) const;
+
+	/**
+	 Cumulative interaction rate [1/m] in s, i.e. the rate of interactions with
+	 s = s_tot - m^2 c^4 below each of the given values
+	 @param sigma	cross section as function of s
+	 @param sMin	threshold in s [J^2]
+	 @param E		energy of the particle [J]
+	 @param s		values of s [J^2], ascending
+	 */
+	std::vector<double> cumulativeRate(CrossSection sigma, double sMin, double E,
+			const std::vector<double> &s) const;
+
+	/**
+	 Relative energy loss rate (1/gamma) dgamma/dx [1/m] of a proton due to
+	 electron pair production (Blumenthal 1970, Chodorowski et al. 1992)
+	 @param gamma	Lorentz factor of the proton
+	 */
+	double electronPairLossRate(double gamma) const;
+
+	/// Breit-Wheeler pair production cross section, s in [J^2]
+	static double sigmaPairProduction(double s);
+	/// Klein-Nishina cross section, s = s_tot - m_e^2 c^4 in [J^2]
+	static double sigmaInverseComptonScattering(double s);
+	/// Triplet pair production cross section (Lee 1998), s = s_tot - m_e^2 c^4 in [J^2]
+	static double sigmaTripletPairProduction(double s);
+	/// Double pair production cross section (Brown et al. 1973), s in [J^2]
+	static double sigmaDoublePairProduction(double s);
+	/// Photo-pion cross section of protons (SOPHIA), s = s_tot - m_p^2 c^4 in [J^2]
+	static double sigmaPhotoPionProton(double s);
+	/// Photo-pion cross section of neutrons (SOPHIA), s = s_tot - m_n^2 c^4 in [J^2]
+	static double sigmaPhotoPionNeutron(double s);
+
+	/// Rate and cumulative rate tables of EMPairProduction
+	void buildEMPairProduction(const std::string &directory) const;
+	/// Rate and cumulative rate tables of EMInverseComptonScattering
+	void buildEMInverseComptonScattering(const std::string &directory) const;
+	/// Rate and cumulative rate tables of EMTripletPairProduction
+	void buildEMTripletPairProduction(const std::string &directory) const;
+	/// Rate table of EMDoublePairProduction
+	void buildEMDoublePairProduction(const std::string &directory) const;
+	/// Proton and neutron rate table of PhotoPionProduction
+	void buildPhotoPionProduction(const std::string &directory) const;
+	/// Loss rate table of ElectronPairProduction
+	void buildElectronPairProduction(const std::string &directory) const;
+	/// All of the above
+	void buildAll(const std::string &directory) const;
+};
+
+/** @}*/
+} // namespace crpropa
+
+#endif // CRPROPA_RATETABLEBUILDER_H
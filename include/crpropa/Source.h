@@ -2,6 +2,7 @@
 #define CRPROPA_SOURCE_H
 
 #include "crpropa/Candidate.h"
+#include "crpropa/DiscreteSampler.h"
 #include "crpropa/Grid.h"
 #include "crpropa/EmissionMap.h"
 
@@ -65,7 +66,7 @@ public:
  */
 class SourceList: public SourceInterface {
 	std::vector<ref_ptr<Source> > sources;
-	std::vector<double> cdf;
+	DiscreteSampler sampler;
 public:
 	/** Add an individual source to the list.
 	 @param source		source to be added
@@ -109,7 +110,7 @@ public:
  */
 class SourceMultipleParticleTypes: public SourceFeature {
 	std::vector<int> particleTypes;
-	std::vector<double> cdf;
+	DiscreteSampler sampler;
 public:
 	/** Constructor
 	 */
@@ -175,7 +176,7 @@ class SourceComposition: public SourceFeature {
 	double Rmax;
 	double index;
 	std::vector<int> nuclei;
-	std::vector<double> cdf;
+	DiscreteSampler sampler;
 public:
 	/** Constructor
 	 @param Emin		minimum energy (in Joules)
@@ -226,7 +227,7 @@ public:
  */
 class SourceMultiplePositions: public SourceFeature {
 	std::vector<Vector3d> positions;
-	std::vector<double> cdf;
+	DiscreteSampler sampler;
 public:
 	/** Constructor.
 	 The sources must be added individually to the object.
@@ -490,6 +491,7 @@ public:
  */
 class SourceDensityGrid: public SourceFeature {
 	ref_ptr<Grid1f> grid;
+	DiscreteSampler sampler;
 public:
 	/** Constructor
 	 @param densityGrid 	3D grid containing the density of sources in each cell
@@ -506,6 +508,7 @@ public:
  */
 class SourceDensityGrid1D: public SourceFeature {
 	ref_ptr<Grid1f> grid;
+	DiscreteSampler sampler;
 public:
 	/** Constructor
 	 @param densityGrid 	1D grid containing the density of sources in each cell
@@ -792,7 +795,7 @@ protected:
 	std::vector<double> energy;
 
 	std::vector<Nucleus> nuclei;
-	std::vector<double> cdf;
+	DiscreteSampler sampler;
 
 };
 #endif
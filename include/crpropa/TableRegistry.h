@@ -0,0 +1,72 @@
+#ifndef CRPROPA_TABLEREGISTRY_H
+#define CRPROPA_TABLEREGISTRY_H
+
+#include "crpropa/Referenced.h"
+
+#include <string>
+#include <typeinfo>
+
+namespace crpropa {
+/**
+ * \addtogroup Core
+ * @{
+ */
+
+/**
+ @class TableRegistry
+ @brief Process-wide registry of immutable tables shared between modules
+
+ Interaction modules keep their tabulated data in small table classes, which
+ are constructed from a data file and not modified afterwards. The registry
+ hands out one shared instance per (table type, data file), so that modules
+ for the same photon field, e.g. in several ModuleLists or when modules are
+ re-created in a loop, neither reload the file nor hold a copy of the data.
+ The data file name encodes the photon field and, where relevant, the
+ redshift mode.
+
+ Tables are identified by type, file name, size and modification time of
+ the file, so a rewritten data file is loaded again on the next request.
+ The registry only holds tables weakly: a table that is no longer used by any
+ module is released when the next table is registered or on prune(). To
+ drop the tables of a file immediately, e.g. after rewriting it, use
+ remove(); modules holding a table keep it alive independently of the
+ registry.
+ */
+class TableRegistry {
+private:
+	static std::string makeKey(const char *type, const std::string &filename);
+	static ref_ptr<Referenced> find(const std::string &key);
+	static ref_ptr<Referenced> insert(const std::string &key,
+			const std::string &filename, ref_ptr<Referenced> table);
+
+public:
+	/** Shared table of type T for the given data file.
+	 The table is constructed with T(filename) on first request.
+	 */
+	template<class T>
+	static ref_ptr<const T> get(const std::string &filename) {
+		std::string key = makeKey(typeid(T).name(), filename);
+		ref_ptr<Referenced> table = find(key);
+		if (table.valid())
+			return static_cast<const T *>(table.get());
+
+		// construct outside of the lock, if two threads race the first one wins
+		ref_ptr<T> created = new T(filename);
+		table = insert(key, filename, created);
+		return static_cast<const T *>(table.get());
+	}
+
+	/// Number of registered tables
+	static size_t size();
+	/// Release all tables held by the registry, modules keep their references
+	static void clear();
+	/// Release the tables of all types for the given data file
+	static void remove(const std::string &filename);
+	/// Release the tables that are not used outside of the registry
+	static void prune();
+};
+
+/** @}*/
+} // namespace crpropa
+
+#endif // CRPROPA_TABLEREGISTRY_H
@@ -65,6 +65,8 @@ public:
     Vector3d getRadioArcField(const Vector3d& pos) const;
 
     Vector3d getField(const Vector3d& pos) const;
+    /// size of the smallest structure of the used components
+    double getVariationScale() const;
 };
 
 } // namespace crpropa
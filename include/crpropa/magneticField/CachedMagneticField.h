@@ -0,0 +1,120 @@
+#ifndef CRPROPA_CACHEDMAGNETICFIELD_H
+#define CRPROPA_CACHEDMAGNETICFIELD_H
+
+#include "crpropa/magneticField/MagneticField.h"
+#include "crpropa/MemoryMappedFile.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace crpropa {
+/**
+ * \addtogroup MagneticFields
+ * @{
+ */
+
+/**
+ @class CachedMagneticField
+ @brief Magnetic field decorator that interpolates a field sampled once on an adaptive grid
+
+ Analytic field models such as JF12Field or TF17Field evaluate many
+ transcendental functions per call. This decorator samples the field once on
+ a grid and serves lookups by trilinear interpolation.
+
+ The cached box is divided into cubic blocks. Each block holds a regular grid
+ of cellsPerBlock * 2^level cells per axis, where the level of each block is
+ raised until the interpolation error at the cell centers, checked against the
+ field, is below relativeError times the largest field strength in the block.
+ Smooth regions therefore need few nodes and strong gradients are resolved
+ finely. The refinement of a block stops at the maximum level or when it does
+ not reduce the error, as at discontinuities like the spiral arm boundaries of
+ JF12. In such unresolved blocks the field itself is evaluated. The error is
+ checked at the cell centers only, so it is not a strict bound between them.
+ The blocks are sampled in parallel.
+
+ Outside of the cached box the field itself is evaluated. The cache ignores
+ the redshift and stores single precision values.
+
+ The cache can be saved to a file and loaded again; the file is mapped into
+ memory, so that processes on a node share its pages.
+ */
+class CachedMagneticField: public MagneticField {
+private:
+	struct Block {
+		uint64_t offset; // index of the first node
+		uint64_t n; // nodes per axis, 0 if unresolved
+	};
+
+	ref_ptr<MagneticField> field;
+	Vector3d origin;
+	double blockSize;
+	size_t nx, ny, nz; // number of blocks
+	size_t cellsPerBlock;
+	double relativeError;
+	int maxLevel;
+	size_t nUnresolved;
+
+	std::vector<Block> blocks;
+	std::vector<float> nodes; // 3 values per node, when sampled
+	ref_ptr<MemoryMappedFile> file; // when loaded
+	const float *nodeData;
+	size_t nNodes;
+
+	void build();
+	void sampleBlock(size_t ix, size_t iy, size_t iz, size_t n, std::vector<float> &values) const;
+	// largest interpolation error at the cell centers relative to the largest field strength
+	double blockError(size_t ix, size_t iy, size_t iz, size_t n, const std::vector<float> &values) const;
+
+public:
+	/** Constructor, caching the support box of the field (MagneticField::getSupport)
+	 @param field			field to cache
+	 @param blockSize		edge length of the blocks
+	 @param relativeError	error bound relative to the largest field strength in a block
+	 @param cellsPerBlock	cells per axis of a block at level 0
+	 @param maxLevel		maximum number of refinements of a block
+	 */
+	CachedMagneticField(ref_ptr<MagneticField> field, double blockSize,
+			double relativeError = 1e-3, size_t cellsPerBlock = 4, int maxLevel = 4);
+	/** Constructor for a given box
+	 @param field			field to cache
+	 @param lower			lower corner of the cached box
+	 @param upper			upper corner of the cached box, extended to a multiple of the block size
+	 @param blockSize		edge length of the blocks
+	 @param relativeError	error bound relative to the largest field strength in a block
+	 @param cellsPerBlock	cells per axis of a block at level 0
+	 @param maxLevel		maximum number of refinements of a block
+	 */
+	CachedMagneticField(ref_ptr<MagneticField> field, Vector3d lower,
+			Vector3d upper, double blockSize, double relativeError = 1e-3,
+			size_t cellsPerBlock = 4, int maxLevel = 4);
+	/** Constructor loading a cache saved with save()
+	 @param field		the cached field, evaluated outside of the cached box
+	 @param filename	cache file
+	 */
+	CachedMagneticField(ref_ptr<MagneticField> field, std::string filename);
+
+	/// Save the cache to a binary file
+	void save(std::string filename) const;
+
+	Vector3d getField(const Vector3d &position) const;
+	bool getSupport(Vector3d &lower, Vector3d &upper) const;
+	double getVariationScale() const;
+	double getUniformRadius(const Vector3d &position) const;
+
+	ref_ptr<MagneticField> getCachedField() const;
+	Vector3d getOrigin() const;
+	double getBlockSize() const;
+	double getRelativeError() const;
+	size_t getNumberOfBlocks() const;
+	size_t getNumberOfNodes() const;
+	/// Number of blocks that do not meet the error bound, where the field is evaluated
+	size_t getNumberOfUnresolvedBlocks() const;
+	/// Memory of the cached values in bytes
+	size_t getSizeOf() const;
+};
+
+/** @}*/
+} // namespace crpropa
+
+#endif // CRPROPA_CACHEDMAGNETICFIELD_H
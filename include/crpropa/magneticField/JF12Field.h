@@ -132,6 +132,14 @@ public:
 
 	// All set field components
 	Vector3d getField(const Vector3d& pos) const;
+
+	// All set field components at several positions, the random grids are interpolated in blocks
+	void getFields(const Vector3d *positions, Vector3d *fields, size_t n, double z = 0) const;
+
+	// Field geometry: zero beyond 20 kpc from the Galactic center
+	bool getSupport(Vector3d &lower, Vector3d &upper) const;
+	double getVariationScale() const;
+	double getUniformRadius(const Vector3d& pos) const;
 };
 
 
@@ -5,6 +5,10 @@
 #include "crpropa/Vector3.h"
 #include "crpropa/Referenced.h"
 
+#include <algorithm>
+#include <limits>
+#include <vector>
+
 #ifdef CRPROPA_HAVE_MUPARSER
 #include "muParser.h"
 #endif
@@ -18,6 +22,10 @@ namespace crpropa {
 /**
  @class MagneticField
  @brief Abstract base class for magnetic fields.
+
+ Besides the field itself, a field can describe its geometry, which the
+ propagation modules use to choose their steps. The defaults make no
+ assumptions; the descriptions need to be conservative.
  */
 class MagneticField: public Referenced {
 public:
@@ -29,8 +37,53 @@ public:
 	virtual Vector3d getField(const Vector3d &position, double z) const {
 		return getField(position);
 	};
+	/**
+	 Field at several positions at once. The default calls getField for each
+	 position; fields that evaluate many positions more efficiently, e.g. with
+	 SIMD instructions, override it.
+	 @param positions	array of n positions
+	 @param fields		array of n field vectors, output
+	 @param n			number of positions
+	 @param z			redshift
+	 */
+	virtual void getFields(const Vector3d *positions, Vector3d *fields, size_t n, double z = 0) const;
+
+	/**
+	 Axis-aligned box outside of which the field vanishes.
+	 @param lower	lower corner of the box
+	 @param upper	upper corner of the box
+	 @returns		false if the field is not known to be bounded
+	 */
+	virtual bool getSupport(Vector3d &/*lower*/, Vector3d &/*upper*/) const {
+		return false;
+	};
+	/**
+	 Smallest length scale on which the field varies, e.g. the spacing of a
+	 grid or the width of a transition, 0 if unknown
+	 */
+	virtual double getVariationScale() const {
+		return 0;
+	};
+	/**
+	 Radius of a sphere around the position in which the field is uniform,
+	 0 if unknown. The default uses the support: the field vanishes in the
+	 distance of the position to the support box.
+	 */
+	virtual double getUniformRadius(const Vector3d &position) const;
 };
 
+/**
+ Move a charged particle along the exact helix in a uniform magnetic field.
+ @param position	position, updated
+ @param direction	direction (unit vector), updated
+ @param field		uniform magnetic field
+ @param charge		charge of the particle
+ @param energy		energy of the particle
+ @param step		path length
+ */
+void propagateUniform(Vector3d &position, Vector3d &direction,
+		const Vector3d &field, double charge, double energy, double step);
+
 /**
  @class PeriodicMagneticField
  @brief Magnetic field decorator implementing periodic fields.
@@ -39,6 +92,7 @@ class PeriodicMagneticField: public MagneticField {
 	ref_ptr<MagneticField> field;
 	Vector3d origin, extends;
 	bool reflective;
+	Vector3d cellPosition(const Vector3d &position) const; // position in the unit cell
 public:
 	PeriodicMagneticField(ref_ptr<MagneticField> field,
 			const Vector3d &extends);
@@ -51,6 +105,9 @@ public:
 	bool isReflective();
 	void setReflective(bool reflective);
 	Vector3d getField(const Vector3d &position) const;
+	void getFields(const Vector3d *positions, Vector3d *fields, size_t n, double z = 0) const;
+	double getVariationScale() const;
+	double getUniformRadius(const Vector3d &position) const;
 };
 
 /**
@@ -62,6 +119,10 @@ class MagneticFieldList: public MagneticField {
 public:
 	void addField(ref_ptr<MagneticField> field);
 	Vector3d getField(const Vector3d &position) const;
+	void getFields(const Vector3d *positions, Vector3d *fields, size_t n, double z = 0) const;
+	bool getSupport(Vector3d &lower, Vector3d &upper) const;
+	double getVariationScale() const;
+	double getUniformRadius(const Vector3d &position) const;
 };
 
 /**
@@ -74,6 +135,10 @@ class MagneticFieldEvolution: public MagneticField {
 public:
 	MagneticFieldEvolution(ref_ptr<MagneticField> field, double m);
 	Vector3d getField(const Vector3d &position, double z = 0) const;
+	void getFields(const Vector3d *positions, Vector3d *fields, size_t n, double z = 0) const;
+	bool getSupport(Vector3d &lower, Vector3d &upper) const;
+	double getVariationScale() const;
+	double getUniformRadius(const Vector3d &position) const;
 };
 
 /**
@@ -89,6 +154,16 @@ public:
 	Vector3d getField(const Vector3d &position) const {
 		return value;
 	}
+	void getFields(const Vector3d * /*positions*/, Vector3d *fields, size_t n, double /*z*/ = 0) const {
+		std::fill(fields, fields + n, value);
+	}
+	double getVariationScale() const {
+		return std::numeric_limits<double>::infinity();
+	}
+	// only a vanishing field is declared uniform, otherwise the propagation keeps its step control
+	double getUniformRadius(const Vector3d &/*position*/) const {
+		return (value.getR2() == 0) ? std::numeric_limits<double>::infinity() : 0;
+	}
 };
 
 /**
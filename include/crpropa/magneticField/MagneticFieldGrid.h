@@ -3,6 +3,7 @@
 
 #include "crpropa/magneticField/MagneticField.h"
 #include "crpropa/Grid.h"
+#include "crpropa/OctreeGrid.h"
 
 namespace crpropa {
 /**
@@ -23,6 +24,9 @@ public:
 	void setGrid(ref_ptr<Grid3f> grid);
 	ref_ptr<Grid3f> getGrid();
 	Vector3d getField(const Vector3d &position) const;
+	void getFields(const Vector3d *positions, Vector3d *fields, size_t n, double z = 0) const;
+	/// grid spacing, the grid is repeated and has no bounded support
+	double getVariationScale() const;
 };
 
 /**
@@ -46,7 +50,29 @@ public:
 	ref_ptr<Grid1f> getModulationGrid();
 	void setReflective(bool gridReflective, bool modGridReflective);
 	Vector3d getField(const Vector3d &position) const;
+	double getVariationScale() const;
 };
+/**
+ @class OctreeMagneticField
+ @brief Magnetic field on an adaptive mesh (OctreeGrid3f) with trilinear interpolation.
+
+ This class wraps an OctreeGrid3f to serve as a MagneticField, e.g. for
+ cosmological MHD simulations with adaptive resolution loaded with
+ loadOctreeGridFromTxt.
+ */
+class OctreeMagneticField: public MagneticField {
+	ref_ptr<OctreeGrid3f> grid;
+public:
+	OctreeMagneticField(ref_ptr<OctreeGrid3f> grid);
+	void setGrid(ref_ptr<OctreeGrid3f> grid);
+	ref_ptr<OctreeGrid3f> getGrid();
+	Vector3d getField(const Vector3d &position) const;
+	/// the volume of the grid, unless it is periodic
+	bool getSupport(Vector3d &lower, Vector3d &upper) const;
+	/// edge length of the finest cells
+	double getVariationScale() const;
+};
+
 /** @} */
 } // namespace crpropa
 
@@ -155,6 +155,8 @@ public:
     string getHaloModel() const;
 
 	Vector3d getField(const Vector3d& pos) const;
+	/// smallest of the length scales of the used components
+	double getVariationScale() const;
 	Vector3d getDiskField(const double& r, const double& z, const double& phi, const double& sinPhi, const double& cosPhi) const;
 	Vector3d getHaloField(const double& r, const double& z, const double& phi, const double& sinPhi, const double& cosPhi) const;
 
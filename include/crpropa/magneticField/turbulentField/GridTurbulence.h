@@ -8,6 +8,9 @@
 
 #include "fftw3.h"
 
+#include <stdint.h>
+#include <string>
+
 namespace crpropa {
 /**
  * \addtogroup MagneticFields
@@ -17,6 +20,17 @@ namespace crpropa {
 /**
  @class GridTurbulence
  @brief Turbulent grid-based magnetic field with a general energy spectrum
+
+ The random Fourier modes are drawn with a counter-based random number
+ generator from the seed and the index of the mode, so that they are filled in
+ parallel and the field does not depend on the number of threads. The inverse
+ FFT is decomposed into slabs: along x in slabs of constant ky, then along y
+ and z in slabs of constant x, which are transformed in parallel.
+
+ With a filename, the grid is generated out of core: the slabs are written to
+ a temporary file and the grid to a grid file (see GridFileHeader), which is
+ then mapped into memory. Grids larger than the memory can thus be generated
+ and used on one machine; the file can be mapped again with Grid3f(filename).
  */
 class GridTurbulence : public TurbulentField {
   protected:
@@ -25,6 +39,9 @@ class GridTurbulence : public TurbulentField {
 
 	void initGrid(const GridProperties &grid);
 	void initTurbulence();
+	void initTurbulence(const GridProperties &grid, const std::string &filename);
+	// key of the random modes, the seed or a random key for seed 0
+	uint64_t getKey() const;
 
   public:
 	/**
@@ -37,6 +54,19 @@ class GridTurbulence : public TurbulentField {
 	GridTurbulence(const TurbulenceSpectrum &spectum,
 	               const GridProperties &gridProp, unsigned int seed = 0);
 
+	/**
+	 Create a random initialization of a turbulent field out of core, in a
+	 grid file that is mapped into memory.
+	 @param spectrum    TurbulenceSpectrum instance to define the spectrum of
+	 turbulence
+	 @param gridProp	GridProperties instance to define the underlying grid
+	 @param seed	 Random seed
+	 @param filename	Grid file to write, overwritten if it exists
+	 */
+	GridTurbulence(const TurbulenceSpectrum &spectum,
+	               const GridProperties &gridProp, unsigned int seed,
+	               const std::string &filename);
+
 	Vector3d getField(const Vector3d &pos) const;
 
 	/** Return a const reference to the grid */
@@ -46,6 +76,8 @@ class GridTurbulence : public TurbulentField {
 	// Check the grid properties before the FFT procedure
 	static void checkGridRequirements(ref_ptr<Grid3f> grid, double lMin,
 	                                  double lMax);
+	static void checkGridRequirements(const GridProperties &grid, double lMin,
+	                                  double lMax);
 	// Execute inverse discrete FFT in-place for a 3D grid, from complex to real
 	// space
 	static void executeInverseFFTInplace(ref_ptr<Grid3f> grid,
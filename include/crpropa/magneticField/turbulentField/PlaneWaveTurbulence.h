@@ -11,6 +11,18 @@ namespace crpropa {
  * @{
  */
 
+/** Kernels for the evaluation of PlaneWaveTurbulence
+PLANEWAVE_SCALAR: baseline implementation with std::cos
+PLANEWAVE_SSE4: 2 modes at once with SSE4.1
+PLANEWAVE_AVX2: 4 (8 in single precision) modes at once with AVX2 and FMA
+PLANEWAVE_AVX512: 8 (16 in single precision) modes at once with AVX-512F */
+enum planeWaveKernelType {
+  PLANEWAVE_SCALAR = 0,
+  PLANEWAVE_SSE4,
+  PLANEWAVE_AVX2,
+  PLANEWAVE_AVX512
+};
+
 /**
  @class PlaneWaveTurbulence
  @brief Interpolation-free turbulent magnetic field based on the GJ99 and TD13
@@ -34,19 +46,24 @@ Furthermore, depending on the exact setting, the implementation is somewhat slow
 
  ## Using the SIMD optimization
  In order to mitigate some of the performance impact that is inherent in this
-method of field generation, an optimized version is provided. According to our
-tests (see the paper above), this version runs 20-30x faster than the baseline
+method of field generation, optimized versions are provided. According to our
+tests (see the paper above), the AVX version runs 20-30x faster than the baseline
 implementation and matches the speed of trilinear interpolation on a grid at
-a bit less than 100 wavemodes. To do this, it uses special CPU instructions
-called AVX, which are unfortunately not supported by every CPU. On Linux, you
-can check whether your CPU supports AVX by using the `lscpu` command, and
-searching the flags section for the string "avx". Alternatively, if you are
-building on the same CPU that CRPropa will run on, you can have the compiler
-detect this for you automatically (see below).
-
- An additional speedup of about 1.33 can be achieved if the CPU supports the
-FMA extension in addition to AVX. Again, you can either check for this
-manually, or have the compiler figure it out for you.
+a bit less than 100 wavemodes. To do this, it uses special CPU instructions,
+which are unfortunately not supported by every CPU. Kernels for SSE4.1, AVX2
+with FMA and AVX-512 are built into CRPropa independent of the compiler flags,
+and the fastest one supported by the CPU is selected at runtime (see
+getBestKernel). setKernel selects another one, e.g. PLANEWAVE_SCALAR for the
+baseline implementation.
+
+ For thousands of wavemodes, the AVX2 and AVX-512 kernels can evaluate the
+cosines and sum the modes in single precision (see setSinglePrecision), which
+processes twice as many modes per instruction. The phases are still computed
+in double precision, so the precision is limited by the approximation of the
+cosine, which is about 2e-7 in both cases.
+
+ getFields evaluates several positions per pass over the wavemodes, so that
+the data of the modes is loaded once for all of them.
 
  **Note** that the optimized and non-optimized implementations to not return
 the exact same results. In fact, since the effective wave numbers used
@@ -56,35 +73,6 @@ of a double, but nevertheless relevant at some point), the wavemodes go
 out of phase for large distances from the origin, and the fields are no longer
 comparable at all.
 
- ### If you are building on the same machine that the code will run on:
-
-1. In cmake: enable the FAST_WAVES flag.
-2. Also in cmake: set SIMD_EXTENSIONS to "native". The compiler will automatically
-detect support for your CPU and run the build with the appropriate settings.
-3. Generate files and exit cmake, then build.
-3. If your CPU does not support the necessary extensions, the build will fail
-with an error telling you so. In this case, you won't be able to use the optimization;
-go back into cmake, disable FAST_WAVES, and build again.
-4. If the build runs through without errors, the code is built with the optimization.
-
- ### If you are building on a different machine from the one where the code will run:
-
-1. Figure out which extensions your target machine supports, using `lscpu | grep avx`
-for AVX, and `lscpu | grep fma` for FMA. Run these commands on your target machine,
-not on your build machine. If your target machine does not run Linux, you may have to
-use different commands.
-2. If the CPU does not support AVX, you can stop here, and build normally. The CPU
-does not support the necessary extensions, and will not run code that is compiled
-using them.
-3. If the CPU does support AVX, continue. In cmake, enable the FAST_WAVES flag.
-4. Also in cmake, set SIMD_EXTENSIONS to the appropriate value. If your target CPU
-supports only AVX, but not FMA, set it to "avx". If it supports both, set it to
-"avx+fma".
-5. Generate and exit cmake, then build.
-6. If you made a mistake and used the wrong flags, you should see an illegal
-instruction error when trying to import CRPropa, or (at the latest) when trying
-to call `getField`.
-
 [GJ99]: https://doi.org/10.1086/307452
 [TD13]: https://doi.org/10.1063/1.4789861
  */
@@ -100,12 +88,15 @@ class PlaneWaveTurbulence : public TurbulentField {
 	std::vector<double> Ak;
 	std::vector<double> k;
 
-	// data for FAST_WAVES
-	int avx_Nm;
+	// data for the SIMD kernels
+	planeWaveKernelType kernel;
+	bool singlePrecision;
+	int simd_Nm; // number of modes padded with zeros to a multiple of 16
 	int align_offset;
-	std::vector<double> avx_data;
-	// the following are index bases into the avx_data array.
-	// since each subarray has avx_Nm elements, the start offset
+	std::vector<double> simd_data;
+	std::vector<float> simd_Axi; // Ak * xi in single precision
+	// the following are index bases into the simd_data array.
+	// since each subarray has simd_Nm elements, the start offset
 	// of each subarray can be computed by multiplying the two,
 	// and then adding on the alignment offset.
 	// iAxi is a combined array containing the product of Ak * xi
@@ -140,6 +131,25 @@ class PlaneWaveTurbulence : public TurbulentField {
 	   Theoretical runtime is O(Nm), where Nm is the number of wavemodes.
 	*/
 	Vector3d getField(const Vector3d &pos) const;
+
+	/**
+	   Evaluates the field at several positions, with the same results as
+	   getField. Each pass over the wavemodes serves several positions.
+	*/
+	void getFields(const Vector3d *positions, Vector3d *fields, size_t n,
+	               double z = 0) const;
+
+	/** Fastest kernel supported by the CPU, detected at runtime */
+	static planeWaveKernelType getBestKernel();
+
+	/** Select the kernel for getField and getFields, by default the fastest
+	   one. Throws if the CPU does not support it. */
+	void setKernel(planeWaveKernelType kernel);
+	planeWaveKernelType getKernel() const;
+
+	/** Sum the modes in single precision with the AVX2 and AVX-512 kernels */
+	void setSinglePrecision(bool single);
+	bool isSinglePrecision() const;
 };
 
 /** @} */
@@ -0,0 +1,95 @@
+#ifndef CRPROPA_TILEDGRIDTURBULENCE_H
+#define CRPROPA_TILEDGRIDTURBULENCE_H
+
+#ifdef CRPROPA_HAVE_FFTW3F
+
+#include "crpropa/Grid.h"
+#include "crpropa/magneticField/turbulentField/TurbulentField.h"
+
+#include <list>
+#include <map>
+#include <stdint.h>
+
+namespace crpropa {
+/**
+ * \addtogroup MagneticFields
+ * @{
+ */
+
+/**
+ @class TiledGridTurbulence
+ @brief Non-repeating turbulent field from independent grid tiles, generated on demand
+
+ A GridTurbulence grid repeats periodically, so that particles travelling
+ many box lengths see the same field again. Here space is covered by a
+ lattice of tiles of N^3 grid points, each an independent turbulent grid as
+ in GridTurbulence, generated when it is first needed from a seed derived from
+ the global seed and the tile index. The same position hence always has the
+ same field, independent of the order of the evaluations.
+
+ The tiles overlap by half their size, so each position is covered by 8 tiles.
+ Their fields are blended with the weights prod_i sin(pi u_i), where u_i in
+ [0, 1) is the position in the tile along axis i. The squared weights add up
+ to 1, so that the RMS field strength is the one of the tiles everywhere and
+ the blended field is continuous. The blending does not conserve the zero
+ divergence of the tiles where the weights vary.
+
+ The tiles are held in a least recently used cache of a maximum number of
+ tiles, shared by all threads. The memory is thus bounded while the field
+ is unbounded.
+ */
+class TiledGridTurbulence: public TurbulentField {
+private:
+	struct TileIndex {
+		int64_t x, y, z;
+		bool operator<(const TileIndex &i) const {
+			if (x != i.x)
+				return x < i.x;
+			if (y != i.y)
+				return y < i.y;
+			return z < i.z;
+		}
+	};
+	typedef std::list<std::pair<TileIndex, ref_ptr<Grid3f> > > TileList;
+
+	GridProperties tileProperties;
+	uint64_t key;
+	size_t maxTiles;
+	mutable TileList tiles; // most recently used first
+	mutable std::map<TileIndex, TileList::iterator> tileMap;
+	mutable size_t nGenerated;
+
+	ref_ptr<Grid3f> generateTile(const TileIndex &index) const;
+	// tiles from the cache or generated, with one lock of the cache
+	void getTiles(const TileIndex *indices, ref_ptr<Grid3f> *result, size_t n) const;
+
+public:
+	/**
+	 @param spectrum	TurbulenceSpectrum instance to define the spectrum of turbulence
+	 @param tileProp	GridProperties of the tile at the lattice origin, with N^3 grid points
+	 @param seed		random seed, a random one for seed 0
+	 @param maxTiles	maximum number of cached tiles, at least 8
+	 */
+	TiledGridTurbulence(const TurbulenceSpectrum &spectrum,
+			const GridProperties &tileProp, unsigned int seed = 0,
+			size_t maxTiles = 64);
+
+	Vector3d getField(const Vector3d &position) const;
+
+	/** The tile of the given index in the lattice, from the cache or generated */
+	ref_ptr<Grid3f> getTile(int64_t ix, int64_t iy, int64_t iz) const;
+	/** Edge length of a tile, twice the distance of the tiles */
+	double getTileSize() const;
+	size_t getMaximumNumberOfTiles() const;
+	/** Number of tiles in the cache */
+	size_t getNumberOfCachedTiles() const;
+	/** Number of tiles generated so far, including the evicted ones */
+	size_t getNumberOfGeneratedTiles() const;
+};
+
+/** @}*/
+} // namespace crpropa
+
+#endif // CRPROPA_HAVE_FFTW3F
+
+#endif // CRPROPA_TILEDGRIDTURBULENCE_H
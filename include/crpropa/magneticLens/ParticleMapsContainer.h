@@ -7,6 +7,7 @@
 #include "crpropa/magneticLens/MagneticLens.h"
 
 #include "crpropa/Vector3.h"
+#include "crpropa/DiscreteSampler.h"
 
 namespace crpropa {
 /**
@@ -37,6 +38,13 @@ private:
 	std::map<int, double > _weightsPID;
 	std::map<int, map<int, double> > _weights_pidEnergy;
 
+	// alias tables for drawing particle ids, energies and pixels
+	std::vector<int> _pidList;
+	DiscreteSampler _pidSampler;
+	std::map<int, std::vector<int> > _energyIdxList;
+	std::map<int, DiscreteSampler> _energySampler;
+	std::map<int, std::map<int, DiscreteSampler> > _pixelSampler; // created on demand
+
 	// lazy update of weights
 	bool _weightsUpToDate;
 	void _updateWeights();
@@ -140,7 +140,8 @@ class QuasiLinearTheory : public StepLengthModifier {
 /// @details After crossing a surface a given number of times, the particle is
 /// split to N partilces with weight 1/N. This eases performance constraints in
 /// acceleration simulations due to the power law nature of many acceleration
-/// mechanisms.
+/// mechanisms. For splitting and Russian roulette according to a general
+/// importance function see WeightWindow.
 /// Thanks to Matthew Weiss, Penn State University for the first work on this
 /// feature in 2017.
 class ParticleSplitting : public Module {
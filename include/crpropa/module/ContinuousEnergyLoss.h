@@ -0,0 +1,83 @@
+#ifndef CRPROPA_CONTINUOUSENERGYLOSS_H
+#define CRPROPA_CONTINUOUSENERGYLOSS_H
+
+#include "crpropa/Module.h"
+#include "crpropa/PhotonBackground.h"
+
+#include <string>
+#include <vector>
+
+namespace crpropa {
+/**
+ * \addtogroup EnergyLosses
+ * @{
+ */
+
+/**
+ @class ContinuousEnergyLoss
+ @brief Exact integration of the redshift and electron-pair production losses over a step
+
+ Replaces the modules Redshift and ElectronPairProduction (without secondary
+ electrons) in rectilinear simulations. These modules apply their losses as a
+ first-order step and limit the next step to a fraction of the energy loss
+ length, so that the continuous losses force many small steps.
+ This module integrates them over a step of any length, hence the step size is
+ limited only by the stochastic interactions.
+
+ The redshift is updated with the comoving distance-redshift relation of the
+ cosmology and the adiabatic loss scales the energy with 1 + z.
+ For electron-pair production the integral S(u) = int_u du' / beta(e^u') of
+ the relative loss rate beta of protons at z = 0 over u = ln(gamma) is
+ tabulated once per photon field. At fixed redshift S(ln(gamma (1 + z)))
+ increases linearly with the comoving distance, with the slope
+ Z^2 / A (1 + z)^2 s(z) (cf. ElectronPairProduction::lossLength), so the loss
+ is obtained by inverting S. The redshift dependence is taken into account by splitting the step into
+ parts of at most maxRedshiftStep in redshift.
+ */
+class ContinuousEnergyLoss: public Module {
+private:
+	struct LossTable: public Referenced {
+		std::vector<double> u; // ln(gamma) of the tabulated Lorentz factors
+		std::vector<double> beta; // relative energy loss rate of protons at z = 0 [1/m]
+		std::vector<double> slope; // d ln(beta) / du of the power-law segment following each node
+		std::vector<double> S; // int_{u_i}^{u_n} du / beta, relative to the last node for precision at high energies
+		LossTable(const std::string &filename);
+		size_t segment(double u) const;
+		double rate(double u) const; // beta(e^u)
+		double integral(double u) const; // S(u), negative above the table
+		double inverse(double s) const; // u for S(u) = s
+	};
+
+	std::vector<ref_ptr<PhotonField> > photonFields;
+	std::vector<ref_ptr<const LossTable> > lossTables; // shared, see TableRegistry
+	bool haveRedshift;
+	double maxRedshiftStep;
+
+	// electron-pair loss over the comoving distance step at fixed redshift, returns the energy factor
+	double pairProductionFactor(double Z2A, double lf, double z, double step) const;
+
+public:
+	/** Constructor
+	 @param haveRedshift		update the redshift and apply the adiabatic energy loss
+	 @param maxRedshiftStep		maximum redshift difference of the parts of a step
+	 */
+	ContinuousEnergyLoss(bool haveRedshift = true, double maxRedshiftStep = 0.01);
+
+	/// Add electron-pair production on a photon field, using the tables of ElectronPairProduction
+	void addElectronPairProduction(ref_ptr<PhotonField> photonField);
+	/// Add electron-pair production on a photon field with the given loss rate table
+	void addElectronPairProduction(ref_ptr<PhotonField> photonField, std::string filename);
+
+	void setHaveRedshift(bool haveRedshift);
+	void setMaximumRedshiftStep(double dz);
+	bool getHaveRedshift() const;
+	double getMaximumRedshiftStep() const;
+
+	void process(Candidate *candidate) const;
+	std::string getDescription() const;
+};
+
+/** @}*/
+} // namespace crpropa
+
+#endif // CRPROPA_CONTINUOUSENERGYLOSS_H
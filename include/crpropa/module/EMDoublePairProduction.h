@@ -5,6 +5,7 @@
 #include <cmath>
 
 #include "crpropa/Module.h"
+#include "crpropa/InterpolationTable.h"
 #include "crpropa/PhotonBackground.h"
 
 namespace crpropa {
@@ -32,8 +33,13 @@ private:
 	double thinning;
 
 	// tabulated interaction rate 1/lambda(E)
-	std::vector<double> tabEnergy;  //!< electron energy in [J]
-	std::vector<double> tabRate;  //!< interaction rate in [1/m]
+	struct RateTable: public Referenced {
+		std::vector<double> tabEnergy;  //!< electron energy in [J]
+		std::vector<double> tabRate;  //!< interaction rate in [1/m]
+		InterpolationTable interpolation;  //!< tabRate(tabEnergy) for fast interpolation
+		RateTable(const std::string &filename);
+	};
+	ref_ptr<const RateTable> rateTable;  //!< shared between all instances for the same photon field, see TableRegistry
 
 public:
 	/** Constructor
@@ -5,6 +5,8 @@
 #include <cmath>
 
 #include "crpropa/Module.h"
+#include "crpropa/InterpolationTable.h"
+#include "crpropa/DiscreteSampler.h"
 #include "crpropa/PhotonBackground.h"
 
 
@@ -34,13 +36,25 @@ private:
 	double thinning;
 
 	// tabulated interaction rate 1/lambda(E)
-	std::vector<double> tabEnergy;  //!< electron energy in [J]
-	std::vector<double> tabRate;  //!< interaction rate in [1/m]
-	
+	struct RateTable: public Referenced {
+		std::vector<double> tabEnergy;  //!< electron energy in [J]
+		std::vector<double> tabRate;  //!< interaction rate in [1/m]
+		InterpolationTable interpolation;  //!< tabRate(tabEnergy) for fast interpolation
+		RateTable(const std::string &filename);
+	};
+
 	// tabulated CDF(s_kin, E) = cumulative differential interaction rate
-	std::vector<double> tabE;  //!< electron energy in [J]
-	std::vector<double> tabs;  //!< s_kin = s - m^2 in [J**2]
-	std::vector< std::vector<double> > tabCDF;  //!< cumulative interaction rate
+	struct CumulativeRateTable: public Referenced {
+		std::vector<double> tabE;  //!< electron energy in [J]
+		std::vector<double> tabs;  //!< s_kin = s - m^2 in [J**2]
+		std::vector< std::vector<double> > tabCDF;  //!< cumulative interaction rate
+		std::vector<DiscreteSampler> tabSampler;  //!< alias tables for drawing s from each row of tabCDF
+		CumulativeRateTable(const std::string &filename);
+	};
+
+	// shared between all instances for the same photon field, see TableRegistry
+	ref_ptr<const RateTable> rateTable;
+	ref_ptr<const CumulativeRateTable> cdfTable;  //!< only loaded if haveElectrons
 
 public:
 	/** Constructor
@@ -2,6 +2,7 @@
 #define CRPROPA_ELASTICSCATTERING_H
 
 #include "crpropa/Module.h"
+#include "crpropa/DiscreteSampler.h"
 #include "crpropa/PhotonBackground.h"
 
 #include <vector>
@@ -16,8 +17,20 @@ class ElasticScattering: public Module {
 private:
 	ref_ptr<PhotonField> photonField;
 
-	std::vector<double> tabRate; // elastic scattering rate
-	std::vector<std::vector<double> > tabCDF; // CDF as function of background photon energy
+	struct RateTable: public Referenced {
+		std::vector<double> tabRate; // elastic scattering rate
+		RateTable(const std::string &filename);
+	};
+
+	struct CDFTable: public Referenced {
+		std::vector<std::vector<double> > tabCDF; // CDF as function of background photon energy
+		std::vector<DiscreteSampler> tabSampler; // alias tables for drawing from each row of tabCDF
+		CDFTable(const std::string &filename);
+	};
+
+	// shared between all instances for the same photon field, see TableRegistry
+	ref_ptr<const RateTable> rateTable;
+	ref_ptr<const CDFTable> cdfTable;
 
 	static const double lgmin; // minimum log10(Lorentz-factor)
 	static const double lgmax; // maximum log10(Lorentz-factor)
@@ -2,6 +2,8 @@
 #define CRPROPA_ELECTRONPAIRPRODUCTION_H
 
 #include "crpropa/Module.h"
+#include "crpropa/InterpolationTable.h"
+#include "crpropa/DiscreteSampler.h"
 #include "crpropa/PhotonBackground.h"
 
 namespace crpropa {
@@ -23,9 +25,19 @@ namespace crpropa {
 class ElectronPairProduction: public Module {
 private:
 	ref_ptr<PhotonField> photonField;
-	std::vector<double> tabLossRate; /*< tabulated energy loss rate in [J/m] for protons at z = 0 */
-	std::vector<double> tabLorentzFactor; /*< tabulated Lorentz factor */
-	std::vector<std::vector<double> > tabSpectrum; /*< electron/positron cdf(Ee|log10(gamma)) for log10(Ee/eV)=7-24 in 170 steps and log10(gamma)=6-13 in 70 steps and*/
+	struct LossRateTable: public Referenced {
+		std::vector<double> tabLossRate; /*< tabulated energy loss rate in [J/m] for protons at z = 0 */
+		std::vector<double> tabLorentzFactor; /*< tabulated Lorentz factor */
+		InterpolationTable interpolation; /*< tabLossRate(tabLorentzFactor) for fast interpolation */
+		LossRateTable(const std::string &filename);
+	};
+	struct SpectrumTable: public Referenced {
+		std::vector<std::vector<double> > tabSpectrum; /*< electron/positron cdf(Ee|log10(gamma)) for log10(Ee/eV)=7-24 in 170 steps and log10(gamma)=6-13 in 70 steps and*/
+		std::vector<DiscreteSampler> tabSampler; /*< alias tables for drawing Ee from each row of tabSpectrum */
+		SpectrumTable(const std::string &filename);
+	};
+	ref_ptr<const LossRateTable> lossRateTable; /*< shared between all instances for the same photon field, see TableRegistry */
+	ref_ptr<const SpectrumTable> spectrumTable; /*< only loaded if haveElectrons */
 	double limit; ///< fraction of energy loss length to limit the next step
 	bool haveElectrons;
 
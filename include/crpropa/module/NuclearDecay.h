@@ -18,6 +18,9 @@ namespace crpropa {
  This module simulates the nuclear decay of unstable nuclei using data from NuDat2.
  All decay modes are considered: alpha, beta+- and gamma decay, as well as proton- and neutron dripping.
  The resulting non-hadronic secondary particles (e+, e-, neutrinos, gamma) can optionally be created.
+ They can be thinned as in the EM modules, with separate exponents for each species: a secondary
+ carrying the fraction f of the energy of the nucleus is added with probability f^thinning and
+ weight 1/f^thinning. A thinning of 0 means that all particles are tracked (default).
 
  For details on the preprocessing of the NuDat2 data refer to "CRPropa3-data/calc_decay.py".
  */
@@ -27,13 +30,20 @@ private:
 	bool haveElectrons;
 	bool havePhotons;
 	bool haveNeutrinos;
+	double electronThinning;
+	double photonThinning;
+	double neutrinoThinning;
 	struct DecayMode {
 		int channel; // (#beta- #beta+ #alpha #proton #neutron)
 		double rate; // decay rate in [1/m]
 		std::vector<double> energy; // photon energies of ensuing gamma decays
 		std::vector<double> intensity; // probabilities of ensuing gamma decays
 	};
-	std::vector<std::vector<DecayMode> > decayTable; // decayTable[Z * 31 + N] = vector<DecayMode>
+	struct DecayTable: public Referenced {
+		std::vector<std::vector<DecayMode> > decayModes; // decayModes[Z * 31 + N] = vector<DecayMode>
+		DecayTable(const std::string &filename);
+	};
+	ref_ptr<const DecayTable> decayTable; // shared between all instances, see TableRegistry
 
 public:
 	/** Constructor.
@@ -41,12 +51,21 @@ public:
 	 @param photons			if true, add secondary photons as candidates
 	 @param neutrinos		if true, add secondary neutrinos as candidates
 	 @param limit			step size limit as fraction of mean free path
+	 @param thinning		thinning exponent of all secondary species (0: all particles are tracked; 1: maximum thinning)
 	 */
-	NuclearDecay(bool electrons = false, bool photons = false, bool neutrinos = false, double limit = 0.1);
+	NuclearDecay(bool electrons = false, bool photons = false, bool neutrinos = false, double limit = 0.1, double thinning = 0);
 	void setLimit(double limit);
 	void setHaveElectrons(bool b);
 	void setHavePhotons(bool b);
 	void setHaveNeutrinos(bool b);
+	/// Set the thinning exponent of all secondary species (0: all particles are tracked; 1: maximum thinning)
+	void setThinning(double thinning);
+	void setElectronThinning(double thinning);
+	void setPhotonThinning(double thinning);
+	void setNeutrinoThinning(double thinning);
+	double getElectronThinning() const;
+	double getPhotonThinning() const;
+	double getNeutrinoThinning() const;
 	void process(Candidate *candidate) const;
 	void performInteraction(Candidate *candidate, int channel) const;
 	void gammaEmission(Candidate *candidate, int channel) const;
@@ -16,12 +16,18 @@ namespace crpropa {
 /**
  @class PhotoDisintegration
  @brief Photodisintegration of nuclei by background photons.
+
+ The secondary photons can be thinned as in the EM modules: a photon carrying
+ the fraction f of the energy of the nucleus is added with probability
+ f^thinning and weight 1/f^thinning. A thinning of 0 means that all particles
+ are tracked; for thinning > 0 the output must contain the weights.
  */
 class PhotoDisintegration: public Module {
 private:
 	ref_ptr<PhotonField> photonField;
 	double limit; // fraction of mean free path for limiting the next step
 	bool havePhotons;
+	double thinning; // thinning exponent of secondary photons
 
 	struct Branch {
 		int channel; // number of emitted (n, p, H2, H3, He3, He4)
@@ -33,9 +39,25 @@ private:
 		std::vector<double> emissionProbability; // emission probability as function of nucleus Lorentz factor
 	};
 
-	std::vector<std::vector<double> > pdRate; // pdRate[Z * 31 + N] = total interaction rate
-	std::vector<std::vector<Branch> > pdBranch; // pdTable[Z * 31 + N] = branching ratios
-	mutable std::map<int, std::vector<PhotonEmission> > pdPhoton; // map of emitted photon energies and photon emission probabilities
+	struct RateTable: public Referenced {
+		std::vector<std::vector<double> > pdRate; // pdRate[Z * 31 + N] = total interaction rate
+		RateTable(const std::string &filename);
+	};
+
+	struct BranchingTable: public Referenced {
+		std::vector<std::vector<Branch> > pdBranch; // pdTable[Z * 31 + N] = branching ratios
+		BranchingTable(const std::string &filename);
+	};
+
+	struct PhotonEmissionTable: public Referenced {
+		std::map<int, std::vector<PhotonEmission> > pdPhoton; // map of emitted photon energies and photon emission probabilities
+		PhotonEmissionTable(const std::string &filename);
+	};
+
+	// shared between all instances for the same photon field, see TableRegistry
+	ref_ptr<const RateTable> rateTable;
+	ref_ptr<const BranchingTable> branchingTable;
+	ref_ptr<const PhotonEmissionTable> photonEmissionTable; // only loaded if havePhotons
 
 	static const double lgmin; // minimum log10(Lorentz-factor)
 	static const double lgmax; // maximum log10(Lorentz-factor)
@@ -46,12 +68,15 @@ public:
 	 @param photonField		target photon field
 	 @param havePhotons		if true, add secondary photons as candidates
 	 @param limit			step size limit as fraction of mean free path
+	 @param thinning		weighted sampling of secondary photons (0: all particles are tracked; 1: maximum thinning)
 	 */
-	PhotoDisintegration(ref_ptr<PhotonField> photonField, bool havePhotons = false, double limit = 0.1);
+	PhotoDisintegration(ref_ptr<PhotonField> photonField, bool havePhotons = false, double limit = 0.1, double thinning = 0);
 
 	void setPhotonField(ref_ptr<PhotonField> photonField);
 	void setHavePhotons(bool havePhotons);
 	void setLimit(double limit);
+	void setThinning(double thinning);
+	double getThinning() const;
 
 	void initRate(std::string filename);
 	void initBranching(std::string filename);
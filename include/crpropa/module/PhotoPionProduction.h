@@ -2,6 +2,7 @@
 #define CRPROPA_PHOTOPIONPRODUCTION_H
 
 #include "crpropa/Module.h"
+#include "crpropa/InterpolationTable.h"
 #include "crpropa/PhotonBackground.h"
 
 #include <vector>
@@ -21,21 +22,37 @@ struct SophiaEventOutput {
 /**
  @class PhotoPionProduction
  @brief Photo-pion interactions of nuclei with background photons.
+
+ Thinning of the secondary photons, neutrinos and electrons is available as in
+ the EM modules, with separate exponents for each species: a secondary carrying
+ the fraction f of the energy of the interacting nucleon is added with
+ probability f^thinning and weight 1/f^thinning. A thinning of 0 means that all
+ particles are tracked; for thinning > 0 the output must contain the weights.
  */
 class PhotoPionProduction: public Module {
 
 protected:
 	ref_ptr<PhotonField> photonField;
-	std::vector<double> tabLorentz; ///< Lorentz factor of nucleus
-	std::vector<double> tabRedshifts;  ///< redshifts (optional for haveRedshiftDependence)
-	std::vector<double> tabProtonRate; ///< interaction rate in [1/m] for protons
-	std::vector<double> tabNeutronRate; ///< interaction rate in [1/m] for neutrons
+	/// Tabulated interaction rates, columns: [redshift,] log10(Lorentz factor), proton rate, neutron rate
+	struct RateTable: public Referenced {
+		std::vector<double> tabLorentz; ///< Lorentz factor of nucleus
+		std::vector<double> tabRedshifts;  ///< redshifts (only for tables with redshift dependence)
+		std::vector<double> tabProtonRate; ///< interaction rate in [1/m] for protons
+		std::vector<double> tabNeutronRate; ///< interaction rate in [1/m] for neutrons
+		InterpolationTable protonRate; ///< tabProtonRate(tabLorentz) for fast interpolation, without redshift dependence
+		InterpolationTable neutronRate; ///< tabNeutronRate(tabLorentz) for fast interpolation, without redshift dependence
+		RateTable(const std::string &filename);
+	};
+	ref_ptr<const RateTable> rateTable; ///< shared between all instances for the same photon field, see TableRegistry
 	double limit; ///< fraction of mean free path to limit the next step
 	bool havePhotons;
 	bool haveNeutrinos;
 	bool haveElectrons;
 	bool haveAntiNucleons;
 	bool haveRedshiftDependence;
+	double photonThinning; ///< thinning exponent of secondary photons
+	double neutrinoThinning; ///< thinning exponent of secondary neutrinos
+	double electronThinning; ///< thinning exponent of secondary electrons and positrons
 
 	// called by: sampleEps
 	// - input: s [GeV^2]
@@ -64,30 +81,30 @@ protected:
 	// called by: functs
 	// - input: photon energy [eV]
 	// - output: crossection of nucleon-photon-interaction [mubarn]
-	double crossection(double eps, bool onProton) const;
+	static double crossection(double eps, bool onProton);
 
 	// called by: crossection
 	// - input: photon energy [eV], threshold [eV], max [eV], unknown [no unit]
 	// - output: unknown [no unit]
-	double Pl(double eps, double xth, double xMax, double alpha) const;
+	static double Pl(double eps, double xth, double xMax, double alpha);
 
 	// called by: crossection
 	// - input: photon energy [eV], threshold [eV], unknown [eV]
 	// - output: unknown [no unit]
-	double Ef(double eps, double epsTh, double w) const;
+	static double Ef(double eps, double epsTh, double w);
 
 	// called by: crossection
 	// - input: cross section [µbarn], width [GeV], mass [GeV/c^2], rest frame photon energy [GeV]
 	// - output: Breit-Wigner crossection of a resonance of width Gamma
-	double breitwigner(double sigma0, double gamma, double DMM, double epsPrime, bool onProton) const;
+	static double breitwigner(double sigma0, double gamma, double DMM, double epsPrime, bool onProton);
 
 	// called by: probEps, crossection, breitwigner, functs
 	// - input: is proton [bool]
 	// - output: mass [Gev/c^2]
-	double mass(bool onProton) const;
+	static double mass(bool onProton);
 
 	// - output: [GeV^2] head-on collision 
-	double sMin() const;
+	static double sMin();
 
 	bool sampleLog = true;
 	double correctionFactor = 1.6; // increeses the maximum of the propability function
@@ -109,6 +126,11 @@ public:
 	void setHaveAntiNucleons(bool b);
 	void setHaveRedshiftDependence(bool b);
 	void setLimit(double limit);
+	/// Set the thinning exponent of all secondary species
+	void setThinning(double thinning);
+	void setPhotonThinning(double thinning);
+	void setNeutrinoThinning(double thinning);
+	void setElectronThinning(double thinning);
 	void initRate(std::string filename);
 	double nucleonMFP(double gamma, double z, bool onProton) const;
 	double nucleiModification(int A, int X) const;
@@ -124,6 +146,14 @@ public:
 	 */
 	double lossLength(int id, double gamma, double z = 0);
 
+	/**
+	 Total photon-nucleon cross section [m^2] as used by SOPHIA.
+	 This is not used in the simulation.
+	 @param epsPrime	photon energy in the rest frame of the nucleon [J]
+	 @param onProton	proton or neutron
+	 */
+	static double totalCrossSection(double epsPrime, bool onProton);
+
 	/**
 	 Direct SOPHIA interface.
 	 Output is an object SophiaEventOutput with two vectors "energy" and "id" each of length N (number of out-going particles).
@@ -172,6 +202,9 @@ public:
 	double getLimit() const;
 	bool getSampleLog() const;
 	double getCorrectionFactor() const;
+	double getPhotonThinning() const;
+	double getNeutrinoThinning() const;
+	double getElectronThinning() const;
 };
 /** @}*/
 
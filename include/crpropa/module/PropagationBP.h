@@ -21,7 +21,12 @@ namespace crpropa {
  It can be used with a fixed step size or an adaptive version which supports the step size control.
  The step size control tries to keep the relative error close to, but smaller than the designated tolerance.
  Additionally a minimum and maximum size for the steps can be set.
+ Where the field is uniform (MagneticField::getUniformRadius), e.g. outside of the support of a galactic field model,
+ the trajectory is computed as an exact helix and a next step of the maximum step size proposed.
  For neutral particles a rectilinear propagation is applied and a next step of the maximum step size proposed.
+ Since their trajectory does not depend on the field, a separate maximum step can be set for neutral particles.
+ With a large value neutral particles are fast-forwarded to the next event, as limited by the other modules:
+ interactions, observers and boundaries, which for neutral particles limit the next step to the exact crossing distance.
  */
 class PropagationBP: public Module {
 
@@ -57,6 +62,7 @@ private:
 	double tolerance; /** target relative error of the numerical integration */
 	double minStep; /** minimum step size of the propagation */
 	double maxStep; /** maximum step size of the propagation */
+	double maxNeutralStep; /** maximum step size of neutral particles, 0 for maxStep */
 
 public:
 	/** Default constructor for the Boris push. It is constructed with a fixed step size.
@@ -103,6 +109,11 @@ public:
 	 */
 	Vector3d getFieldAtPosition(Vector3d pos, double z) const;
 
+	/** Get the radius of the region of uniform field around a position, see MagneticField::getUniformRadius
+	 * @param pos	   current position of the candidate
+	 */
+	double getUniformRadius(Vector3d pos) const;
+
 	/** Adapt step size if required and calculates the new position and direction of the particle with the usage of the function dY
 	 * @param y		 current position and direction of candidate
 	 * @param out	   position and direction of candidate after the step
@@ -133,6 +144,10 @@ public:
 	 * @param maxStep	   maxStep/c_light is the maximum integration time step 
 	 */
 	void setMaximumStep(double maxStep);
+	/** Set the maximum step of neutral particles
+	 * @param maxNeutralStep	maximum step of the rectilinear propagation of neutral particles, 0 to use the maximum step
+	 */
+	void setMaximumNeutralStep(double maxNeutralStep);
 
 	/** Get functions for the parameters of the class PropagationBP, similar to the set functions */
 
@@ -140,6 +155,7 @@ public:
 	double getTolerance() const;
 	double getMinimumStep() const;
 	double getMaximumStep() const;
+	double getMaximumNeutralStep() const;
 	std::string getDescription() const;
 };
 /** @}*/
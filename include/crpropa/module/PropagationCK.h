@@ -20,7 +20,12 @@ namespace crpropa {
  It uses the Runge-Kutta integration method with Cash-Karp coefficients.\n
  The step size control tries to keep the relative error close to, but smaller than the designated tolerance.
  Additionally a minimum and maximum size for the steps can be set.
+ Where the field is uniform (MagneticField::getUniformRadius), e.g. outside of the support of a galactic field model,
+ the trajectory is computed as an exact helix and a next step of the maximum step size proposed.
  For neutral particles a rectilinear propagation is applied and a next step of the maximum step size proposed.
+ Since their trajectory does not depend on the field, a separate maximum step can be set for neutral particles.
+ With a large value neutral particles are fast-forwarded to the next event, as limited by the other modules:
+ interactions, observers and boundaries, which for neutral particles limit the next step to the exact crossing distance.
  */
 class PropagationCK: public Module {
 public:
@@ -56,6 +61,7 @@ private:
 	double tolerance; /*< target relative error of the numerical integration */
 	double minStep; /*< minimum step size of the propagation */
 	double maxStep; /*< maximum step size of the propagation */
+	double maxNeutralStep; /*< maximum step size of neutral particles, 0 for maxStep */
 
 public:
 	PropagationCK(ref_ptr<MagneticField> field = NULL, double tolerance = 1e-4,
@@ -73,6 +79,8 @@ public:
 	void setTolerance(double tolerance);
 	void setMinimumStep(double minStep);
 	void setMaximumStep(double maxStep);
+	/** set the maximum step of the rectilinear propagation of neutral particles, 0 to use the maximum step */
+	void setMaximumNeutralStep(double maxNeutralStep);
 
 	 /** get functions for the parameters of the class PropagationCK, similar to the set functions */
 	ref_ptr<MagneticField> getField() const;
@@ -83,9 +91,13 @@ public:
 	 * @return	  magnetic field vector at the position pos */
 	Vector3d getFieldAtPosition(Vector3d pos, double z) const;
 
+	/** radius of the region of uniform field around a position, see MagneticField::getUniformRadius */
+	double getUniformRadius(Vector3d pos) const;
+
 	double getTolerance() const;
 	double getMinimumStep() const;
 	double getMaximumStep() const;
+	double getMaximumNeutralStep() const;
 	std::string getDescription() const;
 };
 /** @}*/
@@ -0,0 +1,147 @@
+#ifndef CRPROPA_RESPONSEMATRIX_H
+#define CRPROPA_RESPONSEMATRIX_H
+
+#include "crpropa/Module.h"
+
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace crpropa {
+/**
+ * \addtogroup Output
+ * @{
+ */
+
+/**
+ @class ResponseMatrix
+ @brief Response of a propagation setup for folding source spectra without re-simulating
+
+ Accumulates the weight of the detected candidates binned in source id, source
+ energy and source distance (the quantities of SourceIdColumn,
+ SourceEnergyColumn and SourcePositionColumn of Output) as well as observed id
+ and observed energy. Normalized to the injected weight in the same source bins,
+ counted by ResponseInjection, this gives the mean number of detected particles
+ per injected particle. The response can then be folded with any source
+ spectrum, composition and redshift evolution.
+
+ Energies are binned logarithmically, source distances (comoving, to the
+ origin) linearly. Within each source bin the response is an average over the
+ simulated injection, which should be monoenergetic or log-flat in energy and
+ flat in distance, e.g. SourcePowerLawSpectrum with index -1 and SourceUniform1D.
+
+ Usage: add the matrix as output to the observer and a ResponseInjection to
+ the module list.
+ */
+class ResponseMatrix: public Module {
+private:
+	double logEmin, logEmax; // log10 of the energy range [J]
+	size_t nEnergy;
+	double distanceMin, distanceMax; // source distance range [m]
+	size_t nDistance;
+
+	// source id -> injected weight per (source energy, distance) bin
+	mutable std::map<int, std::vector<double> > injected;
+	// (source id, observed id) -> detected weight per (source energy, distance, observed energy) bin
+	mutable std::map<std::pair<int, int>, std::vector<double> > detected;
+
+	int energyBin(double E) const;
+	int distanceBin(double D) const;
+	double sourceDistance(const Candidate *candidate) const;
+
+public:
+	/** Constructor
+	 @param Emin		lower edge of the energy bins [J]
+	 @param Emax		upper edge of the energy bins [J]
+	 @param nEnergy		number of logarithmic energy bins
+	 @param Dmin		lower edge of the source distance bins [m]
+	 @param Dmax		upper edge of the source distance bins [m]
+	 @param nDistance	number of linear source distance bins
+	 */
+	ResponseMatrix(double Emin, double Emax, size_t nEnergy, double Dmin = 0,
+			double Dmax = std::numeric_limits<double>::max(), size_t nDistance = 1);
+
+	/// Count the weight of a detected candidate
+	void process(Candidate *candidate) const;
+	/// Count the weight of an injected candidate, see ResponseInjection
+	void inject(Candidate *candidate) const;
+
+	/// Add the counts of another matrix with the same binning, e.g. of another run
+	void add(const ResponseMatrix &other);
+	void clear();
+
+	size_t getNumberOfEnergyBins() const;
+	size_t getNumberOfDistanceBins() const;
+	/// Edges of the energy bins [J], nEnergy + 1 values
+	std::vector<double> getEnergyBins() const;
+	/// Edges of the source distance bins [m], nDistance + 1 values
+	std::vector<double> getDistanceBins() const;
+	std::vector<int> getSourceIds() const;
+	std::vector<int> getObservedIds() const;
+
+	/// Injected weight in a source bin
+	double getInjected(int sourceId, size_t iSourceEnergy, size_t iDistance = 0) const;
+	/**
+	 Mean detected weight in an observed energy bin per injected particle in a source bin
+	 @param sourceId		source id
+	 @param iSourceEnergy	source energy bin
+	 @param iDistance		source distance bin
+	 @param observedId		observed id
+	 @param iEnergy			observed energy bin
+	 */
+	double getResponse(int sourceId, size_t iSourceEnergy, size_t iDistance,
+			int observedId, size_t iEnergy) const;
+
+	/**
+	 Fold a source spectrum with the response
+	 @param observedId		observed id
+	 @param sourceId		source id
+	 @param sourceCounts	number of emitted particles per source bin, index iSourceEnergy * nDistance + iDistance
+	 @returns				expected detected weight per observed energy bin
+	 */
+	std::vector<double> fold(int observedId, int sourceId,
+			const std::vector<double> &sourceCounts) const;
+	/**
+	 Fold a power law spectrum dN/dE ~ E^index up to the rigidity Rmax (as in
+	 SourceComposition) and a source density evolution (1 + z)^m, where z is
+	 the redshift of the comoving source distance. The spectrum is normalized
+	 to one emitted particle in the binned source range; for a composition sum
+	 the results weighted with the number fractions.
+	 @param observedId	observed id
+	 @param sourceId	source id
+	 @param index		spectral index of the power law
+	 @param Rmax		maximum rigidity [V]
+	 @param m			index of the redshift evolution (requires finite distance bins if not 0)
+	 @returns			expected detected weight per observed energy bin
+	 */
+	std::vector<double> foldPowerLaw(int observedId, int sourceId, double index,
+			double Rmax = std::numeric_limits<double>::max(), double m = 0) const;
+
+	/// Write the binning and all non-zero counts to a text file
+	void dump(const std::string &filename) const;
+	/// Add the counts from a text file written by dump, the binning must agree
+	void load(const std::string &filename);
+
+	std::string getDescription() const;
+};
+
+/**
+ @class ResponseInjection
+ @brief Counts the injected primaries of a ResponseMatrix
+
+ Each primary candidate is counted once, at the first step it passes the module.
+ */
+class ResponseInjection: public Module {
+private:
+	ref_ptr<ResponseMatrix> matrix;
+public:
+	ResponseInjection(ref_ptr<ResponseMatrix> matrix);
+	void process(Candidate *candidate) const;
+};
+
+/** @}*/
+} // namespace crpropa
+
+#endif // CRPROPA_RESPONSEMATRIX_H
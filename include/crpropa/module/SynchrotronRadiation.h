@@ -2,6 +2,7 @@
 #define CRPROPA_SYNCHROTRONRADIATION_H
 
 #include "crpropa/Module.h"
+#include "crpropa/DiscreteSampler.h"
 #include "crpropa/magneticField/MagneticField.h"
 
 namespace crpropa {
@@ -33,6 +34,7 @@ private:
 	double secondaryThreshold; ///< threshold energy for secondary photons
 	std::vector<double> tabx; ///< tabulated fraction E_photon/E_critical from 10^-6 to 10^2 in 801 log-spaced steps
 	std::vector<double> tabCDF; ///< tabulated CDF of synchrotron spectrum
+	DiscreteSampler sampler; ///< alias table for drawing bins of the synchrotron spectrum
 
 
 public:
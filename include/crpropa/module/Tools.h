@@ -4,8 +4,9 @@
 #include "crpropa/Module.h"
 #include "crpropa/EmissionMap.h"
 
-#include <vector>
+#include <limits>
 #include <set>
+#include <vector>
 
 namespace crpropa {
 /**
@@ -68,6 +69,47 @@ public:
 	std::string getDescription() const;
 };
 
+/**
+  @class SecondaryCoalescence
+  @brief Merge similar secondaries of a step into fewer weighted candidates
+
+  Interaction modules can create many secondaries per step, e.g. synchrotron
+  photons, which then follow nearly identical paths. Added to the ModuleList
+  after the interaction modules, this module groups the secondaries created
+  in the current step by particle id and logarithmic energy bin. Each group
+  is replaced by one of its members, drawn with a probability proportional to
+  weight * energy and reweighted to carry the total weighted energy of the
+  group. Thus the energy is conserved exactly and the expected weighted
+  spectrum is unchanged; only its resolution within a bin is lost.
+  Secondaries above the maximum energy are not merged, nor are copies of the
+  candidate added by WeightWindow or ParticleSplitting (see exclude()).
+  The secondaries seen by the module are marked with the candidate property
+  "SecondaryCoalescence".
+  The weight column needs to be enabled in the output.
+*/
+class SecondaryCoalescence: public Module {
+	double binsPerDecade;
+	double maximumEnergy;
+
+public:
+	/** Constructor
+	 @param binsPerDecade	number of logarithmic energy bins per decade
+	 @param maximumEnergy	only secondaries below this energy are merged
+	 */
+	SecondaryCoalescence(double binsPerDecade = 10,
+			double maximumEnergy = std::numeric_limits<double>::max());
+	void setBinsPerDecade(double binsPerDecade);
+	void setMaximumEnergy(double maximumEnergy);
+	double getBinsPerDecade() const;
+	double getMaximumEnergy() const;
+
+	void process(Candidate* candidate) const;
+	std::string getDescription() const;
+
+	/// Never merge the given secondary with others, e.g. a copy of its parent
+	static void exclude(Candidate *secondary);
+};
+
 /** @}*/
 } // namespace crpropa
 
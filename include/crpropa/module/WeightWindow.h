@@ -0,0 +1,143 @@
+#ifndef CRPROPA_WEIGHTWINDOW_H
+#define CRPROPA_WEIGHTWINDOW_H
+
+#include "crpropa/Module.h"
+#include "crpropa/Referenced.h"
+#include "crpropa/ParticleState.h"
+
+#include <string>
+
+namespace crpropa {
+/**
+ * \addtogroup Tools
+ * @{
+ */
+
+/**
+ @class ImportanceFunction
+ @brief Abstract base class for the importance of a particle state in WeightWindow
+
+ The importance is a positive number, which is larger for particles that are
+ more likely to contribute to the result, e.g. close to the observer or at
+ high energies. Only ratios of importances matter.
+ */
+class ImportanceFunction: public Referenced {
+public:
+	virtual ~ImportanceFunction() {
+	}
+	/// Importance of the state (position, energy and species) of a particle
+	virtual double getImportance(const ParticleState &state) const = 0;
+};
+
+/**
+ @class EnergyImportance
+ @brief Importance (E / E0)^index of the particle energy
+ */
+class EnergyImportance: public ImportanceFunction {
+private:
+	double referenceEnergy;
+	double index;
+public:
+	EnergyImportance(double referenceEnergy, double index = 1);
+	double getImportance(const ParticleState &state) const;
+};
+
+/**
+ @class DistanceImportance
+ @brief Importance (r0 / r)^index of the distance r to a point, e.g. an observer
+
+ Inside the radius r0 the importance is 1.
+ */
+class DistanceImportance: public ImportanceFunction {
+private:
+	Vector3d center;
+	double radius;
+	double index;
+public:
+	DistanceImportance(Vector3d center, double radius, double index = 1);
+	double getImportance(const ParticleState &state) const;
+};
+
+/**
+ @class WeightWindow
+ @brief Splitting and Russian roulette of candidates according to their importance
+
+ For a candidate of importance I the target weight is w0 / I, with the weight
+ w0 at importance 1. After each step the weight w of the candidate is compared
+ to the window [lower * w0 / I, upper * w0 / I]:
+ - Above the window, the candidate is split into n = min(ceil(w I / w0), maximum)
+   copies of weight w / n. The copies are added as secondaries, hence the
+   simulation has to run with recursive = true.
+ - Below the window, the candidate plays Russian roulette: it survives with
+   probability p = w I / w0 with the target weight w / p, otherwise it is
+   deactivated. Candidates of importance 0 are always deactivated.
+
+ The expected weight is conserved, so the weighted results are unbiased while
+ the computing time is spent on the candidates of high importance.
+ The module counts splits and roulette games for the efficiency statistics.
+ */
+class WeightWindow: public Module {
+private:
+	ref_ptr<ImportanceFunction> importance;
+	double referenceWeight;
+	double lowerRatio;
+	double upperRatio;
+	int maximumSplits;
+
+	mutable unsigned long long nSplit; // candidates that were split
+	mutable unsigned long long nCopies; // copies created by splitting
+	mutable unsigned long long nRoulette; // candidates that played Russian roulette
+	mutable unsigned long long nKilled; // candidates deactivated in Russian roulette
+	mutable double weightKilled; // weight of the deactivated candidates
+	mutable double weightRestored; // weight added to the surviving candidates
+
+public:
+	/** Constructor
+	 @param importance		importance function
+	 @param referenceWeight	target weight at importance 1
+	 @param lowerRatio		lower bound of the window relative to the target weight
+	 @param upperRatio		upper bound of the window relative to the target weight
+	 @param maximumSplits	maximum number of copies in a single split
+	 */
+	WeightWindow(ref_ptr<ImportanceFunction> importance, double referenceWeight = 1,
+			double lowerRatio = 0.5, double upperRatio = 2, int maximumSplits = 10);
+
+	void setImportanceFunction(ref_ptr<ImportanceFunction> importance);
+	void setReferenceWeight(double weight);
+	void setWindow(double lowerRatio, double upperRatio);
+	void setMaximumSplits(int n);
+
+	ref_ptr<ImportanceFunction> getImportanceFunction() const;
+	double getReferenceWeight() const;
+	int getMaximumSplits() const;
+
+	void process(Candidate *candidate) const;
+
+	/**
+	 Split the candidate into n copies of equal weight. The copies are added
+	 to the secondaries of the candidate, which keeps the first copy.
+	 Secondaries created before the split keep their weights.
+	 */
+	static void split(Candidate *candidate, int n);
+
+	/// Number of candidates that were split
+	unsigned long long getNumberOfSplits() const;
+	/// Number of copies created by splitting
+	unsigned long long getNumberOfCopies() const;
+	/// Number of candidates that played Russian roulette
+	unsigned long long getNumberOfRoulettes() const;
+	/// Number of candidates deactivated in Russian roulette
+	unsigned long long getNumberOfKilled() const;
+	/// Total weight of the candidates deactivated in Russian roulette
+	double getWeightKilled() const;
+	/// Total weight added to the surviving candidates of Russian roulette
+	double getWeightRestored() const;
+	void resetStatistics();
+
+	std::string getDescription() const;
+};
+
+/** @}*/
+} // namespace crpropa
+
+#endif // CRPROPA_WEIGHTWINDOW_H
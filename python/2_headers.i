@@ -171,11 +171,19 @@ using namespace crpropa;   // for usage of namespace in header files, necessary
 %include "crpropa/Referenced.h"
 %include "crpropa/Units.h"
 %include "crpropa/Common.h"
+%ignore crpropa::InterpolationTable::interpolate(const double *, double *, size_t) const;
+%include "crpropa/InterpolationTable.h"
+%ignore crpropa::DataTable::row;
+%ignore crpropa::DataTable::data;
+%include "crpropa/DataTable.h"
+%template(DataTableRefPtr) crpropa::ref_ptr<crpropa::DataTable>;
+%include "crpropa/TableRegistry.h"
 %include "crpropa/Cosmology.h"
 %include "crpropa/PhotonPropagation.h"
 %template(RandomSeed) std::vector<uint32_t>;
 %template(RandomSeedThreads) std::vector< std::vector<uint32_t> >;
 %include "crpropa/Random.h"
+%include "crpropa/DiscreteSampler.h"
 %include "crpropa/ParticleState.h"
 %include "crpropa/ParticleID.h"
 %include "crpropa/ParticleMass.h"
@@ -400,6 +408,8 @@ using namespace crpropa;   // for usage of namespace in header files, necessary
 %template(PhotonFieldRefPtr) crpropa::ref_ptr<crpropa::PhotonField>;
 %feature("director") crpropa::PhotonField;
 %include "crpropa/PhotonBackground.h"
+%include "crpropa/RateTableBuilder.h"
+%template(RateTableBuilderRefPtr) crpropa::ref_ptr<crpropa::RateTableBuilder>;
 
 %implicitconv crpropa::ref_ptr<crpropa::AdvectionField>;
 %template(AdvectionFieldRefPtr) crpropa::ref_ptr<crpropa::AdvectionField>;
@@ -411,7 +421,9 @@ using namespace crpropa;   // for usage of namespace in header files, necessary
 %feature("director") crpropa::Density;
 %include "crpropa/massDistribution/Density.h"
 
+%include "crpropa/GridKernels.h"
 %include "crpropa/Grid.h"
+%include "crpropa/OctreeGrid.h"
 %include "crpropa/GridTools.h"
 
 %template(Array3d) std::array<double, 3>;
@@ -433,6 +445,14 @@ using namespace crpropa;   // for usage of namespace in header files, necessary
 %template(Grid1dRefPtr) crpropa::ref_ptr<crpropa::Grid<double> >;
 %template(Grid1d) crpropa::Grid<double>;
 
+%implicitconv crpropa::ref_ptr<crpropa::OctreeGrid<crpropa::Vector3<float> > >;
+%template(OctreeGrid3fRefPtr) crpropa::ref_ptr<crpropa::OctreeGrid<crpropa::Vector3<float> > >;
+%template(OctreeGrid3f) crpropa::OctreeGrid<crpropa::Vector3<float> >;
+
+%implicitconv crpropa::ref_ptr<crpropa::OctreeGrid<float> >;
+%template(OctreeGrid1fRefPtr) crpropa::ref_ptr<crpropa::OctreeGrid<float> >;
+%template(OctreeGrid1f) crpropa::OctreeGrid<float>;
+
 %implicitconv std::pair<std::vector<int>, std::vector<float> >;
 %template(PairIntFloat) std::pair<int, float>;
 %template(PairVector) std::vector<std::pair<int, float> >;
@@ -454,11 +474,13 @@ using namespace crpropa;   // for usage of namespace in header files, necessary
 %include "crpropa/magneticField/TF17Field.h"
 %include "crpropa/magneticField/ArchimedeanSpiralField.h"
 %include "crpropa/magneticField/CMZField.h"
+%include "crpropa/magneticField/CachedMagneticField.h"
 %include "crpropa/magneticField/turbulentField/TurbulentField.h"
 %include "crpropa/magneticField/turbulentField/GridTurbulence.h"
 %include "crpropa/magneticField/turbulentField/SimpleGridTurbulence.h"
 %include "crpropa/magneticField/turbulentField/HelicalGridTurbulence.h"
 %include "crpropa/magneticField/turbulentField/PlaneWaveTurbulence.h"
+%include "crpropa/magneticField/turbulentField/TiledGridTurbulence.h"
 %include "crpropa/module/BreakCondition.h"
 %include "crpropa/module/Boundary.h"
 
@@ -547,6 +569,8 @@ using namespace crpropa;   // for usage of namespace in header files, necessary
 
 %include "crpropa/module/HDF5Output.h"
 %include "crpropa/module/OutputShell.h"
+%template(ResponseMatrixRefPtr) crpropa::ref_ptr<crpropa::ResponseMatrix>;
+%include "crpropa/module/ResponseMatrix.h"
 %include "crpropa/module/EMCascade.h"
 %include "crpropa/module/PhotonEleCa.h"
 %include "crpropa/module/PhotonOutput1D.h"
@@ -556,6 +580,7 @@ using namespace crpropa;   // for usage of namespace in header files, necessary
 %include "crpropa/module/PhotoDisintegration.h"
 %include "crpropa/module/ElasticScattering.h"
 %include "crpropa/module/Redshift.h"
+%include "crpropa/module/ContinuousEnergyLoss.h"
 %include "crpropa/module/RestrictToRegion.h"
 %include "crpropa/module/EMPairProduction.h"
 %include "crpropa/module/EMDoublePairProduction.h"
@@ -567,6 +592,10 @@ using namespace crpropa;   // for usage of namespace in header files, necessary
 %template(IntSet) std::set<int>;
 %include "crpropa/module/Tools.h"
 
+%template(ImportanceFunctionRefPtr) crpropa::ref_ptr<crpropa::ImportanceFunction>;
+%feature("director") crpropa::ImportanceFunction;
+%include "crpropa/module/WeightWindow.h"
+
 %template(SourceInterfaceRefPtr) crpropa::ref_ptr<crpropa::SourceInterface>;
 %feature("director") crpropa::SourceInterface;
 %template(SourceFeatureRefPtr) crpropa::ref_ptr<crpropa::SourceFeature>;
@@ -1,7 +1,10 @@
 #include "crpropa/Candidate.h"
 #include "crpropa/ParticleID.h"
+#include "crpropa/Random.h"
 #include "crpropa/Units.h"
 
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
 
 namespace crpropa {
@@ -160,6 +163,18 @@ void Candidate::addSecondary(int id, double energy, Vector3d position, double w)
 	secondaries.push_back(secondary);
 }
 
+bool Candidate::addThinnedSecondary(int id, double energy, Vector3d position, double f, double thinning) {
+	if (thinning == 0) {
+		addSecondary(id, energy, position);
+		return true;
+	}
+	double p = pow(std::min(f, 1.), thinning);
+	if (Random::instance().rand() >= p)
+		return false;
+	addSecondary(id, energy, position, 1. / p);
+	return true;
+}
+
 void Candidate::clearSecondaries() {
 	secondaries.clear();
 }
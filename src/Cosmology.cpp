@@ -2,15 +2,66 @@
 #include "crpropa/Units.h"
 #include "crpropa/Common.h"
 
-#include <vector>
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <memory>
 #include <stdexcept>
+#include <vector>
 
 namespace crpropa {
 
+/**
+ @class IndexedRelation
+ @brief Relation Y(X) through the origin with constant time lookup
+
+ Gives the same results as interpolate(x, X, Y) for the tabulated points
+ X[0] = Y[0] = 0 < X[1] < ... < X[n-1]. Instead of a binary search the bin is
+ looked up in an index over logarithmically uniform cells of x, which holds
+ for each cell the bin containing its lower edge.
+ */
+struct IndexedRelation {
+	std::vector<double> X, Y;
+	std::vector<size_t> index;
+	double scale; // cell = log(x / X[1]) * scale
+
+	void setTable(const std::vector<double> &X, const std::vector<double> &Y, size_t nCells) {
+		this->X = X;
+		this->Y = Y;
+		size_t n = X.size();
+		scale = nCells / log(X.back() / X[1]);
+		index.resize(nCells + 1);
+		size_t i = 1;
+		for (size_t c = 0; c <= nCells; c++) {
+			double x = X[1] * exp(c / scale);
+			while ((i < n - 2) and (X[i + 1] <= x))
+				i++;
+			index[c] = i;
+		}
+	}
+
+	double operator()(double x) const {
+		if (x < X[1])
+			return Y[0] + (x - X[0]) * (Y[1] - Y[0]) / (X[1] - X[0]);
+		if (not (x < X.back()))
+			return Y.back();
+		size_t c = std::min(size_t(log(x / X[1]) * scale), index.size() - 1);
+		size_t i = index[c];
+		// correct for round-off in the cell and for several bins per cell
+		while ((i > 1) and (x < X[i]))
+			i--;
+		while (x >= X[i + 1])
+			i++;
+		return Y[i] + (x - X[i]) * (Y[i + 1] - Y[i]) / (X[i + 1] - X[i]);
+	}
+};
+
 /**
  @class Cosmology
  @brief Cosmology calculations
+
+ A Cosmology is immutable once constructed, setCosmologyParameters replaces
+ the instance in use.
  */
 struct Cosmology {
 	double H0; // Hubble parameter at z=0
@@ -18,6 +69,7 @@ struct Cosmology {
 	double omegaL; // vacuum energy parameter
 
 	static const int n;
+	static const int nIndex;
 	static const double zmin;
 	static const double zmax;
 
@@ -26,7 +78,11 @@ struct Cosmology {
 	std::vector<double> Dl; // luminosity distance [m]
 	std::vector<double> Dt; // light travel distance [m]
 
-	void update() {
+	IndexedRelation redshiftToDc, redshiftToDl, redshiftToDt;
+	IndexedRelation dcToRedshift, dlToRedshift, dtToRedshift;
+	IndexedRelation dcToDt, dtToDc;
+
+	void integrate() {
 		double dH = c_light / H0; // Hubble distance
 
 		std::vector<double> E(n);
@@ -48,11 +104,21 @@ struct Cosmology {
 		}
 	}
 
-	Cosmology() {
-        // Cosmological parameters (K.A. Olive et al. (Particle Data Group), Chin. Phys. C, 38, 090001 (2014))
-		H0 = 67.3 * 1000 * meter / second / Mpc; // default values
-		omegaM = 0.315;
-		omegaL = 1 - omegaM;
+	void tabulate() {
+		redshiftToDc.setTable(Z, Dc, nIndex);
+		redshiftToDl.setTable(Z, Dl, nIndex);
+		redshiftToDt.setTable(Z, Dt, nIndex);
+		dcToRedshift.setTable(Dc, Z, nIndex);
+		dlToRedshift.setTable(Dl, Z, nIndex);
+		dtToRedshift.setTable(Dt, Z, nIndex);
+		dcToDt.setTable(Dc, Dt, nIndex);
+		dtToDc.setTable(Dt, Dc, nIndex);
+	}
+
+	Cosmology(double h, double oM) {
+		H0 = h * 1e5 / Mpc;
+		omegaM = oM;
+		omegaL = 1 - oM;
 
 		Z.resize(n);
 		Dc.resize(n);
@@ -64,106 +130,164 @@ struct Cosmology {
 		Dl[0] = 0;
 		Dt[0] = 0;
 
-		update();
-	}
-
-	void setParameters(double h, double oM) {
-		H0 = h * 1e5 / Mpc;
-		omegaM = oM;
-		omegaL = 1 - oM;
-		update();
+		integrate();
+		tabulate();
 	}
 };
 
 const int Cosmology::n = 1000;
+const int Cosmology::nIndex = 4000; // cells of the lookup index
 const double Cosmology::zmin = 0.0001;
 const double Cosmology::zmax = 100;
 
-static Cosmology cosmology; // instance is created at runtime
+// The instance in use, replaced with atomic_store. Each thread holds its own
+// reference to the instance it reads and only reloads it when the version
+// changes, so that lookups do not need a lock. A replaced instance is freed
+// once every thread that used it has moved on to a newer one.
+static std::shared_ptr<const Cosmology> &currentCosmology() {
+	// Cosmological parameters (K.A. Olive et al. (Particle Data Group), Chin. Phys. C, 38, 090001 (2014))
+	static std::shared_ptr<const Cosmology> instance(new Cosmology(0.673, 0.315));
+	return instance;
+}
+
+static std::atomic<unsigned long> cosmologyVersion(0);
+
+struct LocalCosmology {
+	const Cosmology *cosmology; // owned by the reference in reloadCosmology
+	unsigned long version;
+};
+static thread_local LocalCosmology local = {0, 0};
+
+static const Cosmology *reloadCosmology(unsigned long version) {
+	static thread_local std::shared_ptr<const Cosmology> reference;
+	reference = std::atomic_load(&currentCosmology());
+	local.cosmology = reference.get();
+	local.version = version;
+	return local.cosmology;
+}
+
+static inline const Cosmology &cosmology() {
+	unsigned long version = cosmologyVersion.load(std::memory_order_acquire);
+	const LocalCosmology &l = local;
+	if (l.cosmology and (version == l.version))
+		return *l.cosmology;
+	return *reloadCosmology(version);
+}
 
 void setCosmologyParameters(double h, double oM) {
-	cosmology.setParameters(h, oM);
+	std::shared_ptr<const Cosmology> c(new Cosmology(h, oM));
+	std::atomic_store(&currentCosmology(), c);
+	cosmologyVersion.fetch_add(1, std::memory_order_release);
 }
 
 double hubbleRate(double z) {
-	return cosmology.H0
-			* sqrt(cosmology.omegaL + cosmology.omegaM * pow(1 + z, 3));
+	const Cosmology &c = cosmology();
+	return c.H0 * sqrt(c.omegaL + c.omegaM * pow_integer<3>(1 + z));
 }
 
 double omegaL() {
-	return cosmology.omegaL;
+	return cosmology().omegaL;
 }
 
 double omegaM() {
-	return cosmology.omegaM;
+	return cosmology().omegaM;
 }
 
 double H0() {
-	return cosmology.H0;
+	return cosmology().H0;
 }
 
-double comovingDistance2Redshift(double d) {
-	if (d < 0)
-		throw std::runtime_error("Cosmology: d < 0");
-	if (d > cosmology.Dc.back())
-		throw std::runtime_error("Cosmology: d > dmax");
-	return interpolate(d, cosmology.Dc, cosmology.Z);
-}
+typedef IndexedRelation Cosmology::*Relation;
 
-double redshift2ComovingDistance(double z) {
+static double fromRedshift(const Cosmology &c, Relation relation, double z) {
 	if (z < 0)
 		throw std::runtime_error("Cosmology: z < 0");
-	if (z > cosmology.zmax)
+	if (z > c.zmax)
 		throw std::runtime_error("Cosmology: z > zmax");
-	return interpolate(z, cosmology.Z, cosmology.Dc);
+	return (c.*relation)(z);
 }
 
-double luminosityDistance2Redshift(double d) {
+static double fromDistance(const Cosmology &c, Relation relation, double d) {
 	if (d < 0)
 		throw std::runtime_error("Cosmology: d < 0");
-	if (d > cosmology.Dl.back())
+	if (d > (c.*relation).X.back())
 		throw std::runtime_error("Cosmology: d > dmax");
-	return interpolate(d, cosmology.Dl, cosmology.Z);
+	return (c.*relation)(d);
+}
+
+// converts all values with the same instance
+static std::vector<double> convert(
+		double (*f)(const Cosmology &, Relation, double), Relation relation,
+		const std::vector<double> &x) {
+	const Cosmology &c = cosmology();
+	std::vector<double> y(x.size());
+	for (size_t i = 0; i < x.size(); i++)
+		y[i] = f(c, relation, x[i]);
+	return y;
+}
+
+double comovingDistance2Redshift(double d) {
+	return fromDistance(cosmology(), &Cosmology::dcToRedshift, d);
+}
+
+std::vector<double> comovingDistance2Redshift(const std::vector<double> &d) {
+	return convert(fromDistance, &Cosmology::dcToRedshift, d);
+}
+
+double redshift2ComovingDistance(double z) {
+	return fromRedshift(cosmology(), &Cosmology::redshiftToDc, z);
+}
+
+std::vector<double> redshift2ComovingDistance(const std::vector<double> &z) {
+	return convert(fromRedshift, &Cosmology::redshiftToDc, z);
+}
+
+double luminosityDistance2Redshift(double d) {
+	return fromDistance(cosmology(), &Cosmology::dlToRedshift, d);
+}
+
+std::vector<double> luminosityDistance2Redshift(const std::vector<double> &d) {
+	return convert(fromDistance, &Cosmology::dlToRedshift, d);
 }
 
 double redshift2LuminosityDistance(double z) {
-	if (z < 0)
-		throw std::runtime_error("Cosmology: z < 0");
-	if (z > cosmology.zmax)
-		throw std::runtime_error("Cosmology: z > zmax");
-	return interpolate(z, cosmology.Z, cosmology.Dl);
+	return fromRedshift(cosmology(), &Cosmology::redshiftToDl, z);
+}
+
+std::vector<double> redshift2LuminosityDistance(const std::vector<double> &z) {
+	return convert(fromRedshift, &Cosmology::redshiftToDl, z);
 }
 
 double lightTravelDistance2Redshift(double d) {
-	if (d < 0)
-		throw std::runtime_error("Cosmology: d < 0");
-	if (d > cosmology.Dt.back())
-		throw std::runtime_error("Cosmology: d > dmax");
-	return interpolate(d, cosmology.Dt, cosmology.Z);
+	return fromDistance(cosmology(), &Cosmology::dtToRedshift, d);
+}
+
+std::vector<double> lightTravelDistance2Redshift(const std::vector<double> &d) {
+	return convert(fromDistance, &Cosmology::dtToRedshift, d);
 }
 
 double redshift2LightTravelDistance(double z) {
-	if (z < 0)
-		throw std::runtime_error("Cosmology: z < 0");
-	if (z > cosmology.zmax)
-		throw std::runtime_error("Cosmology: z > zmax");
-	return interpolate(z, cosmology.Z, cosmology.Dt);
+	return fromRedshift(cosmology(), &Cosmology::redshiftToDt, z);
+}
+
+std::vector<double> redshift2LightTravelDistance(const std::vector<double> &z) {
+	return convert(fromRedshift, &Cosmology::redshiftToDt, z);
 }
 
 double comoving2LightTravelDistance(double d) {
-	if (d < 0)
-		throw std::runtime_error("Cosmology: d < 0");
-	if (d > cosmology.Dc.back())
-		throw std::runtime_error("Cosmology: d > dmax");
-	return interpolate(d, cosmology.Dc, cosmology.Dt);
+	return fromDistance(cosmology(), &Cosmology::dcToDt, d);
+}
+
+std::vector<double> comoving2LightTravelDistance(const std::vector<double> &d) {
+	return convert(fromDistance, &Cosmology::dcToDt, d);
 }
 
 double lightTravel2ComovingDistance(double d) {
-	if (d < 0)
-		throw std::runtime_error("Cosmology: d < 0");
-	if (d > cosmology.Dt.back())
-		throw std::runtime_error("Cosmology: d > dmax");
-	return interpolate(d, cosmology.Dt, cosmology.Dc);
+	return fromDistance(cosmology(), &Cosmology::dtToDc, d);
+}
+
+std::vector<double> lightTravel2ComovingDistance(const std::vector<double> &d) {
+	return convert(fromDistance, &Cosmology::dtToDc, d);
 }
 
 } // namespace crpropa
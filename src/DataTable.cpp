@@ -0,0 +1,311 @@
+#include "crpropa/DataTable.h"
+#include "crpropa/Common.h"
+
+#include "kiss/logger.h"
+#include "kiss/path.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <locale.h>
+#include <sys/stat.h>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace crpropa {
+
+namespace {
+
+const char cacheMagic[8] = {'C', 'R', 'P', 'T', 'A', 'B', 'L', 'E'};
+const uint32_t cacheVersion = 1;
+const uint32_t cacheByteOrder = 0x01020304;
+
+struct CacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint64_t sourceChecksum;
+	uint64_t nRows;
+	uint64_t nValues;
+};
+
+// strtod in the "C" locale, independent of the LC_NUMERIC of the process
+#ifdef _WIN32
+double parseDouble(const char *p, char **next) {
+	static _locale_t locale = _create_locale(LC_NUMERIC, "C");
+	return _strtod_l(p, next, locale);
+}
+#else
+double parseDouble(const char *p, char **next) {
+	static locale_t locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t) 0);
+	return strtod_l(p, next, locale);
+}
+#endif
+
+bool statFile(const std::string &filename, uint64_t &size, int64_t &time) {
+	struct stat s;
+	if (stat(filename.c_str(), &s) != 0)
+		return false;
+	size = s.st_size;
+	time = s.st_mtime;
+	return true;
+}
+
+bool readFile(const std::string &filename, std::string &content) {
+	std::ifstream infile(filename.c_str(), std::ios::binary);
+	if (not infile.good())
+		return false;
+	std::stringstream buffer;
+	buffer << infile.rdbuf();
+	content = buffer.str();
+	return true;
+}
+
+// 64 bit FNV-1a hash
+uint64_t checksum(const std::string &content) {
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < content.size(); i++) {
+		h ^= (unsigned char) content[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+// store the new modification time of the text file in the header of a valid cache
+void updateSourceTime(const std::string &cachename, int64_t time) {
+	std::fstream cache(cachename.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+	if (not cache.good())
+		return; // read-only caches are still valid, only slower to check
+	cache.seekp(offsetof(CacheHeader, sourceTime));
+	cache.write((const char *) &time, sizeof(time));
+}
+
+} // namespace
+
+DataTable::DataTable() :
+		offsets(0), values(0), nRows(0), nValues(0) {
+}
+
+DataTable::~DataTable() {
+}
+
+ref_ptr<DataTable> DataTable::load(const std::string &filename) {
+	ref_ptr<DataTable> table = new DataTable();
+	std::string cachename = getCacheFilename(filename);
+	if (table->mapCache(cachename, filename))
+		return table;
+
+	// stat before reading, a concurrent change then only invalidates the cache
+	uint64_t size;
+	int64_t time;
+	std::string content;
+	if (not statFile(filename, size, time) or not readFile(filename, content))
+		throw std::runtime_error("DataTable: could not open file " + filename);
+	table->parseText(content, filename);
+	if (table->writeCache(cachename, size, time, checksum(content))) {
+		// continue with the mapping, so that the memory is shared with other processes
+		ref_ptr<DataTable> mapped = new DataTable();
+		if (mapped->mapCache(cachename, filename))
+			return mapped;
+	}
+	return table;
+}
+
+ref_ptr<DataTable> DataTable::parse(const std::string &filename) {
+	std::string content;
+	if (not readFile(filename, content))
+		throw std::runtime_error("DataTable: could not open file " + filename);
+	ref_ptr<DataTable> table = new DataTable();
+	table->parseText(content, filename);
+	return table;
+}
+
+std::string DataTable::getCacheFilename(const std::string &filename) {
+	const char *cachePath = getenv("CRPROPA_CACHE_PATH");
+	if (not cachePath)
+		return filename + ".cache";
+
+	// flatten the path of the text file into a unique file name
+	std::string name = filename;
+	for (size_t i = 0; i < name.size(); i++)
+		if ((name[i] == '/') or (name[i] == '\\') or (name[i] == ':'))
+			name[i] = '_';
+	return concat_path(cachePath, name + ".cache");
+}
+
+void DataTable::parseText(const std::string &content, const std::string &filename) {
+	ownOffsets.clear();
+	ownValues.clear();
+	ownOffsets.push_back(0);
+
+	const char *p = content.c_str();
+	const char *end = p + content.size();
+	size_t lineNumber = 0;
+	while (p < end) {
+		lineNumber++;
+		const char *eol = (const char *) memchr(p, '\n', end - p);
+		if (not eol)
+			eol = end;
+
+		while ((p < eol) and ((*p == ' ') or (*p == '\t') or (*p == '\r')))
+			p++;
+		if ((p < eol) and (*p != '#')) {
+			while (p < eol) {
+				char *next;
+				double value = parseDouble(p, &next);
+				if (next == p) {
+					std::stringstream s;
+					s << "DataTable: could not parse line " << lineNumber << " in " << filename;
+					throw std::runtime_error(s.str());
+				}
+				ownValues.push_back(value);
+				p = next;
+				while ((p < eol) and ((*p == ' ') or (*p == '\t') or (*p == '\r') or (*p == ',')))
+					p++;
+			}
+			ownOffsets.push_back(ownValues.size());
+		}
+		p = eol + 1;
+	}
+
+	offsets = &ownOffsets[0];
+	values = ownValues.empty() ? 0 : &ownValues[0];
+	nRows = ownOffsets.size() - 1;
+	nValues = ownValues.size();
+}
+
+bool DataTable::mapCache(const std::string &cachename, const std::string &filename) {
+	uint64_t size;
+	int64_t time;
+	if (not statFile(filename, size, time))
+		throw std::runtime_error("DataTable: could not open file " + filename);
+
+	ref_ptr<MemoryMappedFile> cache;
+	try {
+		cache = new MemoryMappedFile(cachename);
+	} catch (std::runtime_error &e) {
+		return false;
+	}
+	if (cache->size() < sizeof(CacheHeader))
+		return false;
+
+	CacheHeader header;
+	memcpy(&header, cache->data(), sizeof(header));
+	if ((memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0)
+			or (header.version != cacheVersion)
+			or (header.byteOrder != cacheByteOrder)
+			or (header.sourceSize != size))
+		return false;
+
+	uint64_t expectedSize = sizeof(header) + (header.nRows + 1) * sizeof(uint64_t)
+			+ header.nValues * sizeof(double);
+	if (cache->size() != expectedSize)
+		return false;
+
+	if (header.sourceTime != time) {
+		// the text file was touched, only reject the cache if the content changed
+		std::string content;
+		if (not readFile(filename, content) or (checksum(content) != header.sourceChecksum))
+			return false;
+		updateSourceTime(cachename, time);
+	}
+
+	file = cache;
+	nRows = header.nRows;
+	nValues = header.nValues;
+	offsets = (const uint64_t *) (cache->data() + sizeof(header));
+	values = (const double *) (cache->data() + sizeof(header) + (nRows + 1) * sizeof(uint64_t));
+	return true;
+}
+
+bool DataTable::writeCache(const std::string &cachename, uint64_t sourceSize,
+		int64_t sourceTime, uint64_t sourceChecksum) const {
+	CacheHeader header;
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	header.byteOrder = cacheByteOrder;
+	header.sourceSize = sourceSize;
+	header.sourceTime = sourceTime;
+	header.sourceChecksum = sourceChecksum;
+	header.nRows = nRows;
+	header.nValues = nValues;
+
+	// write to a temporary file and rename it, so that concurrent processes
+	// never see a partially written cache
+	std::stringstream tmpname;
+	tmpname << cachename << ".tmp";
+#ifndef _WIN32
+	tmpname << getpid();
+#endif
+	tmpname << "_" << this;
+
+	{
+		std::ofstream cache(tmpname.str().c_str(), std::ios::binary);
+		if (not cache.good()) {
+			KISS_LOG_INFO << "DataTable: could not write cache " << cachename << std::endl;
+			return false;
+		}
+		cache.write((const char *) &header, sizeof(header));
+		cache.write((const char *) offsets, (nRows + 1) * sizeof(uint64_t));
+		if (nValues > 0)
+			cache.write((const char *) values, nValues * sizeof(double));
+		if (not cache.good()) {
+			cache.close();
+			remove(tmpname.str().c_str());
+			return false;
+		}
+	}
+
+	if (rename(tmpname.str().c_str(), cachename.c_str()) != 0) {
+		remove(tmpname.str().c_str());
+		return false;
+	}
+	return true;
+}
+
+size_t DataTable::rows() const {
+	return nRows;
+}
+
+size_t DataTable::columns(size_t row) const {
+	if (row >= nRows)
+		throw std::runtime_error("DataTable: row index out of range");
+	return offsets[row + 1] - offsets[row];
+}
+
+const double *DataTable::row(size_t row) const {
+	if (row >= nRows)
+		throw std::runtime_error("DataTable: row index out of range");
+	return values + offsets[row];
+}
+
+double DataTable::operator()(size_t row, size_t column) const {
+	if (column >= columns(row))
+		throw std::runtime_error("DataTable: column index out of range");
+	return values[offsets[row] + column];
+}
+
+size_t DataTable::size() const {
+	return nValues;
+}
+
+const double *DataTable::data() const {
+	return values;
+}
+
+bool DataTable::isMapped() const {
+	return file.valid();
+}
+
+} // namespace crpropa
@@ -0,0 +1,179 @@
+#include "crpropa/DiscreteSampler.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace crpropa {
+
+DiscreteSampler::DiscreteSampler() : totalWeight(0), dirty(false) {
+}
+
+DiscreteSampler::DiscreteSampler(const std::vector<double> &weights) : totalWeight(0), dirty(false) {
+	setWeights(weights);
+}
+
+DiscreteSampler::DiscreteSampler(const DiscreteSampler &other) : dirty(false) {
+	*this = other;
+}
+
+DiscreteSampler &DiscreteSampler::operator=(const DiscreteSampler &other) {
+	if (this == &other)
+		return *this;
+	other.update();
+	weights = other.weights;
+	probability = other.probability;
+	alias = other.alias;
+	totalWeight = other.totalWeight;
+	dirty.store(false, std::memory_order_release);
+	return *this;
+}
+
+void DiscreteSampler::setWeights(const std::vector<double> &w) {
+	weights = w;
+	for (size_t i = 0; i < weights.size(); i++)
+		if (not (weights[i] >= 0))
+			throw std::runtime_error("DiscreteSampler: weights must not be negative");
+	build();
+	dirty.store(false, std::memory_order_release);
+}
+
+void DiscreteSampler::setWeights(const std::vector<float> &w) {
+	setWeights(std::vector<double>(w.begin(), w.end()));
+}
+
+void DiscreteSampler::setCDF(const std::vector<double> &cdf) {
+	std::vector<double> w(cdf.size());
+	double previous = 0;
+	for (size_t i = 0; i < cdf.size(); i++) {
+		// guard against round-off in (non-strictly) increasing tables
+		w[i] = std::max(0., cdf[i] - previous);
+		previous = std::max(previous, cdf[i]);
+	}
+	setWeights(w);
+}
+
+void DiscreteSampler::setCDF(const std::vector<float> &cdf) {
+	setCDF(std::vector<double>(cdf.begin(), cdf.end()));
+}
+
+void DiscreteSampler::add(double weight) {
+	if (not (weight >= 0))
+		throw std::runtime_error("DiscreteSampler: weights must not be negative");
+	weights.push_back(weight);
+	dirty.store(true, std::memory_order_release);
+}
+
+void DiscreteSampler::clear() {
+	weights.clear();
+	probability.clear();
+	alias.clear();
+	totalWeight = 0;
+	dirty.store(false, std::memory_order_release);
+}
+
+void DiscreteSampler::build() const {
+	size_t n = weights.size();
+	if (n > std::numeric_limits<uint32_t>::max())
+		throw std::runtime_error("DiscreteSampler: too many bins");
+
+	totalWeight = 0;
+	for (size_t i = 0; i < n; i++)
+		totalWeight += weights[i];
+
+	probability.resize(n);
+	alias.resize(n);
+	if ((n == 0) or (totalWeight <= 0))
+		return;
+
+	// scale the weights to a mean of 1 and split into under- and overfull bins
+	std::vector<uint32_t> small, large;
+	uint32_t last = 0; // a bin with positive weight to redirect empty bins to
+	for (size_t i = 0; i < n; i++) {
+		if (weights[i] > weights[last])
+			last = i;
+		probability[i] = weights[i] * n / totalWeight;
+		alias[i] = i;
+		if (probability[i] < 1)
+			small.push_back(i);
+		else
+			large.push_back(i);
+	}
+
+	// fill up each underfull bin with the remainder of an overfull one
+	while (not small.empty() and not large.empty()) {
+		uint32_t s = small.back();
+		small.pop_back();
+		uint32_t l = large.back();
+		alias[s] = l;
+		probability[l] -= 1 - probability[s];
+		if (probability[l] < 1) {
+			large.pop_back();
+			small.push_back(l);
+		}
+		last = l;
+	}
+
+	// remaining bins are full up to round-off
+	for (size_t i = 0; i < large.size(); i++)
+		probability[large[i]] = 1;
+	for (size_t i = 0; i < small.size(); i++) {
+		uint32_t s = small[i];
+		if (weights[s] > 0) {
+			probability[s] = 1;
+		} else {
+			probability[s] = 0;
+			alias[s] = last;
+		}
+	}
+}
+
+void DiscreteSampler::update() const {
+	if (not dirty.load(std::memory_order_acquire))
+		return;
+#pragma omp critical(DiscreteSampler)
+	if (dirty.load(std::memory_order_acquire)) {
+		build();
+		// publish the flag only after the tables are complete
+		dirty.store(false, std::memory_order_release);
+	}
+}
+
+size_t DiscreteSampler::sample(Random &random) const {
+	update();
+	if (totalWeight <= 0)
+		throw std::runtime_error("DiscreteSampler: no bins with positive weight");
+
+	size_t n = probability.size();
+	double u = random.rand53() * n;
+	size_t i = std::min(size_t(u), n - 1);
+	if (u - i < probability[i])
+		return i;
+	return alias[i];
+}
+
+size_t DiscreteSampler::sample() const {
+	return sample(Random::instance());
+}
+
+size_t DiscreteSampler::size() const {
+	return weights.size();
+}
+
+bool DiscreteSampler::empty() const {
+	return weights.empty();
+}
+
+double DiscreteSampler::getTotalWeight() const {
+	update();
+	return totalWeight;
+}
+
+double DiscreteSampler::getProbability(size_t i) const {
+	update();
+	if (totalWeight <= 0)
+		return 0;
+	return weights.at(i) / totalWeight;
+}
+
+} // namespace crpropa
@@ -32,7 +32,7 @@ Vector3d CylindricalProjectionMap::drawDirection() const {
 	if (dirty)
 		updateCdf();
 
-	size_t bin = Random::instance().randBin(cdf);
+	size_t bin = sampler.sample();
 
 	return directionFromBin(bin);
 }
@@ -114,6 +114,7 @@ void CylindricalProjectionMap::updateCdf() const {
 		for (size_t i = 1; i < pdf.size(); i++) {
 			cdf[i] = cdf[i-1] + pdf[i];
 		}
+		sampler.setWeights(pdf);
 		dirty = false;
 	}
 }
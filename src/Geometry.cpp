@@ -1,4 +1,5 @@
 #include <limits>
+#include <algorithm>
 #include <cmath>
 #include "kiss/logger.h"
 #include "crpropa/Geometry.h"
@@ -7,6 +8,11 @@
 
 namespace crpropa {
 
+// Surface ----------------------------------------------------------------
+double Surface::intersectionDistance(const Vector3d& point, const Vector3d& /*direction*/) const {
+	return fabs(distance(point));
+}
+
 // Plane ------------------------------------------------------------------
 Plane::Plane(const Vector3d& _x0, const Vector3d& _n) : x0(_x0), n(_n) {
 };
@@ -33,6 +39,13 @@ Vector3d Plane::normal(const Vector3d& point) const {
 	return n;
 }
 
+double Plane::intersectionDistance(const Vector3d& point, const Vector3d& direction) const {
+	double t = -distance(point) / n.dot(direction);
+	if (t > 0)
+		return t;
+	return std::numeric_limits<double>::infinity(); // moving away or parallel
+}
+
 
 // Sphere ------------------------------------------------------------------
 Sphere::Sphere(const Vector3d& _center, double _radius) : center(_center), radius(_radius) {
@@ -48,6 +61,22 @@ Vector3d Sphere::normal(const Vector3d& point) const {
 	return d.getUnitVector();
 }
 
+double Sphere::intersectionDistance(const Vector3d& point, const Vector3d& direction) const {
+	// solve |point + t * direction - center| = radius for t
+	Vector3d d = point - center;
+	double b = d.dot(direction);
+	double disc = b * b - (d.getR2() - radius * radius);
+	if (disc >= 0) {
+		double t1 = -b - sqrt(disc); // entry
+		double t2 = -b + sqrt(disc); // exit
+		if (t1 > 0)
+			return t1;
+		if (t2 > 0)
+			return t2;
+	}
+	return std::numeric_limits<double>::infinity();
+}
+
 std::string Sphere::getDescription() const {
 	std::stringstream ss;
 	ss << "Sphere: " << std::endl
@@ -112,6 +141,32 @@ Vector3d ParaxialBox::normal(const Vector3d& point) const {
 	return n;
 }
 
+double ParaxialBox::intersectionDistance(const Vector3d& point, const Vector3d& direction) const {
+	// intersection of the slabs between the faces of each axis
+	double tEnter = -std::numeric_limits<double>::infinity();
+	double tExit = std::numeric_limits<double>::infinity();
+	for (int i = 0; i < 3; i++) {
+		double lo = corner.data[i] - point.data[i];
+		double hi = lo + size.data[i];
+		if (direction.data[i] == 0) {
+			if ((lo > 0) or (hi < 0))
+				return std::numeric_limits<double>::infinity(); // parallel to and outside the slab
+			continue;
+		}
+		double t1 = lo / direction.data[i];
+		double t2 = hi / direction.data[i];
+		tEnter = std::max(tEnter, std::min(t1, t2));
+		tExit = std::min(tExit, std::max(t1, t2));
+	}
+	if (tEnter > tExit)
+		return std::numeric_limits<double>::infinity();
+	if (tEnter > 0)
+		return tEnter;
+	if (tExit > 0)
+		return tExit;
+	return std::numeric_limits<double>::infinity();
+}
+
 std::string ParaxialBox::getDescription() const {
 	std::stringstream ss;
 	ss << "ParaxialBox: " << std::endl
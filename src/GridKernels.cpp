@@ -0,0 +1,298 @@
+#include "crpropa/GridKernels.h"
+
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRPROPA_HAVE_GRID_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace crpropa {
+
+#ifdef CRPROPA_HAVE_GRID_KERNELS
+
+// The kernels are compiled for their instruction sets independent of the
+// compiler flags and only called if the CPU supports them.
+// Grid indices are handled as doubles, which are exact below 2^52.
+// They give the same values as Grid::closestValue and Grid::floatSum: the
+// nearest grid point is found with the symmetric rounding of fmod(r, n), and
+// the trilinear sum is accumulated in double precision over the neighbours
+// in the order of Grid::trilinearWeights, with the weights rounded to float.
+// The AVX-512 intrinsics are used in their masked forms, since the unmasked
+// ones pass an uninitialized vector to the builtins, which GCC reports.
+
+// neighbours in the order of Grid::trilinearWeights, bits x, y, z
+static const int neighbourOrder[8][3] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1},
+		{1, 0, 1}, {0, 1, 1}, {1, 1, 0}, {1, 1, 1}};
+
+__attribute__((target("avx2,fma")))
+static inline __m256i toIndexAVX2(__m256d x) {
+	const __m256d magic = _mm256_set1_pd(4503599627370496.); // 2^52
+	return _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(x, magic)), _mm256_castpd_si256(magic));
+}
+
+// integer x periodically into [0, n)
+__attribute__((target("avx2,fma")))
+static inline __m256d wrapAVX2(__m256d x, __m256d n) {
+	x = _mm256_sub_pd(x, _mm256_mul_pd(n, _mm256_floor_pd(_mm256_div_pd(x, n))));
+	x = _mm256_add_pd(x, _mm256_and_pd(n, _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_LT_OQ)));
+	return _mm256_sub_pd(x, _mm256_and_pd(n, _mm256_cmp_pd(x, n, _CMP_GE_OQ)));
+}
+
+// nearest integer of x periodically in [0, n), as round(fmod(x, n)) in Grid::closestValue
+__attribute__((target("avx2,fma")))
+static inline __m256d nearestAVX2(__m256d x, __m256d n) {
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d half = _mm256_set1_pd(0.5);
+	// fmod with the sign of x, the subtraction is exact
+	__m256d q = _mm256_round_pd(_mm256_div_pd(x, n), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+	__m256d r = _mm256_sub_pd(x, _mm256_mul_pd(n, q));
+	// the rounded quotient can be too large by one
+	__m256d negative = _mm256_cmp_pd(x, zero, _CMP_LT_OQ);
+	r = _mm256_add_pd(r, _mm256_andnot_pd(negative, _mm256_and_pd(n, _mm256_cmp_pd(r, zero, _CMP_LT_OQ))));
+	r = _mm256_sub_pd(r, _mm256_and_pd(negative, _mm256_and_pd(n, _mm256_cmp_pd(r, zero, _CMP_GT_OQ))));
+	// round half away from zero
+	__m256d up = _mm256_floor_pd(_mm256_add_pd(r, half));
+	__m256d down = _mm256_ceil_pd(_mm256_sub_pd(r, half));
+	r = _mm256_blendv_pd(down, up, _mm256_cmp_pd(r, zero, _CMP_GT_OQ));
+	r = _mm256_add_pd(r, _mm256_and_pd(n, _mm256_cmp_pd(r, zero, _CMP_LT_OQ)));
+	return _mm256_sub_pd(r, _mm256_and_pd(n, _mm256_cmp_pd(r, n, _CMP_GE_OQ)));
+}
+
+__attribute__((target("avx2,fma")))
+static size_t interpolateAVX2(const float *values, size_t nc, const size_t *N,
+		const Vector3d &gridOrigin, const Vector3d &spacing, bool nearest,
+		const Vector3d *p, float *out, size_t n) {
+	__m256d origin[3], step[3], num[3], stride[3];
+	double strides[3] = {double(N[1] * N[2] * nc), double(N[2] * nc), double(nc)};
+	for (int d = 0; d < 3; d++) {
+		origin[d] = _mm256_set1_pd(gridOrigin.data[d]);
+		step[d] = _mm256_set1_pd(spacing.data[d]);
+		num[d] = _mm256_set1_pd(N[d]);
+		stride[d] = _mm256_set1_pd(strides[d]);
+	}
+	const __m256d one = _mm256_set1_pd(1);
+
+	size_t m = n - n % 4;
+	float c[3][4];
+	for (size_t i = 0; i < m; i += 4) {
+		// positions on a unit grid
+		__m256d r[3];
+		for (int d = 0; d < 3; d++) {
+			__m256d x = _mm256_set_pd(p[i + 3].data[d], p[i + 2].data[d], p[i + 1].data[d], p[i].data[d]);
+			r[d] = _mm256_div_pd(_mm256_sub_pd(x, origin[d]), step[d]);
+		}
+
+		__m128 b[3];
+		if (nearest) {
+			__m256d index = _mm256_setzero_pd();
+			for (int d = 0; d < 3; d++)
+				index = _mm256_fmadd_pd(nearestAVX2(r[d], num[d]), stride[d], index);
+			__m256i vindex = toIndexAVX2(index);
+			for (size_t k = 0; k < nc; k++)
+				b[k] = _mm256_i64gather_ps(values + k, vindex, 4);
+		} else {
+			// offsets of the lower and upper neighbours and their weights
+			__m256d lo[3], hi[3], wlo[3], whi[3];
+			for (int d = 0; d < 3; d++) {
+				__m256d fl = _mm256_floor_pd(r[d]);
+				__m256d f = _mm256_sub_pd(r[d], fl);
+				__m256d x0 = wrapAVX2(fl, num[d]);
+				__m256d x1 = _mm256_add_pd(x0, one);
+				x1 = _mm256_sub_pd(x1, _mm256_and_pd(num[d], _mm256_cmp_pd(x1, num[d], _CMP_GE_OQ)));
+				lo[d] = _mm256_mul_pd(x0, stride[d]);
+				hi[d] = _mm256_mul_pd(x1, stride[d]);
+				wlo[d] = _mm256_sub_pd(one, f);
+				whi[d] = f;
+			}
+			// the products of the values and the weights are exact, so the
+			// fused multiply-add gives the same sum as the scalar version
+			__m256d sum[3];
+			for (size_t k = 0; k < nc; k++)
+				sum[k] = _mm256_setzero_pd();
+			for (int j = 0; j < 8; j++) {
+				const int *o = neighbourOrder[j];
+				__m256d index = _mm256_add_pd(_mm256_add_pd(o[0] ? hi[0] : lo[0], o[1] ? hi[1] : lo[1]), o[2] ? hi[2] : lo[2]);
+				__m256d w = _mm256_mul_pd(_mm256_mul_pd(o[0] ? whi[0] : wlo[0], o[1] ? whi[1] : wlo[1]), o[2] ? whi[2] : wlo[2]);
+				w = _mm256_cvtps_pd(_mm256_cvtpd_ps(w));
+				__m256i vindex = toIndexAVX2(index);
+				for (size_t k = 0; k < nc; k++)
+					sum[k] = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm256_i64gather_ps(values + k, vindex, 4)), w, sum[k]);
+			}
+			for (size_t k = 0; k < nc; k++)
+				b[k] = _mm256_cvtpd_ps(sum[k]);
+		}
+
+		for (size_t k = 0; k < nc; k++)
+			_mm_storeu_ps(c[k], b[k]);
+		for (int l = 0; l < 4; l++)
+			for (size_t k = 0; k < nc; k++)
+				out[(i + l) * nc + k] = c[k][l];
+	}
+	return m;
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static inline __m512i toIndexAVX512(__m512d x) {
+	const __m512d magic = _mm512_set1_pd(4503599627370496.); // 2^52
+	return _mm512_sub_epi64(_mm512_castpd_si512(_mm512_add_pd(x, magic)), _mm512_castpd_si512(magic));
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static inline __m512d floorAVX512(__m512d x) {
+	return _mm512_maskz_roundscale_pd(0xff, x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+}
+
+// integer x periodically into [0, n)
+__attribute__((target("avx512f,avx2,fma")))
+static inline __m512d wrapAVX512(__m512d x, __m512d n) {
+	x = _mm512_sub_pd(x, _mm512_mul_pd(n, floorAVX512(_mm512_div_pd(x, n))));
+	x = _mm512_mask_add_pd(x, _mm512_cmp_pd_mask(x, _mm512_setzero_pd(), _CMP_LT_OQ), x, n);
+	return _mm512_mask_sub_pd(x, _mm512_cmp_pd_mask(x, n, _CMP_GE_OQ), x, n);
+}
+
+// nearest integer of x periodically in [0, n), as round(fmod(x, n)) in Grid::closestValue
+__attribute__((target("avx512f,avx2,fma")))
+static inline __m512d nearestAVX512(__m512d x, __m512d n) {
+	const __m512d zero = _mm512_setzero_pd();
+	const __m512d half = _mm512_set1_pd(0.5);
+	// fmod with the sign of x, the subtraction is exact
+	__m512d q = _mm512_maskz_roundscale_pd(0xff, _mm512_div_pd(x, n), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+	__m512d r = _mm512_sub_pd(x, _mm512_mul_pd(n, q));
+	// the rounded quotient can be too large by one
+	__mmask8 negative = _mm512_cmp_pd_mask(x, zero, _CMP_LT_OQ);
+	r = _mm512_mask_add_pd(r, _mm512_mask_cmp_pd_mask(~negative, r, zero, _CMP_LT_OQ), r, n);
+	r = _mm512_mask_sub_pd(r, _mm512_mask_cmp_pd_mask(negative, r, zero, _CMP_GT_OQ), r, n);
+	// round half away from zero
+	__mmask8 positive = _mm512_cmp_pd_mask(r, zero, _CMP_GT_OQ);
+	__m512d up = floorAVX512(_mm512_add_pd(r, half));
+	__m512d down = _mm512_maskz_roundscale_pd(0xff, _mm512_sub_pd(r, half), _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC);
+	r = _mm512_mask_blend_pd(positive, down, up);
+	r = _mm512_mask_add_pd(r, _mm512_cmp_pd_mask(r, zero, _CMP_LT_OQ), r, n);
+	return _mm512_mask_sub_pd(r, _mm512_cmp_pd_mask(r, n, _CMP_GE_OQ), r, n);
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static size_t interpolateAVX512(const float *values, size_t nc, const size_t *N,
+		const Vector3d &gridOrigin, const Vector3d &spacing, bool nearest,
+		const Vector3d *p, float *out, size_t n) {
+	__m512d origin[3], step[3], num[3], stride[3];
+	double strides[3] = {double(N[1] * N[2] * nc), double(N[2] * nc), double(nc)};
+	for (int d = 0; d < 3; d++) {
+		origin[d] = _mm512_set1_pd(gridOrigin.data[d]);
+		step[d] = _mm512_set1_pd(spacing.data[d]);
+		num[d] = _mm512_set1_pd(N[d]);
+		stride[d] = _mm512_set1_pd(strides[d]);
+	}
+	const __m512d one = _mm512_set1_pd(1);
+	// the x, y, z components of 8 consecutive positions
+	const __m512i gather = _mm512_set_epi64(21, 18, 15, 12, 9, 6, 3, 0);
+
+	size_t m = n - n % 8;
+	float c[3][8];
+	for (size_t i = 0; i < m; i += 8) {
+		// positions on a unit grid
+		__m512d r[3];
+		for (int d = 0; d < 3; d++) {
+			__m512d x = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), 0xff, gather, p[i].data + d, 8);
+			r[d] = _mm512_div_pd(_mm512_sub_pd(x, origin[d]), step[d]);
+		}
+
+		__m256 b[3];
+		if (nearest) {
+			__m512d index = _mm512_setzero_pd();
+			for (int d = 0; d < 3; d++)
+				index = _mm512_fmadd_pd(nearestAVX512(r[d], num[d]), stride[d], index);
+			__m512i vindex = toIndexAVX512(index);
+			for (size_t k = 0; k < nc; k++)
+				b[k] = _mm512_mask_i64gather_ps(_mm256_setzero_ps(), 0xff, vindex, values + k, 4);
+		} else {
+			// offsets of the lower and upper neighbours and their weights
+			__m512d lo[3], hi[3], wlo[3], whi[3];
+			for (int d = 0; d < 3; d++) {
+				__m512d fl = floorAVX512(r[d]);
+				__m512d f = _mm512_sub_pd(r[d], fl);
+				__m512d x0 = wrapAVX512(fl, num[d]);
+				__m512d x1 = _mm512_add_pd(x0, one);
+				x1 = _mm512_mask_sub_pd(x1, _mm512_cmp_pd_mask(x1, num[d], _CMP_GE_OQ), x1, num[d]);
+				lo[d] = _mm512_mul_pd(x0, stride[d]);
+				hi[d] = _mm512_mul_pd(x1, stride[d]);
+				wlo[d] = _mm512_sub_pd(one, f);
+				whi[d] = f;
+			}
+			// the products of the values and the weights are exact, so the
+			// fused multiply-add gives the same sum as the scalar version
+			__m512d sum[3];
+			for (size_t k = 0; k < nc; k++)
+				sum[k] = _mm512_setzero_pd();
+			for (int j = 0; j < 8; j++) {
+				const int *o = neighbourOrder[j];
+				__m512d index = _mm512_add_pd(_mm512_add_pd(o[0] ? hi[0] : lo[0], o[1] ? hi[1] : lo[1]), o[2] ? hi[2] : lo[2]);
+				__m512d w = _mm512_mul_pd(_mm512_mul_pd(o[0] ? whi[0] : wlo[0], o[1] ? whi[1] : wlo[1]), o[2] ? whi[2] : wlo[2]);
+				w = _mm512_maskz_cvtps_pd(0xff, _mm512_maskz_cvtpd_ps(0xff, w));
+				__m512i vindex = toIndexAVX512(index);
+				for (size_t k = 0; k < nc; k++)
+					sum[k] = _mm512_fmadd_pd(_mm512_maskz_cvtps_pd(0xff,
+							_mm512_mask_i64gather_ps(_mm256_setzero_ps(), 0xff, vindex, values + k, 4)), w, sum[k]);
+			}
+			for (size_t k = 0; k < nc; k++)
+				b[k] = _mm512_maskz_cvtpd_ps(0xff, sum[k]);
+		}
+
+		for (size_t k = 0; k < nc; k++)
+			_mm256_storeu_ps(c[k], b[k]);
+		for (int l = 0; l < 8; l++)
+			for (size_t k = 0; k < nc; k++)
+				out[(i + l) * nc + k] = c[k][l];
+	}
+	return m;
+}
+
+#endif // CRPROPA_HAVE_GRID_KERNELS
+
+gridKernelType getBestGridKernel() {
+#ifdef CRPROPA_HAVE_GRID_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return AVX512_KERNEL;
+	if (__builtin_cpu_supports("avx2") and __builtin_cpu_supports("fma"))
+		return AVX2_KERNEL;
+#endif
+	return SCALAR_KERNEL;
+}
+
+static gridKernelType &currentGridKernel() {
+	static gridKernelType kernel = getBestGridKernel();
+	return kernel;
+}
+
+gridKernelType getGridKernel() {
+	return currentGridKernel();
+}
+
+void setGridKernel(gridKernelType kernel) {
+	if ((kernel < SCALAR_KERNEL) or (kernel > getBestGridKernel()))
+		throw std::runtime_error("setGridKernel: kernel not supported by the CPU");
+	currentGridKernel() = kernel;
+}
+
+size_t gridKernelInterpolate(const float *values, size_t nc, const size_t *N,
+		const Vector3d &gridOrigin, const Vector3d &spacing, bool nearest,
+		const Vector3d *positions, float *out, size_t n) {
+	// indices as doubles and the gathers with 64 bit offsets
+	if ((N[0] * N[1] * N[2] * nc) >= (size_t(1) << 52))
+		return 0;
+#ifdef CRPROPA_HAVE_GRID_KERNELS
+	switch (getGridKernel()) {
+	case AVX512_KERNEL:
+		return interpolateAVX512(values, nc, N, gridOrigin, spacing, nearest, positions, out, n);
+	case AVX2_KERNEL:
+		return interpolateAVX2(values, nc, N, gridOrigin, spacing, nearest, positions, out, n);
+	default:
+		break;
+	}
+#endif
+	return 0;
+}
+
+} // namespace crpropa
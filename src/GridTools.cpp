@@ -1,104 +1,213 @@
 #include "crpropa/GridTools.h"
 #include "crpropa/magneticField/MagneticField.h"
 
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
 namespace crpropa {
 
+namespace {
+
+// Sums over the grid points of a slab, in double precision. The loops over
+// the components run over contiguous floats and are vectorised.
+struct ScalarSums {
+	double sum, sum2;
+
+	ScalarSums() : sum(0), sum2(0) {
+	}
+
+	void add(const float *v, size_t n) {
+		double s = 0, s2 = 0;
+#pragma omp simd reduction(+:s,s2)
+		for (size_t i = 0; i < n; i++) {
+			double x = v[i];
+			s += x;
+			s2 += x * x;
+		}
+		sum += s;
+		sum2 += s2;
+	}
+
+	void add(const ScalarSums &s) {
+		sum += s.sum;
+		sum2 += s.sum2;
+	}
+};
+
+struct VectorSums {
+	double sum[3], sum2[3], sumR;
+
+	VectorSums() : sumR(0) {
+		for (int c = 0; c < 3; c++)
+			sum[c] = sum2[c] = 0;
+	}
+
+	void add(const Vector3f *v, size_t n) {
+		const float *f = v[0].data;
+		double sx = 0, sy = 0, sz = 0, sxx = 0, syy = 0, szz = 0, sr = 0;
+#pragma omp simd reduction(+:sx,sy,sz,sxx,syy,szz,sr)
+		for (size_t i = 0; i < n; i++) {
+			double x = f[3 * i], y = f[3 * i + 1], z = f[3 * i + 2];
+			sx += x;
+			sy += y;
+			sz += z;
+			sxx += x * x;
+			syy += y * y;
+			szz += z * z;
+			sr += std::sqrt(x * x + y * y + z * z);
+		}
+		sum[0] += sx;
+		sum[1] += sy;
+		sum[2] += sz;
+		sum2[0] += sxx;
+		sum2[1] += syy;
+		sum2[2] += szz;
+		sumR += sr;
+	}
+
+	void add(const VectorSums &s) {
+		for (int c = 0; c < 3; c++) {
+			sum[c] += s.sum[c];
+			sum2[c] += s.sum2[c];
+		}
+		sumR += s.sumR;
+	}
+};
+
+template<typename T, typename S>
+void addSlab(const Grid<T> &g, size_t ix, S &sums) {
+	size_t Ny = g.getNy(), Nz = g.getNz();
+	if ((g.getStorageType() == FULL_PRECISION) and (g.getLayout() == ROW_MAJOR)) {
+		sums.add(g.values() + ix * Ny * Nz, Ny * Nz);
+		return;
+	}
+	std::vector<T> row(Nz);
+	for (size_t iy = 0; iy < Ny; iy++) {
+		for (size_t iz = 0; iz < Nz; iz++)
+			row[iz] = g.get(ix, iy, iz);
+		sums.add(row.data(), Nz);
+	}
+}
+
+// Sums over all grid points, in parallel over the slabs of constant ix.
+// The slab sums are added in order, independent of the number of threads.
+// With release, the pages of a mapped grid are released after each slab.
+template<typename T, typename S>
+S sumGrid(const Grid<T> &g, bool release = false) {
+	size_t Nx = g.getNx();
+	std::vector<S> slabs(Nx);
+#pragma omp parallel for schedule(dynamic)
+	for (size_t ix = 0; ix < Nx; ix++) {
+		addSlab(g, ix, slabs[ix]);
+		if (release)
+			g.releaseMapped(ix, ix + 1);
+	}
+	S sums;
+	for (size_t ix = 0; ix < Nx; ix++)
+		sums.add(slabs[ix]);
+	return sums;
+}
+
+template<typename T>
+void scaleValues(Grid<T> &g, float a) {
+	g.detach(); // before the threads access the values
+	size_t Nx = g.getNx(), Ny = g.getNy(), Nz = g.getNz();
+	bool rowMajor = (g.getLayout() == ROW_MAJOR);
+#pragma omp parallel for schedule(dynamic)
+	for (size_t ix = 0; ix < Nx; ix++) {
+		if (rowMajor) {
+			float *v = (float *)&g.get(ix, 0, 0);
+			size_t n = Ny * Nz * (sizeof(T) / sizeof(float));
+#pragma omp simd
+			for (size_t i = 0; i < n; i++)
+				v[i] *= a;
+			continue;
+		}
+		for (size_t iy = 0; iy < Ny; iy++)
+			for (size_t iz = 0; iz < Nz; iz++)
+				g.get(ix, iy, iz) *= a;
+	}
+}
+
+GridStatistics statistics(const Grid3f &g, bool release) {
+	VectorSums s = sumGrid<Vector3f, VectorSums>(g, release);
+	GridStatistics stat;
+	stat.count = g.getNx() * g.getNy() * g.getNz();
+	double n = stat.count;
+	for (int c = 0; c < 3; c++) {
+		stat.mean.data[c] = s.sum[c] / n;
+		stat.rmsPerAxis.data[c] = std::sqrt(s.sum2[c] / n);
+	}
+	stat.meanStrength = s.sumR / n;
+	stat.rms = std::sqrt((s.sum2[0] + s.sum2[1] + s.sum2[2]) / n);
+	return stat;
+}
+
+} // namespace
+
 void scaleGrid(ref_ptr<Grid1f> grid, double a) {
-	for (int ix = 0; ix < grid->getNx(); ix++)
-		for (int iy = 0; iy < grid->getNy(); iy++)
-			for (int iz = 0; iz < grid->getNz(); iz++)
-				grid->get(ix, iy, iz) *= a;
+	scaleValues(*grid, a);
 }
 
 void scaleGrid(ref_ptr<Grid3f> grid, double a) {
-	for (int ix = 0; ix < grid->getNx(); ix++)
-		for (int iy = 0; iy < grid->getNy(); iy++)
-			for (int iz = 0; iz < grid->getNz(); iz++)
-				grid->get(ix, iy, iz) *= a;
+	scaleValues(*grid, a);
+}
+
+GridStatistics gridStatistics(ref_ptr<Grid3f> grid) {
+	return statistics(*grid, false);
+}
+
+GridStatistics gridStatistics(const std::string &filename) {
+	Grid3f grid(filename);
+	return statistics(grid, true);
 }
 
 Vector3f meanFieldVector(ref_ptr<Grid3f> grid) {
-	size_t Nx = grid->getNx();
-	size_t Ny = grid->getNy();
-	size_t Nz = grid->getNz();
-	Vector3f mean(0.);
-	for (int ix = 0; ix < Nx; ix++)
-		for (int iy = 0; iy < Ny; iy++)
-			for (int iz = 0; iz < Nz; iz++)
-				mean += grid->get(ix, iy, iz);
-	return mean / Nx / Ny / Nz;
+	return Vector3f(gridStatistics(grid).mean);
 }
 
 double meanFieldStrength(ref_ptr<Grid3f> grid) {
-	size_t Nx = grid->getNx();
-	size_t Ny = grid->getNy();
-	size_t Nz = grid->getNz();
-	double mean = 0;
-	for (int ix = 0; ix < Nx; ix++)
-		for (int iy = 0; iy < Ny; iy++)
-			for (int iz = 0; iz < Nz; iz++)
-				mean += grid->get(ix, iy, iz).getR();
-	return mean / Nx / Ny / Nz;
+	return gridStatistics(grid).meanStrength;
 }
 
 double meanFieldStrength(ref_ptr<Grid1f> grid) {
-	size_t Nx = grid->getNx();
-	size_t Ny = grid->getNy();
-	size_t Nz = grid->getNz();
-	double mean = 0;
-	for (int ix = 0; ix < Nx; ix++)
-		for (int iy = 0; iy < Ny; iy++)
-			for (int iz = 0; iz < Nz; iz++)
-				mean += grid->get(ix, iy, iz);
-	return mean / Nx / Ny / Nz;
+	const Grid1f &g = *grid; // const access, a mapped or compressed grid is not copied
+	ScalarSums s = sumGrid<float, ScalarSums>(g);
+	return s.sum / g.getNx() / g.getNy() / g.getNz();
 }
 
 double rmsFieldStrength(ref_ptr<Grid3f> grid) {
-	size_t Nx = grid->getNx();
-	size_t Ny = grid->getNy();
-	size_t Nz = grid->getNz();
-	double sumV2 = 0;
-	for (int ix = 0; ix < Nx; ix++)
-		for (int iy = 0; iy < Ny; iy++)
-			for (int iz = 0; iz < Nz; iz++)
-				sumV2 += grid->get(ix, iy, iz).getR2();
-	return std::sqrt(sumV2 / Nx / Ny / Nz);
+	return gridStatistics(grid).rms;
 }
 
 double rmsFieldStrength(ref_ptr<Grid1f> grid) {
-	size_t Nx = grid->getNx();
-	size_t Ny = grid->getNy();
-	size_t Nz = grid->getNz();
-	double sumV2 = 0;
-	for (int ix = 0; ix < Nx; ix++)
-		for (int iy = 0; iy < Ny; iy++)
-			for (int iz = 0; iz < Nz; iz++)
-				sumV2 += pow(grid->get(ix, iy, iz), 2);
-	return std::sqrt(sumV2 / Nx / Ny / Nz);
+	const Grid1f &g = *grid;
+	ScalarSums s = sumGrid<float, ScalarSums>(g);
+	return std::sqrt(s.sum2 / g.getNx() / g.getNy() / g.getNz());
 }
 
 std::array<float, 3> rmsFieldStrengthPerAxis(ref_ptr<Grid3f> grid) {
-    size_t Nx = grid->getNx();
-    size_t Ny = grid->getNy();
-    size_t Nz = grid->getNz();
-    float sumV2_x = 0;
-    float sumV2_y = 0;
-    float sumV2_z = 0;
-    for (int ix = 0; ix < Nx; ix++)
-        for (int iy = 0; iy < Ny; iy++)
-            for (int iz = 0; iz < Nz; iz++) {
-                sumV2_x += pow(grid->get(ix, iy, iz).x, 2);
-                sumV2_y += pow(grid->get(ix, iy, iz).y, 2);
-                sumV2_z += pow(grid->get(ix, iy, iz).z, 2);
-            }
-    return {
-        std::sqrt(sumV2_x / Nx / Ny / Nz),
-        std::sqrt(sumV2_y / Nx / Ny / Nz),
-        std::sqrt(sumV2_z / Nx / Ny / Nz)
-    };
+	Vector3d rms = gridStatistics(grid).rmsPerAxis;
+	return {float(rms.x), float(rms.y), float(rms.z)};
+}
+
+template<typename T>
+static double convertStorage(ref_ptr<T> grid, storageType storage) {
+	double before = rmsFieldStrength(grid);
+	double deviation = grid->setStorageType(storage);
+	double after = rmsFieldStrength(grid);
+	KISS_LOG_INFO << "convertGridStorage: RMS " << before << " before, "
+			<< after << " after, RMS deviation " << deviation;
+	return (before > 0) ? deviation / before : 0;
+}
+
+double convertGridStorage(ref_ptr<Grid3f> grid, storageType storage) {
+	return convertStorage(grid, storage);
+}
+
+double convertGridStorage(ref_ptr<Grid1f> grid, storageType storage) {
+	return convertStorage(grid, storage);
 }
 
 void fromMagneticField(ref_ptr<Grid3f> grid, ref_ptr<MagneticField> field) {
@@ -107,12 +216,20 @@ void fromMagneticField(ref_ptr<Grid3f> grid, ref_ptr<MagneticField> field) {
 	size_t Nx = grid->getNx();
 	size_t Ny = grid->getNy();
 	size_t Nz = grid->getNz();
-	for (size_t ix = 0; ix < Nx; ix++)
-		for (size_t iy = 0; iy < Ny; iy++)
-			for (size_t iz = 0; iz < Nz; iz++) {
-				Vector3d pos = Vector3d(double(ix) + 0.5, double(iy) + 0.5, double(iz) + 0.5) * spacing + origin;
-				Vector3d B = field->getField(pos);
-				grid->get(ix, iy, iz) = B;
+	grid->detach(); // before the threads access the values
+#pragma omp parallel
+	{
+		// one row of constant ix and iy per call of the field
+		std::vector<Vector3d> pos(Nz), B(Nz);
+#pragma omp for schedule(dynamic)
+		for (size_t ix = 0; ix < Nx; ix++)
+			for (size_t iy = 0; iy < Ny; iy++) {
+				for (size_t iz = 0; iz < Nz; iz++)
+					pos[iz] = Vector3d(double(ix) + 0.5, double(iy) + 0.5, double(iz) + 0.5) * spacing + origin;
+				field->getFields(pos.data(), B.data(), Nz);
+				for (size_t iz = 0; iz < Nz; iz++)
+					grid->get(ix, iy, iz) = B[iz];
+			}
 	}
 }
 
@@ -122,12 +239,19 @@ void fromMagneticFieldStrength(ref_ptr<Grid1f> grid, ref_ptr<MagneticField> fiel
 	size_t Nx = grid->getNx();
 	size_t Ny = grid->getNy();
 	size_t Nz = grid->getNz();
-	for (size_t ix = 0; ix < Nx; ix++)
-		for (size_t iy = 0; iy < Ny; iy++)
-			for (size_t iz = 0; iz < Nz; iz++) {
-				Vector3d pos = Vector3d(double(ix) + 0.5, double(iy) + 0.5, double(iz) + 0.5) * spacing + origin;
-				double s = field->getField(pos).getR();
-				grid->get(ix, iy, iz) = s;
+	grid->detach();
+#pragma omp parallel
+	{
+		std::vector<Vector3d> pos(Nz), B(Nz);
+#pragma omp for schedule(dynamic)
+		for (size_t ix = 0; ix < Nx; ix++)
+			for (size_t iy = 0; iy < Ny; iy++) {
+				for (size_t iz = 0; iz < Nz; iz++)
+					pos[iz] = Vector3d(double(ix) + 0.5, double(iy) + 0.5, double(iz) + 0.5) * spacing + origin;
+				field->getFields(pos.data(), B.data(), Nz);
+				for (size_t iz = 0; iz < Nz; iz++)
+					grid->get(ix, iy, iz) = B[iz].getR();
+			}
 	}
 }
 
@@ -151,6 +275,7 @@ void loadGrid(ref_ptr<Grid3f> grid, std::string filename, double c) {
 	if (length != (3 * nx * ny * nz))
 		throw std::runtime_error("loadGrid: file and grid size do not match");
 
+	grid->detach(); // all values are replaced
 	for (int ix = 0; ix < grid->getNx(); ix++) {
 		for (int iy = 0; iy < grid->getNy(); iy++) {
 			for (int iz = 0; iz < grid->getNz(); iz++) {
@@ -185,6 +310,7 @@ void loadGrid(ref_ptr<Grid1f> grid, std::string filename, double c) {
 	if (length != (nx * ny * nz))
 		throw std::runtime_error("loadGrid: file and grid size do not match");
 
+	grid->detach(); // all values are replaced
 	for (int ix = 0; ix < nx; ix++) {
 		for (int iy = 0; iy < ny; iy++) {
 			for (int iz = 0; iz < nz; iz++) {
@@ -198,6 +324,7 @@ void loadGrid(ref_ptr<Grid1f> grid, std::string filename, double c) {
 }
 
 void dumpGrid(ref_ptr<Grid3f> grid, std::string filename, double c) {
+	const Grid3f &g = *grid;
 	std::ofstream fout(filename.c_str(), std::ios::binary);
 	if (!fout) {
 		std::stringstream ss;
@@ -207,7 +334,7 @@ void dumpGrid(ref_ptr<Grid3f> grid, std::string filename, double c) {
 	for (int ix = 0; ix < grid->getNx(); ix++) {
 		for (int iy = 0; iy < grid->getNy(); iy++) {
 			for (int iz = 0; iz < grid->getNz(); iz++) {
-				Vector3f b = grid->get(ix, iy, iz) * c;
+				Vector3f b = g.get(ix, iy, iz) * c;
 				fout.write((char*) &(b.x), sizeof(float));
 				fout.write((char*) &(b.y), sizeof(float));
 				fout.write((char*) &(b.z), sizeof(float));
@@ -218,6 +345,7 @@ void dumpGrid(ref_ptr<Grid3f> grid, std::string filename, double c) {
 }
 
 void dumpGrid(ref_ptr<Grid1f> grid, std::string filename, double c) {
+	const Grid1f &g = *grid;
 	std::ofstream fout(filename.c_str(), std::ios::binary);
 	if (!fout) {
 		std::stringstream ss;
@@ -227,7 +355,7 @@ void dumpGrid(ref_ptr<Grid1f> grid, std::string filename, double c) {
 	for (int ix = 0; ix < grid->getNx(); ix++) {
 		for (int iy = 0; iy < grid->getNy(); iy++) {
 			for (int iz = 0; iz < grid->getNz(); iz++) {
-				float b = grid->get(ix, iy, iz) * c;
+				float b = g.get(ix, iy, iz) * c;
 				fout.write((char*) &b, sizeof(float));
 			}
 		}
@@ -246,6 +374,7 @@ void loadGridFromTxt(ref_ptr<Grid3f> grid, std::string filename, double c) {
 	while (fin.peek() == '#')
 		fin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 
+	grid->detach(); // all values are replaced
 	for (int ix = 0; ix < grid->getNx(); ix++) {
 		for (int iy = 0; iy < grid->getNy(); iy++) {
 			for (int iz = 0; iz < grid->getNz(); iz++) {
@@ -271,6 +400,7 @@ void loadGridFromTxt(ref_ptr<Grid1f> grid, std::string filename, double c) {
 	while (fin.peek() == '#')
 		fin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 
+	grid->detach(); // all values are replaced
 	for (int ix = 0; ix < grid->getNx(); ix++) {
 		for (int iy = 0; iy < grid->getNy(); iy++) {
 			for (int iz = 0; iz < grid->getNz(); iz++) {
@@ -286,6 +416,7 @@ void loadGridFromTxt(ref_ptr<Grid1f> grid, std::string filename, double c) {
 }
 
 void dumpGridToTxt(ref_ptr<Grid3f> grid, std::string filename, double c) {
+	const Grid3f &g = *grid;
 	std::ofstream fout(filename.c_str());
 	if (!fout) {
 		std::stringstream ss;
@@ -295,7 +426,7 @@ void dumpGridToTxt(ref_ptr<Grid3f> grid, std::string filename, double c) {
 	for (int ix = 0; ix < grid->getNx(); ix++) {
 		for (int iy = 0; iy < grid->getNy(); iy++) {
 			for (int iz = 0; iz < grid->getNz(); iz++) {
-				Vector3f b = grid->get(ix, iy, iz) * c;
+				Vector3f b = g.get(ix, iy, iz) * c;
 				fout << b << "\n";
 			}
 		}
@@ -304,6 +435,7 @@ void dumpGridToTxt(ref_ptr<Grid3f> grid, std::string filename, double c) {
 }
 
 void dumpGridToTxt(ref_ptr<Grid1f> grid, std::string filename, double c) {
+	const Grid1f &g = *grid;
 	std::ofstream fout(filename.c_str());
 	if (!fout) {
 		std::stringstream ss;
@@ -313,7 +445,7 @@ void dumpGridToTxt(ref_ptr<Grid1f> grid, std::string filename, double c) {
 	for (int ix = 0; ix < grid->getNx(); ix++) {
 		for (int iy = 0; iy < grid->getNy(); iy++) {
 			for (int iz = 0; iz < grid->getNz(); iz++) {
-				float b = grid->get(ix, iy, iz) * c;
+				float b = g.get(ix, iy, iz) * c;
 				fout << b << "\n";
 			}
 		}
@@ -321,89 +453,152 @@ void dumpGridToTxt(ref_ptr<Grid1f> grid, std::string filename, double c) {
 	fout.close();
 }
 
+void loadOctreeGridFromTxt(ref_ptr<OctreeGrid3f> grid, std::string filename, double c, double lengthUnit) {
+	std::ifstream fin(filename.c_str());
+	if (!fin) {
+		std::stringstream ss;
+		ss << "load OctreeGrid3f: " << filename << " not found";
+		throw std::runtime_error(ss.str());
+	}
+
+	double spacing = grid->getSpacing().x;
+	std::string line;
+	while (std::getline(fin, line)) {
+		if ((line.size() == 0) or (line[0] == '#'))
+			continue;
+		std::stringstream ss(line);
+		Vector3d x;
+		double dx;
+		Vector3f b;
+		ss >> x.x >> x.y >> x.z >> dx >> b.x >> b.y >> b.z;
+		if (ss.fail())
+			throw std::runtime_error("load OctreeGrid3f: invalid line in " + filename);
+
+		// level of the cell from the ratio of the edge lengths
+		double ratio = spacing / (dx * lengthUnit);
+		int level = round(log2(ratio));
+		if ((level < 0) or (std::fabs(ratio / pow(2, level) - 1) > 1e-3))
+			throw std::runtime_error("load OctreeGrid3f: cell size is no power of 2 fraction of the spacing in " + filename);
+		grid->setCell(x * lengthUnit, level, b * c);
+	}
+	fin.close();
+	grid->update();
+}
+
+struct OctreeDumper {
+	std::ofstream &fout;
+	Vector3d spacing;
+	double c, lengthUnit;
+	OctreeDumper(std::ofstream &fout, Vector3d spacing, double c, double lengthUnit) :
+			fout(fout), spacing(spacing), c(c), lengthUnit(lengthUnit) {
+	}
+	void operator()(const Vector3d &x, int level, const Vector3f &b) {
+		fout << x / lengthUnit << " " << spacing.x / (1L << level) / lengthUnit
+				<< " " << b * c << "\n";
+	}
+};
+
+void dumpOctreeGridToTxt(ref_ptr<OctreeGrid3f> grid, std::string filename, double c, double lengthUnit) {
+	std::ofstream fout(filename.c_str());
+	if (!fout) {
+		std::stringstream ss;
+		ss << "dump OctreeGrid3f: " << filename << " not found";
+		throw std::runtime_error(ss.str());
+	}
+	fout.precision(12);
+	fout << "# x y z dx bx by bz\n";
+	grid->forEachCell(OctreeDumper(fout, grid->getSpacing(), c, lengthUnit));
+	fout.close();
+}
+
 #ifdef CRPROPA_HAVE_FFTW3F
 
 std::vector<std::pair<int, float>> gridPowerSpectrum(ref_ptr<Grid3f> grid) {
-
+  const Grid3f &g = *grid; // const access, a mapped or compressed grid is not copied
+  size_t n = g.getNx(); // size of array
+  if ((g.getNy() != n) or (g.getNz() != n))
+    throw std::runtime_error("gridPowerSpectrum: grid must be cubic");
+  size_t n2 = n / 2 + 1; // number of modes in z-direction
   double rms = rmsFieldStrength(grid);
-  size_t n = grid->getNx(); // size of array
-
-  // arrays to hold the complex vector components of the B(k)-field
-  fftwf_complex *Bkx, *Bky, *Bkz;
-  Bkx = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n * n * n);
-  Bky = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n * n * n);
-  Bkz = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n * n * n);
-
-  fftwf_complex *Bx = (fftwf_complex *)Bkx;
-  fftwf_complex *By = (fftwf_complex *)Bky;
-  fftwf_complex *Bz = (fftwf_complex *)Bkz;
-
-  // save to temp
-  int i;
-  for (size_t ix = 0; ix < n; ix++) {
-    for (size_t iy = 0; iy < n; iy++) {
-      for (size_t iz = 0; iz < n; iz++) {
-        i = ix * n * n + iy * n + iz;
-        Vector3<float> &b = grid->get(ix, iy, iz);
-        Bx[i][0] = b.x / rms;
-        By[i][0] = b.y / rms;
-        Bz[i][0] = b.z / rms;
-      }
-    }
+
+  // Forward Fourier transformation in slabs, the inverse of the one in
+  // GridTurbulence: along y and z in slabs of constant x, then along x in
+  // slabs of constant ky. Only the modes with kx, ky, kz <= n / 2 enter the
+  // spectrum, so only the slabs with ky <= n / 2 are kept.
+  fftwf_complex *slab = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n * n2);
+  fftwf_plan r2c, c2c;
+  int N[1] = {int(n)};
+#pragma omp critical(FFTW)
+  {
+    r2c = fftwf_plan_many_dft_r2c(1, N, n, (float *)slab, NULL, 1, 2 * n2,
+                                  slab, NULL, 1, n2, FFTW_ESTIMATE);
+    c2c = fftwf_plan_many_dft(1, N, n2, slab, NULL, n2, 1, slab, NULL, n2, 1,
+                              FFTW_FORWARD, FFTW_ESTIMATE);
   }
+  fftwf_free(slab);
+
+  // one component at a time, holding the slabs transformed along y and z [x][ky][kz]
+  fftwf_complex *Bk = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n * n2 * n2);
+  // power and number of modes per bin of k, per slab of constant ky
+  std::vector<double> power(n2 * n2, 0.);
+  std::vector<size_t> count(n2 * n2, 0);
+
+  for (int c = 0; c < 3; c++) {
+#pragma omp parallel
+    {
+      fftwf_complex *slab = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n * n2);
+      float *b = (float *)slab; // rows of 2 * n2 floats
+
+#pragma omp for schedule(dynamic)
+      for (size_t ix = 0; ix < n; ix++) {
+        for (size_t iy = 0; iy < n; iy++)
+          for (size_t iz = 0; iz < n; iz++)
+            b[iy * 2 * n2 + iz] = g.get(ix, iy, iz).data[c] / rms;
+        fftwf_execute_dft_r2c(r2c, b, slab);
+        fftwf_execute_dft(c2c, slab, slab);
+        std::memcpy(Bk[ix * n2 * n2], slab, sizeof(fftwf_complex) * n2 * n2);
+      }
 
-  // in-place, real to complex, inverse Fourier transformation on each component
-  // note that the last elements of B(x) are unused now
-  fftwf_plan plan_x =
-      fftwf_plan_dft_3d(n, n, n, Bx, Bkx, FFTW_FORWARD, FFTW_ESTIMATE);
-  fftwf_execute(plan_x);
-  fftwf_destroy_plan(plan_x);
-
-  fftwf_plan plan_y =
-      fftwf_plan_dft_3d(n, n, n, By, Bky, FFTW_FORWARD, FFTW_ESTIMATE);
-  fftwf_execute(plan_y);
-  fftwf_destroy_plan(plan_y);
-
-  fftwf_plan plan_z =
-      fftwf_plan_dft_3d(n, n, n, Bz, Bkz, FFTW_FORWARD, FFTW_ESTIMATE);
-  fftwf_execute(plan_z);
-  fftwf_destroy_plan(plan_z);
-
-  float power;
-  std::map<size_t, std::pair<float, int>> spectrum;
-  int k;
-
-  for (size_t ix = 0; ix < n; ix++) {
-    for (size_t iy = 0; iy < n; iy++) {
-      for (size_t iz = 0; iz < n; iz++) {
-        i = ix * n * n + iy * n + iz;
-        k = static_cast<int>(
-            std::floor(std::sqrt(ix * ix + iy * iy + iz * iz)));
-        if (k > n / 2. || k == 0)
-          continue;
-        power = ((Bkx[i][0] * Bkx[i][0] + Bkx[i][1] * Bkx[i][1]) +
-                 (Bky[i][0] * Bky[i][0] + Bky[i][1] * Bky[i][1]) +
-                 (Bkz[i][0] * Bkz[i][0] + Bkz[i][1] * Bkz[i][1]));
-        if (spectrum.find(k) == spectrum.end()) {
-          spectrum[k].first = power;
-          spectrum[k].second = 1;
-        } else {
-          spectrum[k].first += power;
-          spectrum[k].second += 1;
+#pragma omp for schedule(dynamic)
+      for (size_t ky = 0; ky < n2; ky++) {
+        for (size_t ix = 0; ix < n; ix++)
+          std::memcpy(slab[ix * n2], Bk[(ix * n2 + ky) * n2], sizeof(fftwf_complex) * n2);
+        fftwf_execute_dft(c2c, slab, slab);
+        for (size_t kx = 0; kx < n2; kx++) {
+          for (size_t kz = 0; kz < n2; kz++) {
+            size_t k = static_cast<size_t>(
+                std::floor(std::sqrt(kx * kx + ky * ky + kz * kz)));
+            if (k > n / 2. || k == 0)
+              continue;
+            fftwf_complex &m = slab[kx * n2 + kz];
+            power[ky * n2 + k] += m[0] * m[0] + m[1] * m[1];
+            if (c == 0)
+              count[ky * n2 + k]++;
+          }
         }
       }
+
+      fftwf_free(slab);
     }
   }
 
-  fftwf_free(Bkx);
-  fftwf_free(Bky);
-  fftwf_free(Bkz);
+  fftwf_free(Bk);
+#pragma omp critical(FFTW)
+  {
+    fftwf_destroy_plan(r2c);
+    fftwf_destroy_plan(c2c);
+  }
 
   std::vector<std::pair<int, float>> points;
-  for (std::map<size_t, std::pair<float, int>>::iterator it = spectrum.begin();
-       it != spectrum.end(); ++it) {
-    points.push_back(
-        std::make_pair(it->first, (it->second).first / (it->second).second));
+  for (size_t k = 1; k < n2; k++) {
+    double sum = 0;
+    size_t number = 0;
+    for (size_t ky = 0; ky < n2; ky++) {
+      sum += power[ky * n2 + k];
+      number += count[ky * n2 + k];
+    }
+    if (number > 0)
+      points.push_back(std::make_pair(int(k), float(sum / number)));
   }
 
   return points;
@@ -0,0 +1,116 @@
+#include "crpropa/InterpolationTable.h"
+
+#include <stdexcept>
+
+namespace crpropa {
+
+InterpolationTable::InterpolationTable() : spacing(Irregular), offset(0), scale(0) {
+}
+
+InterpolationTable::InterpolationTable(const std::vector<double> &X, const std::vector<double> &Y) : spacing(Irregular), offset(0), scale(0) {
+	setTable(X, Y);
+}
+
+void InterpolationTable::setTable(const std::vector<double> &X, const std::vector<double> &Y) {
+	if (X.size() != Y.size())
+		throw std::runtime_error("InterpolationTable: X and Y differ in size");
+	this->X = X;
+	this->Y = Y;
+
+	size_t n = X.size();
+	slope.assign(n, 0.);
+	for (size_t i = 0; i + 1 < n; i++) {
+		double dx = X[i + 1] - X[i];
+		if (dx > 0)
+			slope[i] = (Y[i + 1] - Y[i]) / dx;
+	}
+
+	// detect the spacing; deviations below a fraction of a bin only cost a
+	// correction step in the bin search, so the tolerance can be generous
+	spacing = Irregular;
+	if (n < 2)
+		return;
+	const double tolerance = 0.1; // in units of the bin width
+
+	bool uniform = X.back() > X.front();
+	double dx = (X.back() - X.front()) / (n - 1);
+	for (size_t i = 0; uniform and (i < n); i++)
+		uniform = std::fabs(X[i] - (X.front() + i * dx)) < tolerance * dx;
+	if (uniform) {
+		spacing = Uniform;
+		offset = X.front();
+		scale = 1. / dx;
+		return;
+	}
+
+	bool logUniform = (X.front() > 0) and (X.back() > X.front());
+	double dlx = logUniform ? (std::log(X.back()) - std::log(X.front())) / (n - 1) : 0;
+	for (size_t i = 0; logUniform and (i < n); i++)
+		logUniform = std::fabs(std::log(X[i]) - (std::log(X.front()) + i * dlx)) < tolerance * dlx;
+	if (logUniform) {
+		spacing = LogUniform;
+		offset = std::log(X.front());
+		scale = 1. / dlx;
+	}
+}
+
+void InterpolationTable::interpolate(const double *x, double *y, size_t n) const {
+	if (spacing == Irregular) {
+		for (size_t k = 0; k < n; k++)
+			y[k] = interpolate(x[k]);
+		return;
+	}
+
+	// first pass: estimate the bins without branches or table lookups, which
+	// allows the compiler to vectorize the loop (including the logarithm when
+	// a vector math library is available)
+	if (spacing == Uniform) {
+		for (size_t k = 0; k < n; k++)
+			y[k] = (x[k] - offset) * scale;
+	} else {
+		for (size_t k = 0; k < n; k++)
+			y[k] = (std::log(x[k]) - offset) * scale;
+	}
+
+	// second pass: correct the bins and interpolate
+	for (size_t k = 0; k < n; k++) {
+		double xk = x[k];
+		if (xk < X.front()) {
+			y[k] = Y.front();
+		} else if (not (xk < X.back())) {
+			y[k] = Y.back();
+		} else {
+			size_t i = correctBin(xk, y[k]);
+			y[k] = Y[i] + (xk - X[i]) * slope[i];
+		}
+	}
+}
+
+std::vector<double> InterpolationTable::interpolate(const std::vector<double> &x) const {
+	std::vector<double> y(x.size());
+	if (x.size() > 0)
+		interpolate(&x[0], &y[0], x.size());
+	return y;
+}
+
+InterpolationTable::Spacing InterpolationTable::getSpacing() const {
+	return spacing;
+}
+
+const std::vector<double> &InterpolationTable::getX() const {
+	return X;
+}
+
+const std::vector<double> &InterpolationTable::getY() const {
+	return Y;
+}
+
+size_t InterpolationTable::size() const {
+	return X.size();
+}
+
+bool InterpolationTable::empty() const {
+	return X.empty();
+}
+
+} // namespace crpropa
@@ -0,0 +1,85 @@
+#include "crpropa/MemoryMappedFile.h"
+
+#include <fstream>
+#include <stdint.h>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CRPROPA_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace crpropa {
+
+MemoryMappedFile::MemoryMappedFile(const std::string &filename) :
+		filename(filename), begin(0), length(0), mapped(false) {
+#ifdef CRPROPA_HAVE_MMAP
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error("MemoryMappedFile: could not open " + filename);
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		throw std::runtime_error("MemoryMappedFile: could not stat " + filename);
+	}
+	length = st.st_size;
+	if (length > 0) {
+		void *p = mmap(0, length, PROT_READ, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("MemoryMappedFile: could not map " + filename);
+		}
+		begin = static_cast<const char*>(p);
+		mapped = true;
+	}
+	close(fd); // the mapping stays valid
+#else
+	std::ifstream in(filename.c_str(), std::ios::binary | std::ios::ate);
+	if (not in.good())
+		throw std::runtime_error("MemoryMappedFile: could not open " + filename);
+	length = in.tellg();
+	char *buffer = new char[length];
+	in.seekg(0);
+	in.read(buffer, length);
+	begin = buffer;
+#endif
+}
+
+MemoryMappedFile::~MemoryMappedFile() {
+#ifdef CRPROPA_HAVE_MMAP
+	if (mapped)
+		munmap(const_cast<char*>(begin), length);
+#else
+	delete[] begin;
+#endif
+}
+
+const char *MemoryMappedFile::data() const {
+	return begin;
+}
+
+size_t MemoryMappedFile::size() const {
+	return length;
+}
+
+std::string MemoryMappedFile::getFilename() const {
+	return filename;
+}
+
+void MemoryMappedFile::release(const void *p, size_t n) const {
+#ifdef CRPROPA_HAVE_MMAP
+	if (not mapped)
+		return;
+	// only the pages completely within the range
+	uintptr_t page = sysconf(_SC_PAGESIZE);
+	uintptr_t first = (uintptr_t(p) + page - 1) / page * page;
+	uintptr_t last = (uintptr_t(p) + n) / page * page;
+	if (last > first)
+		madvise((void *)first, last - first, MADV_DONTNEED);
+#endif
+}
+
+} // namespace crpropa
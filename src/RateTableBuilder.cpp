@@ -0,0 +1,413 @@
+#include "crpropa/RateTableBuilder.h"
+#include "crpropa/Common.h"
+#include "crpropa/DataTable.h"
+#include "crpropa/TableRegistry.h"
+#include "crpropa/Units.h"
+#include "crpropa/module/PhotoPionProduction.h"
+
+#include "kiss/path.h"
+
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+namespace crpropa {
+
+static const double mec2 = mass_electron * c_squared;
+static const double sigmaThomson = 6.6524587158e-29 * meter * meter;
+static const double alphaFineStructure = 7.2973525693e-3;
+static const double radiusElectron = 2.8179403262e-15 * meter;
+static const double sMinPhotoPion = 1.1646 * GeV * GeV; // (m_N + m_pi)^2 c^4 as in SOPHIA
+
+// tabulation points: log10(E/eV) for the electromagnetic interactions, log10(gamma) for nucleons
+static const double logEnergyMin = 9, logEnergyMax = 23;
+static const double logGammaMin = 6, logGammaMax = 16;
+static const double logStepEnergy = 0.02, logStepGamma = 0.01, logStepS = 0.1;
+
+namespace {
+
+template<class Integrand>
+double simpson(const Integrand &f, double a, double b, double fa, double fm, double fb,
+		double whole, double eps, int depth) {
+	double m = (a + b) / 2;
+	double flm = f((a + m) / 2);
+	double frm = f((m + b) / 2);
+	double left = (m - a) / 6 * (fa + 4 * flm + fm);
+	double right = (b - m) / 6 * (fm + 4 * frm + fb);
+	double delta = left + right - whole;
+	if ((depth <= 0) or (std::fabs(delta) <= 15 * eps))
+		return left + right + delta / 15;
+	return simpson(f, a, m, fa, flm, fm, left, eps / 2, depth - 1)
+			+ simpson(f, m, b, fm, frm, fb, right, eps / 2, depth - 1);
+}
+
+// adaptive Simpson quadrature on panels of at most the given width,
+// the tolerance is relative to the total integral
+template<class Integrand>
+double integrate(const Integrand &f, double a, double b, double tolerance, double panelWidth) {
+	if (not (b > a))
+		return 0;
+	size_t n = std::max(1., std::ceil((b - a) / panelWidth));
+	double h = (b - a) / n;
+
+	std::vector<double> y(2 * n + 1);
+	for (size_t i = 0; i <= 2 * n; i++)
+		y[i] = f(a + i * h / 2);
+
+	std::vector<double> estimate(n);
+	double total = 0;
+	for (size_t i = 0; i < n; i++) {
+		estimate[i] = h / 6 * (y[2 * i] + 4 * y[2 * i + 1] + y[2 * i + 2]);
+		total += estimate[i];
+	}
+
+	double eps = tolerance * std::fabs(total) / n;
+	double result = 0;
+	for (size_t i = 0; i < n; i++)
+		result += simpson(f, a + i * h, a + (i + 1) * h, y[2 * i], y[2 * i + 1], y[2 * i + 2],
+				estimate[i], eps, 20);
+	return result;
+}
+
+std::vector<double> logGrid(double logMin, double logMax, double step) {
+	size_t n = std::floor((logMax - logMin) / step + 0.5) + 1;
+	std::vector<double> grid(n);
+	for (size_t i = 0; i < n; i++)
+		grid[i] = logMin + i * step;
+	return grid;
+}
+
+void openTable(std::ofstream &out, const std::string &filename) {
+	size_t pos = filename.find_last_of("/\\");
+	if (pos != std::string::npos)
+		create_directory_recursive(filename.substr(0, pos));
+	out.open(filename.c_str());
+	if (not out.good())
+		throw std::runtime_error("RateTableBuilder: could not write " + filename);
+	out.precision(7);
+}
+
+void closeTable(std::ofstream &out, const std::string &filename) {
+	out.close();
+	if (out.fail())
+		throw std::runtime_error("RateTableBuilder: could not write " + filename);
+	DataTable::load(filename); // create the binary cache
+	TableRegistry::remove(filename);
+}
+
+} // namespace
+
+RateTableBuilder::RateTableBuilder(ref_ptr<PhotonField> photonField, double tolerance) :
+		photonField(photonField), tolerance(tolerance) {
+	initPhotonIntegral();
+}
+
+ref_ptr<PhotonField> RateTableBuilder::getPhotonField() const {
+	return photonField;
+}
+
+double RateTableBuilder::getTolerance() const {
+	return tolerance;
+}
+
+void RateTableBuilder::initPhotonIntegral() {
+	epsMin = photonField->getMinimumPhotonEnergy(0);
+	epsMax = photonField->getMaximumPhotonEnergy(0);
+	if (not ((epsMin > 0) and (epsMax > epsMin)))
+		throw std::runtime_error("RateTableBuilder: invalid energy range of photon field " + photonField->getFieldName());
+
+	// G(eps) = int_eps^epsMax n(eps') / eps'^2 deps' on 100 points per decade,
+	// integrated in log(eps') with n(eps') eps' = getPhotonDensity
+	logEpsMin = std::log(epsMin);
+	size_t n = std::max(1., std::ceil(std::log10(epsMax / epsMin) * 100));
+	dLogEps = (std::log(epsMax) - logEpsMin) / n;
+
+	const PhotonField *field = photonField.get();
+	auto integrand = [field](double logEps) {
+		double eps = std::exp(logEps);
+		return field->getPhotonDensity(eps, 0) / eps / eps;
+	};
+
+	std::vector<double> cell(n);
+	double tol = tolerance;
+	double x0 = logEpsMin, dx = dLogEps;
+#pragma omp parallel for schedule(dynamic)
+	for (size_t i = 0; i < n; i++)
+		cell[i] = integrate(integrand, x0 + i * dx, x0 + (i + 1) * dx, tol, dx);
+
+	tabG.assign(n + 1, 0.);
+	for (size_t i = n; i > 0; i--)
+		tabG[i - 1] = tabG[i] + cell[i - 1];
+}
+
+double RateTableBuilder::photonIntegral(double eps) const {
+	if (eps <= epsMin)
+		return tabG.front();
+	if (eps >= epsMax)
+		return 0;
+	double x = (std::log(eps) - logEpsMin) / dLogEps;
+	size_t i = std::min(size_t(x), tabG.size() - 2);
+	double f = x - i;
+	if (tabG[i + 1] > 0)
+		return tabG[i] * std::pow(tabG[i + 1] / tabG[i], f); // G falls off steeply in the tails
+	return tabG[i] * (1 - f);
+}
+
+double RateTableBuilder::sLimit(double sMin, double E) const {
+	// below 4 E epsMin, G is constant and the integrand vanishes with s^2
+	return std::max(sMin, 4 * E * epsMin * 1e-3);
+}
+
+double RateTableBuilder::rate(CrossSection sigma, double sMin, double E) const {
+	auto integrand = [this, sigma, E](double logS) {
+		double s = std::exp(logS);
+		return sigma(s) * s * s * photonIntegral(s / 4 / E);
+	};
+	double a = std::log(sLimit(sMin, E));
+	double b = std::log(4 * E * epsMax);
+	return integrate(integrand, a, b, tolerance, logStepS * M_LN10) / 8 / E / E;
+}
+
+std::vector<double> RateTableBuilder::cumulativeRate(CrossSection sigma, double sMin,
+		double E, const std::vector<double> &s) const {
+	auto integrand = [this, sigma, E](double logS) {
+		double s = std::exp(logS);
+		return sigma(s) * s * s * photonIntegral(s / 4 / E);
+	};
+	double a = std::log(sLimit(sMin, E));
+	double b = std::log(4 * E * epsMax);
+
+	std::vector<double> cdf(s.size());
+	double sum = 0;
+	double lo = a;
+	for (size_t j = 0; j < s.size(); j++) {
+		double hi = std::min(std::log(s[j]), b);
+		if (hi > lo) {
+			sum += std::max(0., integrate(integrand, lo, hi, tolerance, logStepS * M_LN10));
+			lo = hi;
+		}
+		cdf[j] = sum / 8 / E / E;
+	}
+	return cdf;
+}
+
+double RateTableBuilder::electronPairLossRate(double gamma) const {
+	// Chodorowski et al. 1992, eq. 3.14 and 3.18
+	auto phi = [](double k) {
+		if (k < 25) {
+			static const double c[4] = {0.8048, 0.1459, 1.137e-3, -3.879e-6};
+			double x = k - 2;
+			double denominator = 1 + x * (c[0] + x * (c[1] + x * (c[2] + x * c[3])));
+			return M_PI / 12 * pow_integer<4>(x) / denominator;
+		}
+		static const double d[4] = {-86.07, 50.96, -14.45, 8. / 3.};
+		static const double f[3] = {2.910, 78.35, 1837};
+		double l = std::log(k);
+		double numerator = d[0] + l * (d[1] + l * (d[2] + l * d[3]));
+		double denominator = 1 - (f[0] + (f[1] + f[2] / k) / k) / k;
+		return k * numerator / denominator;
+	};
+
+	// Blumenthal 1970, eq. 13: integrate over k = 2 gamma eps / (m_e c^2) in log(k),
+	// with the photon density per dimensionless energy n(eps) m_e c^2
+	const PhotonField *field = photonField.get();
+	auto integrand = [field, phi, gamma](double logK) {
+		double k = std::exp(logK);
+		double eps = k * mec2 / 2 / gamma;
+		return field->getPhotonDensity(eps, 0) / eps * mec2 * phi(k) / k;
+	};
+	double a = std::log(std::max(2., 2 * gamma * epsMin / mec2));
+	double b = std::log(2 * gamma * epsMax / mec2);
+	double integral = integrate(integrand, a, b, tolerance, logStepS * M_LN10);
+
+	// (1/gamma) dgamma/dt / c
+	return alphaFineStructure * radiusElectron * radiusElectron * mass_electron / mass_proton
+			* integral / gamma;
+}
+
+double RateTableBuilder::sigmaPairProduction(double s) {
+	double smin = 4 * mec2 * mec2;
+	if (s <= smin)
+		return 0;
+	double b = std::sqrt(1 - smin / s);
+	return sigmaThomson * 3 / 16 * (1 - b * b)
+			* ((3 - pow_integer<4>(b)) * std::log((1 + b) / (1 - b)) - 2 * b * (2 - b * b));
+}
+
+double RateTableBuilder::sigmaInverseComptonScattering(double s) {
+	double smin = mec2 * mec2;
+	double sTot = s + smin;
+	double b = s / (sTot + smin);
+	if (b < 1e-4)
+		return sigmaThomson * (1 - 2 * b); // Thomson limit, avoids the cancellation below
+	double A = 2 / b / (1 + b) * (2 + 2 * b - b * b - 2 * b * b * b);
+	double B = (2 - 3 * b * b - b * b * b) / b / b * std::log((1 + b) / (1 - b));
+	return sigmaThomson * 3 / 8 * smin / sTot / b * (A - B);
+}
+
+double RateTableBuilder::sigmaTripletPairProduction(double s) {
+	double sTot = s + mec2 * mec2;
+	double beta = 28. / 9. * std::log(sTot / mec2 / mec2) - 218. / 27.;
+	if (beta < 0)
+		return 0;
+	return sigmaThomson * 3 / 8 / M_PI * alphaFineStructure * beta;
+}
+
+double RateTableBuilder::sigmaDoublePairProduction(double s) {
+	double smin = 16 * mec2 * mec2;
+	if (s <= smin)
+		return 0;
+	return 6.45e-34 * meter * meter * pow_integer<6>(1 - smin / s);
+}
+
+double RateTableBuilder::sigmaPhotoPionProton(double s) {
+	return PhotoPionProduction::totalCrossSection(s / 2 / (mass_proton * c_squared), true);
+}
+
+double RateTableBuilder::sigmaPhotoPionNeutron(double s) {
+	return PhotoPionProduction::totalCrossSection(s / 2 / (mass_neutron * c_squared), false);
+}
+
+void RateTableBuilder::writeTables(const std::string &rateFile, const std::string &cdfFile,
+		CrossSection sigma, double sMin, bool binCenters) const {
+	std::vector<double> logE = logGrid(logEnergyMin, logEnergyMax, logStepEnergy);
+	std::vector<double> rates(logE.size());
+	bool haveCDF = not cdfFile.empty();
+
+	// s from the threshold to the largest s reachable in the field; the
+	// cumulative rate is tabulated at each s, or at the upper bin edge if the
+	// module samples s within bins around the tabulated values
+	double logSMin = std::log10(sLimit(sMin, std::pow(10, logE.front()) * eV) / eV / eV);
+	double logSMax = std::log10(4 * std::pow(10, logE.back()) * eV * epsMax / eV / eV);
+	std::vector<double> logS = logGrid(logSMin, logSMax + logStepS, logStepS);
+	std::vector<double> s(logS.size());
+	for (size_t j = 0; j < s.size(); j++)
+		s[j] = std::pow(10, logS[j] + (binCenters ? logStepS / 2 : 0)) * eV * eV;
+
+	std::vector<std::vector<double> > cdf(haveCDF ? logE.size() : 0);
+#pragma omp parallel for schedule(dynamic)
+	for (size_t i = 0; i < logE.size(); i++) {
+		double E = std::pow(10, logE[i]) * eV;
+		if (haveCDF) {
+			cdf[i] = cumulativeRate(sigma, sMin, E, s);
+			rates[i] = cdf[i].back();
+		} else {
+			rates[i] = rate(sigma, sMin, E);
+		}
+	}
+
+	// the modules interpolate the rate but sample from the closest cdf row:
+	// switch the rate off next to rows without interactions
+	if (haveCDF)
+		for (size_t i = logE.size() - 1; i > 0; i--)
+			if (cdf[i - 1].back() <= 0)
+				rates[i] = 0;
+
+	std::ofstream out;
+	openTable(out, rateFile);
+	out << "# Interaction rate for " << photonField->getFieldName() << ", computed by RateTableBuilder\n";
+	out << "# log10(E/eV), rate [1/Mpc]\n";
+	for (size_t i = 0; i < logE.size(); i++)
+		out << logE[i] << " " << rates[i] * Mpc << "\n";
+	closeTable(out, rateFile);
+
+	if (not haveCDF)
+		return;
+
+	openTable(out, cdfFile);
+	out << "# Cumulative interaction rate for " << photonField->getFieldName() << ", computed by RateTableBuilder\n";
+	out << "# first row: 0, log10(s_kin/eV^2)\n";
+	out << "# following rows: log10(E/eV), cumulative rate [1/Mpc]\n";
+	out << 0;
+	for (size_t j = 0; j < logS.size(); j++)
+		out << " " << logS[j];
+	out << "\n";
+	for (size_t i = 0; i < logE.size(); i++) {
+		out << logE[i];
+		for (size_t j = 0; j < logS.size(); j++)
+			out << " " << cdf[i][j] * Mpc;
+		out << "\n";
+	}
+	closeTable(out, cdfFile);
+}
+
+void RateTableBuilder::buildEMPairProduction(const std::string &directory) const {
+	std::string fname = photonField->getFieldName();
+	std::string path = concat_path(directory, "EMPairProduction");
+	writeTables(concat_path(path, "rate_" + fname + ".txt"), concat_path(path, "cdf_" + fname + ".txt"),
+			sigmaPairProduction, 4 * mec2 * mec2, false);
+}
+
+void RateTableBuilder::buildEMInverseComptonScattering(const std::string &directory) const {
+	std::string fname = photonField->getFieldName();
+	std::string path = concat_path(directory, "EMInverseComptonScattering");
+	writeTables(concat_path(path, "rate_" + fname + ".txt"), concat_path(path, "cdf_" + fname + ".txt"),
+			sigmaInverseComptonScattering, 0, true);
+}
+
+void RateTableBuilder::buildEMTripletPairProduction(const std::string &directory) const {
+	std::string fname = photonField->getFieldName();
+	std::string path = concat_path(directory, "EMTripletPairProduction");
+	double sMin = mec2 * mec2 * (std::exp(218. / 84.) - 1); // zero of the cross section
+	writeTables(concat_path(path, "rate_" + fname + ".txt"), concat_path(path, "cdf_" + fname + ".txt"),
+			sigmaTripletPairProduction, sMin, true);
+}
+
+void RateTableBuilder::buildEMDoublePairProduction(const std::string &directory) const {
+	std::string fname = photonField->getFieldName();
+	std::string path = concat_path(directory, "EMDoublePairProduction");
+	writeTables(concat_path(path, "rate_" + fname + ".txt"), "",
+			sigmaDoublePairProduction, 16 * mec2 * mec2, false);
+}
+
+void RateTableBuilder::buildPhotoPionProduction(const std::string &directory) const {
+	std::vector<double> logGamma = logGrid(logGammaMin, logGammaMax, logStepGamma);
+	double mp2 = pow_integer<2>(mass_proton * c_squared);
+	double mn2 = pow_integer<2>(mass_neutron * c_squared);
+	std::vector<double> protonRate(logGamma.size()), neutronRate(logGamma.size());
+#pragma omp parallel for schedule(dynamic)
+	for (size_t i = 0; i < logGamma.size(); i++) {
+		double gamma = std::pow(10, logGamma[i]);
+		protonRate[i] = rate(sigmaPhotoPionProton, sMinPhotoPion - mp2, gamma * mass_proton * c_squared);
+		neutronRate[i] = rate(sigmaPhotoPionNeutron, sMinPhotoPion - mn2, gamma * mass_neutron * c_squared);
+	}
+
+	std::string filename = concat_path(directory, "PhotoPionProduction",
+			"rate_" + photonField->getFieldName() + ".txt");
+	std::ofstream out;
+	openTable(out, filename);
+	out << "# Photo-pion interaction rate for " << photonField->getFieldName() << ", computed by RateTableBuilder\n";
+	out << "# log10(gamma), proton rate [1/Mpc], neutron rate [1/Mpc]\n";
+	for (size_t i = 0; i < logGamma.size(); i++)
+		out << logGamma[i] << " " << protonRate[i] * Mpc << " " << neutronRate[i] * Mpc << "\n";
+	closeTable(out, filename);
+}
+
+void RateTableBuilder::buildElectronPairProduction(const std::string &directory) const {
+	std::vector<double> logGamma = logGrid(logGammaMin, logGammaMax, logStepGamma);
+	std::vector<double> lossRate(logGamma.size());
+#pragma omp parallel for schedule(dynamic)
+	for (size_t i = 0; i < logGamma.size(); i++)
+		lossRate[i] = electronPairLossRate(std::pow(10, logGamma[i]));
+
+	std::string filename = concat_path(directory, "ElectronPairProduction",
+			"lossrate_" + photonField->getFieldName() + ".txt");
+	std::ofstream out;
+	openTable(out, filename);
+	out << "# Electron pair production loss rate for " << photonField->getFieldName() << ", computed by RateTableBuilder\n";
+	out << "# log10(gamma), (1/gamma) dgamma/dx [1/Mpc]\n";
+	for (size_t i = 0; i < logGamma.size(); i++)
+		out << logGamma[i] << " " << lossRate[i] * Mpc << "\n";
+	closeTable(out, filename);
+}
+
+void RateTableBuilder::buildAll(const std::string &directory) const {
+	buildEMPairProduction(directory);
+	buildEMInverseComptonScattering(directory);
+	buildEMTripletPairProduction(directory);
+	buildEMDoublePairProduction(directory);
+	buildPhotoPionProduction(directory);
+	buildElectronPairProduction(directory);
+}
+
+} // namespace crpropa
@@ -37,15 +37,13 @@ std::string Source::getDescription() const {
 // SourceList------------------------------------------------------------------
 void SourceList::add(Source* source, double weight) {
 	sources.push_back(source);
-	if (cdf.size() > 0)
-		weight += cdf.back();
-	cdf.push_back(weight);
+	sampler.add(weight);
 }
 
 ref_ptr<Candidate> SourceList::getCandidate() const {
 	if (sources.size() == 0)
 		throw std::runtime_error("SourceList: no sources set");
-	size_t i = Random::instance().randBin(cdf);
+	size_t i = sampler.sample();
 	return (sources[i])->getCandidate();
 }
 
@@ -93,16 +91,14 @@ SourceMultipleParticleTypes::SourceMultipleParticleTypes() {
 
 void SourceMultipleParticleTypes::add(int id, double a) {
 	particleTypes.push_back(id);
-	if (cdf.size() > 0)
-		a += cdf.back();
-	cdf.push_back(a);
+	sampler.add(a);
 	setDescription();
 }
 
 void SourceMultipleParticleTypes::prepareParticle(ParticleState& particle) const {
 	if (particleTypes.size() == 0)
 		throw std::runtime_error("SourceMultipleParticleTypes: no nuclei set");
-	size_t i = Random::instance().randBin(cdf);
+	size_t i = sampler.sample();
 	particle.setId(particleTypes[i]);
 }
 
@@ -170,9 +166,7 @@ void SourceComposition::add(int id, double weight) {
 
 	weight *= pow(A, -a);
 
-	if (cdf.size() > 0)
-		weight += cdf.back();
-	cdf.push_back(weight);
+	sampler.add(weight);
 	setDescription();
 }
 
@@ -187,7 +181,7 @@ void SourceComposition::prepareParticle(ParticleState& particle) const {
 	Random &random = Random::instance();
 
 	// draw random particle type
-	size_t i = random.randBin(cdf);
+	size_t i = sampler.sample(random);
 	int id = nuclei[i];
 	particle.setId(id);
 
@@ -234,15 +228,13 @@ SourceMultiplePositions::SourceMultiplePositions() {
 
 void SourceMultiplePositions::add(Vector3d pos, double weight) {
 	positions.push_back(pos);
-	if (cdf.size() > 0)
-		weight += cdf.back();
-	cdf.push_back(weight);
+	sampler.add(weight);
 }
 
 void SourceMultiplePositions::prepareParticle(ParticleState& particle) const {
 	if (positions.size() == 0)
 		throw std::runtime_error("SourceMultiplePositions: no position set");
-	size_t i = Random::instance().randBin(cdf);
+	size_t i = sampler.sample();
 	particle.setPosition(positions[i]);
 }
 
@@ -668,6 +660,7 @@ void SourceUniform1D::setDescription() {
 // ----------------------------------------------------------------------------
 SourceDensityGrid::SourceDensityGrid(ref_ptr<Grid1f> grid) :
 		grid(grid) {
+	grid->detach(); // the values are replaced by the cumulative distribution
 	float sum = 0;
 	for (int ix = 0; ix < grid->getNx(); ix++) {
 		for (int iy = 0; iy < grid->getNy(); iy++) {
@@ -677,6 +670,7 @@ SourceDensityGrid::SourceDensityGrid(ref_ptr<Grid1f> grid) :
 			}
 		}
 	}
+	sampler.setCDF(grid->getGrid());
 	setDescription();
 }
 
@@ -684,7 +678,7 @@ void SourceDensityGrid::prepareParticle(ParticleState& particle) const {
 	Random &random = Random::instance();
 
 	// draw random bin
-	size_t i = random.randBin(grid->getGrid());
+	size_t i = sampler.sample(random);
 	Vector3d pos = grid->positionFromIndex(i);
 
 	// draw uniform position within bin
@@ -708,11 +702,14 @@ SourceDensityGrid1D::SourceDensityGrid1D(ref_ptr<Grid1f> grid) :
 	if (grid->getNz() != 1)
 		throw std::runtime_error("SourceDensityGrid1D: Nz != 1");
 
+	grid->detach(); // the values are replaced by the cumulative distribution
+
 	float sum = 0;
 	for (int ix = 0; ix < grid->getNx(); ix++) {
 		sum += grid->get(ix, 0, 0);
 		grid->get(ix, 0, 0) = sum;
 	}
+	sampler.setCDF(grid->getGrid());
 	setDescription();
 }
 
@@ -720,7 +717,7 @@ void SourceDensityGrid1D::prepareParticle(ParticleState& particle) const {
 	Random &random = Random::instance();
 
 	// draw random bin
-	size_t i = random.randBin(grid->getGrid());
+	size_t i = sampler.sample(random);
 	Vector3d pos = grid->positionFromIndex(i);
 
 	// draw uniform position within bin
@@ -1063,11 +1060,8 @@ void SourceGenericComposition::add(int id, double weight) {
 
 	nuclei.push_back(n);
 
-	// update composition cdf
-	if (cdf.size() == 0)
-		cdf.push_back(weight * n.cdf.back());
-	else
-		cdf.push_back(cdf.back() + weight * n.cdf.back());
+	// update composition weights
+	sampler.add(weight * n.cdf.back());
 }
 
 void SourceGenericComposition::add(int A, int Z, double a) {
@@ -1082,7 +1076,7 @@ void SourceGenericComposition::prepareParticle(ParticleState& particle) const {
 
 
 	// draw random particle type
-	size_t iN = random.randBin(cdf);
+	size_t iN = sampler.sample(random);
 	const Nucleus &n = nuclei.at(iN);
 	particle.setId(n.id);
 
@@ -0,0 +1,104 @@
+#include "crpropa/TableRegistry.h"
+
+#include <map>
+#include <sstream>
+
+#include <sys/stat.h>
+
+namespace crpropa {
+
+namespace {
+
+struct Entry {
+	std::string filename;
+	ref_ptr<Referenced> table;
+};
+
+typedef std::map<std::string, Entry> Registry;
+
+Registry &registry() {
+	static Registry tables;
+	return tables;
+}
+
+// drop the entries only referenced by the registry, call within the lock;
+// no other reference can be created meanwhile, as they are obtained here
+void pruneUnused() {
+	Registry::iterator it = registry().begin();
+	while (it != registry().end()) {
+		if (it->second.table->getReferenceCount() <= 1)
+			registry().erase(it++);
+		else
+			++it;
+	}
+}
+
+} // namespace
+
+std::string TableRegistry::makeKey(const char *type, const std::string &filename) {
+	std::stringstream key;
+	key << type << ":" << filename;
+	struct stat s;
+	if (stat(filename.c_str(), &s) == 0)
+		key << ":" << s.st_size << ":" << s.st_mtime;
+	return key.str();
+}
+
+ref_ptr<Referenced> TableRegistry::find(const std::string &key) {
+	ref_ptr<Referenced> table;
+#pragma omp critical(TableRegistry)
+	{
+		Registry::iterator it = registry().find(key);
+		if (it != registry().end())
+			table = it->second.table;
+	}
+	return table;
+}
+
+ref_ptr<Referenced> TableRegistry::insert(const std::string &key,
+		const std::string &filename, ref_ptr<Referenced> table) {
+#pragma omp critical(TableRegistry)
+	{
+		pruneUnused();
+		Entry &entry = registry()[key];
+		if (entry.table.valid()) {
+			table = entry.table;
+		} else {
+			entry.filename = filename;
+			entry.table = table;
+		}
+	}
+	return table;
+}
+
+size_t TableRegistry::size() {
+	size_t n;
+#pragma omp critical(TableRegistry)
+	n = registry().size();
+	return n;
+}
+
+void TableRegistry::clear() {
+#pragma omp critical(TableRegistry)
+	registry().clear();
+}
+
+void TableRegistry::remove(const std::string &filename) {
+#pragma omp critical(TableRegistry)
+	{
+		Registry::iterator it = registry().begin();
+		while (it != registry().end()) {
+			if (it->second.filename == filename)
+				registry().erase(it++);
+			else
+				++it;
+		}
+	}
+}
+
+void TableRegistry::prune() {
+#pragma omp critical(TableRegistry)
+	pruneUnused();
+}
+
+} // namespace crpropa
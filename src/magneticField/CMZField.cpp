@@ -1,6 +1,8 @@
 #include "crpropa/magneticField/CMZField.h"
 #include "crpropa/Units.h"
 
+#include <limits>
+
 namespace crpropa {
 
 CMZField::CMZField() {
@@ -303,4 +305,15 @@ Vector3d CMZField::getField(const Vector3d& pos) const{
     return b;
 }
 
+double CMZField::getVariationScale() const {
+    // smallest cloud radius or filament width
+    if (useMCField or useNTFField)
+        return 1.7 * pc;
+    if (useRadioArc)
+        return 9.89 * pc;
+    if (useICField)
+        return 70 * pc;
+    return std::numeric_limits<double>::infinity();
+}
+
 } // namespace crpropa
@@ -0,0 +1,319 @@
+#include "crpropa/magneticField/CachedMagneticField.h"
+
+#include "kiss/logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace crpropa {
+
+static const char cacheMagic[8] = {'C', 'R', 'P', 'C', 'A', 'C', 'H', '1'};
+
+// layout of the cache file: header, block table, node values
+struct CacheHeader {
+	char magic[8];
+	double origin[3];
+	double blockSize;
+	uint64_t nBlocks[3];
+	uint64_t cellsPerBlock;
+	double relativeError;
+	uint64_t maxLevel;
+	uint64_t nUnresolved;
+	uint64_t nNodes;
+};
+
+// trilinear interpolation on a block of n^3 nodes at the unit coordinates u in [0, 1]
+static Vector3d interpolateBlock(const float *values, size_t n, double ux, double uy, double uz) {
+	size_t m = n - 1;
+	ux *= m;
+	uy *= m;
+	uz *= m;
+	size_t ix = std::min(size_t(ux), m - 1);
+	size_t iy = std::min(size_t(uy), m - 1);
+	size_t iz = std::min(size_t(uz), m - 1);
+	double fx = ux - ix, fy = uy - iy, fz = uz - iz;
+
+	// successive linear interpolation along z, y and x
+	const float *v = values + 3 * ((ix * n + iy) * n + iz);
+	size_t sx = 3 * n * n, sy = 3 * n, sz = 3;
+	double b[3];
+	for (int c = 0; c < 3; c++) {
+		double v00 = v[c] + fz * (v[c + sz] - v[c]);
+		double v01 = v[c + sy] + fz * (v[c + sy + sz] - v[c + sy]);
+		double v10 = v[c + sx] + fz * (v[c + sx + sz] - v[c + sx]);
+		double v11 = v[c + sx + sy] + fz * (v[c + sx + sy + sz] - v[c + sx + sy]);
+		double v0 = v00 + fy * (v01 - v00);
+		double v1 = v10 + fy * (v11 - v10);
+		b[c] = v0 + fx * (v1 - v0);
+	}
+	return Vector3d(b[0], b[1], b[2]);
+}
+
+CachedMagneticField::CachedMagneticField(ref_ptr<MagneticField> field,
+		double blockSize, double relativeError, size_t cellsPerBlock,
+		int maxLevel) :
+		field(field), blockSize(blockSize), cellsPerBlock(cellsPerBlock),
+		relativeError(relativeError), maxLevel(maxLevel), nUnresolved(0),
+		nodeData(0), nNodes(0) {
+	Vector3d lower, upper;
+	if (not field->getSupport(lower, upper))
+		throw std::runtime_error("CachedMagneticField: the field has no bounded support, specify the box");
+	origin = lower;
+	Vector3d n = ((upper - lower) / blockSize).ceil();
+	nx = std::max(1., n.x);
+	ny = std::max(1., n.y);
+	nz = std::max(1., n.z);
+	build();
+}
+
+CachedMagneticField::CachedMagneticField(ref_ptr<MagneticField> field,
+		Vector3d lower, Vector3d upper, double blockSize, double relativeError,
+		size_t cellsPerBlock, int maxLevel) :
+		field(field), origin(lower), blockSize(blockSize),
+		cellsPerBlock(cellsPerBlock), relativeError(relativeError),
+		maxLevel(maxLevel), nUnresolved(0), nodeData(0), nNodes(0) {
+	Vector3d n = ((upper - lower) / blockSize).ceil();
+	nx = std::max(1., n.x);
+	ny = std::max(1., n.y);
+	nz = std::max(1., n.z);
+	build();
+}
+
+CachedMagneticField::CachedMagneticField(ref_ptr<MagneticField> field,
+		std::string filename) :
+		field(field), nUnresolved(0), nodeData(0), nNodes(0) {
+	file = new MemoryMappedFile(filename);
+	if (file->size() < sizeof(CacheHeader))
+		throw std::runtime_error("CachedMagneticField: invalid cache file " + filename);
+	CacheHeader header;
+	std::memcpy(&header, file->data(), sizeof(header));
+	if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0)
+		throw std::runtime_error("CachedMagneticField: invalid cache file " + filename);
+
+	origin = Vector3d(header.origin[0], header.origin[1], header.origin[2]);
+	blockSize = header.blockSize;
+	nx = header.nBlocks[0];
+	ny = header.nBlocks[1];
+	nz = header.nBlocks[2];
+	cellsPerBlock = header.cellsPerBlock;
+	relativeError = header.relativeError;
+	maxLevel = header.maxLevel;
+	nUnresolved = header.nUnresolved;
+	nNodes = header.nNodes;
+
+	// bound the counts by the file size before multiplying them
+	size_t maxBlocks = file->size() / sizeof(Block);
+	if ((nx == 0) or (ny == 0) or (nz == 0) or (ny > maxBlocks / nx)
+			or (nz > maxBlocks / (nx * ny)) or (nNodes > file->size() / (3 * sizeof(float))))
+		throw std::runtime_error("CachedMagneticField: invalid cache file " + filename);
+	size_t nBlocks = nx * ny * nz;
+	size_t expected = sizeof(CacheHeader) + nBlocks * sizeof(Block) + nNodes * 3 * sizeof(float);
+	if (file->size() != expected)
+		throw std::runtime_error("CachedMagneticField: invalid cache file " + filename);
+	blocks.resize(nBlocks);
+	std::memcpy(blocks.data(), file->data() + sizeof(CacheHeader), nBlocks * sizeof(Block));
+
+	// each resolved block needs n >= 2 nodes per axis and its n^3 nodes inside the node data
+	for (size_t i = 0; i < nBlocks; i++) {
+		uint64_t n = blocks[i].n;
+		if (n == 0)
+			continue;
+		if ((n < 2) or (nNodes / n / n < n) or (blocks[i].offset > nNodes - n * n * n))
+			throw std::runtime_error("CachedMagneticField: invalid block table in cache file " + filename);
+	}
+	nodeData = reinterpret_cast<const float*>(file->data() + sizeof(CacheHeader) + nBlocks * sizeof(Block));
+}
+
+void CachedMagneticField::sampleBlock(size_t ix, size_t iy, size_t iz,
+		size_t n, std::vector<float> &values) const {
+	values.resize(3 * n * n * n);
+	Vector3d corner = origin + Vector3d(ix, iy, iz) * blockSize;
+	double h = blockSize / (n - 1);
+	for (size_t i = 0; i < n; i++)
+		for (size_t j = 0; j < n; j++)
+			for (size_t k = 0; k < n; k++) {
+				Vector3d b = field->getField(corner + Vector3d(i, j, k) * h);
+				float *v = &values[3 * ((i * n + j) * n + k)];
+				v[0] = b.x;
+				v[1] = b.y;
+				v[2] = b.z;
+			}
+}
+
+double CachedMagneticField::blockError(size_t ix, size_t iy, size_t iz,
+		size_t n, const std::vector<float> &values) const {
+	// largest field strength in the block
+	double bMax = 0;
+	for (size_t i = 0; i < values.size(); i += 3)
+		bMax = std::max(bMax, Vector3d(values[i], values[i + 1], values[i + 2]).getR());
+
+	// the error of the trilinear interpolation is largest at the cell centers
+	Vector3d corner = origin + Vector3d(ix, iy, iz) * blockSize;
+	size_t m = n - 1;
+	double maxError = 0;
+	for (size_t i = 0; i < m; i++)
+		for (size_t j = 0; j < m; j++)
+			for (size_t k = 0; k < m; k++) {
+				Vector3d u = (Vector3d(i, j, k) + 0.5) / m;
+				Vector3d b = field->getField(corner + u * blockSize);
+				bMax = std::max(bMax, b.getR());
+				maxError = std::max(maxError, (interpolateBlock(values.data(), n, u.x, u.y, u.z) - b).getR());
+			}
+	return (bMax > 0) ? maxError / bMax : 0;
+}
+
+void CachedMagneticField::build() {
+	if (blockSize <= 0)
+		throw std::runtime_error("CachedMagneticField: block size must be positive");
+	if (cellsPerBlock < 1)
+		throw std::runtime_error("CachedMagneticField: at least one cell per block required");
+	if (relativeError <= 0)
+		throw std::runtime_error("CachedMagneticField: relative error must be positive");
+
+	size_t nBlocks = nx * ny * nz;
+	std::vector<std::vector<float> > values(nBlocks);
+	std::vector<size_t> nodesPerAxis(nBlocks);
+	size_t unresolved = 0;
+
+#pragma omp parallel for schedule(dynamic) reduction(+:unresolved)
+	for (long b = 0; b < long(nBlocks); b++) {
+		size_t ix = b / (ny * nz);
+		size_t iy = (b / nz) % ny;
+		size_t iz = b % nz;
+		double lastError = std::numeric_limits<double>::infinity();
+		for (int level = 0; level <= maxLevel; level++) {
+			size_t n = (cellsPerBlock << level) + 1;
+			nodesPerAxis[b] = n;
+			sampleBlock(ix, iy, iz, n, values[b]);
+			double error = blockError(ix, iy, iz, n, values[b]);
+			if (error <= relativeError)
+				break;
+			// the error of a smooth field decreases by a factor 4 per level,
+			// no improvement indicates a discontinuity
+			if ((level == maxLevel) or (error > 0.5 * lastError)) {
+				unresolved++;
+				nodesPerAxis[b] = 0; // evaluate the field
+				std::vector<float>().swap(values[b]);
+				break;
+			}
+			lastError = error;
+		}
+	}
+	nUnresolved = unresolved;
+
+	// pack the blocks
+	blocks.resize(nBlocks);
+	nNodes = 0;
+	for (size_t b = 0; b < nBlocks; b++) {
+		blocks[b].offset = nNodes;
+		blocks[b].n = nodesPerAxis[b];
+		nNodes += nodesPerAxis[b] * nodesPerAxis[b] * nodesPerAxis[b];
+	}
+	nodes.resize(3 * nNodes);
+	for (size_t b = 0; b < nBlocks; b++) {
+		std::copy(values[b].begin(), values[b].end(), nodes.begin() + 3 * blocks[b].offset);
+		std::vector<float>().swap(values[b]);
+	}
+	nodeData = nodes.data();
+
+	if (nUnresolved > 0) {
+		KISS_LOG_INFO << "CachedMagneticField: " << nUnresolved << " of "
+				<< nBlocks << " blocks do not reach the relative error "
+				<< relativeError << ", the field is evaluated there" << std::endl;
+	}
+}
+
+void CachedMagneticField::save(std::string filename) const {
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	if (not out.good())
+		throw std::runtime_error("CachedMagneticField: could not open file " + filename);
+
+	CacheHeader header;
+	std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.origin[0] = origin.x;
+	header.origin[1] = origin.y;
+	header.origin[2] = origin.z;
+	header.blockSize = blockSize;
+	header.nBlocks[0] = nx;
+	header.nBlocks[1] = ny;
+	header.nBlocks[2] = nz;
+	header.cellsPerBlock = cellsPerBlock;
+	header.relativeError = relativeError;
+	header.maxLevel = maxLevel;
+	header.nUnresolved = nUnresolved;
+	header.nNodes = nNodes;
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(Block));
+	out.write(reinterpret_cast<const char*>(nodeData), nNodes * 3 * sizeof(float));
+	if (not out.good())
+		throw std::runtime_error("CachedMagneticField: could not write file " + filename);
+}
+
+Vector3d CachedMagneticField::getField(const Vector3d &position) const {
+	Vector3d r = (position - origin) / blockSize;
+	if ((r.x < 0) or (r.y < 0) or (r.z < 0) or (r.x >= nx) or (r.y >= ny) or (r.z >= nz))
+		return field->getField(position);
+
+	size_t ix = r.x, iy = r.y, iz = r.z;
+	const Block &block = blocks[(ix * ny + iy) * nz + iz];
+	if (block.n == 0)
+		return field->getField(position); // unresolved block
+	return interpolateBlock(nodeData + 3 * block.offset, block.n, r.x - ix, r.y - iy, r.z - iz);
+}
+
+bool CachedMagneticField::getSupport(Vector3d &lower, Vector3d &upper) const {
+	return field->getSupport(lower, upper);
+}
+
+double CachedMagneticField::getVariationScale() const {
+	return field->getVariationScale();
+}
+
+double CachedMagneticField::getUniformRadius(const Vector3d &position) const {
+	// the interpolation may deviate from a uniform field inside of the cached box
+	Vector3d upper = origin + Vector3d(nx, ny, nz) * blockSize;
+	double dx = std::max(0., std::max(origin.x - position.x, position.x - upper.x));
+	double dy = std::max(0., std::max(origin.y - position.y, position.y - upper.y));
+	double dz = std::max(0., std::max(origin.z - position.z, position.z - upper.z));
+	double d = sqrt(dx * dx + dy * dy + dz * dz);
+	return std::min(d, field->getUniformRadius(position));
+}
+
+ref_ptr<MagneticField> CachedMagneticField::getCachedField() const {
+	return field;
+}
+
+Vector3d CachedMagneticField::getOrigin() const {
+	return origin;
+}
+
+double CachedMagneticField::getBlockSize() const {
+	return blockSize;
+}
+
+double CachedMagneticField::getRelativeError() const {
+	return relativeError;
+}
+
+size_t CachedMagneticField::getNumberOfBlocks() const {
+	return blocks.size();
+}
+
+size_t CachedMagneticField::getNumberOfNodes() const {
+	return nNodes;
+}
+
+size_t CachedMagneticField::getNumberOfUnresolvedBlocks() const {
+	return nUnresolved;
+}
+
+size_t CachedMagneticField::getSizeOf() const {
+	return nNodes * 3 * sizeof(float) + blocks.size() * sizeof(Block);
+}
+
+} // namespace crpropa
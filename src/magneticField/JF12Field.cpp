@@ -3,6 +3,8 @@
 #include "crpropa/magneticField/turbulentField/SimpleGridTurbulence.h"
 #include "crpropa/Random.h"
 
+#include <algorithm>
+
 namespace crpropa {
 
 JF12Field::JF12Field() {
@@ -350,6 +352,48 @@ Vector3d JF12Field::getField(const Vector3d& pos) const {
 	return b;
 }
 
+void JF12Field::getFields(const Vector3d *positions, Vector3d *fields, size_t n, double z) const {
+	for (size_t i = 0; i < n; i++) {
+		if (useStriatedField)
+			fields[i] = getStriatedField(positions[i]);
+		else if (useRegularField)
+			fields[i] = getRegularField(positions[i]);
+		else
+			fields[i] = Vector3d(0.);
+	}
+	if (not useTurbulentField)
+		return;
+
+	const size_t blockSize = 64;
+	Vector3f b[blockSize];
+	for (size_t first = 0; first < n; first += blockSize) {
+		size_t m = std::min(blockSize, n - first);
+		turbulentGrid->interpolate(positions + first, b, m);
+		for (size_t i = 0; i < m; i++)
+			fields[first + i] += Vector3d(b[i] * getTurbulentStrength(positions[first + i]));
+	}
+}
+
+bool JF12Field::getSupport(Vector3d &lower, Vector3d &upper) const {
+	lower = Vector3d(-20 * kpc);
+	upper = Vector3d(20 * kpc);
+	return true;
+}
+
+double JF12Field::getVariationScale() const {
+	// transition widths of the regular field and the cells of the random fields
+	double scale = std::min(wDisk, wHalo);
+	if (useStriatedField and striatedGrid.valid())
+		scale = std::min(scale, striatedGrid->getSpacing().min());
+	if (useTurbulentField and turbulentGrid.valid())
+		scale = std::min(scale, turbulentGrid->getSpacing().min());
+	return scale;
+}
+
+double JF12Field::getUniformRadius(const Vector3d& pos) const {
+	return std::max(0., pos.getR() - 20 * kpc);
+}
+
 
 
 PlanckJF12bField::PlanckJF12bField() : JF12Field::JF12Field(){
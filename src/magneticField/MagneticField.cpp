@@ -1,7 +1,47 @@
 #include "crpropa/magneticField/MagneticField.h"
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 namespace crpropa {
 
+void MagneticField::getFields(const Vector3d *positions, Vector3d *fields, size_t n, double z) const {
+	for (size_t i = 0; i < n; i++)
+		fields[i] = getField(positions[i], z);
+}
+
+double MagneticField::getUniformRadius(const Vector3d &position) const {
+	Vector3d lower, upper;
+	if (not getSupport(lower, upper))
+		return 0;
+	// distance to the support box, 0 inside
+	double dx = std::max(0., std::max(lower.x - position.x, position.x - upper.x));
+	double dy = std::max(0., std::max(lower.y - position.y, position.y - upper.y));
+	double dz = std::max(0., std::max(lower.z - position.z, position.z - upper.z));
+	return sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+void propagateUniform(Vector3d &position, Vector3d &direction,
+		const Vector3d &field, double charge, double energy, double step) {
+	// du/ds = q c / E (u x B) = w x u: rotation of the direction around w
+	Vector3d w = field * (-charge * c_light / energy);
+	double omega = w.getR();
+	if (omega == 0) {
+		position += direction * step;
+		return;
+	}
+	Vector3d n = w / omega;
+	Vector3d uPar = n * n.dot(direction);
+	Vector3d uPerp = direction - uPar;
+	Vector3d nxu = n.cross(uPerp);
+	double theta = omega * step;
+	double sinTheta = sin(theta);
+	double sinHalf = sin(theta / 2);
+	position += uPar * step + uPerp * (sinTheta / omega) + nxu * (2 * sinHalf * sinHalf / omega);
+	direction = (uPar + uPerp * cos(theta) + nxu * sinTheta).getUnitVector();
+}
+
 PeriodicMagneticField::PeriodicMagneticField(ref_ptr<MagneticField> field,
 		const Vector3d &extends) :
 		field(field), extends(extends), origin(0, 0, 0), reflective(false) {
@@ -38,7 +78,7 @@ void PeriodicMagneticField::setReflective(bool reflective) {
 	this->reflective = reflective;
 }
 
-Vector3d PeriodicMagneticField::getField(const Vector3d &position) const {
+Vector3d PeriodicMagneticField::cellPosition(const Vector3d &position) const {
 	Vector3d n = ((position - origin) / extends).floor();
 	Vector3d p = position - origin - n * extends;
 
@@ -54,7 +94,35 @@ Vector3d PeriodicMagneticField::getField(const Vector3d &position) const {
 			p.z = extends.z - p.z;
 	}
 
-	return field->getField(p);
+	return p;
+}
+
+Vector3d PeriodicMagneticField::getField(const Vector3d &position) const {
+	return field->getField(cellPosition(position));
+}
+
+void PeriodicMagneticField::getFields(const Vector3d *positions, Vector3d *fields, size_t n, double z) const {
+	// as in getField, the redshift is not passed on
+	std::vector<Vector3d> p(n);
+	for (size_t i = 0; i < n; i++)
+		p[i] = cellPosition(positions[i]);
+	field->getFields(p.data(), fields, n);
+}
+
+double PeriodicMagneticField::getVariationScale() const {
+	return field->getVariationScale();
+}
+
+double PeriodicMagneticField::getUniformRadius(const Vector3d &position) const {
+	Vector3d p = cellPosition(position);
+	double r = field->getUniformRadius(p);
+	if (r == std::numeric_limits<double>::infinity())
+		return r; // the same uniform field in all cells
+	// limit to the cell
+	r = std::min(r, std::min(p.x, extends.x - p.x));
+	r = std::min(r, std::min(p.y, extends.y - p.y));
+	r = std::min(r, std::min(p.z, extends.z - p.z));
+	return std::max(r, 0.);
 }
 
 void MagneticFieldList::addField(ref_ptr<MagneticField> field) {
@@ -68,6 +136,51 @@ Vector3d MagneticFieldList::getField(const Vector3d &position) const {
 	return b;
 }
 
+void MagneticFieldList::getFields(const Vector3d *positions, Vector3d *b, size_t n, double z) const {
+	// as in getField, the redshift is not passed on
+	std::fill(b, b + n, Vector3d(0.));
+	std::vector<Vector3d> bi(n);
+	for (int i = 0; i < fields.size(); i++) {
+		fields[i]->getFields(positions, bi.data(), n);
+		for (size_t j = 0; j < n; j++)
+			b[j] += bi[j];
+	}
+}
+
+bool MagneticFieldList::getSupport(Vector3d &lower, Vector3d &upper) const {
+	if (fields.empty())
+		return false;
+	// bounding box of the supports
+	for (int i = 0; i < fields.size(); i++) {
+		Vector3d lo, hi;
+		if (not fields[i]->getSupport(lo, hi))
+			return false;
+		if (i == 0) {
+			lower = lo;
+			upper = hi;
+			continue;
+		}
+		lower = Vector3d(std::min(lower.x, lo.x), std::min(lower.y, lo.y), std::min(lower.z, lo.z));
+		upper = Vector3d(std::max(upper.x, hi.x), std::max(upper.y, hi.y), std::max(upper.z, hi.z));
+	}
+	return true;
+}
+
+double MagneticFieldList::getVariationScale() const {
+	double scale = std::numeric_limits<double>::infinity();
+	for (int i = 0; i < fields.size(); i++)
+		scale = std::min(scale, fields[i]->getVariationScale());
+	return scale;
+}
+
+double MagneticFieldList::getUniformRadius(const Vector3d &position) const {
+	// the sum is uniform where all fields are
+	double r = std::numeric_limits<double>::infinity();
+	for (int i = 0; i < fields.size(); i++)
+		r = std::min(r, fields[i]->getUniformRadius(position));
+	return r;
+}
+
 MagneticFieldEvolution::MagneticFieldEvolution(ref_ptr<MagneticField> field,
 	double m) :
 	field(field), m(m) {
@@ -78,6 +191,25 @@ Vector3d MagneticFieldEvolution::getField(const Vector3d &position,
 	return field->getField(position) * pow(1+z, m);
 }
 
+void MagneticFieldEvolution::getFields(const Vector3d *positions, Vector3d *fields, size_t n, double z) const {
+	field->getFields(positions, fields, n);
+	double scale = pow(1+z, m);
+	for (size_t i = 0; i < n; i++)
+		fields[i] *= scale;
+}
+
+bool MagneticFieldEvolution::getSupport(Vector3d &lower, Vector3d &upper) const {
+	return field->getSupport(lower, upper);
+}
+
+double MagneticFieldEvolution::getVariationScale() const {
+	return field->getVariationScale();
+}
+
+double MagneticFieldEvolution::getUniformRadius(const Vector3d &position) const {
+	return field->getUniformRadius(position);
+}
+
 Vector3d MagneticDipoleField::getField(const Vector3d &position) const {
 		Vector3d r = (position - origin);
 		Vector3d unit_r = r.getUnitVector();
@@ -1,5 +1,7 @@
 #include "crpropa/magneticField/MagneticFieldGrid.h"
 
+#include <algorithm>
+
 namespace crpropa {
 
 MagneticFieldGrid::MagneticFieldGrid(ref_ptr<Grid3f> grid) {
@@ -18,6 +20,21 @@ Vector3d MagneticFieldGrid::getField(const Vector3d &pos) const {
 	return grid->interpolate(pos);
 }
 
+void MagneticFieldGrid::getFields(const Vector3d *positions, Vector3d *fields, size_t n, double z) const {
+	const size_t blockSize = 64;
+	Vector3f b[blockSize];
+	for (size_t first = 0; first < n; first += blockSize) {
+		size_t m = std::min(blockSize, n - first);
+		grid->interpolate(positions + first, b, m);
+		for (size_t i = 0; i < m; i++)
+			fields[first + i] = b[i];
+	}
+}
+
+double MagneticFieldGrid::getVariationScale() const {
+	return grid->getSpacing().min();
+}
+
 ModulatedMagneticFieldGrid::ModulatedMagneticFieldGrid(ref_ptr<Grid3f> grid,
 		ref_ptr<Grid1f> modGrid) {
 	grid->setReflective(false);
@@ -54,4 +71,36 @@ Vector3d ModulatedMagneticFieldGrid::getField(const Vector3d &pos) const {
 	return b * m;
 }
 
+double ModulatedMagneticFieldGrid::getVariationScale() const {
+	return std::min(grid->getSpacing().min(), modGrid->getSpacing().min());
+}
+
+OctreeMagneticField::OctreeMagneticField(ref_ptr<OctreeGrid3f> grid) {
+	setGrid(grid);
+}
+
+void OctreeMagneticField::setGrid(ref_ptr<OctreeGrid3f> grid) {
+	this->grid = grid;
+}
+
+ref_ptr<OctreeGrid3f> OctreeMagneticField::getGrid() {
+	return grid;
+}
+
+Vector3d OctreeMagneticField::getField(const Vector3d &pos) const {
+	return grid->interpolate(pos);
+}
+
+bool OctreeMagneticField::getSupport(Vector3d &lower, Vector3d &upper) const {
+	if (grid->isPeriodic())
+		return false;
+	lower = grid->getOrigin();
+	upper = lower + Vector3d(grid->getNx(), grid->getNy(), grid->getNz()) * grid->getSpacing();
+	return true;
+}
+
+double OctreeMagneticField::getVariationScale() const {
+	return grid->getSpacing(grid->getMaximumLevel()).min();
+}
+
 } // namespace crpropa
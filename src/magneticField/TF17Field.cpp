@@ -2,7 +2,9 @@
 #include "crpropa/Units.h"
 
 #include <algorithm>
+#include <limits>
 #include <string>
+#include <vector>
 
 namespace crpropa {
 using namespace std;
@@ -181,6 +183,28 @@ Vector3d TF17Field::getField(const Vector3d& pos) const {
 	return b;
 }
 
+double TF17Field::getVariationScale() const {
+	std::vector<double> scales;
+	scales.push_back(H_p);
+	scales.push_back(L_p);
+	if (useDiskField) {
+		scales.push_back(z1_disk);
+		scales.push_back(r1_disk);
+		scales.push_back(H_disk);
+		scales.push_back(L_disk);
+	}
+	if (useHaloField) {
+		scales.push_back(z1_halo);
+		scales.push_back(L_halo);
+	}
+	// parameters not used by the model are 0
+	double scale = std::numeric_limits<double>::infinity();
+	for (size_t i = 0; i < scales.size(); i++)
+		if (scales[i] > 0)
+			scale = std::min(scale, scales[i]);
+	return scale;
+}
+
 Vector3d TF17Field::getDiskField(const double& r, const double& z, const double& phi, const double& sinPhi, const double& cosPhi) const {
 	Vector3d b(0.);
     double B_r = 0;
@@ -4,6 +4,10 @@
 
 #ifdef CRPROPA_HAVE_FFTW3F
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
 namespace crpropa {
 
 
@@ -16,6 +20,15 @@ GridTurbulence::GridTurbulence(const TurbulenceSpectrum &spectrum,
 	initTurbulence();
 }
 
+GridTurbulence::GridTurbulence(const TurbulenceSpectrum &spectrum,
+                               const GridProperties &gridProp,
+                               unsigned int seed, const std::string &filename)
+    : TurbulentField(spectrum), seed(seed) {
+	checkGridRequirements(gridProp, spectrum.getLmin(), spectrum.getLmax());
+	initTurbulence(gridProp, filename);
+	gridPtr = new Grid3f(filename);
+}
+
 void GridTurbulence::initGrid(const GridProperties &p) {
 	gridPtr = new Grid3f(p);
 }
@@ -26,109 +39,317 @@ Vector3d GridTurbulence::getField(const Vector3d &pos) const {
 
 const ref_ptr<Grid3f> &GridTurbulence::getGrid() const { return gridPtr; }
 
-void GridTurbulence::initTurbulence() {
+namespace {
 
-	Vector3d spacing = gridPtr->getSpacing();
-	size_t n = gridPtr->getNx(); // size of array
-	size_t n2 = (size_t)floor(n / 2) +
-	            1; // size array in z-direction in configuration space
+// splitmix64 finalizer
+uint64_t mix64(uint64_t z) {
+	z += 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+// Counter-based random number in [0, 1) for a key and a counter. Each mode has
+// its own counters, so the field does not depend on the order of the modes and
+// the number of threads.
+double counterRandom(uint64_t key, uint64_t counter) {
+	return (mix64(key ^ mix64(counter)) >> 11) * (1. / 9007199254740992.);
+}
 
-	// arrays to hold the complex vector components of the B(k)-field
-	fftwf_complex *Bkx, *Bky, *Bkz;
-	Bkx = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n * n * n2);
-	Bky = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n * n * n2);
-	Bkz = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n * n * n2);
+// Random Fourier modes of the magnetic field with a given spectrum
+class ModeSampler {
+	const TurbulenceSpectrum &spectrum;
+	size_t n, n2;
+	uint64_t key;
+	std::vector<double> K;
+	double kMin, kMax, lambda;
+
+public:
+	ModeSampler(const TurbulenceSpectrum &spectrum, size_t n, double spacing,
+	            uint64_t key)
+	    : spectrum(spectrum), n(n), n2(n / 2 + 1), key(key), K(n) {
+		// calculate the n possible discrete wave numbers
+		for (size_t i = 0; i < n; i++)
+			K[i] = ((double)i / n - i / (n / 2));
+		kMin = spacing / spectrum.getLmax();
+		kMax = spacing / spectrum.getLmin();
+		lambda = 1 / spacing * 2 * M_PI;
+	}
 
-	Random random;
-	if (seed != 0)
-		random.seed(seed); // use given seed
+	// complex amplitude re + i im of the mode (ix, iy, iz)
+	void sample(size_t ix, size_t iy, size_t iz, Vector3f &re,
+	            Vector3f &im) const {
+		Vector3f ek, e1, e2; // orthogonal base
+		ek.setXYZ(K[ix], K[iy], K[iz]);
+		double k = ek.getR();
+
+		// wave outside of turbulent range -> B(k) = 0
+		if ((k < kMin) || (k > kMax)) {
+			re = Vector3f(0.);
+			im = Vector3f(0.);
+			return;
+		}
 
-	// calculate the n possible discrete wave numbers
-	double K[n];
-	for (size_t i = 0; i < n; i++)
-		K[i] = ((double)i / n - i / (n / 2));
+		// construct an orthogonal base ek, e1, e2
+		Vector3f n0(1, 1, 1); // arbitrary vector to construct orthogonal base
+		if (ek.isParallelTo(n0, float(1e-3))) {
+			// ek parallel to (1,1,1)
+			e1.setXYZ(-1., 1., 0);
+			e2.setXYZ(1., 1., -2.);
+		} else {
+			// ek not parallel to (1,1,1)
+			e1 = n0.cross(ek);
+			e2 = ek.cross(e1);
+		}
+		e1 /= e1.getR();
+		e2 /= e2.getR();
 
-	// double kMin = 2*M_PI / lMax; // * 2 * spacing.x; // spacing.x / lMax;
-	// double kMax = 2*M_PI / lMin; // * 2 * spacing.x; // spacing.x / lMin;
-	double kMin = spacing.x / spectrum.getLmax();
-	double kMax = spacing.x / spectrum.getLmin();
-	auto lambda = 1 / spacing.x * 2 * M_PI;
+		// random orientation perpendicular to k
+		uint64_t i = (ix * n + iy) * n2 + iz;
+		double theta = 2 * M_PI * counterRandom(key, 2 * i);
+		Vector3f b = e1 * std::cos(theta) + e2 * std::sin(theta); // real b-field vector
 
-	Vector3f n0(1, 1, 1); // arbitrary vector to construct orthogonal base
+		// normal distributed amplitude with mean = 0
+		b *= std::sqrt(spectrum.energySpectrum(k * lambda));
 
-	for (size_t ix = 0; ix < n; ix++) {
-		for (size_t iy = 0; iy < n; iy++) {
+		// uniform random phase
+		double phase = 2 * M_PI * counterRandom(key, 2 * i + 1);
+		re = b * std::cos(phase);
+		im = b * std::sin(phase);
+	}
+};
+
+// Inverse FFT from complex to real space in slabs of n x n2 modes: first along
+// x in slabs of constant ky, then along y and z in slabs of constant x. The
+// slabs are independent and can be transformed in parallel and out of core.
+class SlabFFT {
+	size_t n, n2;
+	fftwf_plan c2c, c2r;
+
+public:
+	SlabFFT(size_t n) : n(n), n2(n / 2 + 1) {
+		// the plans are executed on the slabs of all threads, which are
+		// allocated with the same alignment
+		fftwf_complex *slab = allocate();
+		int N[1] = {int(n)};
+		// the planner is not thread-safe, e.g. for TiledGridTurbulence
+#pragma omp critical(FFTW)
+		{
+			c2c = fftwf_plan_many_dft(1, N, n2, slab, NULL, n2, 1, slab, NULL,
+			                          n2, 1, FFTW_BACKWARD, FFTW_ESTIMATE);
+			c2r = fftwf_plan_many_dft_c2r(1, N, n, slab, NULL, 1, n2,
+			                              (float *)slab, NULL, 1, 2 * n2,
+			                              FFTW_ESTIMATE);
+		}
+		fftwf_free(slab);
+	}
+
+	~SlabFFT() {
+#pragma omp critical(FFTW)
+		{
+			fftwf_destroy_plan(c2c);
+			fftwf_destroy_plan(c2r);
+		}
+	}
+
+	fftwf_complex *allocate() const {
+		return (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n * n2);
+	}
+
+	// Sample the components [first, first + nc) of the modes with constant ky
+	// and transform them along x, giving the slabs [x][kz]
+	void transformX(const ModeSampler &modes, size_t iy, int first, int nc,
+	                fftwf_complex **slabs) const {
+		Vector3f re, im;
+		for (size_t ix = 0; ix < n; ix++) {
 			for (size_t iz = 0; iz < n2; iz++) {
-	
-				Vector3f ek, e1, e2;  // orthogonal base
-
-				size_t i = ix * n * n2 + iy * n2 + iz;
-				ek.setXYZ(K[ix], K[iy], K[iz]);
-				double k = ek.getR();
-
-				// wave outside of turbulent range -> B(k) = 0
-				if ((k < kMin) || (k > kMax)) {
-					Bkx[i][0] = 0;
-					Bkx[i][1] = 0;
-					Bky[i][0] = 0;
-					Bky[i][1] = 0;
-					Bkz[i][0] = 0;
-					Bkz[i][1] = 0;
-					continue;
+				modes.sample(ix, iy, iz, re, im);
+				for (int c = 0; c < nc; c++) {
+					slabs[c][ix * n2 + iz][0] = re.data[first + c];
+					slabs[c][ix * n2 + iz][1] = im.data[first + c];
 				}
+			}
+		}
+		for (int c = 0; c < nc; c++)
+			fftwf_execute_dft(c2c, slabs[c], slabs[c]);
+	}
 
-				// construct an orthogonal base ek, e1, e2
-				if (ek.isParallelTo(n0, float(1e-3))) {
-					// ek parallel to (1,1,1)
-					e1.setXYZ(-1., 1., 0);
-					e2.setXYZ(1., 1., -2.);
-				} else {
-					// ek not parallel to (1,1,1)
-					e1 = n0.cross(ek);
-					e2 = ek.cross(e1);
-				}
-				e1 /= e1.getR();
-				e2 /= e2.getR();
-
-				// random orientation perpendicular to k
-				double theta = 2 * M_PI * random.rand();
-				Vector3f b = e1 * std::cos(theta) + e2 * std::sin(theta); // real b-field vector
-
-				// normal distributed amplitude with mean = 0
-				b *= std::sqrt(spectrum.energySpectrum(k*lambda));
-				
-				// uniform random phase
-				double phase = 2 * M_PI * random.rand();
-				double cosPhase = std::cos(phase); // real part
-				double sinPhase = std::sin(phase); // imaginary part
-
-				Bkx[i][0] = b.x * cosPhase;
-				Bkx[i][1] = b.x * sinPhase;
-				Bky[i][0] = b.y * cosPhase;
-				Bky[i][1] = b.y * sinPhase;
-				Bkz[i][0] = b.z * cosPhase;
-				Bkz[i][1] = b.z * sinPhase;
-			} // for iz
-		}     // for iy
-	}         // for ix
-
-	executeInverseFFTInplace(gridPtr, Bkx, Bky, Bkz);
-
-	fftwf_free(Bkx);
-	fftwf_free(Bky);
-	fftwf_free(Bkz);
+	// Transform a slab [ky][kz] of constant x along y and z in-place, giving
+	// the real values [y][z] with rows of 2 * n2 floats
+	float *transformYZ(fftwf_complex *slab) const {
+		fftwf_execute_dft(c2c, slab, slab);
+		fftwf_execute_dft_c2r(c2r, slab, (float *)slab);
+		return (float *)slab;
+	}
+};
+
+} // namespace
+
+uint64_t GridTurbulence::getKey() const {
+	if (seed != 0)
+		return seed;
+	return Random::instance().randInt64();
+}
+
+void GridTurbulence::initTurbulence() {
+	size_t n = gridPtr->getNx(); // size of array
+	size_t n2 = n / 2 + 1; // size array in z-direction in configuration space
+	ModeSampler modes(spectrum, n, gridPtr->getSpacing().x, getKey());
+	SlabFFT fft(n);
+	std::vector<Vector3f> &values = gridPtr->getGrid();
+
+	// one component at a time, holding the slabs transformed along x [x][ky][kz]
+	fftwf_complex *B = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n * n * n2);
+	for (int c = 0; c < 3; c++) {
+#pragma omp parallel
+		{
+			fftwf_complex *slab = fft.allocate();
+
+#pragma omp for schedule(dynamic)
+			for (size_t iy = 0; iy < n; iy++) {
+				fft.transformX(modes, iy, c, 1, &slab);
+				for (size_t ix = 0; ix < n; ix++)
+					std::memcpy(B[(ix * n + iy) * n2], slab[ix * n2],
+					            sizeof(fftwf_complex) * n2);
+			}
+
+#pragma omp for schedule(dynamic)
+			for (size_t ix = 0; ix < n; ix++) {
+				std::memcpy(slab, B[ix * n * n2], sizeof(fftwf_complex) * n * n2);
+				const float *b = fft.transformYZ(slab);
+				for (size_t iy = 0; iy < n; iy++)
+					for (size_t iz = 0; iz < n; iz++)
+						values[(ix * n + iy) * n + iz].data[c] = b[iy * 2 * n2 + iz];
+			}
+
+			fftwf_free(slab);
+		}
+	}
+	fftwf_free(B);
 
 	scaleGrid(gridPtr, spectrum.getBrms() /
 	                       rmsFieldStrength(gridPtr)); // normalize to Brms
 }
 
+void GridTurbulence::initTurbulence(const GridProperties &p,
+                                    const std::string &filename) {
+	size_t n = p.Nx; // size of array
+	size_t n2 = n / 2 + 1; // size array in z-direction in configuration space
+	ModeSampler modes(spectrum, n, p.spacing.x, getKey());
+	SlabFFT fft(n);
+
+	std::fstream out(filename.c_str(), std::ios::in | std::ios::out |
+	                                       std::ios::binary | std::ios::trunc);
+	GridFileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, "CRPGRID1", 8);
+	header.valueSize = sizeof(Vector3f);
+	header.Nx = header.Ny = header.Nz = n;
+	for (int i = 0; i < 3; i++) {
+		header.origin[i] = p.origin.data[i];
+		header.spacing[i] = p.spacing.data[i];
+	}
+	header.reflective = p.reflective;
+	header.interpolation = p.ipol;
+	out.write((const char *)&header, sizeof(header));
+
+	// slabs transformed along x [x][ky][component][kz]
+	std::string tmpname = filename + ".tmp";
+	std::fstream tmp(tmpname.c_str(), std::ios::in | std::ios::out |
+	                                      std::ios::binary | std::ios::trunc);
+	if (not out.good() or not tmp.good())
+		throw std::runtime_error("GridTurbulence: could not open " + filename);
+
+	const size_t record = 3 * n2 * sizeof(fftwf_complex);
+	const size_t plane = n * n * sizeof(Vector3f);
+	bool good = true;
+	double sumB2 = 0;
+#pragma omp parallel reduction(+:sumB2)
+	{
+		fftwf_complex *slabs[3] = {fft.allocate(), fft.allocate(), fft.allocate()};
+		std::vector<float> buffer(2 * 3 * n * n2);
+		fftwf_complex *records = (fftwf_complex *)buffer.data();
+		std::vector<Vector3f> values(n * n);
+
+#pragma omp for schedule(dynamic)
+		for (size_t iy = 0; iy < n; iy++) {
+			fft.transformX(modes, iy, 0, 3, slabs);
+			for (size_t ix = 0; ix < n; ix++)
+				for (int c = 0; c < 3; c++)
+					std::memcpy(records[(3 * ix + c) * n2], slabs[c][ix * n2],
+					            sizeof(fftwf_complex) * n2);
+#pragma omp critical(GridTurbulence)
+			for (size_t ix = 0; ix < n; ix++) {
+				tmp.seekp((ix * n + iy) * record);
+				tmp.write((const char *)records[3 * ix * n2], record);
+				good = good and tmp.good();
+			}
+		}
+
+#pragma omp for schedule(dynamic)
+		for (size_t ix = 0; ix < n; ix++) {
+#pragma omp critical(GridTurbulence)
+			{
+				tmp.seekg(ix * n * record);
+				tmp.read((char *)records, n * record);
+				good = good and tmp.good();
+			}
+			for (int c = 0; c < 3; c++) {
+				for (size_t iy = 0; iy < n; iy++)
+					std::memcpy(slabs[c][iy * n2], records[(3 * iy + c) * n2],
+					            sizeof(fftwf_complex) * n2);
+				const float *b = fft.transformYZ(slabs[c]);
+				for (size_t iy = 0; iy < n; iy++)
+					for (size_t iz = 0; iz < n; iz++)
+						values[iy * n + iz].data[c] = b[iy * 2 * n2 + iz];
+			}
+			for (size_t i = 0; i < n * n; i++)
+				sumB2 += values[i].getR2();
+#pragma omp critical(GridTurbulence)
+			{
+				out.seekp(sizeof(header) + ix * plane);
+				out.write((const char *)values.data(), plane);
+				good = good and out.good();
+			}
+		}
+
+		for (int c = 0; c < 3; c++)
+			fftwf_free(slabs[c]);
+	}
+	tmp.close();
+	std::remove(tmpname.c_str());
+	if (not good)
+		throw std::runtime_error("GridTurbulence: could not write " + filename);
+
+	// normalize to Brms
+	float scale = spectrum.getBrms() / std::sqrt(sumB2 / (n * n * n));
+	std::vector<Vector3f> values(n * n);
+	for (size_t ix = 0; ix < n; ix++) {
+		out.seekg(sizeof(header) + ix * plane);
+		out.read((char *)values.data(), plane);
+		for (size_t i = 0; i < n * n; i++)
+			values[i] *= scale;
+		out.seekp(sizeof(header) + ix * plane);
+		out.write((const char *)values.data(), plane);
+	}
+	if (not out.good())
+		throw std::runtime_error("GridTurbulence: could not write " + filename);
+}
+
 // Check the grid properties before the FFT procedure
 void GridTurbulence::checkGridRequirements(ref_ptr<Grid3f> grid, double lMin,
                                            double lMax) {
-	size_t Nx = grid->getNx();
-	size_t Ny = grid->getNy();
-	size_t Nz = grid->getNz();
-	Vector3d spacing = grid->getSpacing();
+	GridProperties p(grid->getOrigin(), grid->getNx(), grid->getNy(),
+	                 grid->getNz(), grid->getSpacing());
+	checkGridRequirements(p, lMin, lMax);
+}
+
+void GridTurbulence::checkGridRequirements(const GridProperties &p,
+                                           double lMin, double lMax) {
+	size_t Nx = p.Nx;
+	size_t Ny = p.Ny;
+	size_t Nz = p.Nz;
+	Vector3d spacing = p.spacing;
 
 	if ((Nx != Ny) or (Ny != Nz))
 		throw std::runtime_error("turbulentField: only cubic grid supported");
@@ -169,6 +390,7 @@ void GridTurbulence::executeInverseFFTInplace(ref_ptr<Grid3f> grid,
 	fftwf_destroy_plan(plan_z);
 
 	// save to grid
+	grid->detach(); // all values are replaced
 	for (size_t ix = 0; ix < n; ix++) {
 		for (size_t iy = 0; iy < n; iy++) {
 			for (size_t iz = 0; iz < n; iz++) {
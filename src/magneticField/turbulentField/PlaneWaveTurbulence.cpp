@@ -46,48 +46,362 @@
 
 #include "kiss/logger.h"
 
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 
-#if defined(FAST_WAVES)
-#if defined(__SSE__) && defined(__SSE2__) && defined(__SSE3__) && defined(__SSE4_1__) && defined(__SSE4_2__) && defined(__AVX__)
-#define ENABLE_FAST_WAVES
-#else
-#error "FAST_WAVES is enabled, but it appears that not all required SIMD extensions are enabled in the compiler. Without these extensions, the FAST_WAVES optimization cannot be used. Please make sure that the SIMD_EXTENSIONS option in cmake matches the capabilities of your target CPU, or (if your target CPU does not support the required extensions), disable the FAST_WAVES flag in cmake."
-#endif
-#endif
-
-
-#ifdef ENABLE_FAST_WAVES
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRPROPA_HAVE_WAVE_KERNELS
 #include <immintrin.h>
 #endif
 
 namespace crpropa {
-#ifdef ENABLE_FAST_WAVES
-// see
-// https://stackoverflow.com/questions/49941645/get-sum-of-values-stored-in-m256d-with-sse-avx
-double hsum_double_avx(__m256d v) {
-	__m128d vlow = _mm256_castpd256_pd128(v);
-	__m128d vhigh = _mm256_extractf128_pd(v, 1); // high 128
-	vlow = _mm_add_pd(vlow, vhigh);              // reduce down to 128
-
-	__m128d high64 = _mm_unpackhi_pd(vlow, vlow);
-	return _mm_cvtsd_f64(_mm_add_sd(vlow, high64)); // reduce to scalar
+
+#ifdef CRPROPA_HAVE_WAVE_KERNELS
+
+namespace {
+
+// data of the wavemodes for the kernels, each array padded to n modes
+struct WaveData {
+	const double *Axi[3];
+	const double *kkappa[3];
+	const double *beta;
+	const float *Axif[3];
+	int n;
+};
+
+typedef void (*WaveKernel)(const WaveData &, const Vector3d *, Vector3d *);
+
+} // namespace
+
+// The kernels sum Axi * cos(pi * x) over the modes with x = kkappa . pos + beta,
+// where pi is divided out of kkappa and beta. They are built for their
+// instruction sets regardless of the compiler flags and selected at runtime.
+//
+// Computing the cosine: it is periodic, so x is first reduced exactly to
+// r = x - 2 round(x / 2) in [-1, 1]. round(r) is the center of the half-wave
+// containing r, and s = r - round(r) in [-0.5, 0.5] the position within it.
+// The half-waves with round(r) = +-1 are negative, so the sign of the result is
+// flipped for those. cos(pi * s) is even and approximated by a polynomial in
+// s^2 with coefficients generated by SLEEF's gencoef.c, to a precision of 2e-7.
+// The single precision kernels do the reduction in double precision, which
+// keeps the phases of the modes exact, and the polynomial and the sum in
+// single precision.
+
+#define COSPI_C4 +0.2211852080653743946e+0
+#define COSPI_C3 -0.1332560668688523853e+1
+#define COSPI_C2 +0.4058509506474178075e+1
+#define COSPI_C1 -0.4934797516664651162e+1
+
+// SSE4.1, 2 modes at once
+
+__attribute__((target("sse4.1")))
+static inline __m128d cosPiSSE4(__m128d x) {
+	const int mode = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;
+	__m128d h = _mm_round_pd(_mm_mul_pd(x, _mm_set1_pd(0.5)), mode);
+	__m128d r = _mm_sub_pd(x, _mm_add_pd(h, h));
+	__m128d q = _mm_round_pd(r, mode);
+	__m128d s = _mm_sub_pd(r, q);
+	__m128d invert = _mm_andnot_pd(_mm_cmpeq_pd(q, _mm_setzero_pd()), _mm_set1_pd(-0.0));
+
+	s = _mm_mul_pd(s, s);
+	__m128d u = _mm_set1_pd(COSPI_C4);
+	u = _mm_add_pd(_mm_mul_pd(u, s), _mm_set1_pd(COSPI_C3));
+	u = _mm_add_pd(_mm_mul_pd(u, s), _mm_set1_pd(COSPI_C2));
+	u = _mm_add_pd(_mm_mul_pd(u, s), _mm_set1_pd(COSPI_C1));
+	u = _mm_add_pd(_mm_mul_pd(u, s), _mm_set1_pd(1.));
+	return _mm_xor_pd(u, invert);
 }
-#endif // defined(ENABLE_FAST_WAVES)
 
-PlaneWaveTurbulence::PlaneWaveTurbulence(const TurbulenceSpectrum &spectrum,
-                                         int Nm, int seed)
-    : TurbulentField(spectrum), Nm(Nm) {
+// field at P positions in one pass over the modes
+template<int P>
+__attribute__((target("sse4.1")))
+static void wavesSSE4(const WaveData &d, const Vector3d *pos, Vector3d *B) {
+	__m128d x[P][3], acc[P][3];
+	for (int p = 0; p < P; p++)
+		for (int c = 0; c < 3; c++) {
+			x[p][c] = _mm_set1_pd(pos[p].data[c]);
+			acc[p][c] = _mm_setzero_pd();
+		}
+
+	for (int i = 0; i < d.n; i += 2) {
+		__m128d kk0 = _mm_loadu_pd(d.kkappa[0] + i);
+		__m128d kk1 = _mm_loadu_pd(d.kkappa[1] + i);
+		__m128d kk2 = _mm_loadu_pd(d.kkappa[2] + i);
+		__m128d beta = _mm_loadu_pd(d.beta + i);
+		__m128d A0 = _mm_loadu_pd(d.Axi[0] + i);
+		__m128d A1 = _mm_loadu_pd(d.Axi[1] + i);
+		__m128d A2 = _mm_loadu_pd(d.Axi[2] + i);
+		for (int p = 0; p < P; p++) {
+			__m128d arg = _mm_add_pd(_mm_add_pd(_mm_mul_pd(x[p][0], kk0),
+					_mm_mul_pd(x[p][1], kk1)), _mm_add_pd(_mm_mul_pd(x[p][2], kk2), beta));
+			__m128d u = cosPiSSE4(arg);
+			acc[p][0] = _mm_add_pd(_mm_mul_pd(u, A0), acc[p][0]);
+			acc[p][1] = _mm_add_pd(_mm_mul_pd(u, A1), acc[p][1]);
+			acc[p][2] = _mm_add_pd(_mm_mul_pd(u, A2), acc[p][2]);
+		}
+	}
+
+	for (int p = 0; p < P; p++)
+		for (int c = 0; c < 3; c++) {
+			__m128d a = acc[p][c];
+			B[p].data[c] = _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a)));
+		}
+}
 
-#ifdef ENABLE_FAST_WAVES
-	KISS_LOG_INFO << "PlaneWaveTurbulence: Using SIMD TD13 implementation"
-	              << std::endl;
+// AVX2 and FMA, 4 modes at once, 8 in single precision
 
-	// There used to be a cpuid check here, to see if the cpu running
-	// this code would support SIMD (SSE + AVX). However, the library providing
-	// the relevant function is no longer being used, and doing this manually
-	// might be a bit too much work.
-#endif
+__attribute__((target("avx2,fma")))
+static inline __m256d reduceAVX2(__m256d x) {
+	__m256d h = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(0.5)),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	return _mm256_fnmadd_pd(_mm256_set1_pd(2.), h, x);
+}
+
+// cos(pi * r) for r in [-1, 1]
+__attribute__((target("avx2,fma")))
+static inline __m256d cosPiReducedAVX2(__m256d r) {
+	__m256d q = _mm256_round_pd(r, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256d s = _mm256_sub_pd(r, q);
+	__m256d invert = _mm256_andnot_pd(_mm256_cmp_pd(q, _mm256_setzero_pd(), _CMP_EQ_OQ),
+			_mm256_set1_pd(-0.0));
+
+	s = _mm256_mul_pd(s, s);
+	__m256d u = _mm256_set1_pd(COSPI_C4);
+	u = _mm256_fmadd_pd(u, s, _mm256_set1_pd(COSPI_C3));
+	u = _mm256_fmadd_pd(u, s, _mm256_set1_pd(COSPI_C2));
+	u = _mm256_fmadd_pd(u, s, _mm256_set1_pd(COSPI_C1));
+	u = _mm256_fmadd_pd(u, s, _mm256_set1_pd(1.));
+	return _mm256_xor_pd(u, invert);
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 cosPiReducedAVX2f(__m256 r) {
+	__m256 q = _mm256_round_ps(r, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256 s = _mm256_sub_ps(r, q);
+	__m256 invert = _mm256_andnot_ps(_mm256_cmp_ps(q, _mm256_setzero_ps(), _CMP_EQ_OQ),
+			_mm256_set1_ps(-0.0f));
+
+	s = _mm256_mul_ps(s, s);
+	__m256 u = _mm256_set1_ps(COSPI_C4);
+	u = _mm256_fmadd_ps(u, s, _mm256_set1_ps(COSPI_C3));
+	u = _mm256_fmadd_ps(u, s, _mm256_set1_ps(COSPI_C2));
+	u = _mm256_fmadd_ps(u, s, _mm256_set1_ps(COSPI_C1));
+	u = _mm256_fmadd_ps(u, s, _mm256_set1_ps(1.f));
+	return _mm256_xor_ps(u, invert);
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256d argAVX2(const __m256d *x, const WaveData &d, int i) {
+	__m256d arg = _mm256_fmadd_pd(x[2], _mm256_loadu_pd(d.kkappa[2] + i), _mm256_loadu_pd(d.beta + i));
+	arg = _mm256_fmadd_pd(x[1], _mm256_loadu_pd(d.kkappa[1] + i), arg);
+	return _mm256_fmadd_pd(x[0], _mm256_loadu_pd(d.kkappa[0] + i), arg);
+}
+
+__attribute__((target("avx2,fma")))
+static inline double hsumAVX2(__m256d v) {
+	__m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+__attribute__((target("avx2,fma")))
+static inline double hsumAVX2f(__m256 v) {
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+}
+
+template<int P>
+__attribute__((target("avx2,fma")))
+static void wavesAVX2(const WaveData &d, const Vector3d *pos, Vector3d *B) {
+	__m256d x[P][3], acc[P][3];
+	for (int p = 0; p < P; p++)
+		for (int c = 0; c < 3; c++) {
+			x[p][c] = _mm256_set1_pd(pos[p].data[c]);
+			acc[p][c] = _mm256_setzero_pd();
+		}
+
+	for (int i = 0; i < d.n; i += 4) {
+		__m256d A0 = _mm256_loadu_pd(d.Axi[0] + i);
+		__m256d A1 = _mm256_loadu_pd(d.Axi[1] + i);
+		__m256d A2 = _mm256_loadu_pd(d.Axi[2] + i);
+		for (int p = 0; p < P; p++) {
+			__m256d u = cosPiReducedAVX2(reduceAVX2(argAVX2(x[p], d, i)));
+			acc[p][0] = _mm256_fmadd_pd(u, A0, acc[p][0]);
+			acc[p][1] = _mm256_fmadd_pd(u, A1, acc[p][1]);
+			acc[p][2] = _mm256_fmadd_pd(u, A2, acc[p][2]);
+		}
+	}
+
+	for (int p = 0; p < P; p++)
+		B[p] = Vector3d(hsumAVX2(acc[p][0]), hsumAVX2(acc[p][1]), hsumAVX2(acc[p][2]));
+}
+
+template<int P>
+__attribute__((target("avx2,fma")))
+static void wavesAVX2f(const WaveData &d, const Vector3d *pos, Vector3d *B) {
+	__m256d x[P][3];
+	__m256 acc[P][3];
+	for (int p = 0; p < P; p++)
+		for (int c = 0; c < 3; c++) {
+			x[p][c] = _mm256_set1_pd(pos[p].data[c]);
+			acc[p][c] = _mm256_setzero_ps();
+		}
+
+	for (int i = 0; i < d.n; i += 8) {
+		__m256 A0 = _mm256_loadu_ps(d.Axif[0] + i);
+		__m256 A1 = _mm256_loadu_ps(d.Axif[1] + i);
+		__m256 A2 = _mm256_loadu_ps(d.Axif[2] + i);
+		for (int p = 0; p < P; p++) {
+			__m128 lo = _mm256_cvtpd_ps(reduceAVX2(argAVX2(x[p], d, i)));
+			__m128 hi = _mm256_cvtpd_ps(reduceAVX2(argAVX2(x[p], d, i + 4)));
+			__m256 u = cosPiReducedAVX2f(_mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1));
+			acc[p][0] = _mm256_fmadd_ps(u, A0, acc[p][0]);
+			acc[p][1] = _mm256_fmadd_ps(u, A1, acc[p][1]);
+			acc[p][2] = _mm256_fmadd_ps(u, A2, acc[p][2]);
+		}
+	}
+
+	for (int p = 0; p < P; p++)
+		B[p] = Vector3d(hsumAVX2f(acc[p][0]), hsumAVX2f(acc[p][1]), hsumAVX2f(acc[p][2]));
+}
+
+// AVX-512F, 8 modes at once, 16 in single precision
+// The maskz forms of the intrinsics are used, since the unmasked ones pass an
+// uninitialized vector to the builtins, which GCC reports with -Wall.
+
+__attribute__((target("avx512f,avx2,fma")))
+static inline __m512d reduceAVX512(__m512d x) {
+	__m512d h = _mm512_maskz_roundscale_pd(0xff, _mm512_mul_pd(x, _mm512_set1_pd(0.5)),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	return _mm512_fnmadd_pd(_mm512_set1_pd(2.), h, x);
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static inline __m512d cosPiReducedAVX512(__m512d r) {
+	__m512d q = _mm512_maskz_roundscale_pd(0xff, r, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m512d s = _mm512_sub_pd(r, q);
+	__mmask8 invert = _mm512_cmp_pd_mask(q, _mm512_setzero_pd(), _CMP_NEQ_OQ);
+
+	s = _mm512_mul_pd(s, s);
+	__m512d u = _mm512_set1_pd(COSPI_C4);
+	u = _mm512_fmadd_pd(u, s, _mm512_set1_pd(COSPI_C3));
+	u = _mm512_fmadd_pd(u, s, _mm512_set1_pd(COSPI_C2));
+	u = _mm512_fmadd_pd(u, s, _mm512_set1_pd(COSPI_C1));
+	u = _mm512_fmadd_pd(u, s, _mm512_set1_pd(1.));
+	return _mm512_mask_sub_pd(u, invert, _mm512_setzero_pd(), u);
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static inline __m512 cosPiReducedAVX512f(__m512 r) {
+	__m512 q = _mm512_maskz_roundscale_ps(0xffff, r, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m512 s = _mm512_sub_ps(r, q);
+	__mmask16 invert = _mm512_cmp_ps_mask(q, _mm512_setzero_ps(), _CMP_NEQ_OQ);
+
+	s = _mm512_mul_ps(s, s);
+	__m512 u = _mm512_set1_ps(COSPI_C4);
+	u = _mm512_fmadd_ps(u, s, _mm512_set1_ps(COSPI_C3));
+	u = _mm512_fmadd_ps(u, s, _mm512_set1_ps(COSPI_C2));
+	u = _mm512_fmadd_ps(u, s, _mm512_set1_ps(COSPI_C1));
+	u = _mm512_fmadd_ps(u, s, _mm512_set1_ps(1.f));
+	return _mm512_mask_sub_ps(u, invert, _mm512_setzero_ps(), u);
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static inline __m512d argAVX512(const __m512d *x, const WaveData &d, int i) {
+	__m512d arg = _mm512_fmadd_pd(x[2], _mm512_loadu_pd(d.kkappa[2] + i), _mm512_loadu_pd(d.beta + i));
+	arg = _mm512_fmadd_pd(x[1], _mm512_loadu_pd(d.kkappa[1] + i), arg);
+	return _mm512_fmadd_pd(x[0], _mm512_loadu_pd(d.kkappa[0] + i), arg);
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static inline double hsumAVX512(__m512d v) {
+	return hsumAVX2(_mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xf, v, 0),
+			_mm512_maskz_extractf64x4_pd(0xf, v, 1)));
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static inline double hsumAVX512f(__m512 v) {
+	__m512d w = _mm512_castps_pd(v);
+	return hsumAVX2f(_mm256_add_ps(_mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xf, w, 0)),
+			_mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xf, w, 1))));
+}
+
+template<int P>
+__attribute__((target("avx512f,avx2,fma")))
+static void wavesAVX512(const WaveData &d, const Vector3d *pos, Vector3d *B) {
+	__m512d x[P][3], acc[P][3];
+	for (int p = 0; p < P; p++)
+		for (int c = 0; c < 3; c++) {
+			x[p][c] = _mm512_set1_pd(pos[p].data[c]);
+			acc[p][c] = _mm512_setzero_pd();
+		}
+
+	for (int i = 0; i < d.n; i += 8) {
+		__m512d A0 = _mm512_loadu_pd(d.Axi[0] + i);
+		__m512d A1 = _mm512_loadu_pd(d.Axi[1] + i);
+		__m512d A2 = _mm512_loadu_pd(d.Axi[2] + i);
+		for (int p = 0; p < P; p++) {
+			__m512d u = cosPiReducedAVX512(reduceAVX512(argAVX512(x[p], d, i)));
+			acc[p][0] = _mm512_fmadd_pd(u, A0, acc[p][0]);
+			acc[p][1] = _mm512_fmadd_pd(u, A1, acc[p][1]);
+			acc[p][2] = _mm512_fmadd_pd(u, A2, acc[p][2]);
+		}
+	}
+
+	for (int p = 0; p < P; p++)
+		B[p] = Vector3d(hsumAVX512(acc[p][0]), hsumAVX512(acc[p][1]), hsumAVX512(acc[p][2]));
+}
+
+template<int P>
+__attribute__((target("avx512f,avx2,fma")))
+static void wavesAVX512f(const WaveData &d, const Vector3d *pos, Vector3d *B) {
+	__m512d x[P][3];
+	__m512 acc[P][3];
+	for (int p = 0; p < P; p++)
+		for (int c = 0; c < 3; c++) {
+			x[p][c] = _mm512_set1_pd(pos[p].data[c]);
+			acc[p][c] = _mm512_setzero_ps();
+		}
+
+	for (int i = 0; i < d.n; i += 16) {
+		__m512 A0 = _mm512_loadu_ps(d.Axif[0] + i);
+		__m512 A1 = _mm512_loadu_ps(d.Axif[1] + i);
+		__m512 A2 = _mm512_loadu_ps(d.Axif[2] + i);
+		for (int p = 0; p < P; p++) {
+			__m256 lo = _mm512_maskz_cvtpd_ps(0xff, reduceAVX512(argAVX512(x[p], d, i)));
+			__m256 hi = _mm512_maskz_cvtpd_ps(0xff, reduceAVX512(argAVX512(x[p], d, i + 8)));
+			// without AVX512DQ the halves are joined as doubles
+			__m512d r = _mm512_maskz_insertf64x4(0xff, _mm512_castpd256_pd512(_mm256_castps_pd(lo)),
+					_mm256_castps_pd(hi), 1);
+			__m512 u = cosPiReducedAVX512f(_mm512_castpd_ps(r));
+			acc[p][0] = _mm512_fmadd_ps(u, A0, acc[p][0]);
+			acc[p][1] = _mm512_fmadd_ps(u, A1, acc[p][1]);
+			acc[p][2] = _mm512_fmadd_ps(u, A2, acc[p][2]);
+		}
+	}
+
+	for (int p = 0; p < P; p++)
+		B[p] = Vector3d(hsumAVX512f(acc[p][0]), hsumAVX512f(acc[p][1]), hsumAVX512f(acc[p][2]));
+}
+
+// P positions per pass with kernelP, the remaining ones with kernel1
+static void runWaveKernel(size_t P, WaveKernel kernelP, WaveKernel kernel1,
+		const WaveData &d, const Vector3d *positions, Vector3d *fields, size_t n) {
+	size_t j = 0;
+	for (; j + P <= n; j += P)
+		kernelP(d, positions + j, fields + j);
+	for (; j < n; j++)
+		kernel1(d, positions + j, fields + j);
+}
+
+#endif // CRPROPA_HAVE_WAVE_KERNELS
+
+PlaneWaveTurbulence::PlaneWaveTurbulence(const TurbulenceSpectrum &spectrum,
+                                         int Nm, int seed)
+    : TurbulentField(spectrum), Nm(Nm), kernel(getBestKernel()),
+      singlePrecision(false) {
 
 	if (Nm <= 1) {
 		throw std::runtime_error(
@@ -176,266 +490,138 @@ PlaneWaveTurbulence::PlaneWaveTurbulence(const TurbulenceSpectrum &spectrum,
 		Ak[i] = sqrt(2 * Ak[i] / Ak2_sum) * spectrum.getBrms();
 	}
 
-#ifdef ENABLE_FAST_WAVES
-	// * copy data into AVX-compatible arrays *
+	// * copy data into the arrays of the SIMD kernels *
 	//
-	// AVX requires all data to be aligned to 256 bit, or 32 bytes, which is the
-	// same as 4 double precision floating point numbers. Since support for
-	// alignments this big seems to be somewhat tentative in C++ allocators,
-	// we're aligning them manually by allocating a normal double array, and
-	// then computing the offset to the first value with the correct alignment.
-	// This is a little bit of work, so instead of doing it separately for each
-	// of the individual data arrays, we're doing it once for one big array that
-	// all of the component arrays get packed into.
-	//
-	// The other thing to keep in mind is that AVX always reads in units of 256
-	// bits, or 4 doubles. This means that our number of wavemodes must be
-	// divisible by 4. If it isn't, we simply pad it out with zeros. Since the
-	// final step of the computation of each wavemode is multiplication by the
-	// amplitude, which will be set to 0, these padding wavemodes won't affect
-	// the result.
-
-	avx_Nm = ((Nm + 4 - 1) / 4) * 4; // round up to next larger multiple of 4:
-	                                 // align is 256 = 4 * sizeof(double) bit
-	avx_data = std::vector<double>(itotal * avx_Nm + 3, 0.);
-
-	// get the first 256-bit aligned element
-	size_t size = avx_data.size() * sizeof(double);
-	void *pointer = avx_data.data();
+	// The data of all modes is packed into one array, aligned to 64 bytes,
+	// the width of an AVX-512 register. The kernels process up to 16 modes at
+	// once, so the number of modes is padded to a multiple of 16 with modes of
+	// zero amplitude, which do not contribute to the field.
+	simd_Nm = ((Nm + 16 - 1) / 16) * 16;
+	simd_data = std::vector<double>(itotal * simd_Nm + 7, 0.);
+	simd_Axi = std::vector<float>(3 * simd_Nm, 0.f);
+
+	// get the first 64 byte aligned element
+	size_t size = simd_data.size() * sizeof(double);
+	void *pointer = simd_data.data();
 	align_offset =
-	    (double *)std::align(32, 32, pointer, size) - avx_data.data();
+	    (double *)std::align(64, 64, pointer, size) - simd_data.data();
 
-	// copy into the AVX arrays
 	for (int i = 0; i < Nm; i++) {
-		avx_data[i + align_offset + avx_Nm * iAxi0] = Ak[i] * xi[i].x;
-		avx_data[i + align_offset + avx_Nm * iAxi1] = Ak[i] * xi[i].y;
-		avx_data[i + align_offset + avx_Nm * iAxi2] = Ak[i] * xi[i].z;
+		double *data = simd_data.data() + i + align_offset;
+		data[simd_Nm * iAxi0] = Ak[i] * xi[i].x;
+		data[simd_Nm * iAxi1] = Ak[i] * xi[i].y;
+		data[simd_Nm * iAxi2] = Ak[i] * xi[i].z;
 
 		// The cosine implementation computes cos(pi*x), so we'll divide out the
 		// pi here.
-		avx_data[i + align_offset + avx_Nm * ikkappa0] =
-		    k[i] / M_PI * kappa[i].x;
-		avx_data[i + align_offset + avx_Nm * ikkappa1] =
-		    k[i] / M_PI * kappa[i].y;
-		avx_data[i + align_offset + avx_Nm * ikkappa2] =
-		    k[i] / M_PI * kappa[i].z;
+		data[simd_Nm * ikkappa0] = k[i] / M_PI * kappa[i].x;
+		data[simd_Nm * ikkappa1] = k[i] / M_PI * kappa[i].y;
+		data[simd_Nm * ikkappa2] = k[i] / M_PI * kappa[i].z;
 
 		// We also need to divide beta by pi, since that goes into the argument
 		// of the cosine as well.
-		avx_data[i + align_offset + avx_Nm * ibeta] = beta[i] / M_PI;
+		data[simd_Nm * ibeta] = beta[i] / M_PI;
+
+		for (int c = 0; c < 3; c++)
+			simd_Axi[i + simd_Nm * c] = data[simd_Nm * (iAxi0 + c)];
 	}
-#endif // ENABLE_FAST_WAVES
 }
 
 Vector3d PlaneWaveTurbulence::getField(const Vector3d &pos) const {
+	if (kernel != PLANEWAVE_SCALAR) {
+		Vector3d B;
+		getFields(&pos, &B, 1);
+		return B;
+	}
 
-#ifndef ENABLE_FAST_WAVES
 	Vector3d B(0.);
 	for (int i = 0; i < Nm; i++) {
 		double z_ = pos.dot(kappa[i]);
 		B += xi[i] * Ak[i] * cos(k[i] * z_ + beta[i]);
 	}
 	return B;
+}
 
-#else  // ENABLE_FAST_WAVES
+void PlaneWaveTurbulence::getFields(const Vector3d *positions, Vector3d *fields,
+                                    size_t n, double z) const {
+#ifdef CRPROPA_HAVE_WAVE_KERNELS
+	if (kernel != PLANEWAVE_SCALAR) {
+		// Several positions are evaluated per pass over the wavemodes,
+		// sharing the loads of the wavemode data. The computation for each
+		// position does not depend on their number, so that the results are
+		// the same as those of getField.
+		WaveData d;
+		const double *data = simd_data.data() + align_offset;
+		for (int c = 0; c < 3; c++) {
+			d.Axi[c] = data + simd_Nm * (iAxi0 + c);
+			d.kkappa[c] = data + simd_Nm * (ikkappa0 + c);
+			d.Axif[c] = simd_Axi.data() + simd_Nm * c;
+		}
+		d.beta = data + simd_Nm * ibeta;
+		d.n = simd_Nm;
+
+		switch (kernel) {
+		case PLANEWAVE_AVX512:
+			if (singlePrecision)
+				runWaveKernel(4, wavesAVX512f<4>, wavesAVX512f<1>, d, positions, fields, n);
+			else
+				runWaveKernel(4, wavesAVX512<4>, wavesAVX512<1>, d, positions, fields, n);
+			return;
+		case PLANEWAVE_AVX2:
+			if (singlePrecision)
+				runWaveKernel(2, wavesAVX2f<2>, wavesAVX2f<1>, d, positions, fields, n);
+			else
+				runWaveKernel(2, wavesAVX2<2>, wavesAVX2<1>, d, positions, fields, n);
+			return;
+		default:
+			runWaveKernel(2, wavesSSE4<2>, wavesSSE4<1>, d, positions, fields, n);
+			return;
+		}
+	}
+#endif // CRPROPA_HAVE_WAVE_KERNELS
 
-	// Initialize accumulators
-	//
-	// There is one accumulator per component of the result vector.
-	// Note that each accumulator contains four numbers. At the end of
-	// the loop, each of these numbers will contain the sum of every
-	// fourth wavemode, starting at a different offset. In the end, each
-	// of the accumulator's numbers are added together (using
-	// hsum_double_avx), resulting in the total sum for that component.
-
-	__m256d acc0 = _mm256_setzero_pd();
-	__m256d acc1 = _mm256_setzero_pd();
-	__m256d acc2 = _mm256_setzero_pd();
-
-	// broadcast position into AVX registers
-	__m256d pos0 = _mm256_set1_pd(pos.x);
-	__m256d pos1 = _mm256_set1_pd(pos.y);
-	__m256d pos2 = _mm256_set1_pd(pos.z);
-
-	for (int i = 0; i < avx_Nm; i += 4) {
-
-		// Load data from memory into AVX registers:
-		//  - the three components of the vector A * xi
-		__m256d Axi0 =
-		    _mm256_load_pd(avx_data.data() + i + align_offset + avx_Nm * iAxi0);
-		__m256d Axi1 =
-		    _mm256_load_pd(avx_data.data() + i + align_offset + avx_Nm * iAxi1);
-		__m256d Axi2 =
-		    _mm256_load_pd(avx_data.data() + i + align_offset + avx_Nm * iAxi2);
-
-		//  - the three components of the vector k * kappa
-		__m256d kkappa0 = _mm256_load_pd(avx_data.data() + i + align_offset +
-		                                 avx_Nm * ikkappa0);
-		__m256d kkappa1 = _mm256_load_pd(avx_data.data() + i + align_offset +
-		                                 avx_Nm * ikkappa1);
-		__m256d kkappa2 = _mm256_load_pd(avx_data.data() + i + align_offset +
-		                                 avx_Nm * ikkappa2);
-
-		//  - the phase beta.
-		__m256d beta =
-		    _mm256_load_pd(avx_data.data() + i + align_offset + avx_Nm * ibeta);
-
-		// Then, do the computation.
-
-		// This is the scalar product between k*kappa and pos:
-		__m256d z = _mm256_add_pd(_mm256_mul_pd(pos0, kkappa0),
-		                          _mm256_add_pd(_mm256_mul_pd(pos1, kkappa1),
-		                                        _mm256_mul_pd(pos2, kkappa2)));
-
-		// Here, the phase is added on. This is the argument of the cosine.
-		__m256d cos_arg = _mm256_add_pd(z, beta);
-
-		// ********
-		// * Computing the cosine
-		// * Part 1: Argument reduction
-		//
-		//  To understand the computation of the cosine, first note that the
-		//  cosine is periodic and we thus only need to model its behavior
-		//  between 0 and 2*pi to be able compute the function anywhere. In
-		//  fact, by mirroring the function along the x and y axes, even the
-		//  range between 0 and pi/2 is sufficient for this purpose. In this
-		//  range, the cosine can be efficiently evaluated with high precision
-		//  by using a polynomial approximation. Thus, to compute the cosine,
-		//  the input value is first reduced so that it lies within this range.
-		//  Then, the polynomial approximation is evaluated. Finally, if
-		//  necessary, the sign of the result is flipped (mirroring the function
-		//  along the x axis).
-		//
-		//  The actual computation is slightly more involved. First, argument
-		//  reduction can be simplified drastically by computing cos(pi*x),
-		//  such that the values are reduced to the range [0, 0.5) instead of
-		//  [0, pi/2). Since the cosine is even (independent of the sign), we
-		//  can first reduce values to [-0.5, 0.5) – that is, a simple rounding
-		//  operation – and then neutralize the sign. In fact, precisely because
-		//  the cosine is even, all terms of the polynomial are powers of x^2,
-		//  so the value of x^2 (computed as x*x) forms the basis for the
-		//  polynomial approximation. If I understand things correctly, then (in
-		//  IEEE-754 floating point) x*x and (-x)*(-x) will always result in the
-		//  exact same value, which means that any error bound over [0, 0.5)
-		//  automatically applies to (-0.5, 0] as well.
-
-		// First, compute round(x), and store it in q. If this value is odd,
-		// we're looking at the negative half-wave of the cosine, and thus
-		// will have to invert the sign of the result.
-		__m256d q = _mm256_round_pd(
-		    cos_arg, (_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
-
-		// Since we're computing cos(pi*x), round(x) always yields the center of
-		// a half-wave (where cos(pi*x) achieves an extremum). This point
-		// logically corresponds to x=0. Therefore, we subtract this center from
-		// the actual input argument to find the corresponding point on the
-		// half-wave that is centered around zero.
-		__m256d s = _mm256_sub_pd(cos_arg, q);
-
-		// We now want to check whether q (the index of our half-wave) is even
-		// or odd, since all of the odd-numbered half-waves are negative, so
-		// we'll have to flip the final result. On an int, this is as simple as
-		// checking the 0th bit. Idea: manipulate the double in such a way that
-		// we can do this. So, we add 2^52, such that the last digit of the
-		// mantissa is actually in the ones' position. Since q may be negative,
-		// we'll also add 2^51 to make sure it's positive. Note that 2^51 is
-		// even and thus leaves evenness invariant, which is the only thing we
-		// care about here.
-		//
-		// This is based on the int extraction process described here:
-		// https://stackoverflow.com/questions/41144668/how-to-efficiently-perform-double-int64-conversions-with-sse-avx/41223013
-		//
-		// We assume -2^51 <= q < 2^51 for this, which is unproblematic, as
-		// double precision has decayed far enough at that point that the
-		// usefulness of the cosine becomes limited.
-		//
-		// Explanation: The mantissa of a double-precision float has 52 bits
-		// (excluding the implicit first bit, which is always one). If |q| >
-		// 2^51, this implicit first bit has a place value of at least 2^51,
-		// while the first stored bit of the mantissa has a place value of at
-		// least 2^50. This means that the LSB of the mantissa has a place value
-		// of at least 2^(-1), or 0.5. For a cos(pi*x), this corresponds to a
-		// quarter of a cycle (pi/2), so at this point the precision of the
-		// input argument is so low that going from one representable number to
-		// the next causes the result to jump by +/-1.
-
-		q = _mm256_add_pd(q, _mm256_set1_pd(0x0018000000000000));
-
-		// Unfortunately, integer comparisons were only introduced in AVX2, so
-		// we'll have to make do with a floating point comparison to check
-		// whether the last bit is set. However, masking out all but the last
-		// bit will result in a denormal float, which may either result in
-		// performance problems or just be rounded down to zero, neither of
-		// which is what we want here. To fix this, we'll mask in not only bit
-		// 0, but also the exponent (and sign, but that doesn't matter) of q.
-		// Luckily, the exponent of q is guaranteed to have the fixed value of
-		// 1075 (corresponding to 2^52) after our addition.
-
-		__m256d invert = _mm256_and_pd(
-		    q, _mm256_castsi256_pd(_mm256_set1_epi64x(0xfff0000000000001)));
-
-		// If we did have a one in bit 0, our result will be equal to 2^52 + 1.
-		invert = _mm256_cmp_pd(
-		    invert, _mm256_castsi256_pd(_mm256_set1_epi64x(0x4330000000000001)),
-		    _CMP_EQ_OQ);
-
-		// Now we know whether to flip the sign of the result. However, remember
-		// that we're working on multiple values at a time, so an if statement
-		// won't be of much use here (plus it might perform badly). Instead,
-		// we'll make use of the fact that the result of the comparison is all
-		// ones if the comparison was true (i.e. q is odd and we need to flip
-		// the result), and all zeroes otherwise. If we now mask out all bits
-		// except the sign bit, we get something that, when xor'ed into our
-		// final result, will flip the sign exactly when q is odd.
-		invert = _mm256_and_pd(invert, _mm256_set1_pd(-0.0));
-		// (Note that the binary representation of -0.0 is all 0 bits, except
-		// for the sign bit, which is set to 1.)
-
-		// TODO: clamp floats between 0 and 1? This would ensure that we never
-		// see inf's, but maybe we want that, so that things dont just fail
-		// silently...
-
-		// * end of argument reduction
-		// *******
-
-		// ******
-		// * Evaluate the cosine using a polynomial approximation for the zeroth
-		// half-wave.
-		// * The coefficients for this were generated using sleefs gencoef.c.
-		// * These coefficients are probably far from optimal; however, they
-		// should be sufficient for this case.
-		s = _mm256_mul_pd(s, s);
-
-		__m256d u = _mm256_set1_pd(+0.2211852080653743946e+0);
-
-		u = _mm256_add_pd(_mm256_mul_pd(u, s),
-		                  _mm256_set1_pd(-0.1332560668688523853e+1));
-		u = _mm256_add_pd(_mm256_mul_pd(u, s),
-		                  _mm256_set1_pd(+0.4058509506474178075e+1));
-		u = _mm256_add_pd(_mm256_mul_pd(u, s),
-		                  _mm256_set1_pd(-0.4934797516664651162e+1));
-		u = _mm256_add_pd(_mm256_mul_pd(u, s), _mm256_set1_pd(1.));
-
-		// Then, flip the sign of each double for which invert is not zero.
-		// Since invert has only zero bits except for a possible one in bit 63,
-		// we can xor it onto our result to selectively invert the 63rd (sign)
-		// bit in each double where invert is set.
-		u = _mm256_xor_pd(u, invert);
-
-		// * end computation of cosine
-		// **********
-
-		// Finally, Ak*xi is multiplied on. Since this is a vector, the
-		// multiplication needs to be done for each of the three
-		// components, so it happens separately.
-		acc0 = _mm256_add_pd(_mm256_mul_pd(u, Axi0), acc0);
-		acc1 = _mm256_add_pd(_mm256_mul_pd(u, Axi1), acc1);
-		acc2 = _mm256_add_pd(_mm256_mul_pd(u, Axi2), acc2);
+	// The wavemodes are the outer loop, so that the data of each mode is
+	// loaded once for all positions. The sum over the modes is done in the
+	// same order as in getField.
+	std::fill(fields, fields + n, Vector3d(0.));
+	for (int i = 0; i < Nm; i++) {
+		Vector3d Axi = xi[i] * Ak[i];
+		for (size_t j = 0; j < n; j++) {
+			double z_ = positions[j].dot(kappa[i]);
+			fields[j] += Axi * cos(k[i] * z_ + beta[i]);
+		}
 	}
+}
+
+planeWaveKernelType PlaneWaveTurbulence::getBestKernel() {
+#ifdef CRPROPA_HAVE_WAVE_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return PLANEWAVE_AVX512;
+	if (__builtin_cpu_supports("avx2") and __builtin_cpu_supports("fma"))
+		return PLANEWAVE_AVX2;
+	if (__builtin_cpu_supports("sse4.1"))
+		return PLANEWAVE_SSE4;
+#endif
+	return PLANEWAVE_SCALAR;
+}
+
+void PlaneWaveTurbulence::setKernel(planeWaveKernelType kernel) {
+	if ((kernel < PLANEWAVE_SCALAR) or (kernel > getBestKernel()))
+		throw std::runtime_error("PlaneWaveTurbulence: kernel not supported by the CPU");
+	this->kernel = kernel;
+}
+
+planeWaveKernelType PlaneWaveTurbulence::getKernel() const {
+	return kernel;
+}
+
+void PlaneWaveTurbulence::setSinglePrecision(bool single) {
+	singlePrecision = single;
+}
 
-	return Vector3d(hsum_double_avx(acc0), hsum_double_avx(acc1),
-	                hsum_double_avx(acc2));
-#endif // ENABLE_FAST_WAVES
+bool PlaneWaveTurbulence::isSinglePrecision() const {
+	return singlePrecision;
 }
 
 } // namespace crpropa
@@ -0,0 +1,147 @@
+#include "crpropa/magneticField/turbulentField/TiledGridTurbulence.h"
+#include "crpropa/magneticField/turbulentField/GridTurbulence.h"
+#include "crpropa/Random.h"
+
+#ifdef CRPROPA_HAVE_FFTW3F
+
+#include <cmath>
+
+namespace crpropa {
+
+TiledGridTurbulence::TiledGridTurbulence(const TurbulenceSpectrum &spectrum,
+		const GridProperties &tileProp, unsigned int seed, size_t maxTiles) :
+		TurbulentField(spectrum), tileProperties(tileProp), maxTiles(maxTiles),
+		nGenerated(0) {
+	if (maxTiles < 8)
+		throw std::runtime_error("TiledGridTurbulence: at least 8 tiles needed");
+	GridTurbulence::checkGridRequirements(tileProp, spectrum.getLmin(),
+			spectrum.getLmax());
+	key = (seed != 0) ? seed : Random::instance().randInt64();
+}
+
+ref_ptr<Grid3f> TiledGridTurbulence::generateTile(const TileIndex &index) const {
+	// seed of the tile from the key and the index
+	uint32_t s[8] = {uint32_t(key), uint32_t(key >> 32), uint32_t(index.x),
+			uint32_t(index.x >> 32), uint32_t(index.y), uint32_t(index.y >> 32),
+			uint32_t(index.z), uint32_t(index.z >> 32)};
+	Random random(s, 8);
+	unsigned int seed = random.randInt();
+	if (seed == 0)
+		seed = 1; // would be a random seed
+
+	GridProperties p(tileProperties);
+	p.origin += Vector3d(index.x, index.y, index.z) * getTileSize() / 2;
+	GridTurbulence turbulence(spectrum, p, seed);
+	return turbulence.getGrid();
+}
+
+void TiledGridTurbulence::getTiles(const TileIndex *indices,
+		ref_ptr<Grid3f> *result, size_t n) const {
+	bool missing = false;
+#pragma omp critical(TiledGridTurbulence)
+	for (size_t i = 0; i < n; i++) {
+		std::map<TileIndex, TileList::iterator>::iterator it = tileMap.find(indices[i]);
+		if (it == tileMap.end()) {
+			missing = true;
+			continue;
+		}
+		tiles.splice(tiles.begin(), tiles, it->second);
+		result[i] = it->second->second;
+	}
+	if (not missing)
+		return;
+
+	// generate the missing tiles without locking the cache
+	for (size_t i = 0; i < n; i++)
+		if (not result[i].valid())
+			result[i] = generateTile(indices[i]);
+
+#pragma omp critical(TiledGridTurbulence)
+	for (size_t i = 0; i < n; i++) {
+		std::map<TileIndex, TileList::iterator>::iterator it = tileMap.find(indices[i]);
+		if (it != tileMap.end()) {
+			// already present or generated by another thread
+			tiles.splice(tiles.begin(), tiles, it->second);
+			result[i] = it->second->second;
+			continue;
+		}
+		tiles.push_front(std::make_pair(indices[i], result[i]));
+		tileMap[indices[i]] = tiles.begin();
+		nGenerated++;
+		while (tiles.size() > maxTiles) {
+			tileMap.erase(tiles.back().first);
+			tiles.pop_back();
+		}
+	}
+}
+
+Vector3d TiledGridTurbulence::getField(const Vector3d &position) const {
+	// position in units of the tile distance
+	Vector3d t = (position - tileProperties.origin) / (getTileSize() / 2);
+
+	// the two tiles along each axis and their weights
+	int64_t lower[3];
+	double w[3][2];
+	for (int i = 0; i < 3; i++) {
+		double fl = std::floor(t.data[i]);
+		double f = t.data[i] - fl;
+		lower[i] = int64_t(fl);
+		w[i][0] = std::cos(M_PI_2 * f); // tile lower - 1
+		w[i][1] = std::sin(M_PI_2 * f); // tile lower
+	}
+
+	TileIndex indices[8];
+	double weights[8];
+	size_t n = 0;
+	for (int j = 0; j < 8; j++) {
+		int dx = (j >> 2) & 1, dy = (j >> 1) & 1, dz = j & 1;
+		double weight = w[0][dx] * w[1][dy] * w[2][dz];
+		if (weight == 0)
+			continue;
+		TileIndex index = {lower[0] - 1 + dx, lower[1] - 1 + dy, lower[2] - 1 + dz};
+		indices[n] = index;
+		weights[n] = weight;
+		n++;
+	}
+
+	ref_ptr<Grid3f> tiles[8];
+	getTiles(indices, tiles, n);
+	Vector3d b(0.);
+	for (size_t i = 0; i < n; i++)
+		b += Vector3d(tiles[i]->interpolate(position)) * weights[i];
+	return b;
+}
+
+ref_ptr<Grid3f> TiledGridTurbulence::getTile(int64_t ix, int64_t iy,
+		int64_t iz) const {
+	TileIndex index = {ix, iy, iz};
+	ref_ptr<Grid3f> tile;
+	getTiles(&index, &tile, 1);
+	return tile;
+}
+
+double TiledGridTurbulence::getTileSize() const {
+	return tileProperties.Nx * tileProperties.spacing.x;
+}
+
+size_t TiledGridTurbulence::getMaximumNumberOfTiles() const {
+	return maxTiles;
+}
+
+size_t TiledGridTurbulence::getNumberOfCachedTiles() const {
+	size_t n;
+#pragma omp critical(TiledGridTurbulence)
+	n = tiles.size();
+	return n;
+}
+
+size_t TiledGridTurbulence::getNumberOfGeneratedTiles() const {
+	size_t n;
+#pragma omp critical(TiledGridTurbulence)
+	n = nGenerated;
+	return n;
+}
+
+} // namespace crpropa
+
+#endif // CRPROPA_HAVE_FFTW3F
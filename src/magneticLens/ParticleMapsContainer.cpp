@@ -117,9 +117,18 @@ void ParticleMapsContainer::_updateWeights() {
 	if (_weightsUpToDate)
 		return;
 
+	_sumOfWeights = 0;
+	_pidList.clear();
+	_pidSampler.clear();
+	_energyIdxList.clear();
+	_energySampler.clear();
+	_pixelSampler.clear();
+
 	for(std::map<int, std::map<int, double*> >::iterator pid_iter = _data.begin(); 
 			pid_iter != _data.end(); ++pid_iter) {
 		_weightsPID[pid_iter->first] = 0;
+		std::vector<int> &energyIdxList = _energyIdxList[pid_iter->first];
+		DiscreteSampler &energySampler = _energySampler[pid_iter->first];
 
 		for(std::map<int, double*>::iterator energy_iter = pid_iter->second.begin();
 			energy_iter != pid_iter->second.end(); ++energy_iter)  {
@@ -130,7 +139,11 @@ void ParticleMapsContainer::_updateWeights() {
 				_weightsPID[pid_iter->first]+=energy_iter->second[j];
 			}
 			_sumOfWeights+=_weights_pidEnergy[pid_iter->first][energy_iter->first];
+			energyIdxList.push_back(energy_iter->first);
+			energySampler.add(_weights_pidEnergy[pid_iter->first][energy_iter->first]);
 		}
+		_pidList.push_back(pid_iter->first);
+		_pidSampler.add(_weightsPID[pid_iter->first]);
 	}
 	_weightsUpToDate = true;
 }
@@ -148,20 +161,11 @@ void ParticleMapsContainer::getRandomParticles(size_t N, vector<int> &particleId
 
 	for(size_t i=0; i< N; i++) {
 		//get particle
-		double r = Random::instance().rand() * _sumOfWeights;
-		std::map<int, double>::iterator iter = _weightsPID.begin();
-		while ((r-= iter->second) > 0) {
-			++iter; 
-		}
-		particleId[i] = iter->first;
-	
+		particleId[i] = _pidList[_pidSampler.sample()];
+
 		//get energy
-		r = Random::instance().rand() * iter->second;
-		iter = _weights_pidEnergy[particleId[i]].begin();
-		while ((r-= iter->second) > 0) {
-		 ++iter; 
-		}
-		energy[i] = idx2Energy(iter->first) / eV;
+		int energyIdx = _energyIdxList[particleId[i]][_energySampler[particleId[i]].sample()];
+		energy[i] = idx2Energy(energyIdx) / eV;
 
 		placeOnMap(particleId[i], energy[i] * eV, galacticLongitudes[i], galacticLatitudes[i]);
 	}
@@ -179,16 +183,19 @@ bool ParticleMapsContainer::placeOnMap(int pid, double energy, double &galacticL
 		return false;
 	}
 
-	double r = Random::instance().rand() * _weights_pidEnergy[pid][energyIdx];
+	if (_weights_pidEnergy[pid][energyIdx] <= 0)
+		return false;
 
-	for(size_t j = 0; j< _pixelization.getNumberOfPixels(); j++) {
-		r -= _data[pid][energyIdx][j];
-		if (r <= 0) {
-			_pixelization.getRandomDirectionInPixel(j, galacticLongitude, galacticLatitude);
-			return true;
-		}
+	// build the pixel sampler of this map on first use
+	std::map<int, DiscreteSampler> &pixelSampler = _pixelSampler[pid];
+	if (pixelSampler.find(energyIdx) == pixelSampler.end()) {
+		double *map = _data[pid][energyIdx];
+		pixelSampler[energyIdx].setWeights(std::vector<double>(map, map + _pixelization.getNumberOfPixels()));
 	}
-	return false;
+
+	size_t j = pixelSampler[energyIdx].sample();
+	_pixelization.getRandomDirectionInPixel(j, galacticLongitude, galacticLatitude);
+	return true;
 }
 
 
@@ -1,6 +1,7 @@
 #include "crpropa/module/Acceleration.h"
 #include <crpropa/Common.h>
 #include <crpropa/Random.h>
+#include <crpropa/module/WeightWindow.h>
 #include <cmath>
 
 namespace crpropa {
@@ -143,8 +144,8 @@ double QuasiLinearTheory::modify(double steplength, Candidate* candidate)
 
 ParticleSplitting::ParticleSplitting(Surface *surface, int numSplits,
 		int	crossingThreshold, double minWeight, std::string counterid)
-	: surface(surface), crossingThreshold(crossingThreshold),
-	  numSplits(numSplits), minWeight(minWeight), counterid(counterid){};
+	: numSplits(numSplits), crossingThreshold(crossingThreshold),
+	  minWeight(minWeight), surface(surface), counterid(counterid){};
 
 void ParticleSplitting::process(Candidate *candidate) const {
 	const double currentDistance =
@@ -167,18 +168,7 @@ void ParticleSplitting::process(Candidate *candidate) const {
 	if (num_crossings % crossingThreshold != 0)
 		return;
 
-	candidate->updateWeight(1. / numSplits);
-
-	for (size_t i = 1; i < numSplits; i++) {
-		// No recursive split as the weights of the secondaries created
-		// before the split are not affected
-		ref_ptr<Candidate> new_candidate = candidate->clone(false);
-		new_candidate->parent = candidate;
-		uint64_t snr = Candidate::getNextSerialNumber();
-		Candidate::setNextSerialNumber(snr + 1);
-		new_candidate->setSerialNumber(snr);
-		candidate->addSecondary(new_candidate);
-	}
+	WeightWindow::split(candidate, numSplits);
 };
 
 } // namespace crpropa
@@ -1,4 +1,5 @@
 #include "crpropa/module/Boundary.h"
+#include "crpropa/Geometry.h"
 #include "crpropa/Units.h"
 
 #include <sstream>
@@ -125,8 +126,14 @@ void CubicBoundary::process(Candidate *c) const {
 		reject(c);
 	}
 	if (limitStep) {
-		c->limitNextStep(lo + margin);
-		c->limitNextStep(size - hi + margin);
+		// neutral particles move on straight lines up to the boundary
+		if (c->current.getCharge() == 0) {
+			ParaxialBox box(origin, Vector3d(size));
+			c->limitNextStep(box.intersectionDistance(c->current.getPosition(), c->current.getDirection()) + margin);
+		} else {
+			c->limitNextStep(lo + margin);
+			c->limitNextStep(size - hi + margin);
+		}
 	}
 }
 
@@ -167,8 +174,15 @@ void SphericalBoundary::process(Candidate *c) const {
 	if (d >= radius) {
 		reject(c);
 	}
-	if (limitStep)
-		c->limitNextStep(radius - d + margin);
+	if (limitStep) {
+		// neutral particles move on straight lines up to the boundary
+		if (c->current.getCharge() == 0) {
+			Sphere sphere(center, radius);
+			c->limitNextStep(sphere.intersectionDistance(c->current.getPosition(), c->current.getDirection()) + margin);
+		} else {
+			c->limitNextStep(radius - d + margin);
+		}
+	}
 }
 
 void SphericalBoundary::setCenter(Vector3d c) {
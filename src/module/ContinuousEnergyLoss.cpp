@@ -0,0 +1,234 @@
+#include "crpropa/module/ContinuousEnergyLoss.h"
+#include "crpropa/Cosmology.h"
+#include "crpropa/DataTable.h"
+#include "crpropa/ParticleID.h"
+#include "crpropa/ParticleMass.h"
+#include "crpropa/TableRegistry.h"
+#include "crpropa/Units.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace crpropa {
+
+// power-law extrapolation of the loss rate above the table, as in ElectronPairProduction
+static const double extrapolationSlope = -0.6;
+
+// int_0^delta exp(-s x) dx / beta
+static double segmentIntegral(double beta, double s, double delta) {
+	if (std::abs(s * delta) < 1e-10)
+		return delta / beta;
+	return -expm1(-s * delta) / (s * beta);
+}
+
+// inverse of segmentIntegral
+static double segmentInverse(double beta, double s, double t) {
+	if (std::abs(s * beta * t) < 1e-10)
+		return beta * t;
+	double x = -s * beta * t;
+	if (x <= -1)
+		return std::numeric_limits<double>::max(); // beyond the reach of a decreasing loss rate
+	return -log1p(x) / s;
+}
+
+ContinuousEnergyLoss::LossTable::LossTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
+
+	// log10(gamma), relative energy loss rate [1/Mpc]
+	std::vector<double> x, b;
+	double maxRate = 0;
+	for (size_t i = 0; i < table->rows(); i++) {
+		if (table->columns(i) < 2)
+			throw std::runtime_error("ContinuousEnergyLoss: invalid line in " + filename);
+		x.push_back((*table)(i, 0) * M_LN10);
+		b.push_back((*table)(i, 1) / Mpc);
+		maxRate = std::max(maxRate, b.back());
+	}
+
+	// skip the rows below the threshold, where the loss length exceeds 1e20 times its minimum
+	size_t i0 = 0;
+	while ((i0 < b.size()) and (b[i0] < 1e-20 * maxRate))
+		i0++;
+	for (size_t i = i0; i < b.size(); i++) {
+		if (b[i] <= 0)
+			throw std::runtime_error("ContinuousEnergyLoss: loss rate not positive in " + filename);
+		u.push_back(x[i]);
+		beta.push_back(b[i]);
+	}
+	if (u.size() < 2)
+		throw std::runtime_error("ContinuousEnergyLoss: not enough data in " + filename);
+
+	size_t n = u.size();
+	slope.resize(n);
+	S.resize(n);
+	slope[n - 1] = extrapolationSlope;
+	S[n - 1] = 0;
+	for (size_t i = n - 1; i-- > 0;) {
+		double delta = u[i + 1] - u[i];
+		slope[i] = log(beta[i + 1] / beta[i]) / delta;
+		S[i] = S[i + 1] + segmentIntegral(beta[i], slope[i], delta);
+	}
+}
+
+size_t ContinuousEnergyLoss::LossTable::segment(double x) const {
+	size_t i = std::upper_bound(u.begin(), u.end(), x) - u.begin();
+	return (i == 0) ? 0 : i - 1;
+}
+
+double ContinuousEnergyLoss::LossTable::rate(double x) const {
+	if (x < u.front())
+		return 0;
+	size_t i = segment(x);
+	return beta[i] * exp(slope[i] * (x - u[i]));
+}
+
+double ContinuousEnergyLoss::LossTable::integral(double x) const {
+	x = std::max(x, u.front());
+	size_t i = segment(x);
+	return S[i] - segmentIntegral(beta[i], slope[i], x - u[i]);
+}
+
+double ContinuousEnergyLoss::LossTable::inverse(double s) const {
+	if (s >= S.front())
+		return u.front();
+	// S is decreasing, find the segment with S[i] >= s > S[i + 1]
+	size_t i = std::upper_bound(S.begin(), S.end(), s, std::greater<double>()) - S.begin() - 1;
+	double delta = segmentInverse(beta[i], slope[i], S[i] - s);
+	if (i + 1 < u.size())
+		delta = std::min(delta, u[i + 1] - u[i]);
+	return u[i] + delta;
+}
+
+ContinuousEnergyLoss::ContinuousEnergyLoss(bool haveRedshift, double maxRedshiftStep) {
+	setHaveRedshift(haveRedshift);
+	setMaximumRedshiftStep(maxRedshiftStep);
+}
+
+void ContinuousEnergyLoss::addElectronPairProduction(ref_ptr<PhotonField> photonField) {
+	addElectronPairProduction(photonField,
+			getDataPath("ElectronPairProduction/lossrate_" + photonField->getFieldName() + ".txt"));
+}
+
+void ContinuousEnergyLoss::addElectronPairProduction(ref_ptr<PhotonField> photonField, std::string filename) {
+	lossTables.push_back(TableRegistry::get<LossTable>(filename));
+	photonFields.push_back(photonField);
+}
+
+void ContinuousEnergyLoss::setHaveRedshift(bool b) {
+	haveRedshift = b;
+}
+
+void ContinuousEnergyLoss::setMaximumRedshiftStep(double dz) {
+	if (dz <= 0)
+		throw std::runtime_error("ContinuousEnergyLoss: maximum redshift step must be positive");
+	maxRedshiftStep = dz;
+}
+
+bool ContinuousEnergyLoss::getHaveRedshift() const {
+	return haveRedshift;
+}
+
+double ContinuousEnergyLoss::getMaximumRedshiftStep() const {
+	return maxRedshiftStep;
+}
+
+double ContinuousEnergyLoss::pairProductionFactor(double Z2A, double lf, double z, double step) const {
+	// S(ln(gamma (1 + z))) increases by Z^2 / A (1 + z)^3 s(z) per local distance = comoving distance / (1 + z)
+	std::vector<double> k(lossTables.size());
+	for (size_t i = 0; i < lossTables.size(); i++)
+		k[i] = Z2A * pow_integer<2>(1 + z) * photonFields[i]->getRedshiftScaling(z);
+
+	double u0 = log(lf * (1 + z));
+	double u = u0;
+	double remaining = step;
+	while (remaining > 0) {
+		// with several photon fields the losses are applied one after the other,
+		// in parts of at most 5% of the combined energy loss length
+		double part = remaining;
+		if (lossTables.size() > 1) {
+			double rate = 0;
+			for (size_t i = 0; i < lossTables.size(); i++)
+				rate += k[i] * lossTables[i]->rate(u);
+			if (rate > 0)
+				part = std::min(remaining, 0.05 / rate);
+		}
+		remaining -= part;
+
+		for (size_t i = 0; i < lossTables.size(); i++) {
+			const LossTable &table = *lossTables[i];
+			if (u <= table.u.front())
+				continue; // below the energy threshold
+			u = table.inverse(table.integral(u) + k[i] * part);
+		}
+	}
+	return exp(u - u0);
+}
+
+void ContinuousEnergyLoss::process(Candidate *candidate) const {
+	double step = candidate->getCurrentStep();
+	if (step <= 0)
+		return;
+
+	int id = candidate->current.getId();
+	double E = candidate->current.getEnergy();
+	double z = candidate->getRedshift();
+
+	// electron-pair production only for charged nuclei
+	double Z2A = 0;
+	if (isNucleus(id) and (lossTables.size() > 0)) {
+		double Z = chargeNumber(id);
+		Z2A = Z * Z / (nuclearMass(id) / mass_proton);
+	}
+
+	// parts of the step with redshift difference below maxRedshiftStep
+	bool redshifting = haveRedshift and (z > std::numeric_limits<double>::min());
+	double D = redshifting ? redshift2ComovingDistance(z) : 0;
+	double zEnd = z;
+	if (redshifting)
+		zEnd = (D > step) ? comovingDistance2Redshift(D - step) : 0;
+	size_t n = std::max(1., ceil((z - zEnd) / maxRedshiftStep));
+	double ds = step / n;
+
+	for (size_t i = 0; i < n; i++) {
+		double zMid = z, zNext = z;
+		if (redshifting) {
+			zMid = (D > ds / 2) ? comovingDistance2Redshift(D - ds / 2) : 0;
+			zNext = (D > ds) ? comovingDistance2Redshift(D - ds) : 0;
+			D = std::max(D - ds, 0.);
+			E *= (1 + zMid) / (1 + z); // adiabatic loss over the first half
+		}
+
+		if (Z2A > 0) {
+			double lf = E / (candidate->current.getMass() * c_squared);
+			E *= pairProductionFactor(Z2A, lf, zMid, ds);
+		}
+
+		if (redshifting)
+			E *= (1 + zNext) / (1 + zMid); // adiabatic loss over the second half
+		z = zNext;
+	}
+
+	if (redshifting)
+		candidate->setRedshift(z);
+	candidate->current.setEnergy(E);
+}
+
+std::string ContinuousEnergyLoss::getDescription() const {
+	std::stringstream s;
+	s << "ContinuousEnergyLoss:";
+	if (haveRedshift)
+		s << " redshift and adiabatic loss,";
+	s << " electron-pair production on";
+	for (size_t i = 0; i < photonFields.size(); i++)
+		s << " " << photonFields[i]->getFieldName();
+	if (photonFields.empty())
+		s << " -";
+	s << ", maximum redshift step " << maxRedshiftStep;
+	return s.str();
+}
+
+} // namespace crpropa
@@ -1,9 +1,9 @@
 #include "crpropa/module/EMDoublePairProduction.h"
+#include "crpropa/DataTable.h"
+#include "crpropa/TableRegistry.h"
 #include "crpropa/Units.h"
 #include "crpropa/Random.h"
 
-#include <fstream>
-#include <limits>
 #include <stdexcept>
 
 namespace crpropa {
@@ -34,28 +34,21 @@ void EMDoublePairProduction::setThinning(double thinning) {
 	this->thinning = thinning;
 }
 
-void EMDoublePairProduction::initRate(std::string filename) {
-	std::ifstream infile(filename.c_str());
-
-	if (!infile.good())
-		throw std::runtime_error("EMDoublePairProduction: could not open file " + filename);
-
-	// clear previously loaded interaction rates
-	tabEnergy.clear();
-	tabRate.clear();
-
-	while (infile.good()) {
-		if (infile.peek() != '#') {
-			double a, b;
-			infile >> a >> b;
-			if (infile) {
-				tabEnergy.push_back(pow(10, a) * eV);
-				tabRate.push_back(b / Mpc);
-			}
-		}
-		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
+EMDoublePairProduction::RateTable::RateTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
+
+	for (size_t i = 0; i < table->rows(); i++) {
+		if (table->columns(i) < 2)
+			throw std::runtime_error("EMDoublePairProduction: invalid line in " + filename);
+		tabEnergy.push_back(pow(10, (*table)(i, 0)) * eV);
+		tabRate.push_back((*table)(i, 1) / Mpc);
 	}
-	infile.close();
+
+	interpolation.setTable(tabEnergy, tabRate);
+}
+
+void EMDoublePairProduction::initRate(std::string filename) {
+	rateTable = TableRegistry::get<RateTable>(filename);
 }
 
 
@@ -100,11 +93,11 @@ void EMDoublePairProduction::process(Candidate *candidate) const {
 	double E = (1 + z) * candidate->current.getEnergy();
 
 	// check if in tabulated energy range
-	if (E < tabEnergy.front() or (E > tabEnergy.back()))
+	if (E < rateTable->tabEnergy.front() or (E > rateTable->tabEnergy.back()))
 		return;
 
 	// interaction rate
-	double rate = interpolate(E, tabEnergy, tabRate);
+	double rate = rateTable->interpolation.interpolate(E);
 	rate *= pow_integer<2>(1 + z) * photonField->getRedshiftScaling(z);
 
 	// check for interaction
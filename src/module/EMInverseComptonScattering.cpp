@@ -1,110 +1,21 @@
 #include "crpropa/module/EMInverseComptonScattering.h"
+#include "crpropa/DataTable.h"
+#include "crpropa/TableRegistry.h"
 #include "crpropa/Units.h"
 #include "crpropa/Random.h"
 #include "crpropa/Common.h"
 
-#include <fstream>
-#include <limits>
+#include <algorithm>
 #include <stdexcept>
 
 namespace crpropa {
 
 static const double mec2 = mass_electron * c_squared;
 
-EMInverseComptonScattering::EMInverseComptonScattering(ref_ptr<PhotonField> photonField, bool havePhotons, double thinning, double limit) {
-	setPhotonField(photonField);
-	setHavePhotons(havePhotons);
-	setLimit(limit);
-	setThinning(thinning);
-}
-
-void EMInverseComptonScattering::setPhotonField(ref_ptr<PhotonField> photonField) {
-	this->photonField = photonField;
-	std::string fname = photonField->getFieldName();
-	setDescription("EMInverseComptonScattering: " + fname);
-	initRate(getDataPath("EMInverseComptonScattering/rate_" + fname + ".txt"));
-	initCumulativeRate(getDataPath("EMInverseComptonScattering/cdf_" + fname + ".txt"));
-}
-
-void EMInverseComptonScattering::setHavePhotons(bool havePhotons) {
-	this->havePhotons = havePhotons;
-}
-
-void EMInverseComptonScattering::setLimit(double limit) {
-	this->limit = limit;
-}
-
-void EMInverseComptonScattering::setThinning(double thinning) {
-	this->thinning = thinning;
-}
-
-void EMInverseComptonScattering::initRate(std::string filename) {
-	std::ifstream infile(filename.c_str());
-
-	if (!infile.good())
-		throw std::runtime_error("EMInverseComptonScattering: could not open file " + filename);
-
-	// clear previously loaded tables
-	tabEnergy.clear();
-	tabRate.clear();
-
-	while (infile.good()) {
-		if (infile.peek() != '#') {
-			double a, b;
-			infile >> a >> b;
-			if (infile) {
-				tabEnergy.push_back(pow(10, a) * eV);
-				tabRate.push_back(b / Mpc);
-			}
-		}
-		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
-	}
-	infile.close();
-}
-
-void EMInverseComptonScattering::initCumulativeRate(std::string filename) {
-	std::ifstream infile(filename.c_str());
-
-	if (!infile.good())
-		throw std::runtime_error("EMInverseComptonScattering: could not open file " + filename);
-
-	// clear previously loaded tables
-	tabE.clear();
-	tabs.clear();
-	tabCDF.clear();
-	
-	// skip header
-	while (infile.peek() == '#')
-		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
-
-	// read s values in first line
-	double a;
-	infile >> a; // skip first value
-	while (infile.good() and (infile.peek() != '\n')) {
-		infile >> a;
-		tabs.push_back(pow(10, a) * eV * eV);
-	}
-
-	// read all following lines: E, cdf values
-	while (infile.good()) {
-		infile >> a;
-		if (!infile)
-			break;  // end of file
-		tabE.push_back(pow(10, a) * eV);
-		std::vector<double> cdf;
-		for (int i = 0; i < tabs.size(); i++) {
-			infile >> a;
-			cdf.push_back(a / Mpc);
-		}
-		tabCDF.push_back(cdf);
-	}
-	infile.close();
-}
-
 // Class to calculate the energy distribution of the ICS photon and to sample from it
 class ICSSecondariesEnergyDistribution {
 	private:
-		std::vector< std::vector<double> > data;
+		std::vector<DiscreteSampler> tabSampler; // alias tables of the cumulative distributions for each s
 		std::vector<double> s_values;
 		size_t Ns;
 		size_t Nrer;
@@ -126,11 +37,11 @@ class ICSSecondariesEnergyDistribution {
 			s_min = mec2 * mec2;
 			s_max = 1e23 * eV * eV;
 			dls = (log(s_max) - log(s_min)) / Ns;
-			data = std::vector< std::vector<double> >(1000, std::vector<double>(1000));
-			std::vector<double> data_i(1000);
+			tabSampler = std::vector<DiscreteSampler>(Ns);
+			std::vector<double> data_i(Nrer);
 
 			// tabulate s bin borders
-			s_values = std::vector<double>(1001);
+			s_values = std::vector<double>(Ns + 1);
 			for (size_t i = 0; i < Ns + 1; ++i)
 				s_values[i] = s_min * exp(i*dls);
 
@@ -150,16 +61,16 @@ class ICSSecondariesEnergyDistribution {
 					data_i[j] = dSigmadE(x, beta) * dx;
 					data_i[j] += data_i[j-1];
 				}
-				data[i] = data_i;
+				tabSampler[i].setCDF(data_i);
 			}
 		}
 
 		// draw random energy for the up-scattered photon Ep(Ee, s)
-		double sample(double Ee, double s) {
+		double sample(double Ee, double s) const {
 			size_t idx = std::lower_bound(s_values.begin(), s_values.end(), s) - s_values.begin();
-			std::vector<double> s0 = data[idx];
+			idx = std::min(idx, Ns - 1);
 			Random &random = Random::instance();
-			size_t j = random.randBin(s0) + 1; // draw random bin (upper bin boundary returned)
+			size_t j = tabSampler[idx].sample(random) + 1; // draw random bin (upper bin boundary returned)
 			double beta = (s - s_min) / (s + s_min);
 			double x0 = (1 - beta) / (1 + beta);
 			double dlx = -log(x0) / Nrer;
@@ -169,24 +80,105 @@ class ICSSecondariesEnergyDistribution {
 		}
 };
 
+// The distribution is shared by all instances and never modified after construction.
+// Initialization of the function-local static is thread-safe (C++11).
+static const ICSSecondariesEnergyDistribution &getSecondariesEnergyDistribution() {
+	static ICSSecondariesEnergyDistribution distribution;
+	return distribution;
+}
+
+EMInverseComptonScattering::EMInverseComptonScattering(ref_ptr<PhotonField> photonField, bool havePhotons, double thinning, double limit) {
+	setPhotonField(photonField);
+	setHavePhotons(havePhotons);
+	setLimit(limit);
+	setThinning(thinning);
+	getSecondariesEnergyDistribution(); // build the shared table now instead of during the first interaction
+}
+
+void EMInverseComptonScattering::setPhotonField(ref_ptr<PhotonField> photonField) {
+	this->photonField = photonField;
+	std::string fname = photonField->getFieldName();
+	setDescription("EMInverseComptonScattering: " + fname);
+	initRate(getDataPath("EMInverseComptonScattering/rate_" + fname + ".txt"));
+	initCumulativeRate(getDataPath("EMInverseComptonScattering/cdf_" + fname + ".txt"));
+}
+
+void EMInverseComptonScattering::setHavePhotons(bool havePhotons) {
+	this->havePhotons = havePhotons;
+}
+
+void EMInverseComptonScattering::setLimit(double limit) {
+	this->limit = limit;
+}
+
+void EMInverseComptonScattering::setThinning(double thinning) {
+	this->thinning = thinning;
+}
+
+EMInverseComptonScattering::RateTable::RateTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
+
+	for (size_t i = 0; i < table->rows(); i++) {
+		if (table->columns(i) < 2)
+			throw std::runtime_error("EMInverseComptonScattering: invalid line in " + filename);
+		tabEnergy.push_back(pow(10, (*table)(i, 0)) * eV);
+		tabRate.push_back((*table)(i, 1) / Mpc);
+	}
+
+	interpolation.setTable(tabEnergy, tabRate);
+}
+
+void EMInverseComptonScattering::initRate(std::string filename) {
+	rateTable = TableRegistry::get<RateTable>(filename);
+}
+
+EMInverseComptonScattering::CumulativeRateTable::CumulativeRateTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
+	if (table->rows() < 1)
+		throw std::runtime_error("EMInverseComptonScattering: no data in " + filename);
+
+	// first line: s values (skip first value)
+	for (size_t j = 1; j < table->columns(0); j++)
+		tabs.push_back(pow(10, (*table)(0, j)) * eV * eV);
+
+	// all following lines: E, cdf values
+	for (size_t i = 1; i < table->rows(); i++) {
+		if (table->columns(i) < tabs.size() + 1)
+			throw std::runtime_error("EMInverseComptonScattering: invalid line in " + filename);
+		const double *row = table->row(i);
+		tabE.push_back(pow(10, row[0]) * eV);
+		std::vector<double> cdf(tabs.size());
+		for (size_t j = 0; j < tabs.size(); j++)
+			cdf[j] = row[j + 1] / Mpc;
+		tabCDF.push_back(cdf);
+		tabSampler.push_back(DiscreteSampler());
+		tabSampler.back().setCDF(cdf);
+	}
+}
+
+void EMInverseComptonScattering::initCumulativeRate(std::string filename) {
+	cdfTable = TableRegistry::get<CumulativeRateTable>(filename);
+}
+
 void EMInverseComptonScattering::performInteraction(Candidate *candidate) const {
 	// scale the particle energy instead of background photons
 	double z = candidate->getRedshift();
 	double E = candidate->current.getEnergy() * (1 + z);
 
+	const std::vector<double> &tabE = cdfTable->tabE;
+	const std::vector<double> &tabs = cdfTable->tabs;
 	if (E < tabE.front() or E > tabE.back())
 		return;
 
 	// sample the value of s
 	Random &random = Random::instance();
 	size_t i = closestIndex(E, tabE);
-	size_t j = random.randBin(tabCDF[i]);
+	size_t j = cdfTable->tabSampler[i].sample(random);
 	double s_kin = pow(10, log10(tabs[j]) + (random.rand() - 0.5) * 0.1);
 	double s = s_kin + mec2 * mec2;
 
 	// sample electron energy after scattering
-	static ICSSecondariesEnergyDistribution distribution;
-	double Enew = distribution.sample(E, s);
+	double Enew = getSecondariesEnergyDistribution().sample(E, s);
 
 	// add up-scattered photon
 	double Esecondary = E - Enew;
@@ -213,11 +205,11 @@ void EMInverseComptonScattering::process(Candidate *candidate) const {
 	double z = candidate->getRedshift();
 	double E = candidate->current.getEnergy() * (1 + z);
 
-	if (E < tabEnergy.front() or (E > tabEnergy.back()))
+	if (E < rateTable->tabEnergy.front() or (E > rateTable->tabEnergy.back()))
 		return;
 
 	// interaction rate
-	double rate = interpolate(E, tabEnergy, tabRate);
+	double rate = rateTable->interpolation.interpolate(E);
 	rate *= pow_integer<2>(1 + z) * photonField->getRedshiftScaling(z);
 
 	// run this loop at least once to limit the step size
@@ -1,9 +1,10 @@
 #include "crpropa/module/EMPairProduction.h"
+#include "crpropa/DataTable.h"
+#include "crpropa/TableRegistry.h"
 #include "crpropa/Units.h"
 #include "crpropa/Random.h"
 
-#include <fstream>
-#include <limits>
+#include <algorithm>
 #include <stdexcept>
 
 
@@ -11,101 +12,11 @@ namespace crpropa {
 
 static const double mec2 = mass_electron * c_squared;
 
-EMPairProduction::EMPairProduction(ref_ptr<PhotonField> photonField, bool haveElectrons, double thinning, double limit) {
-	setPhotonField(photonField);
-	setThinning(thinning);
-	setLimit(limit);
-	setHaveElectrons(haveElectrons);
-}
-
-void EMPairProduction::setPhotonField(ref_ptr<PhotonField> photonField) {
-	this->photonField = photonField;
-	std::string fname = photonField->getFieldName();
-	setDescription("EMPairProduction: " + fname);
-	initRate(getDataPath("EMPairProduction/rate_" + fname + ".txt"));
-	initCumulativeRate(getDataPath("EMPairProduction/cdf_" + fname + ".txt"));
-}
-
-void EMPairProduction::setHaveElectrons(bool haveElectrons) {
-	this->haveElectrons = haveElectrons;
-}
-
-void EMPairProduction::setLimit(double limit) {
-	this->limit = limit;
-}
-
-void EMPairProduction::setThinning(double thinning) {
-	this->thinning = thinning;
-}
-
-void EMPairProduction::initRate(std::string filename) {
-	std::ifstream infile(filename.c_str());
-
-	if (!infile.good())
-		throw std::runtime_error("EMPairProduction: could not open file " + filename);
-
-	// clear previously loaded interaction rates
-	tabEnergy.clear();
-	tabRate.clear();
-
-	while (infile.good()) {
-		if (infile.peek() != '#') {
-			double a, b;
-			infile >> a >> b;
-			if (infile) {
-				tabEnergy.push_back(pow(10, a) * eV);
-				tabRate.push_back(b / Mpc);
-			}
-		}
-		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
-	}
-	infile.close();
-}
-
-void EMPairProduction::initCumulativeRate(std::string filename) {
-	std::ifstream infile(filename.c_str());
-
-	if (!infile.good())
-		throw std::runtime_error("EMPairProduction: could not open file " + filename);
-
-	// clear previously loaded tables
-	tabE.clear();
-	tabs.clear();
-	tabCDF.clear();
-	
-	// skip header
-	while (infile.peek() == '#')
-		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
-
-	// read s values in first line
-	double a;
-	infile >> a; // skip first value
-	while (infile.good() and (infile.peek() != '\n')) {
-		infile >> a;
-		tabs.push_back(pow(10, a) * eV * eV);
-	}
-
-	// read all following lines: E, cdf values
-	while (infile.good()) {
-		infile >> a;
-		if (!infile)
-			break;  // end of file
-		tabE.push_back(pow(10, a) * eV);
-		std::vector<double> cdf;
-		for (int i = 0; i < tabs.size(); i++) {
-			infile >> a;
-			cdf.push_back(a / Mpc);
-		}
-		tabCDF.push_back(cdf);
-	}
-	infile.close();
-}
-
 // Hold an data array to interpolate the energy distribution on
 class PPSecondariesEnergyDistribution {
 	private:
 		std::vector<double> tab_s;
-		std::vector< std::vector<double> > data;
+		std::vector<DiscreteSampler> tabSampler; // alias tables of the cumulative distributions for each s
 		size_t N;
 
 	public:
@@ -123,12 +34,13 @@ class PPSecondariesEnergyDistribution {
 			double s_min = 4 * mec2 * mec2;
 			double s_max = 1e23 * eV * eV;
 			double dls = log(s_max / s_min) / Ns;
-			data = std::vector< std::vector<double> >(Ns, std::vector<double>(N));
+			tabSampler = std::vector<DiscreteSampler>(Ns);
 			tab_s = std::vector<double>(Ns + 1);
 
 			for (size_t i = 0; i < Ns + 1; ++i)
 				tab_s[i] = s_min * exp(i*dls); // tabulate s bin borders
 
+			std::vector<double> data_i(N);
 			for (size_t i = 0; i < Ns; i++) {
 				double s = s_min * exp(i*dls + 0.5*dls);
 				double beta = sqrt(1 - s_min/s);
@@ -136,26 +48,25 @@ class PPSecondariesEnergyDistribution {
 				double dx = log((1 + beta) / (1 - beta)) / N;
 
 				// cumulative midpoint integration
-				std::vector<double> data_i(1000);
 				data_i[0] = dSigmadE_PPx(x0, beta) * expm1(dx);
 				for (size_t j = 1; j < N; j++) {
 					double x = x0 * exp(j*dx + 0.5*dx);
 					double binWidth = exp((j+1)*dx)-exp(j*dx);
 					data_i[j] = dSigmadE_PPx(x, beta) * binWidth + data_i[j-1];
 				}
-				data[i] = data_i;
+				tabSampler[i].setCDF(data_i);
 			}
 		}
 
 		// sample positron energy from cdf(E, s_kin)
-		double sample(double E0, double s) {
+		double sample(double E0, double s) const {
 			// get distribution for given s
 			size_t idx = std::lower_bound(tab_s.begin(), tab_s.end(), s) - tab_s.begin();
-			std::vector<double> s0 = data[idx];
+			idx = std::min(idx, tabSampler.size() - 1);
 
 			// draw random bin
 			Random &random = Random::instance();
-			size_t j = random.randBin(s0) + 1;
+			size_t j = tabSampler[idx].sample(random) + 1;
 
 			double s_min = 4. * mec2 * mec2;
 			double beta = sqrtl(1. - s_min / s);
@@ -169,6 +80,93 @@ class PPSecondariesEnergyDistribution {
 		}
 };
 
+// The distribution is shared by all instances and never modified after construction.
+// Initialization of the function-local static is thread-safe (C++11).
+static const PPSecondariesEnergyDistribution &getSecondariesEnergyDistribution() {
+	static PPSecondariesEnergyDistribution distribution;
+	return distribution;
+}
+
+EMPairProduction::EMPairProduction(ref_ptr<PhotonField> photonField, bool haveElectrons, double thinning, double limit) {
+	setThinning(thinning);
+	setLimit(limit);
+	setHaveElectrons(haveElectrons);
+	setPhotonField(photonField);
+}
+
+void EMPairProduction::setPhotonField(ref_ptr<PhotonField> photonField) {
+	this->photonField = photonField;
+	std::string fname = photonField->getFieldName();
+	setDescription("EMPairProduction: " + fname);
+	initRate(getDataPath("EMPairProduction/rate_" + fname + ".txt"));
+	cdfTable = 0;
+	if (haveElectrons)
+		initCumulativeRate(getDataPath("EMPairProduction/cdf_" + fname + ".txt"));
+}
+
+void EMPairProduction::setHaveElectrons(bool haveElectrons) {
+	this->haveElectrons = haveElectrons;
+	if (not haveElectrons)
+		return;
+	// the pair energies are only sampled with electrons, load the tables now instead of during the first interaction
+	getSecondariesEnergyDistribution();
+	if (photonField.valid() and not cdfTable.valid())
+		initCumulativeRate(getDataPath("EMPairProduction/cdf_" + photonField->getFieldName() + ".txt"));
+}
+
+void EMPairProduction::setLimit(double limit) {
+	this->limit = limit;
+}
+
+void EMPairProduction::setThinning(double thinning) {
+	this->thinning = thinning;
+}
+
+EMPairProduction::RateTable::RateTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
+
+	for (size_t i = 0; i < table->rows(); i++) {
+		if (table->columns(i) < 2)
+			throw std::runtime_error("EMPairProduction: invalid line in " + filename);
+		tabEnergy.push_back(pow(10, (*table)(i, 0)) * eV);
+		tabRate.push_back((*table)(i, 1) / Mpc);
+	}
+
+	interpolation.setTable(tabEnergy, tabRate);
+}
+
+void EMPairProduction::initRate(std::string filename) {
+	rateTable = TableRegistry::get<RateTable>(filename);
+}
+
+EMPairProduction::CumulativeRateTable::CumulativeRateTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
+	if (table->rows() < 1)
+		throw std::runtime_error("EMPairProduction: no data in " + filename);
+
+	// first line: s values (skip first value)
+	for (size_t j = 1; j < table->columns(0); j++)
+		tabs.push_back(pow(10, (*table)(0, j)) * eV * eV);
+
+	// all following lines: E, cdf values
+	for (size_t i = 1; i < table->rows(); i++) {
+		if (table->columns(i) < tabs.size() + 1)
+			throw std::runtime_error("EMPairProduction: invalid line in " + filename);
+		const double *row = table->row(i);
+		tabE.push_back(pow(10, row[0]) * eV);
+		std::vector<double> cdf(tabs.size());
+		for (size_t j = 0; j < tabs.size(); j++)
+			cdf[j] = row[j + 1] / Mpc;
+		tabCDF.push_back(cdf);
+		tabSampler.push_back(DiscreteSampler());
+		tabSampler.back().setCDF(cdf);
+	}
+}
+
+void EMPairProduction::initCumulativeRate(std::string filename) {
+	cdfTable = TableRegistry::get<CumulativeRateTable>(filename);
+}
+
 void EMPairProduction::performInteraction(Candidate *candidate) const {
 	// scale particle energy instead of background photon energy
 	double z = candidate->getRedshift();
@@ -182,20 +180,21 @@ void EMPairProduction::performInteraction(Candidate *candidate) const {
 		return;
 
 	// check if in tabulated energy range
+	const std::vector<double> &tabE = cdfTable->tabE;
+	const std::vector<double> &tabs = cdfTable->tabs;
 	if (E < tabE.front() or (E > tabE.back()))
 		return;
 
 	// sample the value of s
 	Random &random = Random::instance();
 	size_t i = closestIndex(E, tabE);  // find closest tabulation point
-	size_t j = random.randBin(tabCDF[i]);
+	size_t j = cdfTable->tabSampler[i].sample(random);
 	double lo = std::max(4 * mec2 * mec2, tabs[j-1]);  // first s-tabulation point below min(s_kin) = (2 me c^2)^2; ensure physical value
 	double hi = tabs[j];
 	double s = lo + random.rand() * (hi - lo);
 
 	// sample electron / positron energy
-	static PPSecondariesEnergyDistribution interpolation;
-	double Ee = interpolation.sample(E, s);
+	double Ee = getSecondariesEnergyDistribution().sample(E, s);
 	double Ep = E - Ee;
 	double f = Ep / E;
 
@@ -226,11 +225,11 @@ void EMPairProduction::process(Candidate *candidate) const {
 	double E = candidate->current.getEnergy() * (1 + z);
 
 	// check if in tabulated energy range
-	if ((E < tabEnergy.front()) or (E > tabEnergy.back()))
+	if ((E < rateTable->tabEnergy.front()) or (E > rateTable->tabEnergy.back()))
 		return;
 
 	// interaction rate
-	double rate = interpolate(E, tabEnergy, tabRate);
+	double rate = rateTable->interpolation.interpolate(E);
 	rate *= pow_integer<2>(1 + z) * photonField->getRedshiftScaling(z);
 
 	// run this loop at least once to limit the step size 
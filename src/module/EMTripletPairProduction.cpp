@@ -1,9 +1,9 @@
 #include "crpropa/module/EMTripletPairProduction.h"
+#include "crpropa/DataTable.h"
+#include "crpropa/TableRegistry.h"
 #include "crpropa/Units.h"
 #include "crpropa/Random.h"
 
-#include <fstream>
-#include <limits>
 #include <stdexcept>
 
 namespace crpropa {
@@ -37,68 +37,49 @@ void EMTripletPairProduction::setThinning(double thinning) {
 	this->thinning = thinning;
 }
 
-void EMTripletPairProduction::initRate(std::string filename) {
-	std::ifstream infile(filename.c_str());
-
-	if (!infile.good())
-		throw std::runtime_error("EMTripletPairProduction: could not open file " + filename);
-
-	// clear previously loaded interaction rates
-	tabEnergy.clear();
-	tabRate.clear();
-
-	while (infile.good()) {
-		if (infile.peek() != '#') {
-			double a, b;
-			infile >> a >> b;
-			if (infile) {
-				tabEnergy.push_back(pow(10, a) * eV);
-				tabRate.push_back(b / Mpc);
-			}
-		}
-		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
+EMTripletPairProduction::RateTable::RateTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
+
+	for (size_t i = 0; i < table->rows(); i++) {
+		if (table->columns(i) < 2)
+			throw std::runtime_error("EMTripletPairProduction: invalid line in " + filename);
+		tabEnergy.push_back(pow(10, (*table)(i, 0)) * eV);
+		tabRate.push_back((*table)(i, 1) / Mpc);
 	}
-	infile.close();
+
+	interpolation.setTable(tabEnergy, tabRate);
 }
 
-void EMTripletPairProduction::initCumulativeRate(std::string filename) {
-	std::ifstream infile(filename.c_str());
-
-	if (!infile.good())
-		throw std::runtime_error(
-				"EMTripletPairProduction: could not open file " + filename);
-
-	// clear previously loaded tables
-	tabE.clear();
-	tabs.clear();
-	tabCDF.clear();
-	
-	// skip header
-	while (infile.peek() == '#')
-		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
-
-	// read s values in first line
-	double a;
-	infile >> a; // skip first value
-	while (infile.good() and (infile.peek() != '\n')) {
-		infile >> a;
-		tabs.push_back(pow(10, a) * eV * eV);
-	}
+void EMTripletPairProduction::initRate(std::string filename) {
+	rateTable = TableRegistry::get<RateTable>(filename);
+}
 
-	// read all following lines: E, cdf values
-	while (infile.good()) {
-		infile >> a;
-		if (!infile)
-			break;  // end of file
-		tabE.push_back(pow(10, a) * eV);
-		std::vector<double> cdf;
-		for (int i = 0; i < tabs.size(); i++) {
-			infile >> a;
-			cdf.push_back(a / Mpc);
-		}
+EMTripletPairProduction::CumulativeRateTable::CumulativeRateTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
+	if (table->rows() < 1)
+		throw std::runtime_error("EMTripletPairProduction: no data in " + filename);
+
+	// first line: s values (skip first value)
+	for (size_t j = 1; j < table->columns(0); j++)
+		tabs.push_back(pow(10, (*table)(0, j)) * eV * eV);
+
+	// all following lines: E, cdf values
+	for (size_t i = 1; i < table->rows(); i++) {
+		if (table->columns(i) < tabs.size() + 1)
+			throw std::runtime_error("EMTripletPairProduction: invalid line in " + filename);
+		const double *row = table->row(i);
+		tabE.push_back(pow(10, row[0]) * eV);
+		std::vector<double> cdf(tabs.size());
+		for (size_t j = 0; j < tabs.size(); j++)
+			cdf[j] = row[j + 1] / Mpc;
 		tabCDF.push_back(cdf);
+		tabSampler.push_back(DiscreteSampler());
+		tabSampler.back().setCDF(cdf);
 	}
-	infile.close();
+}
+
+void EMTripletPairProduction::initCumulativeRate(std::string filename) {
+	cdfTable = TableRegistry::get<CumulativeRateTable>(filename);
 }
 
 void EMTripletPairProduction::performInteraction(Candidate *candidate) const {
@@ -110,13 +91,15 @@ void EMTripletPairProduction::performInteraction(Candidate *candidate) const {
 	double z = candidate->getRedshift();
 	double E = candidate->current.getEnergy() * (1 + z);
 
+	const std::vector<double> &tabE = cdfTable->tabE;
+	const std::vector<double> &tabs = cdfTable->tabs;
 	if (E < tabE.front() or E > tabE.back())
 		return;
 
 	// sample the value of eps
 	Random &random = Random::instance();
 	size_t i = closestIndex(E, tabE);
-	size_t j = random.randBin(tabCDF[i]);
+	size_t j = cdfTable->tabSampler[i].sample(random);
 	double s_kin = pow(10, log10(tabs[j]) + (random.rand() - 0.5) * 0.1);
 	double eps = s_kin / 4. / E; // random background photon energy
 
@@ -154,12 +137,12 @@ void EMTripletPairProduction::process(Candidate *candidate) const {
 	double E = (1 + z) * candidate->current.getEnergy();
 
 	// check if in tabulated energy range
-	if ((E < tabEnergy.front()) or (E > tabEnergy.back()))
+	if ((E < rateTable->tabEnergy.front()) or (E > rateTable->tabEnergy.back()))
 		return;
 
 	// cosmological scaling of interaction distance (comoving)
 	double scaling = pow_integer<2>(1 + z) * photonField->getRedshiftScaling(z);
-	double rate = scaling * interpolate(E, tabEnergy, tabRate);
+	double rate = scaling * rateTable->interpolation.interpolate(E);
 
 	// run this loop at least once to limit the step size
 	double step = candidate->getCurrentStep();
@@ -1,13 +1,12 @@
 #include "crpropa/module/ElasticScattering.h"
+#include "crpropa/DataTable.h"
+#include "crpropa/TableRegistry.h"
 #include "crpropa/Units.h"
 #include "crpropa/ParticleID.h"
 #include "crpropa/ParticleMass.h"
 #include "crpropa/Random.h"
 
 #include <cmath>
-#include <limits>
-#include <sstream>
-#include <fstream>
 #include <stdexcept>
 
 namespace crpropa {
@@ -31,52 +30,33 @@ void ElasticScattering::setPhotonField(ref_ptr<PhotonField> photonField) {
 	initCDF(getDataPath("ElasticScattering/cdf_" + fname.substr(0,3) + ".txt"));
 }
 
-void ElasticScattering::initRate(std::string filename) {
-	std::ifstream infile(filename.c_str());
-	if (not infile.good())
-		throw std::runtime_error("ElasticScattering: could not open file " + filename);
-
-	tabRate.clear();
-
-	while (infile.good()) {
-		if (infile.peek() == '#') {
-			infile.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-			continue;
-		}
-		double r;
-		infile >> r;
-		if (!infile)
-			break;
-		tabRate.push_back(r / Mpc);
-	}
+ElasticScattering::RateTable::RateTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
 
-	infile.close();
+	for (size_t i = 0; i < table->size(); i++)
+		tabRate.push_back(table->data()[i] / Mpc);
 }
 
-void ElasticScattering::initCDF(std::string filename) {
-	std::ifstream infile(filename.c_str());
-	if (not infile.good())
-		throw std::runtime_error("ElasticScattering: could not open file " + filename);
-
-	tabCDF.clear();
-	std::string line;
-	double a;
-	while (std::getline(infile, line)) {
-		if (line[0] == '#')
-			continue;
-
-		std::stringstream lineStream(line);
-		lineStream >> a;
-
-		std::vector<double> cdf(neps);
-		for (size_t i = 0; i < neps; i++) {
-			lineStream >> a;
-			cdf[i] = a;
-		}
+void ElasticScattering::initRate(std::string filename) {
+	rateTable = TableRegistry::get<RateTable>(filename);
+}
+
+ElasticScattering::CDFTable::CDFTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
+
+	for (size_t i = 0; i < table->rows(); i++) {
+		if (table->columns(i) < neps + 1)
+			throw std::runtime_error("ElasticScattering: invalid line in " + filename);
+		const double *row = table->row(i);
+		std::vector<double> cdf(row + 1, row + 1 + neps);
 		tabCDF.push_back(cdf);
+		tabSampler.push_back(DiscreteSampler());
+		tabSampler.back().setCDF(cdf);
 	}
+}
 
-	infile.close();
+void ElasticScattering::initCDF(std::string filename) {
+	cdfTable = TableRegistry::get<CDFTable>(filename);
 }
 
 void ElasticScattering::process(Candidate *candidate) const {
@@ -97,7 +77,7 @@ void ElasticScattering::process(Candidate *candidate) const {
 	double step = candidate->getCurrentStep();
 	while (step > 0) {
 
-		double rate = interpolateEquidistant(lg, lgmin, lgmax, tabRate);
+		double rate = interpolateEquidistant(lg, lgmin, lgmax, rateTable->tabRate);
 		rate *= Z * N / double(A);  // TRK scaling
 		rate *= pow_integer<2>(1 + z) * photonField->getRedshiftScaling(z);  // cosmological scaling
 
@@ -109,7 +89,7 @@ void ElasticScattering::process(Candidate *candidate) const {
 
 		// draw random background photon energy from CDF
 		size_t i = floor((lg - lgmin) / (lgmax - lgmin) * (nlg - 1)); // index of closest gamma tabulation point
-		size_t j = random.randBin(tabCDF[i]) - 1; // index of next lower tabulated eps value
+		size_t j = cdfTable->tabSampler[i].sample(random) - 1; // index of next lower tabulated eps value
 		double binWidth = (epsmax - epsmin) / (neps - 1); // logarithmic bin width
 		double eps = pow(10, epsmin + (j + random.rand()) * binWidth);
 
@@ -1,10 +1,11 @@
 #include "crpropa/module/ElectronPairProduction.h"
+#include "crpropa/DataTable.h"
+#include "crpropa/TableRegistry.h"
 #include "crpropa/Units.h"
 #include "crpropa/ParticleID.h"
 #include "crpropa/ParticleMass.h"
 #include "crpropa/Random.h"
 
-#include <fstream>
 #include <limits>
 #include <stdexcept>
 
@@ -12,9 +13,9 @@ namespace crpropa {
 
 ElectronPairProduction::ElectronPairProduction(ref_ptr<PhotonField> photonField,
 		bool haveElectrons, double limit) {
-	setPhotonField(photonField);
 	this->haveElectrons = haveElectrons;
 	this->limit = limit;
+	setPhotonField(photonField);
 }
 
 void ElectronPairProduction::setPhotonField(ref_ptr<PhotonField> photonField) {
@@ -22,59 +23,60 @@ void ElectronPairProduction::setPhotonField(ref_ptr<PhotonField> photonField) {
 	std::string fname = photonField->getFieldName();
 	setDescription("ElectronPairProduction: " + fname);
 	initRate(getDataPath("ElectronPairProduction/lossrate_" + fname + ".txt"));
-	initSpectrum(getDataPath("ElectronPairProduction/spectrum_" + fname.substr(0,3) + ".txt"));
+	spectrumTable = 0;
+	if (haveElectrons)
+		initSpectrum(getDataPath("ElectronPairProduction/spectrum_" + fname.substr(0,3) + ".txt"));
 }
 
 void ElectronPairProduction::setHaveElectrons(bool haveElectrons) {
 	this->haveElectrons = haveElectrons;
+	if (haveElectrons and not spectrumTable.valid())
+		initSpectrum(getDataPath("ElectronPairProduction/spectrum_" + photonField->getFieldName().substr(0,3) + ".txt"));
 }
 
 void ElectronPairProduction::setLimit(double limit) {
 	this->limit = limit;
 }
 
-void ElectronPairProduction::initRate(std::string filename) {
-	std::ifstream infile(filename.c_str());
-
-	if (!infile.good())
-		throw std::runtime_error("ElectronPairProduction: could not open file " + filename);
-
-	// clear previously loaded interaction rates
-	tabLorentzFactor.clear();
-	tabLossRate.clear();
-
-	while (infile.good()) {
-		if (infile.peek() != '#') {
-			double a, b;
-			infile >> a >> b;
-			if (infile) {
-				tabLorentzFactor.push_back(pow(10, a));
-				tabLossRate.push_back(b / Mpc);
-			}
-		}
-		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
+ElectronPairProduction::LossRateTable::LossRateTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
+
+	for (size_t i = 0; i < table->rows(); i++) {
+		if (table->columns(i) < 2)
+			throw std::runtime_error("ElectronPairProduction: invalid line in " + filename);
+		tabLorentzFactor.push_back(pow(10, (*table)(i, 0)));
+		tabLossRate.push_back((*table)(i, 1) / Mpc);
 	}
-	infile.close();
+
+	interpolation.setTable(tabLorentzFactor, tabLossRate);
 }
 
-void ElectronPairProduction::initSpectrum(std::string filename) {
-	std::ifstream infile(filename.c_str());
-	if (!infile.good())
-		throw std::runtime_error("ElectronPairProduction: could not open file " + filename);
+void ElectronPairProduction::initRate(std::string filename) {
+	lossRateTable = TableRegistry::get<LossRateTable>(filename);
+}
+
+ElectronPairProduction::SpectrumTable::SpectrumTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
+	if (table->size() < 70 * 170)
+		throw std::runtime_error("ElectronPairProduction: not enough data in " + filename);
 
-	double dNdE;
+	const double *dNdE = table->data();
 	tabSpectrum.resize(70);
+	tabSampler.resize(70);
 	for (size_t i = 0; i < 70; i++) {
 		tabSpectrum[i].resize(170);
 		for (size_t j = 0; j < 170; j++) {
-			infile >> dNdE;
-			tabSpectrum[i][j] = dNdE * pow(10, (7 + 0.1 * j)); // read electron distribution pdf(Ee) ~ dN/dEe * Ee
+			tabSpectrum[i][j] = dNdE[i * 170 + j] * pow(10, (7 + 0.1 * j)); // read electron distribution pdf(Ee) ~ dN/dEe * Ee
 		}
 		for (size_t j = 1; j < 170; j++) {
 			tabSpectrum[i][j] += tabSpectrum[i][j - 1]; // cdf(Ee), unnormalized
 		}
+		tabSampler[i].setCDF(tabSpectrum[i]);
 	}
-	infile.close();
+}
+
+void ElectronPairProduction::initSpectrum(std::string filename) {
+	spectrumTable = TableRegistry::get<SpectrumTable>(filename);
 }
 
 double ElectronPairProduction::lossLength(int id, double lf, double z) const {
@@ -83,14 +85,15 @@ double ElectronPairProduction::lossLength(int id, double lf, double z) const {
 		return std::numeric_limits<double>::max(); // no pair production on uncharged particles
 
 	lf *= (1 + z);
+	const std::vector<double> &tabLorentzFactor = lossRateTable->tabLorentzFactor;
 	if (lf < tabLorentzFactor.front())
 		return std::numeric_limits<double>::max(); // below energy threshold
 
 	double rate;
 	if (lf < tabLorentzFactor.back())
-		rate = interpolate(lf, tabLorentzFactor, tabLossRate); // interpolation
+		rate = lossRateTable->interpolation.interpolate(lf); // interpolation
 	else
-		rate = tabLossRate.back() * pow(lf / tabLorentzFactor.back(), -0.6); // extrapolation
+		rate = lossRateTable->tabLossRate.back() * pow(lf / tabLorentzFactor.back(), -0.6); // extrapolation
 
 	double A = nuclearMass(id) / mass_proton; // more accurate than massNumber(Id)
 	rate *= Z * Z / A * pow_integer<3>(1 + z) * photonField->getRedshiftScaling(z);
@@ -119,7 +122,7 @@ void ElectronPairProduction::process(Candidate *c) const {
 
 		// draw pairs as long as their energy is smaller than the pair production energy loss
 		while (dE > 0) {
-			size_t j = random.randBin(tabSpectrum[i]);
+			size_t j = spectrumTable->tabSampler[i].sample(random);
 			double Ee = pow(10, 6.95 + (j + random.rand()) * 0.1) * eV;
 			double Epair = 2 * Ee; // NOTE: electron and positron in general don't have same lab frame energy, but averaged over many draws the result is consistent
 			// if the remaining energy is not sufficient check for random accepting
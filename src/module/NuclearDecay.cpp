@@ -1,10 +1,12 @@
 #include "crpropa/module/NuclearDecay.h"
+#include "crpropa/DataTable.h"
+#include "crpropa/TableRegistry.h"
 #include "crpropa/Units.h"
 #include "crpropa/ParticleID.h"
 #include "crpropa/ParticleMass.h"
 #include "crpropa/Random.h"
 
-#include <fstream>
+#include <algorithm>
 #include <limits>
 #include <cmath>
 #include <stdexcept>
@@ -13,43 +15,39 @@
 
 namespace crpropa {
 
-NuclearDecay::NuclearDecay(bool electrons, bool photons, bool neutrinos, double l) {
+NuclearDecay::NuclearDecay(bool electrons, bool photons, bool neutrinos, double l, double thinning) {
 	haveElectrons = electrons;
 	havePhotons = photons;
 	haveNeutrinos = neutrinos;
 	limit = l;
+	setThinning(thinning);
 	setDescription("NuclearDecay");
 
 	// load decay table
-	std::string filename = getDataPath("nuclear_decay.txt");
-	std::ifstream infile(filename.c_str());
-	if (!infile.good())
-		throw std::runtime_error(
-				"crpropa::NuclearDecay: could not open file " + filename);
-
-	decayTable.resize(27 * 31);
-	std::string line;
-	while (std::getline(infile,line)) {
-		std::stringstream stream(line);
-		if (stream.peek() == '#')
-			continue;
+	decayTable = TableRegistry::get<DecayTable>(getDataPath("nuclear_decay.txt"));
+}
+
+NuclearDecay::DecayTable::DecayTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
+
+	decayModes.resize(27 * 31);
+	for (size_t i = 0; i < table->rows(); i++) {
+		// Z, N, channel, lifetime, (energy, intensity) of the emitted photons
+		size_t n = table->columns(i);
+		if (n < 4)
+			throw std::runtime_error("crpropa::NuclearDecay: invalid line in " + filename);
+		const double *row = table->row(i);
+		int Z = row[0];
+		int N = row[1];
 		DecayMode decay;
-		int Z, N;
-		double lifetime;
-		stream >> Z >> N >> decay.channel >> lifetime;
-		decay.rate = 1. / lifetime / c_light; // decay rate in [1/m]
-		std::vector<double> gamma;
-		double val;
-		while (stream >> val)
-			gamma.push_back(val);
-		for (int i = 0; i < gamma.size(); i += 2) {
-			decay.energy.push_back(gamma[i] * keV);
-			decay.intensity.push_back(gamma[i+1]);
+		decay.channel = row[2];
+		decay.rate = 1. / row[3] / c_light; // decay rate in [1/m]
+		for (size_t j = 4; j + 1 < n; j += 2) {
+			decay.energy.push_back(row[j] * keV);
+			decay.intensity.push_back(row[j + 1]);
 		}
-		if (infile)
-			decayTable[Z * 31 + N].push_back(decay);
+		decayModes[Z * 31 + N].push_back(decay);
 	}
-	infile.close();
 }
 
 void NuclearDecay::setHaveElectrons(bool b) {
@@ -68,6 +66,36 @@ void NuclearDecay::setLimit(double l) {
 	limit = l;
 }
 
+void NuclearDecay::setThinning(double thinning) {
+	electronThinning = thinning;
+	photonThinning = thinning;
+	neutrinoThinning = thinning;
+}
+
+void NuclearDecay::setElectronThinning(double thinning) {
+	electronThinning = thinning;
+}
+
+void NuclearDecay::setPhotonThinning(double thinning) {
+	photonThinning = thinning;
+}
+
+void NuclearDecay::setNeutrinoThinning(double thinning) {
+	neutrinoThinning = thinning;
+}
+
+double NuclearDecay::getElectronThinning() const {
+	return electronThinning;
+}
+
+double NuclearDecay::getPhotonThinning() const {
+	return photonThinning;
+}
+
+double NuclearDecay::getNeutrinoThinning() const {
+	return neutrinoThinning;
+}
+
 void NuclearDecay::process(Candidate *candidate) const {
 	// the loop should be processed at least once for limiting the next step
 	double step = candidate->getCurrentStep();
@@ -83,7 +111,7 @@ void NuclearDecay::process(Candidate *candidate) const {
 		int N = A - Z;
 
 		// check if particle can decay
-		const std::vector<DecayMode> &decays = decayTable[Z * 31 + N];
+		const std::vector<DecayMode> &decays = decayTable->decayModes[Z * 31 + N];
 		if (decays.size() == 0)
 			return;
 
@@ -147,7 +175,7 @@ void NuclearDecay::gammaEmission(Candidate *candidate, int channel) const {
 	int N = massNumber(id) - Z;
 
 	// get photon energies and emission probabilities for decay channel
-	const std::vector<DecayMode> &decays = decayTable[Z * 31 + N];
+	const std::vector<DecayMode> &decays = decayTable->decayModes[Z * 31 + N];
 	size_t idecay = decays.size();
 	while (idecay-- != 0) {
 		if (decays[idecay].channel == channel)
@@ -163,6 +191,7 @@ void NuclearDecay::gammaEmission(Candidate *candidate, int channel) const {
 
 	Random &random = Random::instance();
 	Vector3d pos = random.randomInterpolatedPosition(candidate->previous.getPosition(), candidate->current.getPosition());
+	double E0 = candidate->current.getEnergy();
 
 	for (int i = 0; i < energy.size(); ++i) {
 		// check if photon of specific energy is emitted
@@ -171,7 +200,7 @@ void NuclearDecay::gammaEmission(Candidate *candidate, int channel) const {
 		// create secondary photon; boost to lab frame
 		double cosTheta = 2 * random.rand() - 1;
 		double E = energy[i] * candidate->current.getLorentzFactor() * (1. - cosTheta);
-		candidate->addSecondary(22, E, pos);
+		candidate->addThinnedSecondary(22, E, pos, E / E0, photonThinning);
 	}
 }
 
@@ -246,10 +275,11 @@ void NuclearDecay::betaDecay(Candidate *candidate, bool isBetaPlus) const {
 	double Enu = gamma * (Q + me - E) * (1 + cosTheta);  // pnu*c ~ Enu
 
 	Vector3d pos = random.randomInterpolatedPosition(candidate->previous.getPosition(), candidate->current.getPosition());
+	double E0 = candidate->current.getEnergy();
 	if (haveElectrons)
-		candidate->addSecondary(electronId, Ee, pos);
+		candidate->addThinnedSecondary(electronId, Ee, pos, Ee / E0, electronThinning);
 	if (haveNeutrinos)
-		candidate->addSecondary(neutrinoId, Enu, pos);
+		candidate->addThinnedSecondary(neutrinoId, Enu, pos, Enu / E0, neutrinoThinning);
 }
 
 void NuclearDecay::nucleonEmission(Candidate *candidate, int dA, int dZ) const {
@@ -293,7 +323,7 @@ double NuclearDecay::meanFreePath(int id, double gamma) {
 	int N = A - Z;
 
 	// check if particle can decay
-	const std::vector<DecayMode> &decays = decayTable[Z * 31 + N];
+	const std::vector<DecayMode> &decays = decayTable->decayModes[Z * 31 + N];
 	if (decays.size() == 0)
 		return std::numeric_limits<double>::max();
 
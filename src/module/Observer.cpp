@@ -108,8 +108,13 @@ DetectionState ObserverSmallSphere::checkDetection(Candidate *candidate) const {
 	// current distance to observer sphere center
 	double d = (candidate->current.getPosition() - center).getR();
 
-	// conservatively limit next step to prevent overshooting
-	candidate->limitNextStep(sqrt(fabs(d*d - radius*radius)));
+	// conservatively limit next step to prevent overshooting,
+	// neutral particles move on straight lines up to the next crossing
+	if (candidate->current.getCharge() == 0)
+		candidate->limitNextStep(Sphere(center, radius).intersectionDistance(
+				candidate->current.getPosition(), candidate->current.getDirection()));
+	else
+		candidate->limitNextStep(sqrt(fabs(d*d - radius*radius)));
 
 	// no detection if outside of observer sphere
 	if (d > radius)
@@ -187,8 +192,13 @@ DetectionState ObserverLargeSphere::checkDetection(Candidate *candidate) const {
 	// current distance to observer sphere center
 	double d = (candidate->current.getPosition() - center).getR();
 
-	// conservatively limit next step size to prevent overshooting
-	candidate->limitNextStep(fabs(radius - d));
+	// conservatively limit next step size to prevent overshooting,
+	// neutral particles move on straight lines up to the next crossing
+	if (candidate->current.getCharge() == 0)
+		candidate->limitNextStep(Sphere(center, radius).intersectionDistance(
+				candidate->current.getPosition(), candidate->current.getDirection()));
+	else
+		candidate->limitNextStep(fabs(radius - d));
 
 	// no detection if inside observer sphere
 	if (d < radius)
@@ -410,7 +420,12 @@ DetectionState ObserverSurface::checkDetection(Candidate *candidate) const
 {
 		double currentDistance = surface->distance(candidate->current.getPosition());
 		double previousDistance = surface->distance(candidate->previous.getPosition());
-		candidate->limitNextStep(fabs(currentDistance));
+		// neutral particles move on straight lines up to the next crossing
+		if (candidate->current.getCharge() == 0)
+			candidate->limitNextStep(surface->intersectionDistance(
+					candidate->current.getPosition(), candidate->current.getDirection()));
+		else
+			candidate->limitNextStep(fabs(currentDistance));
 
 		if (currentDistance * previousDistance > 0)
 			return NOTHING;
@@ -1,14 +1,15 @@
 #include "crpropa/module/PhotoDisintegration.h"
+#include "crpropa/DataTable.h"
+#include "crpropa/TableRegistry.h"
 #include "crpropa/Units.h"
 #include "crpropa/ParticleID.h"
 #include "crpropa/ParticleMass.h"
 #include "crpropa/Random.h"
 #include "kiss/logger.h"
 
+#include <algorithm>
 #include <cmath>
 #include <limits>
-#include <sstream>
-#include <fstream>
 #include <stdexcept>
 
 namespace crpropa {
@@ -17,10 +18,11 @@ const double PhotoDisintegration::lgmin = 6;  // minimum log10(Lorentz-factor)
 const double PhotoDisintegration::lgmax = 14; // maximum log10(Lorentz-factor)
 const size_t PhotoDisintegration::nlg = 201;  // number of Lorentz-factor steps
 
-PhotoDisintegration::PhotoDisintegration(ref_ptr<PhotonField> f, bool havePhotons, double limit) {
-	setPhotonField(f);
+PhotoDisintegration::PhotoDisintegration(ref_ptr<PhotonField> f, bool havePhotons, double limit, double thinning) {
 	this->havePhotons = havePhotons;
 	this->limit = limit;
+	this->thinning = thinning;
+	setPhotonField(f);
 }
 
 void PhotoDisintegration::setPhotonField(ref_ptr<PhotonField> photonField) {
@@ -29,120 +31,99 @@ void PhotoDisintegration::setPhotonField(ref_ptr<PhotonField> photonField) {
 	setDescription("PhotoDisintegration: " + fname);
 	initRate(getDataPath("Photodisintegration/rate_" + fname + ".txt"));
 	initBranching(getDataPath("Photodisintegration/branching_" + fname + ".txt"));
-	initPhotonEmission(getDataPath("Photodisintegration/photon_emission_" + fname.substr(0,3) + ".txt"));
+	photonEmissionTable = 0;
+	if (havePhotons)
+		initPhotonEmission(getDataPath("Photodisintegration/photon_emission_" + fname.substr(0,3) + ".txt"));
 }
 
 void PhotoDisintegration::setHavePhotons(bool havePhotons) {
 	this->havePhotons = havePhotons;
+	if (havePhotons and not photonEmissionTable.valid())
+		initPhotonEmission(getDataPath("Photodisintegration/photon_emission_" + photonField->getFieldName().substr(0,3) + ".txt"));
 }
 
 void PhotoDisintegration::setLimit(double limit) {
 	this->limit = limit;
 }
 
-void PhotoDisintegration::initRate(std::string filename) {
-	std::ifstream infile(filename.c_str());
-	if (not infile.good())
-		throw std::runtime_error("PhotoDisintegration: could not open file " + filename);
+void PhotoDisintegration::setThinning(double thinning) {
+	this->thinning = thinning;
+}
 
-	// clear previously loaded interaction rates
-	pdRate.clear();
-	pdRate.resize(27 * 31);
+double PhotoDisintegration::getThinning() const {
+	return thinning;
+}
 
-	std::string line;
-	while (std::getline(infile, line)) {
-		if (line[0] == '#')
-			continue;
-		std::stringstream lineStream(line);
+PhotoDisintegration::RateTable::RateTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
 
-		int Z, N;
-		lineStream >> Z;
-		lineStream >> N;
+	pdRate.resize(27 * 31);
 
-		double r;
-		for (size_t i = 0; i < nlg; i++) {
-			lineStream >> r;
-			pdRate[Z * 31 + N].push_back(r / Mpc);
-		}
+	for (size_t i = 0; i < table->rows(); i++) {
+		// Z, N, rates
+		if (table->columns(i) < 2 + nlg)
+			throw std::runtime_error("PhotoDisintegration: invalid line in " + filename);
+		const double *row = table->row(i);
+		int Z = row[0];
+		int N = row[1];
+		for (size_t j = 0; j < nlg; j++)
+			pdRate[Z * 31 + N].push_back(row[2 + j] / Mpc);
 	}
-	infile.close();
 }
 
-void PhotoDisintegration::initBranching(std::string filename) {
-	std::ifstream infile(filename.c_str());
-	if (not infile.good())
-		throw std::runtime_error("PhotoDisintegration: could not open file " + filename);
-
-	// clear previously loaded interaction rates
-	pdBranch.clear();
-	pdBranch.resize(27 * 31);
+void PhotoDisintegration::initRate(std::string filename) {
+	rateTable = TableRegistry::get<RateTable>(filename);
+}
 
-	std::string line;
-	while (std::getline(infile, line)) {
-		if (line[0] == '#')
-			continue;
+PhotoDisintegration::BranchingTable::BranchingTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
 
-		std::stringstream lineStream(line);
+	pdBranch.resize(27 * 31);
 
-		int Z, N;
-		lineStream >> Z;
-		lineStream >> N;
+	for (size_t i = 0; i < table->rows(); i++) {
+		// Z, N, channel, branching ratios
+		if (table->columns(i) < 3 + nlg)
+			throw std::runtime_error("PhotoDisintegration: invalid line in " + filename);
+		const double *row = table->row(i);
+		int Z = row[0];
+		int N = row[1];
 
 		Branch branch;
-		lineStream >> branch.channel;
-
-		double r;
-		for (size_t i = 0; i < nlg; i++) {
-			lineStream >> r;
-			branch.branchingRatio.push_back(r);
-		}
+		branch.channel = row[2];
+		branch.branchingRatio.assign(row + 3, row + 3 + nlg);
 
 		pdBranch[Z * 31 + N].push_back(branch);
 	}
-
-	infile.close();
 }
 
-void PhotoDisintegration::initPhotonEmission(std::string filename) {
-	std::ifstream infile(filename.c_str());
-	if (not infile.good())
-		throw std::runtime_error("PhotoDisintegration: could not open file " + filename);
-
-	// clear previously loaded emission probabilities
-	pdPhoton.clear();
-
-	std::string line;
-	while (std::getline(infile, line)) {
-		if (line[0] == '#')
-			continue;
+void PhotoDisintegration::initBranching(std::string filename) {
+	branchingTable = TableRegistry::get<BranchingTable>(filename);
+}
 
-		std::stringstream lineStream(line);
+PhotoDisintegration::PhotonEmissionTable::PhotonEmissionTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
 
-		int Z, N, Zd, Nd;
-		lineStream >> Z;
-		lineStream >> N;
-		lineStream >> Zd;
-		lineStream >> Nd;
+	for (size_t i = 0; i < table->rows(); i++) {
+		// Z, N, Zd, Nd, photon energy, emission probabilities
+		if (table->columns(i) < 5 + nlg)
+			throw std::runtime_error("PhotoDisintegration: invalid line in " + filename);
+		const double *row = table->row(i);
+		int Z = row[0];
+		int N = row[1];
+		int Zd = row[2];
+		int Nd = row[3];
 
 		PhotonEmission em;
-		lineStream >> em.energy;
-		em.energy *= eV;
-
-		double r;
-		for (size_t i = 0; i < nlg; i++) {
-			lineStream >> r;
-			em.emissionProbability.push_back(r);
-		}
+		em.energy = row[4] * eV;
+		em.emissionProbability.assign(row + 5, row + 5 + nlg);
 
 		int key = Z * 1000000 + N * 10000 + Zd * 100 + Nd;
-		if (pdPhoton.find(key) == pdPhoton.end()) {
-			std::vector<PhotonEmission> emissions;
-			pdPhoton[key] = emissions;
-		}
 		pdPhoton[key].push_back(em);
 	}
+}
 
-	infile.close();
+void PhotoDisintegration::initPhotonEmission(std::string filename) {
+	photonEmissionTable = TableRegistry::get<PhotonEmissionTable>(filename);
 }
 
 void PhotoDisintegration::process(Candidate *candidate) const {
@@ -162,7 +143,8 @@ void PhotoDisintegration::process(Candidate *candidate) const {
 		// check if disintegration data available
 		if ((Z > 26) or (N > 30))
 			return;
-		if (pdRate[idx].size() == 0)
+		const std::vector<double> &pdRate = rateTable->pdRate[idx];
+		if (pdRate.size() == 0)
 			return;
 
 		// check if in tabulated energy range
@@ -171,7 +153,7 @@ void PhotoDisintegration::process(Candidate *candidate) const {
 		if ((lg <= lgmin) or (lg >= lgmax))
 			return;
 
-		double rate = interpolateEquidistant(lg, lgmin, lgmax, pdRate[idx]);
+		double rate = interpolateEquidistant(lg, lgmin, lgmax, pdRate);
 		rate *= pow_integer<2>(1 + z) * photonField->getRedshiftScaling(z); // cosmological scaling, rate per comoving distance
 
 		// check if interaction occurs in this step
@@ -184,7 +166,7 @@ void PhotoDisintegration::process(Candidate *candidate) const {
 		}
 
 		// select channel and interact
-		const std::vector<Branch> &branches = pdBranch[idx];
+		const std::vector<Branch> &branches = branchingTable->pdBranch[idx];
 		double cmp = random.rand();
 		int l = round((lg - lgmin) / (lgmax - lgmin) * (nlg - 1)); // index of closest tabulation point
 		size_t i = 0;
@@ -254,19 +236,25 @@ void PhotoDisintegration::performInteraction(Candidate *candidate, int channel)
 	double z = candidate->getRedshift();
 	double lg = log10(candidate->current.getLorentzFactor() * (1 + z));
 	double lf = candidate->current.getLorentzFactor();
+	double E0 = candidate->current.getEnergy();
 
 	int l = round((lg - lgmin) / (lgmax - lgmin) * (nlg - 1));  // index of closest tabulation point
 	int key = Z*1e6 + (A-Z)*1e4 + (Z+dZ)*1e2 + (A+dA) - (Z+dZ);
 
-	for (int i = 0; i < pdPhoton[key].size(); i++) {
+	std::map<int, std::vector<PhotonEmission> >::const_iterator it = photonEmissionTable->pdPhoton.find(key);
+	if (it == photonEmissionTable->pdPhoton.end())
+		return;
+	const std::vector<PhotonEmission> &emissions = it->second;
+
+	for (size_t i = 0; i < emissions.size(); i++) {
 		// check for random emission
-		if (random.rand() > pdPhoton[key][i].emissionProbability[l])
+		if (random.rand() > emissions[i].emissionProbability[l])
 			continue;
 
 		// boost to lab frame
 		double cosTheta = 2 * random.rand() - 1;
-		double E = pdPhoton[key][i].energy * lf * (1 - cosTheta);
-		candidate->addSecondary(22, E, pos);
+		double E = emissions[i].energy * lf * (1 - cosTheta);
+		candidate->addThinnedSecondary(22, E, pos, E / E0, thinning);
 	}
 }
 
@@ -283,7 +271,7 @@ double PhotoDisintegration::lossLength(int id, double gamma, double z) {
 	// check if disintegration data available
 	if ((Z > 26) or (N > 30))
 		return std::numeric_limits<double>::max();
-	const std::vector<double> &rate = pdRate[idx];
+	const std::vector<double> &rate = rateTable->pdRate[idx];
 	if (rate.size() == 0)
 		return std::numeric_limits<double>::max();
 
@@ -300,7 +288,7 @@ double PhotoDisintegration::lossLength(int id, double gamma, double z) {
 
 	// average number of nucleons lost for all disintegration channels
 	double avg_dA = 0;
-	const std::vector<Branch> &branches = pdBranch[idx];
+	const std::vector<Branch> &branches = branchingTable->pdBranch[idx];
 	for (size_t i = 0; i < branches.size(); i++) {
 		int channel = branches[i].channel;
 		int dA = 0;
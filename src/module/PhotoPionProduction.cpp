@@ -1,4 +1,6 @@
 #include "crpropa/module/PhotoPionProduction.h"
+#include "crpropa/DataTable.h"
+#include "crpropa/TableRegistry.h"
 #include "crpropa/Units.h"
 #include "crpropa/ParticleID.h"
 #include "crpropa/Random.h"
@@ -7,10 +9,9 @@
 #include "kiss/logger.h"
 #include "sophia.h"
 
+#include <algorithm>
 #include <limits>
 #include <cmath>
-#include <sstream>
-#include <fstream>
 #include <stdexcept>
 
 namespace crpropa {
@@ -22,6 +23,7 @@ PhotoPionProduction::PhotoPionProduction(ref_ptr<PhotonField> field, bool photon
 	haveAntiNucleons = antiNucleons;
 	haveRedshiftDependence = redshift;
 	limit = l;
+	setThinning(0);
 	setPhotonField(field);
 }
 
@@ -71,28 +73,40 @@ void PhotoPionProduction::setLimit(double l) {
 	limit = l;
 }
 
-void PhotoPionProduction::initRate(std::string filename) {
-	// clear previously loaded tables
-	tabLorentz.clear();
-	tabRedshifts.clear();
-	tabProtonRate.clear();
-	tabNeutronRate.clear();
+void PhotoPionProduction::setThinning(double thinning) {
+	photonThinning = thinning;
+	neutrinoThinning = thinning;
+	electronThinning = thinning;
+}
+
+void PhotoPionProduction::setPhotonThinning(double thinning) {
+	photonThinning = thinning;
+}
 
-	std::ifstream infile(filename.c_str());
-	if (!infile.good())
-		throw std::runtime_error("PhotoPionProduction: could not open file " + filename);
+void PhotoPionProduction::setNeutrinoThinning(double thinning) {
+	neutrinoThinning = thinning;
+}
 
-	if (haveRedshiftDependence) {
+void PhotoPionProduction::setElectronThinning(double thinning) {
+	electronThinning = thinning;
+}
+
+PhotoPionProduction::RateTable::RateTable(const std::string &filename) {
+	ref_ptr<DataTable> table = DataTable::load(filename);
+	if (table->rows() < 1)
+		throw std::runtime_error("PhotoPionProduction: no data in " + filename);
+
+	// tables with redshift dependence have an additional first column
+	size_t nColumns = table->columns(0);
+	for (size_t i = 0; i < table->rows(); i++)
+		if ((nColumns < 3) or (table->columns(i) != nColumns))
+			throw std::runtime_error("PhotoPionProduction: invalid line in " + filename);
+
+	if (nColumns > 3) {
 		double zOld = -1, aOld = -1;
-		while (infile.good()) {
-			if (infile.peek() == '#') {
-				infile.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				continue;
-			}
-			double z, a, b, c;
-			infile >> z >> a >> b >> c;
-			if (!infile)
-				break;
+		for (size_t i = 0; i < table->rows(); i++) {
+			const double *row = table->row(i);
+			double z = row[0], a = row[1];
 			if (z > zOld) {
 				tabRedshifts.push_back(z);
 				zOld = z;
@@ -101,30 +115,31 @@ void PhotoPionProduction::initRate(std::string filename) {
 				tabLorentz.push_back(pow(10, a));
 				aOld = a;
 			}
-			tabProtonRate.push_back(b / Mpc);
-			tabNeutronRate.push_back(c / Mpc);
+			tabProtonRate.push_back(row[2] / Mpc);
+			tabNeutronRate.push_back(row[3] / Mpc);
 		}
 	} else {
-		while (infile.good()) {
-			if (infile.peek() == '#') {
-				infile.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				continue;
-			}
-			double a, b, c;
-			infile >> a >> b >> c;
-			if (!infile)
-				break;
-			tabLorentz.push_back(pow(10, a));
-			tabProtonRate.push_back(b / Mpc);
-			tabNeutronRate.push_back(c / Mpc);
+		for (size_t i = 0; i < table->rows(); i++) {
+			const double *row = table->row(i);
+			tabLorentz.push_back(pow(10, row[0]));
+			tabProtonRate.push_back(row[1] / Mpc);
+			tabNeutronRate.push_back(row[2] / Mpc);
 		}
+		protonRate.setTable(tabLorentz, tabProtonRate);
+		neutronRate.setTable(tabLorentz, tabNeutronRate);
 	}
+}
 
-	infile.close();
+void PhotoPionProduction::initRate(std::string filename) {
+	ref_ptr<const RateTable> table = TableRegistry::get<RateTable>(filename);
+	if (haveRedshiftDependence == table->tabRedshifts.empty())
+		throw std::runtime_error("PhotoPionProduction: redshift dependence of " + filename + " does not match the module setting");
+	rateTable = table;
 }
 
 double PhotoPionProduction::nucleonMFP(double gamma, double z, bool onProton) const {
-	const std::vector<double> &tabRate = (onProton)? tabProtonRate : tabNeutronRate;
+	const std::vector<double> &tabLorentz = rateTable->tabLorentz;
+	const std::vector<double> &tabRate = (onProton)? rateTable->tabProtonRate : rateTable->tabNeutronRate;
 
 	// scale nucleus energy instead of background photon energy
 	gamma *= (1 + z);
@@ -133,9 +148,9 @@ double PhotoPionProduction::nucleonMFP(double gamma, double z, bool onProton) co
 
 	double rate;
 	if (haveRedshiftDependence)
-		rate = interpolate2d(z, gamma, tabRedshifts, tabLorentz, tabRate);
+		rate = interpolate2d(z, gamma, rateTable->tabRedshifts, tabLorentz, tabRate);
 	else
-		rate = interpolate(gamma, tabLorentz, tabRate) * photonField->getRedshiftScaling(z);
+		rate = (onProton ? rateTable->protonRate : rateTable->neutronRate).interpolate(gamma) * photonField->getRedshiftScaling(z);
 
 	// cosmological scaling
 	rate *= pow_integer<2>(1 + z);
@@ -267,31 +282,31 @@ void PhotoPionProduction::performInteraction(Candidate *candidate, bool onProton
 			break;
 		case 1: // photon
 			if (havePhotons)
-				candidate->addSecondary(22, Eout, pos);
+				candidate->addThinnedSecondary(22, Eout, pos, Eout / EpA, photonThinning);
 			break;
 		case 2: // positron
 			if (haveElectrons)
-				candidate->addSecondary(sign * -11, Eout, pos);
+				candidate->addThinnedSecondary(sign * -11, Eout, pos, Eout / EpA, electronThinning);
 			break;
 		case 3: // electron
 			if (haveElectrons)
-				candidate->addSecondary(sign * 11, Eout, pos);
+				candidate->addThinnedSecondary(sign * 11, Eout, pos, Eout / EpA, electronThinning);
 			break;
 		case 15: // nu_e
 			if (haveNeutrinos)
-				candidate->addSecondary(sign * 12, Eout, pos);
+				candidate->addThinnedSecondary(sign * 12, Eout, pos, Eout / EpA, neutrinoThinning);
 			break;
 		case 16: // anti-nu_e
 			if (haveNeutrinos)
-				candidate->addSecondary(sign * -12, Eout, pos);
+				candidate->addThinnedSecondary(sign * -12, Eout, pos, Eout / EpA, neutrinoThinning);
 			break;
 		case 17: // nu_mu
 			if (haveNeutrinos)
-				candidate->addSecondary(sign * 14, Eout, pos);
+				candidate->addThinnedSecondary(sign * 14, Eout, pos, Eout / EpA, neutrinoThinning);
 			break;
 		case 18: // anti-nu_mu
 			if (haveNeutrinos)
-				candidate->addSecondary(sign * -14, Eout, pos);
+				candidate->addThinnedSecondary(sign * -14, Eout, pos, Eout / EpA, neutrinoThinning);
 			break;
 		default:
 			throw std::runtime_error("PhotoPionProduction: unexpected particle " + kiss::str(pType));
@@ -355,6 +370,10 @@ double PhotoPionProduction::lossLength(int id, double gamma, double z) {
 	return 1. / lossRate;
 }
 
+double PhotoPionProduction::totalCrossSection(double epsPrime, bool onProton) {
+	return crossection(epsPrime / GeV, onProton) * 1e-34; // mubarn -> m^2
+}
+
 SophiaEventOutput PhotoPionProduction::sophiaEvent(bool onProton, double Ein, double eps) const {
 	// SOPHIA - input:
 	int nature = 1 - static_cast<int>(onProton);  // 0=proton, 1=neutron
@@ -490,7 +509,7 @@ double PhotoPionProduction::momentum(bool onProton, double Ein) const {
 	return momentumHadron;
 }
 
-double PhotoPionProduction::crossection(double eps, bool onProton) const {
+double PhotoPionProduction::crossection(double eps, bool onProton) {
 	const double m = mass(onProton);
 	const double s = m * m + 2. * m * eps;
 	if (s < sMin())
@@ -571,7 +590,7 @@ double PhotoPionProduction::crossection(double eps, bool onProton) const {
 	return cross_res + cross_dir + cs_multidiff + cross_frag2;
 }
 
-double PhotoPionProduction::Pl(double eps, double epsTh, double epsMax, double alpha) const {
+double PhotoPionProduction::Pl(double eps, double epsTh, double epsMax, double alpha) {
 	if (epsTh > eps)
 		return 0.;
 	const double a = alpha * epsMax / epsTh;
@@ -580,7 +599,7 @@ double PhotoPionProduction::Pl(double eps, double epsTh, double epsMax, double a
 	return prod1 * prod2;
 }
 
-double PhotoPionProduction::Ef(double eps, double epsTh, double w) const {
+double PhotoPionProduction::Ef(double eps, double epsTh, double w) {
 	const double wTh = w + epsTh;
 	if (eps <= epsTh) {
 		return 0.;
@@ -593,7 +612,7 @@ double PhotoPionProduction::Ef(double eps, double epsTh, double w) const {
 	}
 }
 
-double PhotoPionProduction::breitwigner(double sigma0, double gamma, double DMM, double epsPrime, bool onProton) const {
+double PhotoPionProduction::breitwigner(double sigma0, double gamma, double DMM, double epsPrime, bool onProton) {
 	const double m = mass(onProton);
 	const double s = m * m + 2. * m * epsPrime;
 	const double gam2s = gamma * gamma * s;
@@ -608,12 +627,12 @@ double PhotoPionProduction::functs(double s, bool onProton) const {
 	return factor * sigmaPg;
 }
 
-double PhotoPionProduction::mass(bool onProton) const {
+double PhotoPionProduction::mass(bool onProton) {
 	const double m =  onProton ? mass_proton : mass_neutron;
 	return m / GeV * c_squared;
 }
 
-double PhotoPionProduction::sMin() const {
+double PhotoPionProduction::sMin() {
 	return 1.1646; // [GeV^2] head-on collision
 }
 
@@ -661,4 +680,16 @@ double PhotoPionProduction::getCorrectionFactor() const {
 	return correctionFactor;
 }
 
+double PhotoPionProduction::getPhotonThinning() const {
+	return photonThinning;
+}
+
+double PhotoPionProduction::getNeutrinoThinning() const {
+	return neutrinoThinning;
+}
+
+double PhotoPionProduction::getElectronThinning() const {
+	return electronThinning;
+}
+
 } // namespace crpropa
@@ -1,5 +1,7 @@
 #include "crpropa/module/PropagationBP.h"
 
+#include <algorithm>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
 #include <vector>
@@ -41,7 +43,7 @@ namespace crpropa {
 
 	// with a fixed step size
 	PropagationBP::PropagationBP(ref_ptr<MagneticField> field, double fixedStep) :
-			minStep(0) {
+			minStep(0), maxNeutralStep(0) {
 		setField(field);
 		setTolerance(0.42);
 		setMaximumStep(fixedStep);
@@ -51,7 +53,7 @@ namespace crpropa {
 
 	// with adaptive step size
 	PropagationBP::PropagationBP(ref_ptr<MagneticField> field, double tolerance, double minStep, double maxStep) :
-			minStep(0) {
+			minStep(0), maxNeutralStep(0) {
 		setField(field);
 		setTolerance(tolerance);
 		setMaximumStep(maxStep);
@@ -69,12 +71,13 @@ namespace crpropa {
 
 		// rectilinear propagation for neutral particles
 		if (q == 0) {
-			double step = clip(candidate->getNextStep(), minStep, maxStep);
+			double maxNeutral = getMaximumNeutralStep();
+			double step = clip(candidate->getNextStep(), minStep, maxNeutral);
 			Vector3d pos = current.getPosition();
 			Vector3d dir = current.getDirection();
 			current.setPosition(pos + dir * step);
 			candidate->setCurrentStep(step);
-			candidate->setNextStep(maxStep);
+			candidate->setNextStep(maxNeutral);
 			return;
 		}
 
@@ -82,6 +85,20 @@ namespace crpropa {
 		double z = candidate->getRedshift();
 		double m = current.getEnergy()/(c_light * c_light);
 
+		// exact helix where the field is uniform, the next step is limited only by the other modules
+		double radius = getUniformRadius(current.getPosition());
+		double uniformStep = std::min(clip(candidate->getNextStep(), minStep, maxStep), radius);
+		if ((radius > 0) and (uniformStep >= minStep)) {
+			Vector3d pos = current.getPosition();
+			Vector3d dir = current.getDirection();
+			propagateUniform(pos, dir, getFieldAtPosition(pos, z), q, current.getEnergy(), uniformStep);
+			current.setPosition(pos);
+			current.setDirection(dir);
+			candidate->setCurrentStep(uniformStep);
+			candidate->setNextStep(maxStep);
+			return;
+		}
+
 		// if minStep is the same as maxStep the adaptive algorithm with its error
 		// estimation is not needed and the computation time can be saved:
 		if (minStep == maxStep){
@@ -170,6 +187,13 @@ namespace crpropa {
 	}
 
 
+	double PropagationBP::getUniformRadius(Vector3d pos) const {
+		if (not field.valid())
+			return std::numeric_limits<double>::infinity();  // no field
+		return field->getUniformRadius(pos);
+	}
+
+
 	void PropagationBP::setTolerance(double tol) {
 		if ((tol > 1) or (tol < 0))
 			throw std::runtime_error(
@@ -194,6 +218,13 @@ namespace crpropa {
 	}
 
 
+	void PropagationBP::setMaximumNeutralStep(double max) {
+		if ((max != 0) and (max < minStep))
+			throw std::runtime_error("PropagationBP: maxNeutralStep < minStep");
+		maxNeutralStep = max;
+	}
+
+
 	double PropagationBP::getTolerance() const {
 		return tolerance;
 	}
@@ -209,12 +240,19 @@ namespace crpropa {
 	}
 
 
+	double PropagationBP::getMaximumNeutralStep() const {
+		return (maxNeutralStep > 0) ? maxNeutralStep : maxStep;
+	}
+
+
 	std::string PropagationBP::getDescription() const {
 		std::stringstream s;
 		s << "Propagation in magnetic fields using the adaptive Boris push method.";
 		s << " Target error: " << tolerance;
 		s << ", Minimum Step: " << minStep / kpc << " kpc";
 		s << ", Maximum Step: " << maxStep / kpc << " kpc";
+		if (maxNeutralStep > 0)
+			s << ", Maximum Step of neutral particles: " << maxNeutralStep / kpc << " kpc";
 		return s.str();
 	}
 } // namespace crpropa
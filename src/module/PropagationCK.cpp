@@ -1,5 +1,6 @@
 #include "crpropa/module/PropagationCK.h"
 
+#include <algorithm>
 #include <limits>
 #include <sstream>
 #include <stdexcept>
@@ -62,7 +63,7 @@ PropagationCK::Y PropagationCK::dYdt(const Y &y, ParticleState &p, double z) con
 
 PropagationCK::PropagationCK(ref_ptr<MagneticField> field, double tolerance,
 		double minStep, double maxStep) :
-		minStep(0) {
+		minStep(0), maxNeutralStep(0) {
 	setField(field);
 	setTolerance(tolerance);
 	setMaximumStep(maxStep);
@@ -79,14 +80,31 @@ void PropagationCK::process(Candidate *candidate) const {
 	ParticleState &current = candidate->current;
 	candidate->previous = current;
 
-	double step = clip(candidate->getNextStep(), minStep, maxStep);
-
 	// rectilinear propagation for neutral particles
 	if (current.getCharge() == 0) {
+		double maxNeutral = getMaximumNeutralStep();
+		double step = clip(candidate->getNextStep(), minStep, maxNeutral);
 		Vector3d pos = current.getPosition();
 		Vector3d dir = current.getDirection();
 		current.setPosition(pos + dir * step);
 		candidate->setCurrentStep(step);
+		candidate->setNextStep(maxNeutral);
+		return;
+	}
+
+	double step = clip(candidate->getNextStep(), minStep, maxStep);
+	double z = candidate->getRedshift();
+
+	// exact helix where the field is uniform, the next step is limited only by the other modules
+	double radius = getUniformRadius(current.getPosition());
+	if ((radius > 0) and (std::min(step, radius) >= minStep)) {
+		step = std::min(step, radius);
+		Vector3d pos = current.getPosition();
+		Vector3d dir = current.getDirection();
+		propagateUniform(pos, dir, getFieldAtPosition(pos, z), current.getCharge(), current.getEnergy(), step);
+		current.setPosition(pos);
+		current.setDirection(dir);
+		candidate->setCurrentStep(step);
 		candidate->setNextStep(maxStep);
 		return;
 	}
@@ -95,7 +113,6 @@ void PropagationCK::process(Candidate *candidate) const {
 	Y yOut, yErr;
 	double newStep = step;
 	double r = 42;  // arbitrary value > 1
-	double z = candidate->getRedshift();
 
 	// try performing step until the target error (tolerance) or the minimum step size has been reached
 	while (r > 1) {
@@ -139,6 +156,12 @@ Vector3d PropagationCK::getFieldAtPosition(Vector3d pos, double z) const {
 	return B;
 }
 
+double PropagationCK::getUniformRadius(Vector3d pos) const {
+	if (not field.valid())
+		return std::numeric_limits<double>::infinity();  // no field
+	return field->getUniformRadius(pos);
+}
+
 void PropagationCK::setTolerance(double tol) {
 	if ((tol > 1) or (tol < 0))
 		throw std::runtime_error(
@@ -160,6 +183,12 @@ void PropagationCK::setMaximumStep(double max) {
 	maxStep = max;
 }
 
+void PropagationCK::setMaximumNeutralStep(double max) {
+	if ((max != 0) and (max < minStep))
+		throw std::runtime_error("PropagationCK: maxNeutralStep < minStep");
+	maxNeutralStep = max;
+}
+
 double PropagationCK::getTolerance() const {
 	return tolerance;
 }
@@ -172,12 +201,18 @@ double PropagationCK::getMaximumStep() const {
 	return maxStep;
 }
 
+double PropagationCK::getMaximumNeutralStep() const {
+	return (maxNeutralStep > 0) ? maxNeutralStep : maxStep;
+}
+
 std::string PropagationCK::getDescription() const {
 	std::stringstream s;
 	s << "Propagation in magnetic fields using the Cash-Karp method.";
 	s << " Target error: " << tolerance;
 	s << ", Minimum Step: " << minStep / kpc << " kpc";
 	s << ", Maximum Step: " << maxStep / kpc << " kpc";
+	if (maxNeutralStep > 0)
+		s << ", Maximum Step of neutral particles: " << maxNeutralStep / kpc << " kpc";
 	return s.str();
 }
 
@@ -0,0 +1,375 @@
+#include "crpropa/module/ResponseMatrix.h"
+#include "crpropa/Cosmology.h"
+#include "crpropa/ParticleID.h"
+#include "crpropa/Units.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace crpropa {
+
+ResponseMatrix::ResponseMatrix(double Emin, double Emax, size_t nEnergy,
+		double Dmin, double Dmax, size_t nDistance) :
+		logEmin(log10(Emin)), logEmax(log10(Emax)), nEnergy(nEnergy),
+		distanceMin(Dmin), distanceMax(Dmax), nDistance(nDistance) {
+	if ((Emin <= 0) or (Emax <= Emin) or (nEnergy == 0))
+		throw std::runtime_error("ResponseMatrix: invalid energy binning");
+	if ((Dmax <= Dmin) or (nDistance == 0))
+		throw std::runtime_error("ResponseMatrix: invalid distance binning");
+}
+
+int ResponseMatrix::energyBin(double E) const {
+	if (not (E > 0))
+		return -1;
+	double x = (log10(E) - logEmin) / (logEmax - logEmin) * nEnergy;
+	if ((x < 0) or (x >= nEnergy))
+		return -1;
+	return int(x);
+}
+
+int ResponseMatrix::distanceBin(double D) const {
+	if ((D < distanceMin) or (D >= distanceMax))
+		return -1;
+	if (nDistance == 1)
+		return 0;
+	size_t i = (D - distanceMin) / (distanceMax - distanceMin) * nDistance;
+	return std::min(i, nDistance - 1);
+}
+
+double ResponseMatrix::sourceDistance(const Candidate *candidate) const {
+	return candidate->source.getPosition().getR();
+}
+
+void ResponseMatrix::process(Candidate *candidate) const {
+	int i = energyBin(candidate->source.getEnergy());
+	int k = distanceBin(sourceDistance(candidate));
+	int j = energyBin(candidate->current.getEnergy());
+	if ((i < 0) or (j < 0) or (k < 0))
+		return;
+
+	std::pair<int, int> key(candidate->source.getId(), candidate->current.getId());
+	size_t bin = (i * nDistance + k) * nEnergy + j;
+#pragma omp critical(ResponseMatrix)
+	{
+		std::vector<double> &counts = detected[key];
+		if (counts.empty())
+			counts.resize(nEnergy * nDistance * nEnergy, 0.);
+		counts[bin] += candidate->getWeight();
+	}
+}
+
+void ResponseMatrix::inject(Candidate *candidate) const {
+	int i = energyBin(candidate->source.getEnergy());
+	int k = distanceBin(sourceDistance(candidate));
+	if ((i < 0) or (k < 0))
+		return;
+
+	int id = candidate->source.getId();
+#pragma omp critical(ResponseMatrix)
+	{
+		std::vector<double> &counts = injected[id];
+		if (counts.empty())
+			counts.resize(nEnergy * nDistance, 0.);
+		counts[i * nDistance + k] += candidate->getWeight();
+	}
+}
+
+void ResponseMatrix::add(const ResponseMatrix &other) {
+	if ((other.nEnergy != nEnergy) or (other.nDistance != nDistance)
+			or (other.logEmin != logEmin) or (other.logEmax != logEmax)
+			or (other.distanceMin != distanceMin) or (other.distanceMax != distanceMax))
+		throw std::runtime_error("ResponseMatrix: cannot add matrices with different binning");
+
+	std::map<int, std::vector<double> >::const_iterator it;
+	for (it = other.injected.begin(); it != other.injected.end(); ++it) {
+		std::vector<double> &counts = injected[it->first];
+		if (counts.empty())
+			counts.resize(it->second.size(), 0.);
+		for (size_t i = 0; i < counts.size(); i++)
+			counts[i] += it->second[i];
+	}
+
+	std::map<std::pair<int, int>, std::vector<double> >::const_iterator jt;
+	for (jt = other.detected.begin(); jt != other.detected.end(); ++jt) {
+		std::vector<double> &counts = detected[jt->first];
+		if (counts.empty())
+			counts.resize(jt->second.size(), 0.);
+		for (size_t i = 0; i < counts.size(); i++)
+			counts[i] += jt->second[i];
+	}
+}
+
+void ResponseMatrix::clear() {
+	injected.clear();
+	detected.clear();
+}
+
+size_t ResponseMatrix::getNumberOfEnergyBins() const {
+	return nEnergy;
+}
+
+size_t ResponseMatrix::getNumberOfDistanceBins() const {
+	return nDistance;
+}
+
+std::vector<double> ResponseMatrix::getEnergyBins() const {
+	std::vector<double> edges(nEnergy + 1);
+	for (size_t i = 0; i <= nEnergy; i++)
+		edges[i] = pow(10, logEmin + (logEmax - logEmin) * i / nEnergy);
+	return edges;
+}
+
+std::vector<double> ResponseMatrix::getDistanceBins() const {
+	std::vector<double> edges(nDistance + 1);
+	for (size_t i = 0; i <= nDistance; i++)
+		edges[i] = distanceMin + (distanceMax - distanceMin) / nDistance * i;
+	edges[nDistance] = distanceMax;
+	return edges;
+}
+
+std::vector<int> ResponseMatrix::getSourceIds() const {
+	std::vector<int> ids;
+	std::map<int, std::vector<double> >::const_iterator it;
+	for (it = injected.begin(); it != injected.end(); ++it)
+		ids.push_back(it->first);
+	return ids;
+}
+
+std::vector<int> ResponseMatrix::getObservedIds() const {
+	std::vector<int> ids;
+	std::map<std::pair<int, int>, std::vector<double> >::const_iterator it;
+	for (it = detected.begin(); it != detected.end(); ++it)
+		if (std::find(ids.begin(), ids.end(), it->first.second) == ids.end())
+			ids.push_back(it->first.second);
+	std::sort(ids.begin(), ids.end());
+	return ids;
+}
+
+double ResponseMatrix::getInjected(int sourceId, size_t iSourceEnergy, size_t iDistance) const {
+	if ((iSourceEnergy >= nEnergy) or (iDistance >= nDistance))
+		throw std::runtime_error("ResponseMatrix: bin index out of range");
+	std::map<int, std::vector<double> >::const_iterator it = injected.find(sourceId);
+	if (it == injected.end())
+		return 0;
+	return it->second[iSourceEnergy * nDistance + iDistance];
+}
+
+double ResponseMatrix::getResponse(int sourceId, size_t iSourceEnergy,
+		size_t iDistance, int observedId, size_t iEnergy) const {
+	if (iEnergy >= nEnergy)
+		throw std::runtime_error("ResponseMatrix: bin index out of range");
+	double n = getInjected(sourceId, iSourceEnergy, iDistance);
+	if (n == 0)
+		return 0;
+	std::map<std::pair<int, int>, std::vector<double> >::const_iterator it =
+			detected.find(std::make_pair(sourceId, observedId));
+	if (it == detected.end())
+		return 0;
+	return it->second[(iSourceEnergy * nDistance + iDistance) * nEnergy + iEnergy] / n;
+}
+
+std::vector<double> ResponseMatrix::fold(int observedId, int sourceId,
+		const std::vector<double> &sourceCounts) const {
+	if (sourceCounts.size() != nEnergy * nDistance)
+		throw std::runtime_error("ResponseMatrix: number of source counts does not match the source bins");
+
+	std::vector<double> result(nEnergy, 0.);
+	std::map<int, std::vector<double> >::const_iterator in = injected.find(sourceId);
+	std::map<std::pair<int, int>, std::vector<double> >::const_iterator it =
+			detected.find(std::make_pair(sourceId, observedId));
+	if ((in == injected.end()) or (it == detected.end()))
+		return result;
+
+	for (size_t s = 0; s < nEnergy * nDistance; s++) {
+		if ((sourceCounts[s] == 0) or (in->second[s] == 0))
+			continue;
+		double f = sourceCounts[s] / in->second[s];
+		const double *row = &it->second[s * nEnergy];
+		for (size_t j = 0; j < nEnergy; j++)
+			result[j] += f * row[j];
+	}
+	return result;
+}
+
+std::vector<double> ResponseMatrix::foldPowerLaw(int observedId, int sourceId,
+		double index, double Rmax, double m) const {
+	// number of emitted particles per source energy bin, power law up to Z * Rmax
+	double Z = isNucleus(sourceId) ? chargeNumber(sourceId) : 1;
+	double Ecut = (Rmax < std::numeric_limits<double>::max() / Z) ? Z * Rmax : Rmax;
+	std::vector<double> edges = getEnergyBins();
+	std::vector<double> wE(nEnergy, 0.);
+	double a = 1 + index;
+	for (size_t i = 0; i < nEnergy; i++) {
+		double lo = edges[i];
+		double hi = std::min(edges[i + 1], Ecut);
+		if (hi <= lo)
+			continue;
+		if (std::abs(a) < std::numeric_limits<double>::min())
+			wE[i] = log(hi / lo);
+		else
+			wE[i] = (pow(hi, a) - pow(lo, a)) / a;
+	}
+
+	// number of sources per distance bin, evolution (1 + z)^m
+	std::vector<double> wD(nDistance, 1.);
+	if (m != 0) {
+		if (distanceMax == std::numeric_limits<double>::max())
+			throw std::runtime_error("ResponseMatrix: redshift evolution requires finite distance bins");
+		std::vector<double> D = getDistanceBins();
+		for (size_t k = 0; k < nDistance; k++) {
+			double z = comovingDistance2Redshift((D[k] + D[k + 1]) / 2);
+			wD[k] = pow(1 + z, m) * (D[k + 1] - D[k]);
+		}
+	}
+
+	double norm = 0;
+	std::vector<double> counts(nEnergy * nDistance);
+	for (size_t i = 0; i < nEnergy; i++)
+		for (size_t k = 0; k < nDistance; k++) {
+			counts[i * nDistance + k] = wE[i] * wD[k];
+			norm += wE[i] * wD[k];
+		}
+	if (norm == 0)
+		return std::vector<double>(nEnergy, 0.);
+	for (size_t s = 0; s < counts.size(); s++)
+		counts[s] /= norm;
+
+	return fold(observedId, sourceId, counts);
+}
+
+void ResponseMatrix::dump(const std::string &filename) const {
+	std::ofstream out(filename.c_str());
+	if (not out.good())
+		throw std::runtime_error("ResponseMatrix: could not open file " + filename);
+
+	out << std::setprecision(17);
+	out << "# ResponseMatrix\n";
+	out << "# E log10(Emin/J) log10(Emax/J) nEnergy\n";
+	out << "# D Dmin/m Dmax/m nDistance\n";
+	out << "# I sourceId iSourceEnergy iDistance injectedWeight\n";
+	out << "# R sourceId observedId iSourceEnergy iDistance iEnergy detectedWeight\n";
+	out << "E " << logEmin << " " << logEmax << " " << nEnergy << "\n";
+	out << "D " << distanceMin << " " << distanceMax << " " << nDistance << "\n";
+
+	std::map<int, std::vector<double> >::const_iterator it;
+	for (it = injected.begin(); it != injected.end(); ++it)
+		for (size_t s = 0; s < it->second.size(); s++)
+			if (it->second[s] != 0)
+				out << "I " << it->first << " " << s / nDistance << " "
+					<< s % nDistance << " " << it->second[s] << "\n";
+
+	std::map<std::pair<int, int>, std::vector<double> >::const_iterator jt;
+	for (jt = detected.begin(); jt != detected.end(); ++jt)
+		for (size_t b = 0; b < jt->second.size(); b++)
+			if (jt->second[b] != 0) {
+				size_t s = b / nEnergy;
+				out << "R " << jt->first.first << " " << jt->first.second << " "
+					<< s / nDistance << " " << s % nDistance << " "
+					<< b % nEnergy << " " << jt->second[b] << "\n";
+			}
+}
+
+void ResponseMatrix::load(const std::string &filename) {
+	std::ifstream in(filename.c_str());
+	if (not in.good())
+		throw std::runtime_error("ResponseMatrix: could not open file " + filename);
+
+	// read into a matrix of the same binning and add, so that a failed load does not modify this one
+	ResponseMatrix other(*this);
+	other.clear();
+	bool haveEnergy = false, haveDistance = false;
+
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.empty() or line[0] == '#')
+			continue;
+		std::stringstream ss(line);
+		char type;
+		ss >> type;
+		if (type == 'E') {
+			double lo, hi;
+			size_t n;
+			ss >> lo >> hi >> n;
+			other.logEmin = lo;
+			other.logEmax = hi;
+			other.nEnergy = n;
+			haveEnergy = true;
+		} else if (type == 'D') {
+			double lo, hi;
+			size_t n;
+			ss >> lo >> hi >> n;
+			other.distanceMin = lo;
+			other.distanceMax = hi;
+			other.nDistance = n;
+			haveDistance = true;
+		} else if (type == 'I') {
+			int id;
+			size_t i, k;
+			double w;
+			ss >> id >> i >> k >> w;
+			if (ss.fail() or not (haveEnergy and haveDistance) or (i >= other.nEnergy) or (k >= other.nDistance))
+				throw std::runtime_error("ResponseMatrix: invalid line in " + filename);
+			std::vector<double> &counts = other.injected[id];
+			if (counts.empty())
+				counts.resize(other.nEnergy * other.nDistance, 0.);
+			counts[i * other.nDistance + k] += w;
+		} else if (type == 'R') {
+			int id0, id;
+			size_t i, k, j;
+			double w;
+			ss >> id0 >> id >> i >> k >> j >> w;
+			if (ss.fail() or not (haveEnergy and haveDistance) or (i >= other.nEnergy)
+					or (k >= other.nDistance) or (j >= other.nEnergy))
+				throw std::runtime_error("ResponseMatrix: invalid line in " + filename);
+			std::vector<double> &counts = other.detected[std::make_pair(id0, id)];
+			if (counts.empty())
+				counts.resize(other.nEnergy * other.nDistance * other.nEnergy, 0.);
+			counts[(i * other.nDistance + k) * other.nEnergy + j] += w;
+		} else {
+			throw std::runtime_error("ResponseMatrix: invalid line in " + filename);
+		}
+	}
+
+	// binning of the file is compared with the precision it was written with
+	if ((other.nEnergy != nEnergy) or (other.nDistance != nDistance)
+			or (std::abs(other.logEmin - logEmin) > 1e-12)
+			or (std::abs(other.logEmax - logEmax) > 1e-12)
+			or (std::abs(other.distanceMin - distanceMin) > 1e-12 * std::abs(distanceMax))
+			or (std::abs(other.distanceMax - distanceMax) > 1e-12 * std::abs(distanceMax)))
+		throw std::runtime_error("ResponseMatrix: binning in " + filename + " does not match");
+	other.logEmin = logEmin;
+	other.logEmax = logEmax;
+	other.distanceMin = distanceMin;
+	other.distanceMax = distanceMax;
+	add(other);
+}
+
+std::string ResponseMatrix::getDescription() const {
+	std::stringstream s;
+	s << "ResponseMatrix: " << nEnergy << " energy bins, E = "
+		<< pow(10, logEmin) / EeV << " - " << pow(10, logEmax) / EeV << " EeV, "
+		<< nDistance << " source distance bins";
+	if (distanceMax < std::numeric_limits<double>::max())
+		s << ", D = " << distanceMin / Mpc << " - " << distanceMax / Mpc << " Mpc";
+	return s.str();
+}
+
+ResponseInjection::ResponseInjection(ref_ptr<ResponseMatrix> matrix) : matrix(matrix) {
+	setDescription("ResponseInjection");
+}
+
+void ResponseInjection::process(Candidate *candidate) const {
+	// only primaries are injected, each of them once
+	if (candidate->parent)
+		return;
+	if (candidate->hasProperty("ResponseInjection"))
+		return;
+	candidate->setProperty("ResponseInjection", true);
+	matrix->inject(candidate);
+}
+
+} // namespace crpropa
@@ -106,6 +106,8 @@ void SynchrotronRadiation::initSpectrum() {
 		infile.ignore(std::numeric_limits < std::streamsize > ::max(), '\n');
 	}
 	infile.close();
+
+	sampler.setCDF(tabCDF);
 }
 
 void SynchrotronRadiation::process(Candidate *candidate) const {
@@ -154,7 +156,7 @@ void SynchrotronRadiation::process(Candidate *candidate) const {
 	while (dE > 0) {
 		// draw random value between 0 and maximum of corresponding cdf
 		// choose bin of s where cdf(x) = cdf_rand -> x_rand
-		size_t i = random.randBin(tabCDF); // draw random bin (upper bin boundary returned)
+		size_t i = sampler.sample(random); // draw random bin (upper bin boundary returned)
 		double binWidth = (tabx[i] - tabx[i-1]);
 		double x = tabx[i-1] + random.rand() * binWidth; // draw random x uniformly distributed in bin
 		double Ephoton = x * Ecrit;
@@ -1,7 +1,11 @@
 #include "crpropa/module/Tools.h"
 #include "crpropa/Clock.h"
+#include "crpropa/Random.h"
+#include "crpropa/Units.h"
 
+#include <cmath>
 #include <iostream>
+#include <map>
 #include <sstream>
 
 using namespace std;
@@ -120,4 +124,117 @@ string EmissionMapFiller::getDescription() const {
 	return "EmissionMapFiller";
 }
 
+// ----------------------------------------------------------------------------
+SecondaryCoalescence::SecondaryCoalescence(double binsPerDecade, double maximumEnergy) :
+		binsPerDecade(binsPerDecade), maximumEnergy(maximumEnergy) {
+}
+
+void SecondaryCoalescence::setBinsPerDecade(double binsPerDecade) {
+	this->binsPerDecade = binsPerDecade;
+}
+
+void SecondaryCoalescence::setMaximumEnergy(double maximumEnergy) {
+	this->maximumEnergy = maximumEnergy;
+}
+
+double SecondaryCoalescence::getBinsPerDecade() const {
+	return binsPerDecade;
+}
+
+double SecondaryCoalescence::getMaximumEnergy() const {
+	return maximumEnergy;
+}
+
+// Secondaries handled in a previous step carry the property set to true,
+// excluded ones set to false. The marks are kept on the secondaries and not on
+// the candidate, whose properties are copied when it is split.
+static const string coalescenceProperty = "SecondaryCoalescence";
+
+static bool isHandled(const Candidate *secondary) {
+	return secondary->hasProperty(coalescenceProperty)
+			and secondary->getProperty(coalescenceProperty).toBool();
+}
+
+static bool isExcluded(const Candidate *secondary) {
+	return secondary->hasProperty(coalescenceProperty)
+			and not secondary->getProperty(coalescenceProperty).toBool();
+}
+
+void SecondaryCoalescence::exclude(Candidate *secondary) {
+	secondary->setProperty(coalescenceProperty, Variant::fromBool(false));
+}
+
+void SecondaryCoalescence::process(Candidate* candidate) const {
+	// secondaries are appended, the new ones follow the last handled one
+	vector<ref_ptr<Candidate> > &secondaries = candidate->secondaries;
+	size_t begin = secondaries.size();
+	while ((begin > 0) and not isHandled(secondaries[begin - 1]))
+		begin--;
+	if (begin == secondaries.size())
+		return;
+
+	// group the new secondaries by id and energy bin
+	map<pair<int, long>, vector<size_t> > groups;
+	for (size_t i = begin; i < secondaries.size(); i++) {
+		if (isExcluded(secondaries[i]))
+			continue;
+		double E = secondaries[i]->current.getEnergy();
+		if ((E <= 0) or (E >= maximumEnergy))
+			continue;
+		long bin = floor(log10(E / eV) * binsPerDecade);
+		groups[make_pair(secondaries[i]->current.getId(), bin)].push_back(i);
+	}
+
+	// keep one member per group, drawn according to its weighted energy
+	Random &random = Random::instance();
+	vector<bool> merged(secondaries.size(), false);
+	bool haveMerged = false;
+	map<pair<int, long>, vector<size_t> >::const_iterator g;
+	for (g = groups.begin(); g != groups.end(); g++) {
+		const vector<size_t> &members = g->second;
+		if (members.size() < 2)
+			continue;
+
+		double total = 0;
+		for (size_t k = 0; k < members.size(); k++) {
+			const Candidate *s = secondaries[members[k]];
+			total += s->getWeight() * s->current.getEnergy();
+		}
+		double r = random.rand() * total;
+		size_t keep = members.back();
+		for (size_t k = 0; k < members.size(); k++) {
+			const Candidate *s = secondaries[members[k]];
+			r -= s->getWeight() * s->current.getEnergy();
+			if (r < 0) {
+				keep = members[k];
+				break;
+			}
+		}
+
+		for (size_t k = 0; k < members.size(); k++)
+			merged[members[k]] = true;
+		merged[keep] = false;
+		secondaries[keep]->setWeight(total / secondaries[keep]->current.getEnergy());
+		haveMerged = true;
+	}
+
+	if (haveMerged) {
+		size_t n = begin;
+		for (size_t i = begin; i < secondaries.size(); i++)
+			if (not merged[i])
+				secondaries[n++] = secondaries[i];
+		secondaries.resize(n);
+	}
+	for (size_t i = begin; i < secondaries.size(); i++)
+		secondaries[i]->setProperty(coalescenceProperty, Variant::fromBool(true));
+}
+
+string SecondaryCoalescence::getDescription() const {
+	stringstream sstr;
+	sstr << "SecondaryCoalescence: " << binsPerDecade << " bins per decade";
+	if (maximumEnergy < numeric_limits<double>::max())
+		sstr << ", E < " << maximumEnergy / EeV << " EeV";
+	return sstr.str();
+}
+
 } // namespace crpropa
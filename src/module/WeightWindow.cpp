@@ -0,0 +1,184 @@
+#include "crpropa/module/WeightWindow.h"
+#include "crpropa/module/Tools.h"
+#include "crpropa/Random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+namespace crpropa {
+
+EnergyImportance::EnergyImportance(double referenceEnergy, double index) :
+		referenceEnergy(referenceEnergy), index(index) {
+}
+
+double EnergyImportance::getImportance(const ParticleState &state) const {
+	return pow(state.getEnergy() / referenceEnergy, index);
+}
+
+DistanceImportance::DistanceImportance(Vector3d center, double radius, double index) :
+		center(center), radius(radius), index(index) {
+}
+
+double DistanceImportance::getImportance(const ParticleState &state) const {
+	double r = state.getPosition().getDistanceTo(center);
+	if (r <= radius)
+		return 1;
+	return pow(radius / r, index);
+}
+
+WeightWindow::WeightWindow(ref_ptr<ImportanceFunction> importance,
+		double referenceWeight, double lowerRatio, double upperRatio,
+		int maximumSplits) {
+	setImportanceFunction(importance);
+	setReferenceWeight(referenceWeight);
+	setWindow(lowerRatio, upperRatio);
+	setMaximumSplits(maximumSplits);
+	resetStatistics();
+}
+
+void WeightWindow::setImportanceFunction(ref_ptr<ImportanceFunction> importance) {
+	this->importance = importance;
+}
+
+void WeightWindow::setReferenceWeight(double weight) {
+	if (weight <= 0)
+		throw std::runtime_error("WeightWindow: reference weight must be positive");
+	referenceWeight = weight;
+}
+
+void WeightWindow::setWindow(double lower, double upper) {
+	if ((lower <= 0) or (lower > 1) or (upper < 1))
+		throw std::runtime_error("WeightWindow: window has to satisfy 0 < lower <= 1 <= upper");
+	lowerRatio = lower;
+	upperRatio = upper;
+}
+
+void WeightWindow::setMaximumSplits(int n) {
+	if (n < 1)
+		throw std::runtime_error("WeightWindow: maximum number of splits must be positive");
+	maximumSplits = n;
+}
+
+ref_ptr<ImportanceFunction> WeightWindow::getImportanceFunction() const {
+	return importance;
+}
+
+double WeightWindow::getReferenceWeight() const {
+	return referenceWeight;
+}
+
+int WeightWindow::getMaximumSplits() const {
+	return maximumSplits;
+}
+
+void WeightWindow::process(Candidate *candidate) const {
+	if (not candidate->isActive())
+		return;
+
+	double w = candidate->getWeight();
+	double I = importance->getImportance(candidate->current);
+
+	// regions without importance: no chance of survival
+	if (not (I > 0)) {
+		candidate->setActive(false);
+#pragma omp atomic
+		nRoulette++;
+#pragma omp atomic
+		nKilled++;
+#pragma omp atomic
+		weightKilled += w;
+		return;
+	}
+
+	double target = referenceWeight / I;
+
+	// above the window: split
+	if (w > upperRatio * target) {
+		int n = std::min(int(ceil(w / target)), maximumSplits);
+		if (n < 2)
+			return;
+		split(candidate, n);
+#pragma omp atomic
+		nSplit++;
+#pragma omp atomic
+		nCopies += n - 1;
+		return;
+	}
+
+	// below the window: Russian roulette
+	if (w < lowerRatio * target) {
+		double p = w / target;
+#pragma omp atomic
+		nRoulette++;
+		if (Random::instance().rand() < p) {
+			candidate->setWeight(target);
+#pragma omp atomic
+			weightRestored += target - w;
+		} else {
+			candidate->setActive(false);
+#pragma omp atomic
+			nKilled++;
+#pragma omp atomic
+			weightKilled += w;
+		}
+	}
+}
+
+void WeightWindow::split(Candidate *candidate, int n) {
+	candidate->updateWeight(1. / n);
+	for (int i = 1; i < n; i++) {
+		// the clone gets a new serial number, its source is the one of the candidate
+		ref_ptr<Candidate> copy = candidate->clone(false);
+		copy->parent = candidate;
+		SecondaryCoalescence::exclude(copy);
+		candidate->addSecondary(copy);
+	}
+}
+
+unsigned long long WeightWindow::getNumberOfSplits() const {
+	return nSplit;
+}
+
+unsigned long long WeightWindow::getNumberOfCopies() const {
+	return nCopies;
+}
+
+unsigned long long WeightWindow::getNumberOfRoulettes() const {
+	return nRoulette;
+}
+
+unsigned long long WeightWindow::getNumberOfKilled() const {
+	return nKilled;
+}
+
+double WeightWindow::getWeightKilled() const {
+	return weightKilled;
+}
+
+double WeightWindow::getWeightRestored() const {
+	return weightRestored;
+}
+
+void WeightWindow::resetStatistics() {
+	nSplit = 0;
+	nCopies = 0;
+	nRoulette = 0;
+	nKilled = 0;
+	weightKilled = 0;
+	weightRestored = 0;
+}
+
+std::string WeightWindow::getDescription() const {
+	std::stringstream s;
+	s << "WeightWindow: reference weight " << referenceWeight
+		<< ", window [" << lowerRatio << ", " << upperRatio << "]"
+		<< ", maximum splits " << maximumSplits << "\n"
+		<< "  splits: " << nSplit << " (" << nCopies << " copies)"
+		<< ", roulette: " << nRoulette << " (" << nKilled << " killed)"
+		<< ", weight killed / restored: " << weightKilled << " / " << weightRestored;
+	return s.str();
+}
+
+} // namespace crpropa
@@ -5,6 +5,8 @@
 #include "crpropa/module/Boundary.h"
 #include "crpropa/module/Tools.h"
 #include "crpropa/module/RestrictToRegion.h"
+#include "crpropa/module/Acceleration.h"
+#include "crpropa/module/WeightWindow.h"
 #include "crpropa/ParticleID.h"
 #include "crpropa/Geometry.h"
 
@@ -161,7 +163,7 @@ TEST(ObserverFeature, SmallSphere) {
 	// detect if the current position is inside and the previous outside of the sphere
 	Observer obs;
 	obs.add(new ObserverSurface(new Sphere (Vector3d(0, 0, 0), 1)));
-	Candidate c;
+	Candidate c(11); // charged particle, conservative step limit
 	c.setNextStep(10);
 
 	// no detection: particle was inside already
@@ -184,7 +186,7 @@ TEST(ObserverFeature, LargeSphere) {
 	// detect if the current position is outside and the previous inside of the sphere
 	Observer obs;
 	obs.add(new ObserverSurface(new Sphere (Vector3d(0, 0, 0), 10)));
-	Candidate c;
+	Candidate c(11); // charged particle, conservative step limit
 	c.setNextStep(10);
 
 	// no detection: particle was outside already
@@ -203,6 +205,29 @@ TEST(ObserverFeature, LargeSphere) {
 	EXPECT_FALSE(c.isActive());
 }
 
+TEST(ObserverFeature, SurfaceNeutral) {
+	// neutral particles: limit the step to the crossing along the straight line
+	Observer obs;
+	obs.add(new ObserverSurface(new Sphere(Vector3d(0, 0, 0), 1)));
+	Candidate c(22, 1 * EeV, Vector3d(5, 0.6, 0), Vector3d(-1, 0, 0));
+	c.setNextStep(10);
+	obs.process(&c);
+	EXPECT_TRUE(c.isActive());
+	EXPECT_NEAR(4.2, c.getNextStep(), 1e-12);
+
+	// no crossing
+	c.current.setPosition(Vector3d(5, 2, 0));
+	c.setNextStep(10);
+	obs.process(&c);
+	EXPECT_DOUBLE_EQ(10, c.getNextStep());
+
+	// detection after a step to the crossing
+	c.current.setPosition(Vector3d(0.8, 0.6, 0));
+	c.previous.setPosition(Vector3d(5, 0.6, 0));
+	obs.process(&c);
+	EXPECT_FALSE(c.isActive());
+}
+
 TEST(ObserverFeature, Point) {
 	Observer obs;
 	obs.add(new ObserverPoint());
@@ -414,7 +439,7 @@ TEST(CubicBoundary, limitStepLower) {
 	CubicBoundary cube(Vector3d(10, 10, 10), 10);
 	cube.setLimitStep(true);
 	cube.setMargin(1);
-	Candidate c;
+	Candidate c(11);
 	c.current.setPosition(Vector3d(15, 15, 10.5));
 	c.setNextStep(100);
 	cube.process(&c);
@@ -425,13 +450,23 @@ TEST(CubicBoundary, limitStepUpper) {
 	CubicBoundary cube(Vector3d(-10, -10, -10), 10);
 	cube.setLimitStep(true);
 	cube.setMargin(1);
-	Candidate c;
+	Candidate c(11);
 	c.current.setPosition(Vector3d(-5, -5, -0.5));
 	c.setNextStep(100);
 	cube.process(&c);
 	EXPECT_DOUBLE_EQ(1.5, c.getNextStep());
 }
 
+TEST(CubicBoundary, limitStepNeutral) {
+	// neutral particles: limit the step to the exit along the straight line
+	CubicBoundary cube(Vector3d(0, 0, 0), 10);
+	cube.setMargin(1);
+	Candidate c(22, 1 * EeV, Vector3d(5, 5, 0.5), Vector3d(1, 0, 1));
+	c.setNextStep(100);
+	cube.process(&c);
+	EXPECT_NEAR(5 * sqrt(2) + 1, c.getNextStep(), 1e-12);
+}
+
 TEST(SphericalBoundary, inside) {
 	SphericalBoundary sphere(Vector3d(0, 0, 0), 10);
 	Candidate c;
@@ -455,13 +490,22 @@ TEST(SphericalBoundary, limitStep) {
 	SphericalBoundary sphere(Vector3d(0, 0, 0), 10);
 	sphere.setLimitStep(true);
 	sphere.setMargin(1);
-	Candidate c;
+	Candidate c(11);
 	c.setNextStep(100);
 	c.current.setPosition(Vector3d(0, 0, 9.5));
 	sphere.process(&c);
 	EXPECT_DOUBLE_EQ(1.5, c.getNextStep());
 }
 
+TEST(SphericalBoundary, limitStepNeutral) {
+	SphericalBoundary sphere(Vector3d(0, 0, 0), 10);
+	sphere.setMargin(1);
+	Candidate c(22, 1 * EeV, Vector3d(0, 0, 9.5), Vector3d(0, 0, -1));
+	c.setNextStep(100);
+	sphere.process(&c);
+	EXPECT_DOUBLE_EQ(20.5, c.getNextStep());
+}
+
 TEST(EllipsoidalBoundary, inside) {
 	EllipsoidalBoundary ellipsoid(Vector3d(-5, 0, 0), Vector3d(5, 0, 0), 15);
 	Candidate c;
@@ -536,6 +580,77 @@ TEST(RestrictToRegion, RestrictToRegion) {
 	EXPECT_FALSE(c.isActive());
 }
 
+//** ========================= Weight window ================================ */
+TEST(WeightWindow, split) {
+	// Candidate of weight 8 at importance 1 is split into 8 candidates of weight 1
+	WeightWindow ww(new EnergyImportance(1 * EeV, 0));
+	Candidate c(22, 1 * EeV);
+	c.setWeight(8);
+	ww.process(&c);
+	EXPECT_DOUBLE_EQ(1, c.getWeight());
+	ASSERT_EQ(7, c.secondaries.size());
+	for (size_t i = 0; i < 7; i++) {
+		EXPECT_DOUBLE_EQ(1, c.secondaries[i]->getWeight());
+		EXPECT_NE(c.getSerialNumber(), c.secondaries[i]->getSerialNumber());
+		EXPECT_EQ(c.getSourceSerialNumber(), c.secondaries[i]->getSourceSerialNumber());
+	}
+	EXPECT_EQ(1, ww.getNumberOfSplits());
+	EXPECT_EQ(7, ww.getNumberOfCopies());
+
+	// inside the window nothing happens
+	ww.process(&c);
+	EXPECT_EQ(7, c.secondaries.size());
+
+	// maximum number of copies
+	ww.setMaximumSplits(4);
+	Candidate c2;
+	c2.setWeight(100);
+	ww.process(&c2);
+	EXPECT_DOUBLE_EQ(25, c2.getWeight());
+	EXPECT_EQ(3, c2.secondaries.size());
+}
+
+TEST(WeightWindow, roulette) {
+	// Expected weight is conserved in Russian roulette
+	WeightWindow ww(new DistanceImportance(Vector3d(0.), 1, 1));
+	double total = 0;
+	for (int i = 0; i < 10000; i++) {
+		// importance 0.1 --> target weight 10
+		Candidate c;
+		c.current.setPosition(Vector3d(10, 0, 0));
+		ww.process(&c);
+		if (c.isActive()) {
+			EXPECT_DOUBLE_EQ(10, c.getWeight());
+			total += c.getWeight();
+		}
+	}
+	EXPECT_EQ(10000, ww.getNumberOfRoulettes());
+	EXPECT_NEAR(10000, total, 1500); // 5 sigma
+	EXPECT_NEAR(ww.getWeightRestored() - ww.getWeightKilled(), total - 10000, 1e-6);
+
+	// no survival without importance
+	Candidate c;
+	WeightWindow ww0(new EnergyImportance(1 * EeV, 1));
+	c.current.setEnergy(0);
+	ww0.process(&c);
+	EXPECT_FALSE(c.isActive());
+}
+
+TEST(ParticleSplitting, serialNumbers) {
+	// copies of a split candidate get new serial numbers
+	// split into 3 after 3 crossings
+	ParticleSplitting ps(new Sphere(Vector3d(0.), 1), 3, 3);
+	Candidate c;
+	for (int i = 0; i < 3; i++) {
+		c.previous.setPosition(Vector3d(0.5 + i % 2, 0, 0));
+		c.current.setPosition(Vector3d(1.5 - i % 2, 0, 0));
+		ps.process(&c);
+	}
+	EXPECT_NEAR(1. / 3, c.getWeight(), 1e-12);
+	ASSERT_EQ(2, c.secondaries.size());
+	EXPECT_NE(c.secondaries[0]->getSerialNumber(), c.secondaries[1]->getSerialNumber());
+	EXPECT_NE(c.getSerialNumber(), c.secondaries[0]->getSerialNumber());
+}
 
 int main(int argc, char **argv) {
 	::testing::InitGoogleTest(&argc, argv);
@@ -2,6 +2,11 @@
 	Candidate
 	ParticleState
 	Random
+	DiscreteSampler
+	InterpolationTable
+	DataTable
+	TableRegistry
+	Cosmology
 	Common functions
  */
 
@@ -12,14 +17,33 @@
 #include "crpropa/ParticleID.h"
 #include "crpropa/ParticleMass.h"
 #include "crpropa/Random.h"
+#include "crpropa/DiscreteSampler.h"
+#include "crpropa/InterpolationTable.h"
+#include "crpropa/DataTable.h"
+#include "crpropa/TableRegistry.h"
+#include "crpropa/Cosmology.h"
 #include "crpropa/Grid.h"
 #include "crpropa/GridTools.h"
+#include "crpropa/OctreeGrid.h"
 #include "crpropa/Geometry.h"
 #include "crpropa/EmissionMap.h"
 
 #include <HepPID/ParticleIDMethods.hh>
 #include "gtest/gtest.h"
 
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <utime.h>
+#endif
+
 namespace crpropa {
 
 TEST(ParticleState, position) {
@@ -236,6 +260,26 @@ TEST(Candidate, addSecondary) {
 	
 }
 
+TEST(Candidate, addThinnedSecondary) {
+	Candidate c(11, 100 * EeV);
+	c.setWeight(2);
+	Vector3d pos(1, 2, 3);
+
+	// without thinning every secondary is added with the weight of the parent
+	EXPECT_TRUE(c.addThinnedSecondary(22, 1 * EeV, pos, 0.01, 0));
+	EXPECT_EQ(2, c.secondaries[0]->getWeight());
+	EXPECT_TRUE(pos == c.secondaries[0]->current.getPosition());
+
+	// with thinning a fraction f^thinning is kept with weight 1 / f^thinning
+	int n = 10000;
+	size_t kept = 0;
+	for (int i = 0; i < n; i++)
+		kept += c.addThinnedSecondary(22, 1 * EeV, pos, 0.01, 0.5);
+	EXPECT_EQ(kept + 1, c.secondaries.size());
+	EXPECT_NEAR(0.1, kept / double(n), 0.01);
+	EXPECT_NEAR(20, c.secondaries[1]->getWeight(), 1e-12);
+}
+
 TEST(Candidate, serialNumber) {
 	Candidate::setNextSerialNumber(42);
 	Candidate c;
@@ -303,6 +347,289 @@ TEST(common, interpolateEquidistant) {
 	EXPECT_EQ(9, interpolateEquidistant(3.1, 1, 3, yD));
 }
 
+TEST(InterpolationTable, spacing) {
+	std::vector<double> x1, x2, x3, y;
+	for (int i = 0; i < 50; i++) {
+		x1.push_back(1 + 0.1 * i);
+		x2.push_back(pow(10, 6 + 0.1 * i));
+		x3.push_back(pow(1 + 0.1 * i, 2));
+		y.push_back(sin(i));
+	}
+	EXPECT_EQ(InterpolationTable::Uniform, InterpolationTable(x1, y).getSpacing());
+	EXPECT_EQ(InterpolationTable::LogUniform, InterpolationTable(x2, y).getSpacing());
+	EXPECT_EQ(InterpolationTable::Irregular, InterpolationTable(x3, y).getSpacing());
+	EXPECT_THROW(InterpolationTable(x1, std::vector<double>(3)), std::runtime_error);
+}
+
+TEST(InterpolationTable, consistentWithInterpolate) {
+	// log-uniform, uniform and irregular tables give the same results as interpolate()
+	std::vector<std::vector<double> > xs(3);
+	std::vector<double> y;
+	for (int i = 0; i < 100; i++) {
+		xs[0].push_back(pow(10, 6 + 0.05 * i));
+		xs[1].push_back(-1 + 0.02 * i);
+		xs[2].push_back(pow(1 + 0.1 * i, 3));
+		y.push_back(cos(0.3 * i));
+	}
+
+	Random &R = Random::instance();
+	for (size_t k = 0; k < xs.size(); k++) {
+		const std::vector<double> &X = xs[k];
+		InterpolationTable table(X, y);
+		std::vector<double> x;
+		for (int i = 0; i < 1000; i++)
+			x.push_back(X.front() + (X.back() - X.front()) * (1.1 * R.rand() - 0.05));
+		x.push_back(X.front());
+		x.push_back(X.back());
+		for (size_t i = 0; i < X.size(); i++)
+			x.push_back(X[i]); // tabulated points
+
+		std::vector<double> batch = table.interpolate(x);
+		for (size_t i = 0; i < x.size(); i++) {
+			double expected = interpolate(x[i], X, y);
+			EXPECT_NEAR(expected, table.interpolate(x[i]), 1e-12);
+			EXPECT_NEAR(expected, batch[i], 1e-12);
+		}
+	}
+}
+
+TEST(DataTable, parse) {
+	std::string filename = "DataTableTest.txt";
+	{
+		std::ofstream out(filename.c_str());
+		out << "# header\n1 2 3\n\n  # indented comment\n4.5\t-6e3\n7\r\n";
+	}
+	ref_ptr<DataTable> table = DataTable::parse(filename);
+	EXPECT_FALSE(table->isMapped());
+	EXPECT_EQ(3, table->rows());
+	EXPECT_EQ(6, table->size());
+	EXPECT_EQ(3, table->columns(0));
+	EXPECT_EQ(2, table->columns(1));
+	EXPECT_EQ(1, table->columns(2));
+	EXPECT_DOUBLE_EQ(3, (*table)(0, 2));
+	EXPECT_DOUBLE_EQ(-6000, (*table)(1, 1));
+	EXPECT_DOUBLE_EQ(7, table->row(2)[0]);
+	EXPECT_THROW((*table)(1, 2), std::runtime_error);
+	EXPECT_THROW(table->row(3), std::runtime_error);
+
+	{
+		std::ofstream out(filename.c_str());
+		out << "1 2 x\n";
+	}
+	EXPECT_THROW(DataTable::parse(filename), std::runtime_error);
+	EXPECT_THROW(DataTable::parse("DataTableMissing.txt"), std::runtime_error);
+	remove(filename.c_str());
+}
+
+TEST(DataTable, parseLocale) {
+	// the numbers are parsed independent of a comma as decimal separator of the process
+	std::string previous = setlocale(LC_NUMERIC, 0);
+	const char *names[] = {"de_DE.UTF-8", "de_DE.utf8", "de_DE", "fr_FR.UTF-8", "fr_FR"};
+	bool found = false;
+	for (int i = 0; (i < 5) and not found; i++)
+		found = (setlocale(LC_NUMERIC, names[i]) != 0);
+	if (not found)
+		return; // no locale with a decimal comma installed
+
+	std::string filename = "DataTableLocaleTest.txt";
+	{
+		std::ofstream out(filename.c_str());
+		out << "1.5 2.25\n";
+	}
+	ref_ptr<DataTable> table;
+	EXPECT_NO_THROW(table = DataTable::parse(filename));
+	setlocale(LC_NUMERIC, previous.c_str());
+	remove(filename.c_str());
+	ASSERT_TRUE(table.valid());
+	EXPECT_EQ(2, table->size());
+	EXPECT_DOUBLE_EQ(2.25, (*table)(0, 1));
+}
+
+TEST(DataTable, cache) {
+	std::string filename = "DataTableCacheTest.txt";
+	std::string cachename = DataTable::getCacheFilename(filename);
+	remove(cachename.c_str());
+	{
+		std::ofstream out(filename.c_str());
+		out << "# x y\n1 10\n2 20\n3 30\n";
+	}
+
+	// first load creates the cache, second load maps it
+	ref_ptr<DataTable> parsed = DataTable::load(filename);
+	ref_ptr<DataTable> mapped = DataTable::load(filename);
+#ifndef _WIN32
+	EXPECT_TRUE(mapped->isMapped());
+#endif
+	EXPECT_EQ(parsed->rows(), mapped->rows());
+	EXPECT_EQ(parsed->size(), mapped->size());
+	for (size_t i = 0; i < mapped->size(); i++)
+		EXPECT_EQ(parsed->data()[i], mapped->data()[i]);
+
+	// a changed text file invalidates the cache
+	{
+		std::ofstream out(filename.c_str());
+		out << "# x y\n1 10\n2 20\n3 30\n4 40\n";
+	}
+	ref_ptr<DataTable> updated = DataTable::load(filename);
+	EXPECT_EQ(4, updated->rows());
+	EXPECT_DOUBLE_EQ(40, (*updated)(3, 1));
+
+#ifndef _WIN32
+	// a touched but unchanged text file keeps the cache and refreshes its time
+	struct stat st;
+	stat(filename.c_str(), &st);
+	struct utimbuf times;
+	times.actime = st.st_atime;
+	times.modtime = st.st_mtime - 100;
+	utime(filename.c_str(), &times);
+	ref_ptr<DataTable> touched = DataTable::load(filename);
+	EXPECT_TRUE(touched->isMapped());
+	EXPECT_EQ(4, touched->rows());
+	int64_t cachedTime = 0;
+	{
+		// modification time of the text file as stored in the cache header
+		std::ifstream cache(cachename.c_str(), std::ios::binary);
+		cache.seekg(24);
+		cache.read((char *) &cachedTime, sizeof(cachedTime));
+	}
+	EXPECT_EQ(int64_t(st.st_mtime - 100), cachedTime);
+#endif
+
+	remove(filename.c_str());
+	remove(cachename.c_str());
+}
+
+struct RegistryTestTable: public Referenced {
+	static int constructed;
+	std::string filename;
+	RegistryTestTable(const std::string &filename) : filename(filename) {
+		constructed++;
+	}
+};
+int RegistryTestTable::constructed = 0;
+
+TEST(TableRegistry, shared) {
+	TableRegistry::clear();
+	ref_ptr<const RegistryTestTable> a = TableRegistry::get<RegistryTestTable>("a.txt");
+	ref_ptr<const RegistryTestTable> b = TableRegistry::get<RegistryTestTable>("b.txt");
+	ref_ptr<const RegistryTestTable> a2 = TableRegistry::get<RegistryTestTable>("a.txt");
+	EXPECT_EQ(2, RegistryTestTable::constructed);
+	EXPECT_EQ(2, TableRegistry::size());
+	EXPECT_EQ(a.get(), a2.get());
+	EXPECT_NE(a.get(), b.get());
+	EXPECT_EQ("b.txt", b->filename);
+
+	// tables stay valid after clearing the registry, new requests construct new tables
+	TableRegistry::clear();
+	EXPECT_EQ(0, TableRegistry::size());
+	EXPECT_EQ("a.txt", a->filename);
+	TableRegistry::get<RegistryTestTable>("a.txt");
+	EXPECT_EQ(3, RegistryTestTable::constructed);
+	TableRegistry::clear();
+}
+
+TEST(TableRegistry, release) {
+	TableRegistry::clear();
+	RegistryTestTable::constructed = 0;
+	std::string filename = "TableRegistryTest.txt";
+	{
+		std::ofstream out(filename.c_str());
+		out << "1\n";
+	}
+
+	// unused tables are released
+	ref_ptr<const RegistryTestTable> a = TableRegistry::get<RegistryTestTable>(filename);
+	TableRegistry::get<RegistryTestTable>("b.txt");
+	EXPECT_EQ(2, TableRegistry::size());
+	TableRegistry::prune();
+	EXPECT_EQ(1, TableRegistry::size());
+
+	// a rewritten file is loaded again
+	{
+		std::ofstream out(filename.c_str());
+		out << "1 2\n";
+	}
+	ref_ptr<const RegistryTestTable> a2 = TableRegistry::get<RegistryTestTable>(filename);
+	EXPECT_NE(a.get(), a2.get());
+	EXPECT_EQ(3, RegistryTestTable::constructed);
+
+	// remove drops the entries of a file, users keep their tables
+	TableRegistry::remove(filename);
+	EXPECT_EQ(0, TableRegistry::size());
+	EXPECT_EQ(filename, a2->filename);
+	TableRegistry::get<RegistryTestTable>(filename);
+	EXPECT_EQ(4, RegistryTestTable::constructed);
+
+	TableRegistry::clear();
+	remove(filename.c_str());
+}
+
+TEST(Cosmology, inverse) {
+	// Test if the conversions to and from redshift are consistent.
+	for (int i = 0; i <= 100; i++) {
+		double z = pow(10, -5 + 7. * i / 100);
+		EXPECT_NEAR(z, comovingDistance2Redshift(redshift2ComovingDistance(z)), 1e-12 * z);
+		EXPECT_NEAR(z, luminosityDistance2Redshift(redshift2LuminosityDistance(z)), 1e-12 * z);
+		EXPECT_NEAR(z, lightTravelDistance2Redshift(redshift2LightTravelDistance(z)), 1e-12 * z);
+		double d = redshift2ComovingDistance(z);
+		EXPECT_NEAR(d, lightTravel2ComovingDistance(comoving2LightTravelDistance(d)), 1e-12 * d);
+	}
+
+	// small distances: Hubble law
+	EXPECT_NEAR(1e-6, comovingDistance2Redshift(1e-6 * c_light / H0()), 1e-9);
+	EXPECT_THROW(comovingDistance2Redshift(-1), std::runtime_error);
+	EXPECT_THROW(redshift2ComovingDistance(101), std::runtime_error);
+}
+
+TEST(Cosmology, batch) {
+	std::vector<double> d;
+	for (int i = 0; i < 100; i++)
+		d.push_back(i * 50 * Mpc);
+	std::vector<double> z = comovingDistance2Redshift(d);
+	std::vector<double> t = comoving2LightTravelDistance(d);
+	ASSERT_EQ(d.size(), z.size());
+	for (size_t i = 0; i < d.size(); i++) {
+		EXPECT_DOUBLE_EQ(comovingDistance2Redshift(d[i]), z[i]);
+		EXPECT_DOUBLE_EQ(comoving2LightTravelDistance(d[i]), t[i]);
+	}
+}
+
+TEST(Cosmology, setParameters) {
+	double z = comovingDistance2Redshift(1000 * Mpc);
+	setCosmologyParameters(0.7, 0.3);
+	EXPECT_DOUBLE_EQ(0.3, omegaM());
+	EXPECT_DOUBLE_EQ(0.7, omegaL());
+	EXPECT_NEAR(70 * 1000 * meter / second / Mpc, H0(), 1e-12 * H0());
+	EXPECT_GT(comovingDistance2Redshift(1000 * Mpc), z);
+	setCosmologyParameters(0.673, 0.315);
+	EXPECT_DOUBLE_EQ(z, comovingDistance2Redshift(1000 * Mpc));
+}
+
+TEST(Cosmology, setParametersConcurrently) {
+	// lookups during a change see either the old or the new parameters
+	double z1 = comovingDistance2Redshift(1000 * Mpc);
+	setCosmologyParameters(0.7, 0.3);
+	double z2 = comovingDistance2Redshift(1000 * Mpc);
+
+	int mismatches = 0;
+#pragma omp parallel for reduction(+:mismatches)
+	for (int i = 0; i < 2000; i++) {
+		if (i % 100 == 0) {
+			if (i % 200 == 0)
+				setCosmologyParameters(0.673, 0.315);
+			else
+				setCosmologyParameters(0.7, 0.3);
+			continue;
+		}
+		double z = comovingDistance2Redshift(1000 * Mpc);
+		mismatches += (z != z1) and (z != z2);
+	}
+	EXPECT_EQ(0, mismatches);
+
+	setCosmologyParameters(0.673, 0.315);
+	EXPECT_DOUBLE_EQ(z1, comovingDistance2Redshift(1000 * Mpc));
+}
+
 TEST(common, pow_integer)
 {
 	EXPECT_EQ(pow_integer<0>(1.23), 1);
@@ -410,6 +737,122 @@ TEST(Random, base64Seed) {
 	}
 }
 
+TEST(DiscreteSampler, distribution) {
+	std::vector<double> weights;
+	weights.push_back(1);
+	weights.push_back(0);
+	weights.push_back(3);
+	weights.push_back(6);
+	DiscreteSampler sampler(weights);
+	EXPECT_EQ(4, sampler.size());
+	EXPECT_DOUBLE_EQ(10, sampler.getTotalWeight());
+	EXPECT_DOUBLE_EQ(0.3, sampler.getProbability(2));
+
+	Random random(42);
+	std::vector<int> counts(4, 0);
+	int N = 100000;
+	for (int i = 0; i < N; i++)
+		counts[sampler.sample(random)]++;
+
+	EXPECT_NEAR(0.1, counts[0] / double(N), 0.005);
+	EXPECT_EQ(0, counts[1]); // bins with zero weight are never drawn
+	EXPECT_NEAR(0.3, counts[2] / double(N), 0.005);
+	EXPECT_NEAR(0.6, counts[3] / double(N), 0.005);
+}
+
+TEST(DiscreteSampler, cdf) {
+	// same distribution as cumulative distribution in randBin convention
+	std::vector<float> cdf;
+	cdf.push_back(0);
+	cdf.push_back(2);
+	cdf.push_back(2);
+	cdf.push_back(8);
+	DiscreteSampler sampler;
+	sampler.setCDF(cdf);
+	EXPECT_DOUBLE_EQ(0, sampler.getProbability(0));
+	EXPECT_DOUBLE_EQ(0.25, sampler.getProbability(1));
+	EXPECT_DOUBLE_EQ(0, sampler.getProbability(2));
+	EXPECT_DOUBLE_EQ(0.75, sampler.getProbability(3));
+
+	Random random(42);
+	for (int i = 0; i < 1000; i++) {
+		size_t j = sampler.sample(random);
+		EXPECT_TRUE((j == 1) or (j == 3));
+	}
+}
+
+TEST(DiscreteSampler, add) {
+	DiscreteSampler sampler;
+	EXPECT_TRUE(sampler.empty());
+	EXPECT_THROW(sampler.sample(), std::runtime_error);
+	EXPECT_THROW(sampler.add(-1), std::runtime_error);
+
+	// table is rebuilt after adding bins
+	sampler.add(1);
+	EXPECT_EQ(0, sampler.sample());
+	sampler.add(0);
+	sampler.add(1);
+	EXPECT_DOUBLE_EQ(0.5, sampler.getProbability(2));
+
+	Random random(7);
+	int n2 = 0;
+	for (int i = 0; i < 10000; i++) {
+		size_t j = sampler.sample(random);
+		EXPECT_NE(1, j);
+		n2 += (j == 2);
+	}
+	EXPECT_NEAR(0.5, n2 / 10000., 0.02);
+}
+
+TEST(DiscreteSampler, threadedRebuild) {
+	// the lazy rebuild after add must be complete before any thread draws
+	DiscreteSampler sampler;
+	for (int i = 0; i < 1000; i++)
+		sampler.add(i % 2);
+	DiscreteSampler copy(sampler);
+	EXPECT_DOUBLE_EQ(500, copy.getTotalWeight());
+
+	int odd = 0;
+#pragma omp parallel for reduction(+:odd)
+	for (int i = 0; i < 10000; i++)
+		odd += sampler.sample() % 2;
+	EXPECT_EQ(10000, odd);
+}
+
+// Draws per second of randBin and DiscreteSampler for tables of 16, 1000
+// and 1e6 bins. Run with --gtest_also_run_disabled_tests.
+TEST(DiscreteSampler, DISABLED_benchmark) {
+	Random random(42);
+	size_t sizes[] = {16, 1000, 1000000};
+	for (size_t k = 0; k < 3; k++) {
+		size_t n = sizes[k];
+		std::vector<double> cdf(n);
+		double sum = 0;
+		for (size_t i = 0; i < n; i++) {
+			sum += random.rand();
+			cdf[i] = sum;
+		}
+		DiscreteSampler sampler;
+		sampler.setCDF(cdf);
+
+		int N = 10000000;
+		size_t check = 0;
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		for (int i = 0; i < N; i++)
+			check += random.randBin(cdf);
+		std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+		for (int i = 0; i < N; i++)
+			check += sampler.sample(random);
+		std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+
+		double tBin = std::chrono::duration<double>(t1 - t0).count();
+		double tAlias = std::chrono::duration<double>(t2 - t1).count();
+		std::cout << n << " bins: randBin " << N / tBin / 1e6
+			<< " M/s, alias " << N / tAlias / 1e6 << " M/s"
+			<< " (" << check % 2 << ")" << std::endl;
+	}
+}
+
 
 
 TEST(Grid, PeriodicClamp) {
@@ -798,6 +1241,79 @@ TEST(Grid3f, Reflectivity) {
 	EXPECT_FLOAT_EQ(b.z, b2.z);
 }
 
+TEST(Grid3f, InterpolateBatch) {
+	// the batch interpolation gives the same values as the single one
+	ref_ptr<Grid3f> grid = new Grid3f(Vector3d(0.), 4, 5, 6, 1.);
+	Random random(42);
+	for (int ix = 0; ix < 4; ix++)
+		for (int iy = 0; iy < 5; iy++)
+			for (int iz = 0; iz < 6; iz++)
+				grid->get(ix, iy, iz) = Vector3f(random.rand(), random.rand(), random.rand());
+
+	std::vector<Vector3d> positions;
+	for (int i = 0; i < 40; i++)
+		positions.push_back(random.randVector() * random.rand() * 20);
+	std::vector<Vector3f> values(positions.size());
+
+	for (int reflective = 0; reflective < 2; reflective++) {
+		grid->setReflective(reflective);
+		grid->interpolate(positions.data(), values.data(), positions.size());
+		for (size_t i = 0; i < positions.size(); i++)
+			EXPECT_EQ(grid->interpolate(positions[i]), values[i]);
+	}
+
+	grid->setInterpolationType(NEAREST_NEIGHBOUR);
+	grid->interpolate(positions.data(), values.data(), positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+		EXPECT_EQ(grid->closestValue(positions[i]), values[i]);
+}
+
+TEST(Grid3f, Kernels) {
+	// all kernels supported by the CPU give exactly the values of the scalar interpolation
+	ref_ptr<Grid3f> grid = new Grid3f(Vector3d(-2.), 5, 7, 6, Vector3d(1., 0.5, 2.));
+	ref_ptr<Grid1f> grid1 = new Grid1f(Vector3d(-2.), 5, 7, 6, Vector3d(1., 0.5, 2.));
+	Random random(7);
+	for (int ix = 0; ix < 5; ix++)
+		for (int iy = 0; iy < 7; iy++)
+			for (int iz = 0; iz < 6; iz++) {
+				grid->get(ix, iy, iz) = Vector3f(random.rand(), random.rand(), random.rand());
+				grid1->get(ix, iy, iz) = random.rand();
+			}
+
+	// including a remainder for the scalar interpolation
+	std::vector<Vector3d> positions;
+	for (int i = 0; i < 101; i++)
+		positions.push_back(random.randVector() * random.rand() * 50);
+	// and positions halfway between grid points, where nearest neighbour rounds away from zero
+	Vector3d spacing(1., 0.5, 2.);
+	for (int i = -16; i < 16; i++)
+		positions.push_back(Vector3d(-2.) + spacing * (Vector3d(i, i / 2, -i) + 0.5) + spacing / 2);
+	std::vector<Vector3f> values(positions.size());
+	std::vector<float> values1(positions.size());
+
+	gridKernelType best = getBestGridKernel();
+	EXPECT_EQ(best, getGridKernel());
+	for (int k = SCALAR_KERNEL; k <= best; k++) {
+		setGridKernel(gridKernelType(k));
+		for (int nearest = 0; nearest < 2; nearest++) {
+			grid->setInterpolationType(nearest ? NEAREST_NEIGHBOUR : TRILINEAR);
+			grid1->setInterpolationType(nearest ? NEAREST_NEIGHBOUR : TRILINEAR);
+			grid->interpolate(positions.data(), values.data(), positions.size());
+			grid1->interpolate(positions.data(), values1.data(), positions.size());
+			for (size_t i = 0; i < positions.size(); i++) {
+				Vector3f b = nearest ? grid->closestValue(positions[i]) : grid->interpolate(positions[i]);
+				EXPECT_EQ(b, values[i]);
+				float b1 = nearest ? grid1->closestValue(positions[i]) : grid1->interpolate(positions[i]);
+				EXPECT_EQ(b1, values1[i]);
+			}
+		}
+	}
+	setGridKernel(best);
+	if (best < AVX512_KERNEL) {
+		EXPECT_THROW(setGridKernel(AVX512_KERNEL), std::runtime_error);
+	}
+}
+
 TEST(Grid3f, DumpLoad) {
 	// Dump and load a field grid
 	ref_ptr<Grid3f> grid1 = new Grid3f(Vector3d(0.), 3, 1);
@@ -850,6 +1366,288 @@ TEST(Grid3f, DumpLoadTxt) {
 	}
 }
 
+TEST(Grid3f, SaveMap) {
+	// a saved grid is mapped with its properties and values
+	ref_ptr<Grid3f> grid1 = new Grid3f(Vector3d(1, 2, 3), 3, 4, 5, Vector3d(1, 2, 0.5));
+	Random random(7);
+	for (int ix = 0; ix < 3; ix++)
+		for (int iy = 0; iy < 4; iy++)
+			for (int iz = 0; iz < 5; iz++)
+				grid1->get(ix, iy, iz) = Vector3f(random.rand(), random.rand(), random.rand());
+	grid1->setReflective(true);
+	grid1->setInterpolationType(NEAREST_NEIGHBOUR);
+	grid1->save("testSave.grid");
+
+	ref_ptr<Grid3f> grid2 = new Grid3f("testSave.grid");
+	EXPECT_TRUE(grid2->isMapped());
+	EXPECT_EQ(grid1->getOrigin(), grid2->getOrigin());
+	EXPECT_EQ(grid1->getSpacing(), grid2->getSpacing());
+	EXPECT_EQ(4, grid2->getNy());
+	EXPECT_TRUE(grid2->isReflective());
+	for (int i = 0; i < 20; i++) {
+		Vector3d pos = random.randVector() * 10;
+		EXPECT_EQ(grid1->closestValue(pos), grid2->interpolate(pos));
+	}
+
+	// mapped values are read-only until copied into memory
+	EXPECT_FALSE(grid2->isWritable());
+	EXPECT_THROW(grid2->get(1, 2, 3), std::runtime_error);
+	EXPECT_THROW(grid2->setValue(1, 2, 3, Vector3f(0.)), std::runtime_error);
+	EXPECT_THROW(grid2->getGrid(), std::runtime_error);
+	grid2->detach();
+	EXPECT_FALSE(grid2->isMapped());
+	EXPECT_TRUE(grid2->isWritable());
+	EXPECT_EQ(grid1->get(1, 2, 3), grid2->get(1, 2, 3));
+
+	// raw files without header
+	grid1->setReflective(false);
+	grid1->setInterpolationType(TRILINEAR);
+	dumpGrid(grid1, "testDump.raw");
+	GridProperties properties(Vector3d(1, 2, 3), 3, 4, 5, Vector3d(1, 2, 0.5));
+	Grid3f grid3(properties, "testDump.raw");
+	EXPECT_TRUE(grid3.isMapped());
+	for (int i = 0; i < 20; i++) {
+		Vector3d pos = random.randVector() * 10;
+		EXPECT_EQ(grid1->interpolate(pos), grid3.interpolate(pos));
+	}
+
+	// value types and sizes must match
+	EXPECT_THROW(Grid1f("testSave.grid"), std::runtime_error);
+	EXPECT_THROW(Grid3f(GridProperties(Vector3d(0.), 3, 1), "testDump.raw"), std::runtime_error);
+	EXPECT_THROW(Grid3f("testDump.raw"), std::runtime_error);
+}
+
+TEST(Grid, HalfPrecision) {
+	EXPECT_EQ(0x3c00, floatToHalf(1.f));
+	EXPECT_EQ(0xc000, floatToHalf(-2.f));
+	EXPECT_EQ(0x7bff, floatToHalf(65504.f));
+	EXPECT_EQ(0x7c00, floatToHalf(1e6f));
+	EXPECT_EQ(0x0001, floatToHalf(5.9604645e-8f));
+	EXPECT_EQ(0x3c00, floatToHalf(1.f + 1.f / 4096)); // rounded to even
+	EXPECT_EQ(0x3c02, floatToHalf(1.f + 3.f / 2048));
+
+	// all finite values are converted back exactly
+	for (uint32_t h = 0; h < 0x10000; h++) {
+		if ((h & 0x7c00) != 0x7c00) {
+			EXPECT_EQ(h, floatToHalf(halfToFloat(h)));
+		}
+	}
+	EXPECT_TRUE(std::isinf(halfToFloat(0xfc00)));
+	EXPECT_TRUE(std::isnan(halfToFloat(0x7e00)));
+}
+
+TEST(Grid3f, StorageTypes) {
+	// values of a typical magnetic field in SI units
+	ref_ptr<Grid3f> grid = new Grid3f(Vector3d(0.), 8, 8, 20, 1.);
+	Random random(11);
+	for (int ix = 0; ix < 8; ix++)
+		for (int iy = 0; iy < 8; iy++)
+			for (int iz = 0; iz < 20; iz++)
+				grid->get(ix, iy, iz) = Vector3f(random.randNorm(), random.randNorm(), random.randNorm()) * 1e-10;
+	Grid3f reference(*grid);
+	size_t size = grid->getSizeOf();
+
+	storageType types[] = {HALF_PRECISION, QUANTIZED_INT16};
+	double tolerance[] = {1e-3, 1e-4};
+	for (int t = 0; t < 2; t++) {
+		grid = new Grid3f(reference);
+		double error = convertGridStorage(grid, types[t]);
+		EXPECT_EQ(types[t], grid->getStorageType());
+		EXPECT_GT(error, 0);
+		EXPECT_LT(error, tolerance[t]);
+		EXPECT_LT(grid->getSizeOf(), size * 0.6);
+
+		double rms = rmsFieldStrength(grid);
+		for (int i = 0; i < 50; i++) {
+			Vector3d pos = random.randVector() * random.rand() * 30;
+			EXPECT_NEAR(0, (reference.interpolate(pos) - grid->interpolate(pos)).getR(), 10 * tolerance[t] * rms);
+			EXPECT_NEAR(0, (reference.closestValue(pos) - grid->closestValue(pos)).getR(), 10 * tolerance[t] * rms);
+		}
+
+		// the values are read-only until restored to full precision
+		EXPECT_THROW(grid->get(0, 0, 0), std::runtime_error);
+		grid->detach();
+		grid->get(0, 0, 0) = Vector3f(1, 2, 3);
+		EXPECT_EQ(FULL_PRECISION, grid->getStorageType());
+		EXPECT_NEAR(0, (reference.get(1, 2, 3) - grid->get(1, 2, 3)).getR(), 10 * tolerance[t] * rms);
+	}
+
+	Grid3d grid3d(Vector3d(0.), 2, 1.);
+	EXPECT_THROW(grid3d.setStorageType(HALF_PRECISION), std::runtime_error);
+}
+
+TEST(Grid3f, BrickedLayout) {
+	// the bricked layout gives the same values, also for sizes that are no multiple of the brick size
+	ref_ptr<Grid3f> grid = new Grid3f(Vector3d(-1.), 9, 17, 12, 0.5);
+	Random random(13);
+	for (int ix = 0; ix < 9; ix++)
+		for (int iy = 0; iy < 17; iy++)
+			for (int iz = 0; iz < 12; iz++)
+				grid->get(ix, iy, iz) = Vector3f(random.rand(), random.rand(), random.rand());
+	Grid3f reference(*grid);
+
+	grid->setLayout(BRICKED);
+	EXPECT_EQ(BRICKED, grid->getLayout());
+	EXPECT_EQ(sizeof(std::vector<Vector3f>) + 2 * 3 * 2 * 512 * sizeof(Vector3f), grid->getSizeOf());
+	for (int ix = 0; ix < 9; ix++)
+		for (int iy = 0; iy < 17; iy++)
+			for (int iz = 0; iz < 12; iz++)
+				EXPECT_EQ(reference.get(ix, iy, iz), grid->get(ix, iy, iz));
+
+	std::vector<Vector3d> positions;
+	for (int i = 0; i < 100; i++)
+		positions.push_back(random.randVector() * random.rand() * 20);
+	std::vector<Vector3f> values(positions.size());
+	for (int reflective = 0; reflective < 2; reflective++) {
+		reference.setReflective(reflective);
+		grid->setReflective(reflective);
+		grid->interpolate(positions.data(), values.data(), positions.size());
+		for (size_t i = 0; i < positions.size(); i++) {
+			EXPECT_EQ(reference.interpolate(positions[i]), values[i]);
+			EXPECT_EQ(reference.closestValue(positions[i]), grid->closestValue(positions[i]));
+		}
+	}
+
+	// also with 16 bit storage
+	grid->setStorageType(QUANTIZED_INT16);
+	EXPECT_EQ(BRICKED, grid->getLayout());
+	const Grid3f &packed = *grid;
+	EXPECT_NEAR(reference.get(8, 16, 11).x, packed.get(8, 16, 11).x, 1e-4);
+
+	// the grid vector is returned in row-major order
+	grid->detach();
+	std::vector<Vector3f> &v = grid->getGrid();
+	EXPECT_EQ(ROW_MAJOR, grid->getLayout());
+	EXPECT_EQ(9 * 17 * 12, v.size());
+	EXPECT_NEAR(reference.get(8, 16, 11).x, v.back().x, 1e-4);
+}
+
+TEST(Grid3f, DISABLED_benchmarkLayout) {
+	// random lookups in row-major and bricked grids of 256^3 to 2048^3 points,
+	// skipping the grids that do not fit into the physical memory
+	double memory = (double)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+	size_t sizes[] = {256, 512, 1024, 2048};
+	interpolationType types[] = {TRILINEAR, TRICUBIC};
+	const char *typeNames[] = {"trilinear", "tricubic"};
+#if HAVE_SIMD
+	size_t nTypes = 2;
+#else
+	size_t nTypes = 1; // tricubic needs the SIMD build
+#endif
+	layoutType layouts[] = {ROW_MAJOR, BRICKED};
+	const char *layoutNames[] = {"row-major", "bricked"};
+	for (size_t k = 0; k < 4; k++) {
+		size_t n = sizes[k];
+		if (n * n * n * sizeof(Vector3f) > 0.8 * memory) {
+			std::cout << n << "^3: skipped, grid larger than the memory" << std::endl;
+			continue;
+		}
+		for (size_t l = 0; l < 2; l++) {
+			Grid3f grid(Vector3d(0.), n, 1.);
+			grid.setLayout(layouts[l]);
+			for (size_t ix = 0; ix < n; ix++)
+				for (size_t iy = 0; iy < n; iy++)
+					for (size_t iz = 0; iz < n; iz++)
+						grid.get(ix, iy, iz) = Vector3f(ix, iy, iz);
+
+			Random random(42);
+			std::vector<Vector3d> positions(2000000);
+			for (size_t i = 0; i < positions.size(); i++)
+				positions[i] = random.randVector() * random.rand() * n;
+
+			for (size_t t = 0; t < nTypes; t++) {
+				grid.setInterpolationType(types[t]);
+				int N = positions.size();
+				double best = 0;
+				Vector3d check(0.);
+				for (int repeat = 0; repeat < 5; repeat++) {
+					std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+					for (int i = 0; i < N; i++)
+						check += grid.interpolate(positions[i]);
+					std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+					best = std::max(best, N / std::chrono::duration<double>(t1 - t0).count());
+				}
+				std::cout << n << "^3 " << layoutNames[l] << " " << typeNames[t]
+					<< ": " << best / 1e6 << " Mlookups/s"
+					<< " (" << check.getR() << ")" << std::endl;
+			}
+		}
+	}
+}
+
+TEST(GridTools, Statistics) {
+	// the parallel reductions agree with a plain sum, in any storage and for mapped grids
+	ref_ptr<Grid3f> grid = new Grid3f(Vector3d(0.), 11, 6, 9, 1.);
+	Random random(17);
+	Vector3d sum(0.), sum2(0.);
+	double sumR = 0;
+	for (int ix = 0; ix < 11; ix++)
+		for (int iy = 0; iy < 6; iy++)
+			for (int iz = 0; iz < 9; iz++) {
+				Vector3f b(random.randNorm() + 1, random.randNorm(), 2 * random.randNorm());
+				grid->get(ix, iy, iz) = b;
+				sum += Vector3d(b);
+				sum2 += Vector3d(b) * Vector3d(b);
+				sumR += Vector3d(b).getR();
+			}
+	double n = 11 * 6 * 9;
+
+	GridStatistics stat = gridStatistics(grid);
+	EXPECT_EQ(11 * 6 * 9, stat.count);
+	EXPECT_NEAR(sum.x / n, stat.mean.x, 1e-12);
+	EXPECT_NEAR(sum.z / n, stat.mean.z, 1e-12);
+	EXPECT_NEAR(sumR / n, stat.meanStrength, 1e-12);
+	EXPECT_NEAR(std::sqrt(sum2.y / n), stat.rmsPerAxis.y, 1e-12);
+	EXPECT_NEAR(std::sqrt((sum2.x + sum2.y + sum2.z) / n), stat.rms, 1e-12);
+	EXPECT_FLOAT_EQ(stat.rms, rmsFieldStrength(grid));
+	EXPECT_FLOAT_EQ(stat.meanStrength, meanFieldStrength(grid));
+	EXPECT_FLOAT_EQ(stat.mean.y, meanFieldVector(grid).y);
+	EXPECT_FLOAT_EQ(stat.rmsPerAxis.z, rmsFieldStrengthPerAxis(grid)[2]);
+
+	// streamed from a file
+	grid->save("testStatistics.grid");
+	GridStatistics streamed = gridStatistics("testStatistics.grid");
+	EXPECT_EQ(stat.mean, streamed.mean);
+	EXPECT_EQ(stat.rms, streamed.rms);
+	ref_ptr<Grid3f> mapped = new Grid3f("testStatistics.grid");
+	EXPECT_EQ(stat.rms, rmsFieldStrength(mapped));
+	EXPECT_TRUE(mapped->isMapped());
+
+	// other layouts
+	ref_ptr<Grid3f> bricked = new Grid3f(*grid);
+	bricked->setLayout(BRICKED);
+	EXPECT_NEAR(stat.rms, rmsFieldStrength(bricked), 1e-12);
+	scaleGrid(bricked, 2);
+	EXPECT_NEAR(2 * stat.rms, rmsFieldStrength(bricked), 1e-6);
+	EXPECT_EQ(grid->get(10, 5, 8) * 2.f, bricked->get(10, 5, 8));
+	scaleGrid(mapped, 0.5);
+	EXPECT_FALSE(mapped->isMapped());
+	EXPECT_EQ(grid->get(3, 2, 1) * 0.5f, mapped->get(3, 2, 1));
+
+	ref_ptr<Grid1f> scalar = new Grid1f(Vector3d(0.), 5, 7, 3, 1.);
+	sumR = 0;
+	double sumR2 = 0;
+	for (int ix = 0; ix < 5; ix++)
+		for (int iy = 0; iy < 7; iy++)
+			for (int iz = 0; iz < 3; iz++) {
+				float v = random.randNorm();
+				scalar->get(ix, iy, iz) = v;
+				sumR += v;
+				sumR2 += double(v) * v;
+			}
+	EXPECT_NEAR(sumR / 105, meanFieldStrength(scalar), 1e-12);
+	EXPECT_NEAR(std::sqrt(sumR2 / 105), rmsFieldStrength(scalar), 1e-12);
+	scalar->setStorageType(HALF_PRECISION);
+	EXPECT_NEAR(std::sqrt(sumR2 / 105), rmsFieldStrength(scalar), 1e-3);
+
+	// sampling a field
+	fromMagneticField(grid, new UniformMagneticField(Vector3d(1, 2, 3)));
+	EXPECT_EQ(Vector3f(1, 2, 3), grid->get(7, 4, 2));
+	EXPECT_FLOAT_EQ(std::sqrt(14.), rmsFieldStrength(grid));
+	fromMagneticFieldStrength(scalar, new UniformMagneticField(Vector3d(0, 3, 4)));
+	EXPECT_EQ(5, scalar->get(4, 6, 2));
+}
+
 TEST(Grid3f, Speed) {
 	// Dump and load a field grid
 	Grid3f grid(Vector3d(0.), 3, 3);
@@ -863,6 +1661,122 @@ TEST(Grid3f, Speed) {
 		b = grid.interpolate(Vector3d(i));
 }
 
+TEST(OctreeGrid3f, RootCells) {
+	// without refinement the octree grid interpolates as a periodic grid
+	ref_ptr<Grid3f> grid = new Grid3f(Vector3d(1.), 4, 5, 6, 2.);
+	ref_ptr<OctreeGrid3f> octree = new OctreeGrid3f(Vector3d(1.), 4, 5, 6, Vector3d(2.));
+	Random random(42);
+	for (int ix = 0; ix < 4; ix++)
+		for (int iy = 0; iy < 5; iy++)
+			for (int iz = 0; iz < 6; iz++) {
+				Vector3f b(random.rand(), random.rand(), random.rand());
+				grid->get(ix, iy, iz) = b;
+				octree->setCell(Vector3d(1.) + Vector3d(ix, iy, iz) * 2. + Vector3d(0.5), 0, b);
+			}
+
+	EXPECT_EQ(120, octree->getNumberOfCells());
+	EXPECT_EQ(0, octree->getMaximumLevel());
+	for (int i = 0; i < 100; i++) {
+		Vector3d pos = random.randVector() * random.rand() * 30;
+		Vector3f b1 = grid->interpolate(pos);
+		Vector3f b2 = octree->interpolate(pos);
+		EXPECT_NEAR(b1.x, b2.x, 1e-6);
+		EXPECT_NEAR(b1.y, b2.y, 1e-6);
+		EXPECT_NEAR(b1.z, b2.z, 1e-6);
+		EXPECT_EQ(grid->closestValue(pos), octree->closestValue(pos));
+	}
+}
+
+TEST(OctreeGrid3f, Refinement) {
+	OctreeGrid3f grid(Vector3d(0.), 2, 1.);
+	grid.setCell(Vector3d(0.5), 0, Vector3f(1, 0, 0));
+	grid.setCell(Vector3d(0.1, 0.1, 0.1), 2, Vector3f(2, 0, 0));
+
+	// the coarser cells on the way inherit the value
+	EXPECT_EQ(2, grid.getMaximumLevel());
+	EXPECT_EQ(8 + 7 + 7, grid.getNumberOfCells());
+	EXPECT_EQ(8 + 8 + 8, grid.getNumberOfNodes());
+	EXPECT_EQ(2, grid.getLevel(Vector3d(0.1)));
+	EXPECT_EQ(2, grid.getLevel(Vector3d(0.3)));
+	EXPECT_EQ(1, grid.getLevel(Vector3d(0.9)));
+	EXPECT_EQ(0, grid.getLevel(Vector3d(1.5)));
+	EXPECT_EQ(Vector3f(2, 0, 0), grid.closestValue(Vector3d(0.1)));
+	EXPECT_EQ(Vector3f(1, 0, 0), grid.closestValue(Vector3d(0.3)));
+	EXPECT_EQ(Vector3f(0, 0, 0), grid.closestValue(Vector3d(1.5)));
+	EXPECT_EQ(Vector3d(0.25), grid.getSpacing(2));
+
+	// a refined cell cannot be set
+	EXPECT_THROW(grid.setCell(Vector3d(0.1), 1, Vector3f(0.)), std::runtime_error);
+	EXPECT_EQ(3, grid.refine(Vector3d(0.1)));
+	EXPECT_EQ(8 + 7 + 7 + 7, grid.getNumberOfCells());
+
+	// periodic repetition and vanishing values outside
+	EXPECT_EQ(Vector3f(2, 0, 0), grid.closestValue(Vector3d(2.1)));
+	grid.setPeriodic(false);
+	EXPECT_EQ(Vector3f(0, 0, 0), grid.closestValue(Vector3d(2.1)));
+	EXPECT_EQ(Vector3f(0, 0, 0), grid.interpolate(Vector3d(2.1)));
+	EXPECT_EQ(-1, grid.getLevel(Vector3d(-0.1)));
+}
+
+TEST(OctreeGrid3f, Interpolation) {
+	// a linear field is interpolated exactly in regions of constant level
+	OctreeGrid1f grid(Vector3d(0.), 4, 1.);
+	grid.setPeriodic(false);
+	for (int ix = 0; ix < 4; ix++)
+		for (int iy = 0; iy < 4; iy++)
+			for (int iz = 0; iz < 4; iz++) {
+				Vector3d c = Vector3d(ix, iy, iz) + Vector3d(0.5);
+				grid.setCell(c, 0, c.x + 2 * c.y - c.z);
+			}
+	// refine the central 2^3 root cells to level 2
+	for (int ix = 0; ix < 8; ix++)
+		for (int iy = 0; iy < 8; iy++)
+			for (int iz = 0; iz < 8; iz++) {
+				Vector3d c = Vector3d(1.) + Vector3d(ix, iy, iz) * 0.25 + Vector3d(0.125);
+				grid.setCell(c, 2, c.x + 2 * c.y - c.z);
+			}
+	grid.update();
+	EXPECT_EQ(56 + 8 * 64, grid.getNumberOfCells());
+
+	Random random(1);
+	for (int i = 0; i < 50; i++) {
+		Vector3d pos = Vector3d(1.125) + Vector3d(random.rand(), random.rand(), random.rand()) * 1.75;
+		EXPECT_NEAR(pos.x + 2 * pos.y - pos.z, grid.interpolate(pos), 1e-5);
+		// the coarse neighbours use the mean of the refined cells
+		pos = Vector3d(0.5) + Vector3d(random.rand(), random.rand(), random.rand()) * 0.4;
+		EXPECT_NEAR(pos.x + 2 * pos.y - pos.z, grid.interpolate(pos), 1e-5);
+	}
+}
+
+TEST(OctreeGrid3f, DumpLoadTxt) {
+	ref_ptr<OctreeGrid3f> grid1 = new OctreeGrid3f(Vector3d(-1.), 2, 1.);
+	grid1->setCell(Vector3d(-0.5), 0, Vector3f(1, 2, 3));
+	grid1->setCell(Vector3d(0.1, 0.2, 0.6), 3, Vector3f(4, 5, 6));
+	grid1->update();
+	dumpOctreeGridToTxt(grid1, "testDump.txt", 1e4, 0.1);
+
+	ref_ptr<OctreeGrid3f> grid2 = new OctreeGrid3f(Vector3d(-1.), 2, 1.);
+	loadOctreeGridFromTxt(grid2, "testDump.txt", 1e-4, 0.1);
+	EXPECT_EQ(grid1->getNumberOfNodes(), grid2->getNumberOfNodes());
+	EXPECT_EQ(3, grid2->getMaximumLevel());
+
+	Random random(3);
+	for (int i = 0; i < 100; i++) {
+		Vector3d pos = random.randVector();
+		Vector3f b1 = grid1->interpolate(pos);
+		Vector3f b2 = grid2->interpolate(pos);
+		EXPECT_FLOAT_EQ(b1.x, b2.x);
+		EXPECT_FLOAT_EQ(b1.y, b2.y);
+		EXPECT_FLOAT_EQ(b1.z, b2.z);
+	}
+
+	// cell sizes must be power of 2 fractions of the root cells
+	std::ofstream fout("testDump.txt");
+	fout << "0.1 0.1 0.1 0.3 1 2 3\n";
+	fout.close();
+	EXPECT_THROW(loadOctreeGridFromTxt(grid2, "testDump.txt"), std::runtime_error);
+}
+
 TEST(CylindricalProjectionMap, functions) {
 	Vector3d v;
 	v.setRThetaPhi(1.0, 1.2, 2.4);
@@ -975,6 +1889,29 @@ TEST(Geometry, ParaxialBox)
 	EXPECT_NEAR(8., b.distance(Vector3d(-8., 0., 0.)), 1E-10);
 }
 
+TEST(Geometry, intersectionDistance)
+{
+	double inf = std::numeric_limits<double>::infinity();
+	Plane p(Vector3d(0, 0, 1), Vector3d(0, 0, 2));
+	EXPECT_DOUBLE_EQ(1.25, p.intersectionDistance(Vector3d(0, 0, 0), Vector3d(0, 0.6, 0.8)));
+	EXPECT_EQ(inf, p.intersectionDistance(Vector3d(0, 0, 0), Vector3d(0, 0, -1)));
+	EXPECT_EQ(inf, p.intersectionDistance(Vector3d(0, 0, 0), Vector3d(1, 0, 0)));
+
+	Sphere s(Vector3d(1, 0, 0), 1.);
+	EXPECT_DOUBLE_EQ(2., s.intersectionDistance(Vector3d(4, 0, 0), Vector3d(-1, 0, 0))); // entry
+	EXPECT_DOUBLE_EQ(1.5, s.intersectionDistance(Vector3d(0.5, 0, 0), Vector3d(1, 0, 0))); // exit
+	EXPECT_DOUBLE_EQ(2., s.intersectionDistance(Vector3d(0, 0, 0), Vector3d(1, 0, 0))); // on the surface
+	EXPECT_EQ(inf, s.intersectionDistance(Vector3d(4, 0, 0), Vector3d(1, 0, 0)));
+	EXPECT_EQ(inf, s.intersectionDistance(Vector3d(4, 2, 0), Vector3d(-1, 0, 0)));
+
+	ParaxialBox b(Vector3d(0, 0, 0), Vector3d(3, 4, 5));
+	EXPECT_DOUBLE_EQ(7., b.intersectionDistance(Vector3d(10, 1, 1), Vector3d(-1, 0, 0))); // entry
+	EXPECT_DOUBLE_EQ(2., b.intersectionDistance(Vector3d(1, 2, 2), Vector3d(0, 1, 0))); // exit
+	EXPECT_NEAR(sqrt(2.), b.intersectionDistance(Vector3d(1, 1, 1), Vector3d(-1, -1, 0).getUnitVector()), 1e-12);
+	EXPECT_EQ(inf, b.intersectionDistance(Vector3d(10, 1, 1), Vector3d(0, 1, 0)));
+	EXPECT_EQ(inf, b.intersectionDistance(Vector3d(10, 10, 1), Vector3d(-1, 0, 0)));
+}
+
 int main(int argc, char **argv) {
 	::testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
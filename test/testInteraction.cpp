@@ -1,19 +1,27 @@
 #include "crpropa/Candidate.h"
+#include "crpropa/Cosmology.h"
 #include "crpropa/Units.h"
 #include "crpropa/ParticleID.h"
 #include "crpropa/PhotonBackground.h"
+#include "crpropa/DataTable.h"
+#include "crpropa/RateTableBuilder.h"
+#include "crpropa/TableRegistry.h"
 #include "crpropa/module/ElectronPairProduction.h"
 #include "crpropa/module/NuclearDecay.h"
 #include "crpropa/module/PhotoDisintegration.h"
 #include "crpropa/module/ElasticScattering.h"
 #include "crpropa/module/PhotoPionProduction.h"
 #include "crpropa/module/Redshift.h"
+#include "crpropa/module/ContinuousEnergyLoss.h"
+#include "crpropa/module/Tools.h"
+#include "crpropa/module/WeightWindow.h"
 #include "crpropa/module/EMPairProduction.h"
 #include "crpropa/module/EMDoublePairProduction.h"
 #include "crpropa/module/EMTripletPairProduction.h"
 #include "crpropa/module/EMInverseComptonScattering.h"
 #include "gtest/gtest.h"
 
+#include <cstdio>
 #include <fstream>
 
 namespace crpropa {
@@ -268,6 +276,30 @@ TEST(NuclearDecay, secondaries) {
 	EXPECT_GE(nPhotons, 1);
 }
 
+TEST(NuclearDecay, thinning) {
+	// Test if thinned secondaries carry the weight 1 / f^thinning.
+	// With maximum thinning the weighted energy of each secondary equals the
+	// energy of the nucleus, and only a few of the secondaries are kept.
+	NuclearDecay d(true, true, true, 0.1, 1);
+	EXPECT_EQ(1, d.getNeutrinoThinning());
+	Candidate c;
+
+	// He-8 --> Li-8 + e- + neutrino
+	for (int i = 0; i < 1000; ++i) {
+		c.current.setId(nucleusId(8, 2));
+		c.current.setEnergy(5 * EeV);
+		d.performInteraction(&c, 10000);
+	}
+
+	EXPECT_LT(c.secondaries.size(), 100);
+	for (size_t i = 0; i < c.secondaries.size(); ++i) {
+		double w = c.secondaries[i]->getWeight();
+		double E = c.secondaries[i]->current.getEnergy();
+		EXPECT_GT(w, 1);
+		EXPECT_NEAR(w * E, 5 * EeV, 0.01 * EeV);
+	}
+}
+
 TEST(NuclearDecay, thisIsNotNucleonic) {
 	// Test if nothing happens to an electron
 	NuclearDecay decay;
@@ -619,6 +651,68 @@ TEST(Redshift, limitRedshiftDecrease) {
 	EXPECT_DOUBLE_EQ(0, c.getRedshift());
 }
 
+// ContinuousEnergyLoss -------------------------------------------------------
+TEST(ContinuousEnergyLoss, redshift) {
+	// Test if the redshift and the adiabatic energy loss are exact for large steps.
+	ContinuousEnergyLoss loss;
+	double z = comovingDistance2Redshift(1000 * Mpc);
+
+	Candidate c(22, 100 * EeV);
+	c.setRedshift(z);
+	c.setCurrentStep(600 * Mpc);
+	loss.process(&c);
+	double z2 = comovingDistance2Redshift(400 * Mpc);
+	EXPECT_NEAR(z2, c.getRedshift(), 1e-4 * z2);
+	EXPECT_NEAR(100 * (1 + z2) / (1 + z), c.current.getEnergy() / EeV, 1e-6);
+
+	// no redshift below 0
+	c.setCurrentStep(600 * Mpc);
+	loss.process(&c);
+	EXPECT_DOUBLE_EQ(0, c.getRedshift());
+	EXPECT_NEAR(100 / (1 + z), c.current.getEnergy() / EeV, 1e-6);
+}
+
+TEST(ContinuousEnergyLoss, consistentWithModules) {
+	// Test if one large step agrees with Redshift and ElectronPairProduction in small steps.
+	ref_ptr<PhotonField> cmb = new CMB();
+	ref_ptr<PhotonField> irb = new IRB_Gilmore12();
+	ContinuousEnergyLoss loss;
+	loss.addElectronPairProduction(cmb);
+	loss.addElectronPairProduction(irb);
+	Redshift redshift;
+	ElectronPairProduction eppCMB(cmb, false, 0.001);
+	ElectronPairProduction eppIRB(irb, false, 0.001);
+
+	int ids[] = {nucleusId(1, 1), nucleusId(56, 26)};
+	double energies[] = {5 * EeV, 50 * EeV, 500 * EeV};
+	for (int i = 0; i < 2; i++) {
+		for (int j = 0; j < 3; j++) {
+			double z = comovingDistance2Redshift(1000 * Mpc);
+			Candidate c1(ids[i], energies[j]);
+			c1.setRedshift(z);
+			Candidate c2(ids[i], energies[j]);
+			c2.setRedshift(z);
+
+			c1.setCurrentStep(1000 * Mpc);
+			loss.process(&c1);
+
+			double remaining = 1000 * Mpc;
+			c2.setNextStep(1 * Mpc);
+			while (remaining > 0) {
+				double step = std::min(remaining, c2.getNextStep());
+				c2.setCurrentStep(step);
+				c2.setNextStep(1 * Mpc);
+				redshift.process(&c2);
+				eppCMB.process(&c2);
+				eppIRB.process(&c2);
+				remaining -= step;
+			}
+
+			EXPECT_NEAR(c2.current.getEnergy(), c1.current.getEnergy(), 2e-3 * c2.current.getEnergy());
+		}
+	}
+}
+
 // EMPairProduction -----------------------------------------------------------
 TEST(EMPairProduction, allBackgrounds) {
 	// Test if interaction data files are loaded.
@@ -967,6 +1061,144 @@ TEST(EMInverseComptonScattering, secondaries) {
 	}
 }
 
+// RateTableBuilder -----------------------------------------------------------
+TEST(RateTableBuilder, thomsonLimit) {
+	// Test if the inverse Compton rate of GeV electrons on the CMB is sigma_T * n.
+	RateTableBuilder builder(new CMB());
+	double kT = k_boltzmann * 2.73 * kelvin;
+	double n = 2 * 1.2020569 / M_PI / M_PI * pow(kT * 2 * M_PI / h_planck / c_light, 3);
+	double rate = builder.rate(RateTableBuilder::sigmaInverseComptonScattering, 0, 1 * GeV);
+	EXPECT_NEAR(6.6524587e-29 * n, rate, 0.01 * rate);
+}
+
+struct BuilderTestTable: public Referenced {
+	BuilderTestTable(const std::string &) {
+	}
+};
+
+TEST(RateTableBuilder, tables) {
+	// Test if the written tables are consistent with the computed rates.
+	RateTableBuilder builder(new CMB());
+	builder.buildEMPairProduction("RateTableBuilderTest");
+	std::string rateFile = "RateTableBuilderTest/EMPairProduction/rate_CMB.txt";
+	std::string cdfFile = "RateTableBuilderTest/EMPairProduction/cdf_CMB.txt";
+	ref_ptr<DataTable> rates = DataTable::load(rateFile);
+	ref_ptr<DataTable> cdf = DataTable::load(cdfFile);
+	EXPECT_TRUE(rates->rows() > 1);
+	EXPECT_EQ(rates->rows() + 1, cdf->rows());
+
+	double smin = 4 * pow(mass_electron * c_squared, 2);
+	for (size_t i = 0; i < rates->rows(); i += 50) {
+		double E = pow(10, (*rates)(i, 0)) * eV;
+		double expected = builder.rate(RateTableBuilder::sigmaPairProduction, smin, E) * Mpc;
+		EXPECT_NEAR(expected, (*rates)(i, 1), 1e-3 * expected);
+
+		// cumulative rate starts at 0 below the threshold and ends at the total rate
+		const double *row = cdf->row(i + 1);
+		size_t n = cdf->columns(i + 1);
+		EXPECT_DOUBLE_EQ((*rates)(i, 0), row[0]);
+		EXPECT_EQ(0, row[1]);
+		EXPECT_DOUBLE_EQ((*rates)(i, 1), row[n - 1]);
+		for (size_t j = 2; j < n; j++)
+			EXPECT_LE(row[j - 1], row[j]);
+	}
+
+	// rebuilding drops the registered tables of the written files
+	ref_ptr<const BuilderTestTable> registered = TableRegistry::get<BuilderTestTable>(rateFile);
+	builder.buildEMPairProduction("RateTableBuilderTest");
+	EXPECT_NE(registered.get(), TableRegistry::get<BuilderTestTable>(rateFile).get());
+
+	remove(DataTable::getCacheFilename(rateFile).c_str());
+	remove(DataTable::getCacheFilename(cdfFile).c_str());
+	remove(rateFile.c_str());
+	remove(cdfFile.c_str());
+	remove("RateTableBuilderTest/EMPairProduction");
+	remove("RateTableBuilderTest");
+}
+// SecondaryCoalescence -------------------------------------------------------
+TEST(SecondaryCoalescence, merge) {
+	// Test if secondaries of a step are merged per species and energy bin.
+	SecondaryCoalescence m(10, 10 * PeV);
+	Candidate c(11, 1 * EeV);
+	double Ephotons = 0;
+	for (int i = 0; i < 1000; i++) {
+		double E = (1 + 0.0002 * i) * TeV;
+		c.addSecondary(22, E);
+		Ephotons += E;
+	}
+	for (int i = 0; i < 10; i++)
+		c.addSecondary(11, 1 * PeV, 0.5);
+	c.addSecondary(22, 100 * PeV); // above the maximum energy
+	m.process(&c);
+
+	ASSERT_EQ(3, c.secondaries.size());
+	for (size_t i = 0; i < c.secondaries.size(); i++) {
+		const Candidate *s = c.secondaries[i];
+		double Ew = s->getWeight() * s->current.getEnergy();
+		if (s->current.getId() == 11)
+			EXPECT_NEAR(5 * PeV, Ew, 1e-9 * Ew);
+		else if (s->current.getEnergy() < PeV)
+			EXPECT_NEAR(Ephotons, Ew, 1e-9 * Ew);
+		else
+			EXPECT_EQ(1, s->getWeight());
+	}
+
+	// secondaries of previous steps are not merged again
+	m.process(&c);
+	EXPECT_EQ(3, c.secondaries.size());
+	c.addSecondary(22, 1 * TeV);
+	c.addSecondary(22, 1 * TeV);
+	m.process(&c);
+	EXPECT_EQ(4, c.secondaries.size());
+}
+
+TEST(SecondaryCoalescence, splitCandidate) {
+	// Test if the copies of a split candidate merge their own secondaries
+	// and are not merged with each other as secondaries of the original.
+	SecondaryCoalescence m;
+	Candidate c(11, 1 * EeV);
+	for (int i = 0; i < 5; i++)
+		c.addSecondary(22, 1 * TeV);
+	m.process(&c);
+	ASSERT_EQ(1, c.secondaries.size());
+
+	WeightWindow::split(&c, 3);
+	m.process(&c);
+	ASSERT_EQ(3, c.secondaries.size());
+
+	Candidate *copy = c.secondaries[1];
+	EXPECT_EQ(11, copy->current.getId());
+	copy->addSecondary(22, 1 * TeV);
+	copy->addSecondary(22, 1 * TeV);
+	m.process(copy);
+	EXPECT_EQ(1, copy->secondaries.size());
+
+	// secondaries of the original after the split are still merged
+	c.addSecondary(22, 1 * TeV);
+	c.addSecondary(22, 1 * TeV);
+	m.process(&c);
+	EXPECT_EQ(4, c.secondaries.size());
+}
+
+TEST(SecondaryCoalescence, spectrum) {
+	// Test if the expected weighted number per energy is unchanged.
+	SecondaryCoalescence m;
+	double n1 = 0, n2 = 0;
+	int trials = 10000;
+	for (int i = 0; i < trials; i++) {
+		Candidate c(11, 1 * EeV);
+		c.addSecondary(22, 1 * TeV);
+		c.addSecondary(22, 1.2 * TeV, 2);
+		m.process(&c);
+		ASSERT_EQ(1, c.secondaries.size());
+		if (c.secondaries[0]->current.getEnergy() == 1 * TeV)
+			n1 += c.secondaries[0]->getWeight();
+		else
+			n2 += c.secondaries[0]->getWeight();
+	}
+	EXPECT_NEAR(1, n1 / trials, 0.05);
+	EXPECT_NEAR(2, n2 / trials, 0.05);
+}
 
 int main(int argc, char **argv) {
 	::testing::InitGoogleTest(&argc, argv);
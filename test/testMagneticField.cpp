@@ -1,9 +1,14 @@
+#include <fstream>
+#include <iterator>
 #include <stdexcept>
 
 #include "crpropa/magneticField/MagneticFieldGrid.h"
+#include "crpropa/magneticField/CachedMagneticField.h"
 #include "crpropa/magneticField/CMZField.h"
+#include "crpropa/magneticField/JF12Field.h"
 #include "crpropa/magneticField/PolarizedSingleModeMagneticField.h"
 #include "crpropa/Grid.h"
+#include "crpropa/Random.h"
 #include "crpropa/Units.h"
 #include "crpropa/Common.h"
 
@@ -102,6 +107,232 @@ TEST(testPeriodicMagneticField, Exceptions) {
 
 }
 
+TEST(testMagneticField, getFields) {
+	// the batch evaluation gives the same fields as getField
+	std::vector<Vector3d> positions;
+	for (int i = 0; i < 5; i++)
+		positions.push_back(Vector3d(i * 3000, -2000, i * 4000 + 500));
+	std::vector<Vector3d> b(positions.size());
+
+	ref_ptr<Grid3f> grid = new Grid3f(Vector3d(0.), 4, 1000);
+	for (int ix = 0; ix < 4; ix++)
+		for (int iy = 0; iy < 4; iy++)
+			for (int iz = 0; iz < 4; iz++)
+				grid->get(ix, iy, iz) = Vector3f(ix, iy, iz * iz);
+
+	ref_ptr<MagneticFieldList> list = new MagneticFieldList();
+	list->addField(new UniformMagneticField(Vector3d(1, 2, 3)));
+	list->addField(new MagneticFieldGrid(grid));
+	list->addField(new PeriodicMagneticField(new EchoMagneticField(), Vector3d(5000), Vector3d(0.), true));
+	MagneticFieldEvolution evolution(list, 2);
+
+	list->getFields(positions.data(), b.data(), positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+		EXPECT_EQ(list->getField(positions[i]), b[i]);
+
+	evolution.getFields(positions.data(), b.data(), positions.size(), 0.5);
+	for (size_t i = 0; i < positions.size(); i++)
+		EXPECT_EQ(evolution.getField(positions[i], 0.5), b[i]);
+
+	// default implementation
+	EchoMagneticField echo;
+	echo.getFields(positions.data(), b.data(), positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+		EXPECT_EQ(positions[i], b[i]);
+}
+
+class BoxMagneticField: public MagneticField {
+public:
+	Vector3d getField(const Vector3d &/*position*/) const {
+		return Vector3d(0, 0, 1);
+	}
+	bool getSupport(Vector3d &lower, Vector3d &upper) const {
+		lower = Vector3d(-1, -1, -1);
+		upper = Vector3d(1, 1, 1);
+		return true;
+	}
+	double getVariationScale() const {
+		return 0.5;
+	}
+};
+
+TEST(testMagneticFieldMetadata, Defaults) {
+	// no assumptions for an unknown field
+	EchoMagneticField f;
+	Vector3d lower, upper;
+	EXPECT_FALSE(f.getSupport(lower, upper));
+	EXPECT_EQ(0, f.getVariationScale());
+	EXPECT_EQ(0, f.getUniformRadius(Vector3d(0.)));
+
+	// uniform radius from the support
+	BoxMagneticField b;
+	EXPECT_EQ(0, b.getUniformRadius(Vector3d(0.5, 0, 0)));
+	EXPECT_DOUBLE_EQ(2, b.getUniformRadius(Vector3d(3, 0, 0)));
+	EXPECT_DOUBLE_EQ(5, b.getUniformRadius(Vector3d(4, 5, 0)));
+
+	// only the zero uniform field is declared uniform
+	EXPECT_EQ(0, UniformMagneticField(Vector3d(1, 0, 0)).getUniformRadius(Vector3d(0.)));
+	EXPECT_TRUE(std::isinf(UniformMagneticField(Vector3d(0.)).getUniformRadius(Vector3d(0.))));
+}
+
+TEST(testMagneticFieldMetadata, ListAndPeriodic) {
+	MagneticFieldList list;
+	list.addField(new BoxMagneticField());
+	list.addField(new UniformMagneticField(Vector3d(0.)));
+	Vector3d lower, upper;
+	EXPECT_FALSE(list.getSupport(lower, upper)); // the uniform field is unbounded
+	EXPECT_DOUBLE_EQ(0.5, list.getVariationScale());
+	EXPECT_DOUBLE_EQ(2, list.getUniformRadius(Vector3d(0, 0, 3)));
+
+	MagneticFieldList boxes;
+	boxes.addField(new BoxMagneticField());
+	boxes.addField(new PeriodicMagneticField(new BoxMagneticField(), Vector3d(10.))); // unbounded
+	EXPECT_FALSE(boxes.getSupport(lower, upper));
+
+	// the uniform region ends at the cell walls
+	PeriodicMagneticField p(new BoxMagneticField(), Vector3d(10.));
+	EXPECT_DOUBLE_EQ(0.5, p.getVariationScale());
+	EXPECT_DOUBLE_EQ(sqrt(0.33), p.getUniformRadius(Vector3d(1.5, 1.2, 1.2)));
+	EXPECT_DOUBLE_EQ(3, p.getUniformRadius(Vector3d(3, 5, 5)));
+	EXPECT_DOUBLE_EQ(1, p.getUniformRadius(Vector3d(29, 5, 5)));
+}
+
+TEST(testMagneticFieldMetadata, JF12) {
+	JF12Field field;
+	Vector3d lower, upper;
+	EXPECT_TRUE(field.getSupport(lower, upper));
+	EXPECT_DOUBLE_EQ(20 * kpc, upper.x);
+	EXPECT_DOUBLE_EQ(-20 * kpc, lower.z);
+	EXPECT_GT(field.getVariationScale(), 0);
+	EXPECT_LT(field.getVariationScale(), 1 * kpc);
+	EXPECT_EQ(0, field.getUniformRadius(Vector3d(-8.5 * kpc, 0, 0)));
+	EXPECT_DOUBLE_EQ(10 * kpc, field.getUniformRadius(Vector3d(0, 30 * kpc, 0)));
+	EXPECT_EQ(Vector3d(0.), field.getField(Vector3d(0, 30 * kpc, 0)));
+}
+
+TEST(testMagneticFieldMetadata, propagateUniform) {
+	// gyration of a proton in a field along z
+	double E = 100 * EeV;
+	Vector3d B(0, 0, 1 * nG);
+	double rg = E / (eplus * c_light * B.getR());
+	Vector3d pos(0.), dir(0, 1, 0);
+	propagateUniform(pos, dir, B, eplus, E, M_PI / 2 * rg);
+	// quarter circle around (rg, 0, 0) for a positive charge
+	EXPECT_NEAR(rg, pos.x, 1e-10 * rg);
+	EXPECT_NEAR(rg, pos.y, 1e-10 * rg);
+	EXPECT_NEAR(0, pos.z, 1e-10 * rg);
+	EXPECT_NEAR(1, dir.x, 1e-10);
+	EXPECT_NEAR(0, dir.y, 1e-10);
+
+	// motion parallel to the field is unaffected
+	pos = Vector3d(0.);
+	dir = Vector3d(0, 0, 1);
+	propagateUniform(pos, dir, B, eplus, E, rg);
+	EXPECT_NEAR(rg, pos.z, 1e-10 * rg);
+	EXPECT_NEAR(0, pos.x, 1e-10 * rg);
+}
+
+class WaveMagneticField: public MagneticField {
+public:
+	Vector3d getField(const Vector3d &position) const {
+		return Vector3d(sin(position.y), cos(position.z), 1 + position.x * position.y);
+	}
+};
+
+class StepMagneticField: public MagneticField {
+public:
+	Vector3d getField(const Vector3d &position) const {
+		return Vector3d(0, 0, (position.x < 0.3) ? 1 : -1);
+	}
+};
+
+TEST(testCachedMagneticField, errorBound) {
+	ref_ptr<WaveMagneticField> field = new WaveMagneticField();
+	double relativeError = 1e-4;
+	CachedMagneticField cache(field, Vector3d(-2.), Vector3d(2.), 1, relativeError);
+	EXPECT_EQ(64, cache.getNumberOfBlocks());
+	EXPECT_EQ(0, cache.getNumberOfUnresolvedBlocks());
+
+	Random random(42);
+	for (int i = 0; i < 1000; i++) {
+		Vector3d p = Vector3d(random.rand(), random.rand(), random.rand()) * 4 - 2;
+		// bound relative to the largest field strength in the box
+		EXPECT_NEAR(0, (cache.getField(p) - field->getField(p)).getR(), 10 * relativeError);
+	}
+
+	// the field itself outside of the box
+	EXPECT_EQ(field->getField(Vector3d(3, 0, 0)), cache.getField(Vector3d(3, 0, 0)));
+}
+
+TEST(testCachedMagneticField, adaptive) {
+	// linear field, interpolated exactly at the lowest level
+	CachedMagneticField linear(new EchoMagneticField(), Vector3d(0.), Vector3d(2.), 1, 1e-6, 4);
+	EXPECT_EQ(8 * 5 * 5 * 5, linear.getNumberOfNodes());
+	EXPECT_NEAR(0.3, linear.getField(Vector3d(0.3, 1.2, 1.7)).x, 1e-6);
+
+	// discontinuity: the field is evaluated in the unresolved blocks
+	ref_ptr<StepMagneticField> step = new StepMagneticField();
+	CachedMagneticField cache(step, Vector3d(0.), Vector3d(2.), 1, 1e-3);
+	EXPECT_EQ(4, cache.getNumberOfUnresolvedBlocks());
+	EXPECT_EQ(1, cache.getField(Vector3d(0.29, 0.5, 0.5)).z);
+	EXPECT_EQ(-1, cache.getField(Vector3d(0.31, 0.5, 0.5)).z);
+	EXPECT_EQ(-1, cache.getField(Vector3d(1.5, 0.5, 0.5)).z);
+}
+
+TEST(testCachedMagneticField, supportAndFile) {
+	// box from the support of the field
+	CachedMagneticField cache(new BoxMagneticField(), 0.5);
+	EXPECT_EQ(64, cache.getNumberOfBlocks());
+	EXPECT_EQ(Vector3d(-1.), cache.getOrigin());
+	EXPECT_THROW(CachedMagneticField(new EchoMagneticField(), 0.5), std::runtime_error);
+
+	ref_ptr<WaveMagneticField> field = new WaveMagneticField();
+	CachedMagneticField cache1(field, Vector3d(-2.), Vector3d(2.), 1, 1e-3);
+	cache1.save("testCachedMagneticField.bin");
+	CachedMagneticField cache2(field, "testCachedMagneticField.bin");
+	EXPECT_EQ(cache1.getNumberOfNodes(), cache2.getNumberOfNodes());
+	EXPECT_EQ(cache1.getRelativeError(), cache2.getRelativeError());
+	Random random(42);
+	for (int i = 0; i < 100; i++) {
+		Vector3d p = Vector3d(random.rand(), random.rand(), random.rand()) * 4 - 2;
+		EXPECT_EQ(cache1.getField(p), cache2.getField(p));
+	}
+	std::ofstream("testCachedMagneticFieldInvalid.bin") << "no cache";
+	EXPECT_THROW(CachedMagneticField(field, "testCachedMagneticFieldInvalid.bin"), std::runtime_error);
+
+	// corrupted block table: the first block (after the 104 byte header) points past the nodes
+	std::ifstream in("testCachedMagneticField.bin", std::ios::binary);
+	std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	uint64_t block[2] = {cache1.getNumberOfNodes(), 2}; // offset, nodes per axis
+	data.replace(104, sizeof(block), reinterpret_cast<const char*>(block), sizeof(block));
+	std::ofstream("testCachedMagneticFieldInvalid.bin", std::ios::binary) << data;
+	EXPECT_THROW(CachedMagneticField(field, "testCachedMagneticFieldInvalid.bin"), std::runtime_error);
+	block[0] = 0;
+	block[1] = 1; // a single node per axis
+	data.replace(104, sizeof(block), reinterpret_cast<const char*>(block), sizeof(block));
+	std::ofstream("testCachedMagneticFieldInvalid.bin", std::ios::binary) << data;
+	EXPECT_THROW(CachedMagneticField(field, "testCachedMagneticFieldInvalid.bin"), std::runtime_error);
+}
+
+TEST(testOctreeMagneticField, SimpleTest) {
+	ref_ptr<OctreeGrid3f> grid = new OctreeGrid3f(Vector3d(0.), 2, 1 * kpc);
+	grid->setCell(Vector3d(0.1 * kpc), 0, Vector3f(1, 2, 3));
+	grid->setCell(Vector3d(1.1 * kpc), 2, Vector3f(4, 5, 6));
+	grid->update();
+	OctreeMagneticField field(grid);
+
+	EXPECT_EQ(grid->interpolate(Vector3d(0.7 * kpc)), Vector3f(field.getField(Vector3d(0.7 * kpc))));
+	EXPECT_DOUBLE_EQ(0.25 * kpc, field.getVariationScale());
+
+	Vector3d lower, upper;
+	EXPECT_FALSE(field.getSupport(lower, upper));
+	grid->setPeriodic(false);
+	EXPECT_TRUE(field.getSupport(lower, upper));
+	EXPECT_EQ(Vector3d(0.), lower);
+	EXPECT_EQ(Vector3d(2 * kpc), upper);
+	EXPECT_EQ(Vector3d(0.), field.getField(Vector3d(-0.1 * kpc)));
+}
+
 TEST(testCMZMagneticField, SimpleTest) {
 	ref_ptr<CMZField> field = new CMZField();
 	
@@ -269,6 +269,78 @@ TEST(ParticleCollector, runModuleList) {
 	modules.run(&candidates);
 }
 
+TEST(ResponseMatrix, fill) {
+	// photons from 10 Mpc, all detected with the source energy
+	ref_ptr<ResponseMatrix> rm = new ResponseMatrix(1 * EeV, 100 * EeV, 4);
+
+	ModuleList sim;
+	sim.add(new ResponseInjection(rm));
+	sim.add(new SimplePropagation(1 * Mpc, 1 * Mpc));
+	ref_ptr<Observer> obs = new Observer();
+	obs->add(new ObserverPoint());
+	obs->onDetection(rm);
+	sim.add(obs);
+
+	Source source;
+	source.add(new SourcePosition(10 * Mpc));
+	source.add(new SourceDirection(Vector3d(-1, 0, 0)));
+	source.add(new SourceParticleType(22));
+	source.add(new SourcePowerLawSpectrum(1 * EeV, 100 * EeV, -1));
+	for (int i = 0; i < 1000; i++)
+		sim.run(source.getCandidate());
+
+	double total = 0;
+	for (size_t i = 0; i < 4; i++)
+		total += rm->getInjected(22, i);
+	EXPECT_DOUBLE_EQ(1000, total);
+	EXPECT_EQ(1, rm->getSourceIds().size());
+	EXPECT_EQ(1, rm->getObservedIds().size());
+	for (size_t i = 0; i < 4; i++)
+		for (size_t j = 0; j < 4; j++)
+			EXPECT_DOUBLE_EQ((i == j) ? 1 : 0, rm->getResponse(22, i, 0, 22, j));
+
+	// folding with a power law reproduces the source spectrum:
+	// E^-2 --> counts per logarithmic bin of width 0.5 fall off by a factor 10^-0.5
+	std::vector<double> spectrum = rm->foldPowerLaw(22, 22, -2);
+	double sum = 0;
+	for (size_t i = 0; i < 4; i++)
+		sum += spectrum[i];
+	EXPECT_NEAR(1, sum, 1e-12);
+	for (size_t i = 1; i < 4; i++)
+		EXPECT_NEAR(pow(10, -0.5), spectrum[i] / spectrum[i - 1], 1e-12);
+
+	// cut off above 10 EeV
+	spectrum = rm->foldPowerLaw(22, 22, -2, 10 * EeV);
+	EXPECT_EQ(0, spectrum[2]);
+	EXPECT_EQ(0, spectrum[3]);
+
+	// no response for other species
+	spectrum = rm->foldPowerLaw(11, 22, -2);
+	EXPECT_EQ(0, spectrum[0]);
+}
+
+TEST(ResponseMatrix, dumpload) {
+	ResponseMatrix input(1 * EeV, 100 * EeV, 4, 0, 100 * Mpc, 2);
+	Candidate c(22, 2 * EeV);
+	c.source.setPosition(Vector3d(70 * Mpc, 0, 0));
+	input.inject(&c);
+	input.inject(&c);
+	c.current.setEnergy(20 * EeV);
+	input.process(&c);
+
+	input.dump("ResponseMatrix_DumpTest.txt");
+	ResponseMatrix output(1 * EeV, 100 * EeV, 4, 0, 100 * Mpc, 2);
+	output.load("ResponseMatrix_DumpTest.txt");
+	EXPECT_DOUBLE_EQ(2, output.getInjected(22, 0, 1));
+	EXPECT_DOUBLE_EQ(0.5, output.getResponse(22, 0, 1, 22, 2));
+
+	// loading adds to the counts, the binning has to agree
+	output.load("ResponseMatrix_DumpTest.txt");
+	EXPECT_DOUBLE_EQ(4, output.getInjected(22, 0, 1));
+	ResponseMatrix other(1 * EeV, 100 * EeV, 5);
+	EXPECT_THROW(other.load("ResponseMatrix_DumpTest.txt"), std::runtime_error);
+}
+
 int main(int argc, char **argv) {
 	::testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
@@ -3,6 +3,7 @@
 #include "crpropa/module/SimplePropagation.h"
 #include "crpropa/module/PropagationBP.h"
 #include "crpropa/module/PropagationCK.h"
+#include "crpropa/module/Observer.h"
 
 #include "gtest/gtest.h"
 
@@ -53,7 +54,8 @@ TEST(testPropagationCK, zeroField) {
 	propa.process(&c);
 
 	EXPECT_DOUBLE_EQ(minStep, c.getCurrentStep());  // perform minimum step
-	EXPECT_DOUBLE_EQ(5 * minStep, c.getNextStep());  // acceleration by factor 5
+	EXPECT_DOUBLE_EQ(propa.getMaximumStep(), c.getNextStep());  // no field, no step limitation
+	EXPECT_EQ(Vector3d(0, minStep, 0), c.current.getPosition());
 }
 
 
@@ -99,6 +101,31 @@ TEST(testPropagationCK, neutron) {
 }
 
 
+TEST(testPropagationCK, neutralFastForward) {
+	// neutral particles are moved to the observer in one step
+	PropagationCK propa(new UniformMagneticField(Vector3d(0, 0, 1 * nG)), 1e-4, 1 * kpc, 1 * Mpc);
+	EXPECT_DOUBLE_EQ(1 * Mpc, propa.getMaximumNeutralStep());
+	propa.setMaximumNeutralStep(10 * Gpc);
+	EXPECT_DOUBLE_EQ(10 * Gpc, propa.getMaximumNeutralStep());
+
+	Observer obs;
+	obs.add(new ObserverSurface(new Sphere(Vector3d(0, 0, 0), 1 * Mpc)));
+
+	Candidate c(22, 1 * EeV, Vector3d(100 * Mpc, 0.6 * Mpc, 0), Vector3d(-1, 0, 0));
+	int steps = 0;
+	while (c.isActive() and (steps < 100)) {
+		propa.process(&c);
+		obs.process(&c);
+		steps++;
+	}
+	EXPECT_LE(steps, 3);
+	EXPECT_FALSE(c.isActive());
+	EXPECT_NEAR(0.8 * Mpc, c.current.getPosition().x, 1 * kpc); // crossing within the minimum step
+
+	EXPECT_THROW(propa.setMaximumNeutralStep(0.1 * kpc), std::runtime_error);
+}
+
+
 TEST(testPropagationBP, zeroField) {
 	PropagationBP propa(new UniformMagneticField(Vector3d(0, 0, 0)), 1 * kpc);
 
@@ -117,7 +144,8 @@ TEST(testPropagationBP, zeroField) {
 	propa.process(&c);
 
 	EXPECT_DOUBLE_EQ(minStep, c.getCurrentStep());  // perform minimum step
-	EXPECT_DOUBLE_EQ(5 * minStep, c.getNextStep());  // acceleration by factor 5
+	EXPECT_DOUBLE_EQ(propa.getMaximumStep(), c.getNextStep());  // no field, no step limitation
+	EXPECT_EQ(Vector3d(0, minStep, 0), c.current.getPosition());
 }
 
 
@@ -3,11 +3,13 @@
 #include "crpropa/Grid.h"
 #include "crpropa/Units.h"
 #include "crpropa/Common.h"
+#include "crpropa/Random.h"
 #include "crpropa/GridTools.h"
 #include "crpropa/magneticField/turbulentField/TurbulentField.h"
 #include "crpropa/magneticField/turbulentField/GridTurbulence.h"
 #include "crpropa/magneticField/turbulentField/PlaneWaveTurbulence.h"
 #include "crpropa/magneticField/turbulentField/SimpleGridTurbulence.h"
+#include "crpropa/magneticField/turbulentField/TiledGridTurbulence.h"
 
 #include "gtest/gtest.h"
 
@@ -39,6 +41,49 @@ TEST(testTurbulenceSpectrum, correlationLength) {
     EXPECT_NEAR(Lc, 0.498*lBo, 0.001*lBo);
 }
 
+TEST(testPlaneWaveTurbulence, getFields) {
+	// the batch evaluation gives the same fields as getField
+	auto spectrum = TurbulenceSpectrum(1 * muG, 10 * pc, 1 * kpc);
+	PlaneWaveTurbulence field(spectrum, 50, 42);
+
+	std::vector<Vector3d> positions;
+	for (int i = 0; i < 7; i++)
+		positions.push_back(Vector3d(i * 130, -i * 70, i * i * 20) * pc);
+	std::vector<Vector3d> b(positions.size());
+	field.getFields(positions.data(), b.data(), positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+		EXPECT_EQ(field.getField(positions[i]), b[i]);
+}
+
+TEST(testPlaneWaveTurbulence, Kernels) {
+	// all kernels supported by the CPU agree with the scalar implementation
+	auto spectrum = TurbulenceSpectrum(1 * muG, 10 * pc, 1 * kpc);
+	PlaneWaveTurbulence field(spectrum, 100, 42);
+	EXPECT_EQ(field.getBestKernel(), field.getKernel());
+	EXPECT_THROW(field.setKernel(planeWaveKernelType(PLANEWAVE_AVX512 + 1)), std::runtime_error);
+
+	std::vector<Vector3d> positions;
+	for (int i = 0; i < 11; i++)
+		positions.push_back(Vector3d(i * 1300, -i * 700, i * i * 200) * pc);
+	std::vector<Vector3d> expected(positions.size()), b(positions.size());
+	field.setKernel(PLANEWAVE_SCALAR);
+	field.getFields(positions.data(), expected.data(), positions.size());
+
+	for (int k = PLANEWAVE_SSE4; k <= field.getBestKernel(); k++) {
+		field.setKernel(planeWaveKernelType(k));
+		for (int single = 0; single < 2; single++) {
+			field.setSinglePrecision(single);
+			field.getFields(positions.data(), b.data(), positions.size());
+			for (size_t i = 0; i < positions.size(); i++) {
+				EXPECT_NEAR(expected[i].x, b[i].x, 1e-5 * muG);
+				EXPECT_NEAR(expected[i].y, b[i].y, 1e-5 * muG);
+				EXPECT_NEAR(expected[i].z, b[i].z, 1e-5 * muG);
+				EXPECT_EQ(field.getField(positions[i]), b[i]);
+			}
+		}
+	}
+}
+
 #ifdef CRPROPA_HAVE_FFTW3F
 
 TEST(testSimpleGridTurbulence, oldFunctionForCrrelationLength) { //TODO: remove in future
@@ -91,6 +136,83 @@ TEST(testVectorFieldGrid, Turbulence_seed) {
 	EXPECT_FLOAT_EQ(tf1.getField(pos).x, tf2.getField(pos).x);
 }
 
+TEST(testGridTurbulence, OutOfCore) {
+	// the field generated in a file is the same as in memory
+	size_t n = 16;
+	double spacing = 1 * Mpc;
+	auto spectrum = TurbulenceSpectrum(1 * muG, 2 * spacing, 8 * spacing, 2 * spacing);
+	auto gp = GridProperties(Vector3d(0.), n, spacing);
+	auto tf1 = GridTurbulence(spectrum, gp, 42);
+	auto tf2 = GridTurbulence(spectrum, gp, 42, "turbulence.grid");
+
+	ref_ptr<Grid3f> grid1 = tf1.getGrid();
+	ref_ptr<Grid3f> grid2 = tf2.getGrid();
+	const Grid3f &mapped = *grid2; // read-only access
+	EXPECT_TRUE(grid2->isMapped());
+	EXPECT_EQ(n, grid2->getNx());
+	EXPECT_NEAR(1 * muG, tf2.getRmsFieldStrength(), 1e-3 * muG);
+	for (size_t ix = 0; ix < n; ix++)
+		for (size_t iy = 0; iy < n; iy++)
+			for (size_t iz = 0; iz < n; iz++) {
+				Vector3f b1 = grid1->get(ix, iy, iz);
+				Vector3f b2 = mapped.get(ix, iy, iz);
+				EXPECT_NEAR(b1.x, b2.x, 1e-4 * muG);
+				EXPECT_NEAR(b1.y, b2.y, 1e-4 * muG);
+				EXPECT_NEAR(b1.z, b2.z, 1e-4 * muG);
+			}
+
+	// the file can be mapped again
+	const Grid3f grid3("turbulence.grid");
+	EXPECT_EQ(mapped.get(3, 5, 7), grid3.get(3, 5, 7));
+	grid2 = 0;
+	remove("turbulence.grid");
+}
+
+TEST(testTiledGridTurbulence, Tiles) {
+	size_t n = 16;
+	double spacing = 1 * Mpc;
+	double size = n * spacing;
+	auto spectrum = TurbulenceSpectrum(1 * muG, 2 * spacing, 8 * spacing, 2 * spacing);
+	auto gp = GridProperties(Vector3d(0.), n, spacing);
+	TiledGridTurbulence field1(spectrum, gp, 42, 8);
+	TiledGridTurbulence field2(spectrum, gp, 42, 64);
+	EXPECT_DOUBLE_EQ(size, field1.getTileSize());
+
+	// the field does not depend on the order of the evaluations, which evicts
+	// and regenerates the tiles of field1
+	Random random(5);
+	std::vector<Vector3d> positions;
+	for (int i = 0; i < 10; i++)
+		positions.push_back(random.randVector() * random.rand() * Gpc);
+	for (size_t i = 0; i < positions.size(); i++)
+		field2.getField(positions[positions.size() - 1 - i]);
+	for (size_t i = 0; i < positions.size(); i++)
+		EXPECT_EQ(field2.getField(positions[i]), field1.getField(positions[i]));
+	EXPECT_EQ(8, field1.getNumberOfCachedTiles());
+	EXPECT_EQ(64, field2.getNumberOfCachedTiles());
+	EXPECT_LT(64, field2.getNumberOfGeneratedTiles());
+
+	// not periodic, but continuous
+	Vector3d p(3.3 * size, -7.8 * size, 0.2 * size);
+	EXPECT_GT((field1.getField(p) - field1.getField(p + Vector3d(size, 0, 0))).getR(), 0.01 * muG);
+	EXPECT_NEAR(0, (field1.getField(p) - field1.getField(p + Vector3d(1e-3 * spacing))).getR(), 0.01 * muG);
+
+	// at the center of a tile only this tile contributes
+	Vector3d center = Vector3d(2, -3, 4) * size / 2 + Vector3d(size / 2);
+	Vector3d b = field1.getTile(2, -3, 4)->interpolate(center);
+	EXPECT_NEAR(b.x, field1.getField(center).x, 1e-6 * muG);
+
+	// RMS field strength of the tiles, which is reduced by the interpolation
+	ref_ptr<Grid3f> tile = field2.getTile(0, 0, 0);
+	double sumB2 = 0, sumTileB2 = 0;
+	for (int i = 0; i < 2000; i++) {
+		Vector3d r = Vector3d(random.rand(), random.rand(), random.rand()) * 2 * size;
+		sumB2 += field2.getField(r).getR2();
+		sumTileB2 += Vector3d(tile->interpolate(r)).getR2();
+	}
+	EXPECT_NEAR(1, std::sqrt(sumB2 / sumTileB2), 0.1);
+}
+
 TEST(testVectorFieldGrid, turbulence_Exceptions) {
 	// Test exceptions
 	size_t n = 64;
@@ -132,6 +254,30 @@ TEST(testGridTurbulence, Turbulence_seed) {
 	Vector3d pos(22 * Mpc);
 	EXPECT_FLOAT_EQ(tf1.getField(pos).x, tf2.getField(pos).x);
 }
+
+TEST(testGridTools, PowerSpectrum) {
+	// a single plane wave along x only contributes to its wave number
+	size_t n = 16;
+	ref_ptr<Grid3f> grid = new Grid3f(Vector3d(0.), n, 1.);
+	for (size_t ix = 0; ix < n; ix++)
+		for (size_t iy = 0; iy < n; iy++)
+			for (size_t iz = 0; iz < n; iz++)
+				grid->get(ix, iy, iz) = Vector3f(0, cos(2 * M_PI * 3 * ix / n), 0);
+
+	std::vector<std::pair<int, float> > spectrum = gridPowerSpectrum(grid);
+	EXPECT_EQ(n / 2, spectrum.size());
+	double peak = spectrum[2].second;
+	EXPECT_EQ(3, spectrum[2].first);
+	EXPECT_GT(peak, 0);
+	for (size_t i = 0; i < spectrum.size(); i++) {
+		EXPECT_EQ(i + 1, spectrum[i].first);
+		if (i != 2)
+			EXPECT_NEAR(0, spectrum[i].second, 1e-6 * peak);
+	}
+
+	ref_ptr<Grid3f> nonCubic = new Grid3f(Vector3d(0.), 4, 4, 8, 1.);
+	EXPECT_THROW(gridPowerSpectrum(nonCubic), std::runtime_error);
+}
 #endif // CRPROPA_HAVE_FFTW3F
 
 int main(int argc, char **argv) {